@@ -0,0 +1,289 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityGunMath.h"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <random>
+#include <vector>
+
+using namespace GravityGunMath;
+
+namespace
+{
+	const int NumElements = 4096;
+	const int NumIterations = 2000;
+	const float Tolerance = 1.e-3f;
+
+	struct FVec3Buffer
+	{
+		std::vector<float> X, Y, Z;
+
+		explicit FVec3Buffer(int Count) : X(Count), Y(Count), Z(Count) {}
+
+		FVec3Array View() { return FVec3Array{ X.data(), Y.data(), Z.data() }; }
+		FConstVec3Array ConstView() const { return FConstVec3Array(X.data(), Y.data(), Z.data()); }
+		FVec3 Get(int Index) const { return FVec3(X[Index], Y[Index], Z[Index]); }
+		void Set(int Index, const FVec3& V) { X[Index] = V.X; Y[Index] = V.Y; Z[Index] = V.Z; }
+	};
+
+	//Inputs in the ranges the grabber and launcher see in game
+	struct FInputs
+	{
+		FVec3Buffer Directions{ NumElements };
+		FVec3Buffer LinearVelocities{ NumElements };
+		FVec3Buffer AngularVelocities{ NumElements };
+		std::vector<float> Speeds = std::vector<float>(NumElements);
+		std::vector<float> DistanceToCenter = std::vector<float>(NumElements);
+		std::vector<float> DistanceToClosestPoint = std::vector<float>(NumElements);
+		std::vector<float> InitialGrabDistance = std::vector<float>(NumElements);
+
+		FInputs()
+		{
+			std::mt19937 Random(1234);
+			std::uniform_real_distribution<float> Unit(-1.f, 1.f);
+			std::uniform_real_distribution<float> Velocity(-2000.f, 2000.f);
+			std::uniform_real_distribution<float> Speed(0.f, 8000.f);
+			std::uniform_real_distribution<float> Distance(0.f, 950.f);
+
+			for (int Index = 0; Index < NumElements; Index++)
+			{
+				///Every 64th direction is zero, to cover the unnormalizable case
+				Directions.Set(Index, Index % 64 == 0 ? FVec3() : FVec3(Unit(Random), Unit(Random), Unit(Random)));
+				LinearVelocities.Set(Index, FVec3(Velocity(Random), Velocity(Random), Velocity(Random)));
+				AngularVelocities.Set(Index, FVec3(Unit(Random) * 10.f, Unit(Random) * 10.f, Unit(Random) * 10.f));
+				Speeds[Index] = Speed(Random);
+				DistanceToCenter[Index] = Distance(Random) + 100.f;
+				DistanceToClosestPoint[Index] = DistanceToCenter[Index] - Distance(Random) * 0.1f;
+				InitialGrabDistance[Index] = GetInitialGrabDistance(Distance(Random), 300.f);
+			}
+		}
+	};
+
+	bool NearlyEqual(float A, float B)
+	{
+		const float Scale = std::fabs(A) > 1.f ? std::fabs(A) : 1.f;
+		return std::fabs(A - B) <= Tolerance * Scale;
+	}
+
+	bool NearlyEqual(const FVec3& A, const FVec3& B)
+	{
+		return NearlyEqual(A.X, B.X) && NearlyEqual(A.Y, B.Y) && NearlyEqual(A.Z, B.Z);
+	}
+
+	int NumFailures = 0;
+
+	void Check(bool bCondition, const char* Name, int Index)
+	{
+		if (bCondition) { return; }
+		if (NumFailures < 10)
+		{
+			std::printf("MISMATCH %s at element %d\n", Name, Index);
+		}
+		NumFailures++;
+	}
+
+	template<typename FunctionType>
+	double MeasureNanosecondsPerElement(FunctionType&& Function)
+	{
+		const auto Start = std::chrono::steady_clock::now();
+		for (int Iteration = 0; Iteration < NumIterations; Iteration++)
+		{
+			Function();
+		}
+		const auto End = std::chrono::steady_clock::now();
+		return std::chrono::duration<double, std::nano>(End - Start).count() / (double(NumIterations) * NumElements);
+	}
+
+	void Report(const char* Name, double ScalarNs, double BatchNs)
+	{
+		std::printf("%-24s scalar %7.3f ns  batch %7.3f ns  speedup %5.2fx\n", Name, ScalarNs, BatchNs, ScalarNs / BatchNs);
+	}
+
+	//Keeps results alive so the optimizer can't remove the measured loops
+	volatile float Sink = 0.f;
+}
+
+int main()
+{
+	const FInputs Inputs;
+	std::printf("GravityGunMath benchmark, %d elements, %d iterations, SSE %s\n\n", NumElements, NumIterations, GRAVITYGUNMATH_SSE ? "on" : "off");
+
+	///Relative rotation round trip
+	{
+		const FQuat4 View(0.f, 0.3826834f, 0.f, 0.9238795f);
+		const FQuat4 Actor(0.1830127f, 0.1830127f, 0.6830127f, 0.6830127f);
+		const FQuat4 Result = ApplyRelativeRotation(View, GetRelativeRotation(View, Actor));
+		Check(NearlyEqual(Result.X, Actor.X) && NearlyEqual(Result.Y, Actor.Y) && NearlyEqual(Result.Z, Actor.Z) && NearlyEqual(Result.W, Actor.W), "RelativeRotation", 0);
+	}
+
+	///Hover distance
+	{
+		std::vector<float> Scalar(NumElements), Batch(NumElements);
+		const double ScalarNs = MeasureNanosecondsPerElement([&]()
+		{
+			for (int Index = 0; Index < NumElements; Index++)
+			{
+				Scalar[Index] = GetHoverDistance(Inputs.DistanceToCenter[Index], Inputs.DistanceToClosestPoint[Index], Inputs.InitialGrabDistance[Index]);
+			}
+			Sink = Sink + Scalar[0];
+		});
+		const double BatchNs = MeasureNanosecondsPerElement([&]()
+		{
+			GetHoverDistanceBatch(Inputs.DistanceToCenter.data(), Inputs.DistanceToClosestPoint.data(), Inputs.InitialGrabDistance.data(), Batch.data(), NumElements);
+			Sink = Sink + Batch[0];
+		});
+		for (int Index = 0; Index < NumElements; Index++)
+		{
+			Check(NearlyEqual(Scalar[Index], Batch[Index]), "HoverDistance", Index);
+		}
+		Report("HoverDistance", ScalarNs, BatchNs);
+	}
+
+	///Hover target
+	{
+		const FVec3 ViewLocation(120.f, -340.f, 170.f);
+		FVec3Buffer Scalar(NumElements), Batch(NumElements);
+		const double ScalarNs = MeasureNanosecondsPerElement([&]()
+		{
+			for (int Index = 0; Index < NumElements; Index++)
+			{
+				Scalar.Set(Index, GetHoverTarget(ViewLocation, Inputs.Directions.Get(Index), Inputs.InitialGrabDistance[Index]));
+			}
+			Sink = Sink + Scalar.X[0];
+		});
+		const double BatchNs = MeasureNanosecondsPerElement([&]()
+		{
+			GetHoverTargetBatch(ViewLocation, Inputs.Directions.ConstView(), Inputs.InitialGrabDistance.data(), Batch.View(), NumElements);
+			Sink = Sink + Batch.X[0];
+		});
+		for (int Index = 0; Index < NumElements; Index++)
+		{
+			Check(NearlyEqual(Scalar.Get(Index), Batch.Get(Index)), "HoverTarget", Index);
+		}
+		Report("HoverTarget", ScalarNs, BatchNs);
+	}
+
+	///Release velocity limiting works in place, every iteration starts from the inputs
+	{
+		FVec3Buffer ScalarLinear = Inputs.LinearVelocities, ScalarAngular = Inputs.AngularVelocities;
+		FVec3Buffer BatchLinear = Inputs.LinearVelocities, BatchAngular = Inputs.AngularVelocities;
+		const double ScalarNs = MeasureNanosecondsPerElement([&]()
+		{
+			ScalarLinear = Inputs.LinearVelocities;
+			ScalarAngular = Inputs.AngularVelocities;
+			for (int Index = 0; Index < NumElements; Index++)
+			{
+				FVec3 Linear = ScalarLinear.Get(Index);
+				FVec3 Angular = ScalarAngular.Get(Index);
+				LimitReleaseVelocity(Linear, Angular, 900.f);
+				ScalarLinear.Set(Index, Linear);
+				ScalarAngular.Set(Index, Angular);
+			}
+			Sink = Sink + ScalarLinear.X[0];
+		});
+		const double BatchNs = MeasureNanosecondsPerElement([&]()
+		{
+			BatchLinear = Inputs.LinearVelocities;
+			BatchAngular = Inputs.AngularVelocities;
+			LimitReleaseVelocityBatch(BatchLinear.View(), BatchAngular.View(), 900.f, NumElements);
+			Sink = Sink + BatchLinear.X[0];
+		});
+		for (int Index = 0; Index < NumElements; Index++)
+		{
+			Check(NearlyEqual(ScalarLinear.Get(Index), BatchLinear.Get(Index)), "ReleaseVelocity linear", Index);
+			Check(NearlyEqual(ScalarAngular.Get(Index), BatchAngular.Get(Index)), "ReleaseVelocity angular", Index);
+			Check(ScalarLinear.Get(Index).Size() <= 900.f * (1.f + Tolerance), "ReleaseVelocity limit", Index);
+		}
+		Report("LimitReleaseVelocity", ScalarNs, BatchNs);
+	}
+
+	///Launch velocity clamping
+	{
+		FVec3Buffer Scalar(NumElements), Batch(NumElements);
+		const double ScalarNs = MeasureNanosecondsPerElement([&]()
+		{
+			for (int Index = 0; Index < NumElements; Index++)
+			{
+				Scalar.Set(Index, ClampLaunchVelocity(Inputs.Directions.Get(Index), Inputs.Speeds[Index], 1400.f, 4200.f));
+			}
+			Sink = Sink + Scalar.X[0];
+		});
+		const double BatchNs = MeasureNanosecondsPerElement([&]()
+		{
+			ClampLaunchVelocityBatch(Inputs.Directions.ConstView(), Inputs.Speeds.data(), 1400.f, 4200.f, Batch.View(), NumElements);
+			Sink = Sink + Batch.X[0];
+		});
+		for (int Index = 0; Index < NumElements; Index++)
+		{
+			Check(NearlyEqual(Scalar.Get(Index), Batch.Get(Index)), "LaunchVelocity", Index);
+			const float Size = Scalar.Get(Index).Size();
+			Check(Inputs.Directions.Get(Index).SizeSquared() <= SmallNumber || (Size >= 1400.f * (1.f - Tolerance) && Size <= 4200.f * (1.f + Tolerance)), "LaunchVelocity range", Index);
+		}
+		Report("ClampLaunchVelocity", ScalarNs, BatchNs);
+	}
+
+	///Formation targets, the directions double as view space offsets
+	{
+		const FVec3 ViewLocation(120.f, -340.f, 170.f);
+		const FVec3 Forward(0.7071068f, 0.7071068f, 0.f), Right(-0.7071068f, 0.7071068f, 0.f), Up(0.f, 0.f, 1.f);
+		FVec3Buffer Scalar(NumElements), Batch(NumElements);
+		const double ScalarNs = MeasureNanosecondsPerElement([&]()
+		{
+			for (int Index = 0; Index < NumElements; Index++)
+			{
+				Scalar.Set(Index, GetFormationTarget(ViewLocation, Forward, Right, Up, Inputs.Directions.Get(Index) * 300.f));
+			}
+			Sink = Sink + Scalar.X[0];
+		});
+		FVec3Buffer Offsets = Inputs.Directions;
+		for (int Index = 0; Index < NumElements; Index++)
+		{
+			Offsets.Set(Index, Inputs.Directions.Get(Index) * 300.f);
+		}
+		const double BatchNs = MeasureNanosecondsPerElement([&]()
+		{
+			GetFormationTargetBatch(ViewLocation, Forward, Right, Up, Offsets.ConstView(), Batch.View(), NumElements);
+			Sink = Sink + Batch.X[0];
+		});
+		for (int Index = 0; Index < NumElements; Index++)
+		{
+			Check(NearlyEqual(Scalar.Get(Index), Batch.Get(Index)), "FormationTarget", Index);
+		}
+		Report("FormationTarget", ScalarNs, BatchNs);
+	}
+
+	///Drive velocity towards the targets, the velocities double as locations
+	{
+		FVec3Buffer Scalar(NumElements), Batch(NumElements);
+		const double ScalarNs = MeasureNanosecondsPerElement([&]()
+		{
+			for (int Index = 0; Index < NumElements; Index++)
+			{
+				Scalar.Set(Index, GetDriveVelocity(Inputs.Directions.Get(Index), Inputs.LinearVelocities.Get(Index), 10.f, 3000.f));
+			}
+			Sink = Sink + Scalar.X[0];
+		});
+		const double BatchNs = MeasureNanosecondsPerElement([&]()
+		{
+			GetDriveVelocityBatch(Inputs.Directions.ConstView(), Inputs.LinearVelocities.ConstView(), 10.f, 3000.f, Batch.View(), NumElements);
+			Sink = Sink + Batch.X[0];
+		});
+		for (int Index = 0; Index < NumElements; Index++)
+		{
+			Check(NearlyEqual(Scalar.Get(Index), Batch.Get(Index)), "DriveVelocity", Index);
+			Check(Scalar.Get(Index).Size() <= 3000.f * (1.f + Tolerance), "DriveVelocity limit", Index);
+		}
+		Report("DriveVelocity", ScalarNs, BatchNs);
+	}
+
+	if (NumFailures > 0)
+	{
+		std::printf("\n%d mismatches between the scalar and batch results\n", NumFailures);
+		return EXIT_FAILURE;
+	}
+	std::printf("\nScalar and batch results match\n");
+	return EXIT_SUCCESS;
+}
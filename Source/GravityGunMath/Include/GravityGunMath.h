@@ -0,0 +1,356 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+/*
+ * Math of the gravity gun grab and launch systems, without engine dependencies.
+ * Used by the objectgrabber and objectlauncher components, and built standalone by the CMake project next to this folder.
+ *
+ * Every operation has a scalar version for a single value and a batch version working on arrays in structure-of-arrays layout.
+ * The batch versions use SSE when it's available and fall back to the scalar versions otherwise.
+ * Define GRAVITYGUNMATH_FORCE_SCALAR to disable SSE.
+ */
+
+#include <cmath>
+
+#if !defined(GRAVITYGUNMATH_FORCE_SCALAR) && (defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define GRAVITYGUNMATH_SSE 1
+#include <emmintrin.h>
+#else
+#define GRAVITYGUNMATH_SSE 0
+#endif
+
+namespace GravityGunMath
+{
+	//Squared length below which a vector is treated as zero when normalizing, matches SMALL_NUMBER of the engine
+	static const float SmallNumber = 1.e-8f;
+
+	struct FVec3
+	{
+		float X = 0.f;
+		float Y = 0.f;
+		float Z = 0.f;
+
+		FVec3() {}
+		FVec3(float InX, float InY, float InZ) : X(InX), Y(InY), Z(InZ) {}
+
+		FVec3 operator+(const FVec3& V) const { return FVec3(X + V.X, Y + V.Y, Z + V.Z); }
+		FVec3 operator-(const FVec3& V) const { return FVec3(X - V.X, Y - V.Y, Z - V.Z); }
+		FVec3 operator*(float Scale) const { return FVec3(X * Scale, Y * Scale, Z * Scale); }
+
+		float SizeSquared() const { return X * X + Y * Y + Z * Z; }
+		float Size() const { return std::sqrt(SizeSquared()); }
+	};
+
+	//Rotation quaternion, same layout and conventions as the engine's FQuat
+	struct FQuat4
+	{
+		float X = 0.f;
+		float Y = 0.f;
+		float Z = 0.f;
+		float W = 1.f;
+
+		FQuat4() {}
+		FQuat4(float InX, float InY, float InZ, float InW) : X(InX), Y(InY), Z(InZ), W(InW) {}
+	};
+
+	//Mutable view on three float arrays holding the components of a vector array
+	struct FVec3Array
+	{
+		float* X = nullptr;
+		float* Y = nullptr;
+		float* Z = nullptr;
+	};
+
+	//Read-only view on three float arrays holding the components of a vector array
+	struct FConstVec3Array
+	{
+		const float* X = nullptr;
+		const float* Y = nullptr;
+		const float* Z = nullptr;
+
+		FConstVec3Array() {}
+		FConstVec3Array(const float* InX, const float* InY, const float* InZ) : X(InX), Y(InY), Z(InZ) {}
+		FConstVec3Array(const FVec3Array& Array) : X(Array.X), Y(Array.Y), Z(Array.Z) {}
+	};
+
+	inline float Clamp(float Value, float Min, float Max)
+	{
+		return Value < Min ? Min : (Value > Max ? Max : Value);
+	}
+
+	//Returns the normalized vector, or the vector itself if it's too small to normalize
+	inline FVec3 Normalize(const FVec3& V)
+	{
+		const float SizeSquared = V.SizeSquared();
+		if (SizeSquared <= SmallNumber) { return V; }
+		return V * (1.f / std::sqrt(SizeSquared));
+	}
+
+	//Hamilton product. The result applies B first, then A.
+	inline FQuat4 Multiply(const FQuat4& A, const FQuat4& B)
+	{
+		return FQuat4(
+			A.W * B.X + A.X * B.W + A.Y * B.Z - A.Z * B.Y,
+			A.W * B.Y - A.X * B.Z + A.Y * B.W + A.Z * B.X,
+			A.W * B.Z + A.X * B.Y - A.Y * B.X + A.Z * B.W,
+			A.W * B.W - A.X * B.X - A.Y * B.Y - A.Z * B.Z);
+	}
+
+	//Inverse of a normalized quaternion
+	inline FQuat4 Inverse(const FQuat4& Q)
+	{
+		return FQuat4(-Q.X, -Q.Y, -Q.Z, Q.W);
+	}
+
+	//Rotation of an actor relative to the view, so it can keep the same orientation to the player while held
+	inline FQuat4 GetRelativeRotation(const FQuat4& ViewRotation, const FQuat4& ActorRotation)
+	{
+		return Multiply(Inverse(ViewRotation), ActorRotation);
+	}
+
+	//Rotation of a held actor, given the current view and its rotation relative to the view
+	inline FQuat4 ApplyRelativeRotation(const FQuat4& ViewRotation, const FQuat4& RelativeRotation)
+	{
+		return Multiply(ViewRotation, RelativeRotation);
+	}
+
+	//Distance between the view and the grabbed actor when first grabbed, limited to the maximum hover distance
+	inline float GetInitialGrabDistance(float DistanceToActor, float MaximumHoverDistance)
+	{
+		return DistanceToActor > MaximumHoverDistance ? MaximumHoverDistance : DistanceToActor;
+	}
+
+	//Distance at which a held actor hovers in front of the view.
+	//The size of the actor, the distance to its center minus the distance to its closest point, is added to the initial grab distance.
+	inline float GetHoverDistance(float DistanceToCenter, float DistanceToClosestPoint, float InitialGrabDistance)
+	{
+		return DistanceToCenter - DistanceToClosestPoint + InitialGrabDistance;
+	}
+
+	inline FVec3 GetHoverTarget(const FVec3& ViewLocation, const FVec3& ViewDirection, float HoverDistance)
+	{
+		return ViewLocation + ViewDirection * HoverDistance;
+	}
+
+	//Limits the velocity of a released actor to the maximum speed.
+	//The angular velocity is scaled down by the same factor as the linear velocity. Returns whether the velocity was limited.
+	inline bool LimitReleaseVelocity(FVec3& LinearVelocity, FVec3& AngularVelocity, float MaxSpeed)
+	{
+		const float Speed = LinearVelocity.Size();
+		if (Speed <= MaxSpeed) { return false; }
+
+		const float Scale = MaxSpeed / Speed;
+		LinearVelocity = LinearVelocity * Scale;
+		AngularVelocity = AngularVelocity * Scale;
+		return true;
+	}
+
+	//Velocity of a launched actor: the launch direction, with the current speed clamped between the minimum and maximum launch speed
+	inline FVec3 ClampLaunchVelocity(const FVec3& LaunchDirection, float CurrentSpeed, float MinSpeed, float MaxSpeed)
+	{
+		return Normalize(LaunchDirection) * Clamp(CurrentSpeed, MinSpeed, MaxSpeed);
+	}
+
+	//Target of a held actor in a formation, given its offset in view space: forward, right and up
+	inline FVec3 GetFormationTarget(const FVec3& ViewLocation, const FVec3& Forward, const FVec3& Right, const FVec3& Up, const FVec3& LocalOffset)
+	{
+		return ViewLocation + Forward * LocalOffset.X + Right * LocalOffset.Y + Up * LocalOffset.Z;
+	}
+
+	//Velocity that moves a held body towards its target, proportional to the distance and limited to the maximum speed
+	inline FVec3 GetDriveVelocity(const FVec3& Target, const FVec3& Location, float Stiffness, float MaxSpeed)
+	{
+		const FVec3 Velocity = (Target - Location) * Stiffness;
+		const float Speed = Velocity.Size();
+		return Speed > MaxSpeed ? Velocity * (MaxSpeed / Speed) : Velocity;
+	}
+
+	//Batch version of GetHoverDistance
+	inline void GetHoverDistanceBatch(const float* DistanceToCenter, const float* DistanceToClosestPoint, const float* InitialGrabDistance, float* OutHoverDistance, int Count)
+	{
+		int Index = 0;
+#if GRAVITYGUNMATH_SSE
+		for (; Index + 4 <= Count; Index += 4)
+		{
+			const __m128 Center = _mm_loadu_ps(DistanceToCenter + Index);
+			const __m128 Closest = _mm_loadu_ps(DistanceToClosestPoint + Index);
+			const __m128 Initial = _mm_loadu_ps(InitialGrabDistance + Index);
+			_mm_storeu_ps(OutHoverDistance + Index, _mm_add_ps(_mm_sub_ps(Center, Closest), Initial));
+		}
+#endif
+		for (; Index < Count; Index++)
+		{
+			OutHoverDistance[Index] = GetHoverDistance(DistanceToCenter[Index], DistanceToClosestPoint[Index], InitialGrabDistance[Index]);
+		}
+	}
+
+	//Batch version of GetHoverTarget, for actors held from the same view location
+	inline void GetHoverTargetBatch(const FVec3& ViewLocation, FConstVec3Array ViewDirections, const float* HoverDistance, FVec3Array OutTargets, int Count)
+	{
+		int Index = 0;
+#if GRAVITYGUNMATH_SSE
+		const __m128 OriginX = _mm_set1_ps(ViewLocation.X);
+		const __m128 OriginY = _mm_set1_ps(ViewLocation.Y);
+		const __m128 OriginZ = _mm_set1_ps(ViewLocation.Z);
+		for (; Index + 4 <= Count; Index += 4)
+		{
+			const __m128 Distance = _mm_loadu_ps(HoverDistance + Index);
+			_mm_storeu_ps(OutTargets.X + Index, _mm_add_ps(OriginX, _mm_mul_ps(_mm_loadu_ps(ViewDirections.X + Index), Distance)));
+			_mm_storeu_ps(OutTargets.Y + Index, _mm_add_ps(OriginY, _mm_mul_ps(_mm_loadu_ps(ViewDirections.Y + Index), Distance)));
+			_mm_storeu_ps(OutTargets.Z + Index, _mm_add_ps(OriginZ, _mm_mul_ps(_mm_loadu_ps(ViewDirections.Z + Index), Distance)));
+		}
+#endif
+		for (; Index < Count; Index++)
+		{
+			const FVec3 Direction(ViewDirections.X[Index], ViewDirections.Y[Index], ViewDirections.Z[Index]);
+			const FVec3 Target = GetHoverTarget(ViewLocation, Direction, HoverDistance[Index]);
+			OutTargets.X[Index] = Target.X;
+			OutTargets.Y[Index] = Target.Y;
+			OutTargets.Z[Index] = Target.Z;
+		}
+	}
+
+	//Batch version of LimitReleaseVelocity, the velocities are limited in place
+	inline void LimitReleaseVelocityBatch(FVec3Array LinearVelocities, FVec3Array AngularVelocities, float MaxSpeed, int Count)
+	{
+		int Index = 0;
+#if GRAVITYGUNMATH_SSE
+		const __m128 Max = _mm_set1_ps(MaxSpeed);
+		const __m128 One = _mm_set1_ps(1.f);
+		for (; Index + 4 <= Count; Index += 4)
+		{
+			const __m128 LX = _mm_loadu_ps(LinearVelocities.X + Index);
+			const __m128 LY = _mm_loadu_ps(LinearVelocities.Y + Index);
+			const __m128 LZ = _mm_loadu_ps(LinearVelocities.Z + Index);
+			const __m128 Speed = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(LX, LX), _mm_mul_ps(LY, LY)), _mm_mul_ps(LZ, LZ)));
+
+			///Lanes within the maximum speed keep a scale of one
+			const __m128 OverMax = _mm_cmpgt_ps(Speed, Max);
+			const __m128 Scale = _mm_or_ps(_mm_and_ps(OverMax, _mm_div_ps(Max, Speed)), _mm_andnot_ps(OverMax, One));
+
+			_mm_storeu_ps(LinearVelocities.X + Index, _mm_mul_ps(LX, Scale));
+			_mm_storeu_ps(LinearVelocities.Y + Index, _mm_mul_ps(LY, Scale));
+			_mm_storeu_ps(LinearVelocities.Z + Index, _mm_mul_ps(LZ, Scale));
+			_mm_storeu_ps(AngularVelocities.X + Index, _mm_mul_ps(_mm_loadu_ps(AngularVelocities.X + Index), Scale));
+			_mm_storeu_ps(AngularVelocities.Y + Index, _mm_mul_ps(_mm_loadu_ps(AngularVelocities.Y + Index), Scale));
+			_mm_storeu_ps(AngularVelocities.Z + Index, _mm_mul_ps(_mm_loadu_ps(AngularVelocities.Z + Index), Scale));
+		}
+#endif
+		for (; Index < Count; Index++)
+		{
+			FVec3 Linear(LinearVelocities.X[Index], LinearVelocities.Y[Index], LinearVelocities.Z[Index]);
+			FVec3 Angular(AngularVelocities.X[Index], AngularVelocities.Y[Index], AngularVelocities.Z[Index]);
+			if (LimitReleaseVelocity(Linear, Angular, MaxSpeed))
+			{
+				LinearVelocities.X[Index] = Linear.X;
+				LinearVelocities.Y[Index] = Linear.Y;
+				LinearVelocities.Z[Index] = Linear.Z;
+				AngularVelocities.X[Index] = Angular.X;
+				AngularVelocities.Y[Index] = Angular.Y;
+				AngularVelocities.Z[Index] = Angular.Z;
+			}
+		}
+	}
+
+	//Batch version of ClampLaunchVelocity
+	inline void ClampLaunchVelocityBatch(FConstVec3Array LaunchDirections, const float* CurrentSpeeds, float MinSpeed, float MaxSpeed, FVec3Array OutVelocities, int Count)
+	{
+		int Index = 0;
+#if GRAVITYGUNMATH_SSE
+		const __m128 Min = _mm_set1_ps(MinSpeed);
+		const __m128 Max = _mm_set1_ps(MaxSpeed);
+		const __m128 Small = _mm_set1_ps(SmallNumber);
+		const __m128 One = _mm_set1_ps(1.f);
+		for (; Index + 4 <= Count; Index += 4)
+		{
+			const __m128 DX = _mm_loadu_ps(LaunchDirections.X + Index);
+			const __m128 DY = _mm_loadu_ps(LaunchDirections.Y + Index);
+			const __m128 DZ = _mm_loadu_ps(LaunchDirections.Z + Index);
+			const __m128 SizeSquared = _mm_add_ps(_mm_add_ps(_mm_mul_ps(DX, DX), _mm_mul_ps(DY, DY)), _mm_mul_ps(DZ, DZ));
+
+			///Directions too small to normalize are left as they are, like Normalize
+			const __m128 CanNormalize = _mm_cmpgt_ps(SizeSquared, Small);
+			const __m128 InverseSize = _mm_or_ps(_mm_and_ps(CanNormalize, _mm_div_ps(One, _mm_sqrt_ps(SizeSquared))), _mm_andnot_ps(CanNormalize, One));
+
+			const __m128 Speed = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(CurrentSpeeds + Index), Min), Max);
+			const __m128 Scale = _mm_mul_ps(InverseSize, Speed);
+
+			_mm_storeu_ps(OutVelocities.X + Index, _mm_mul_ps(DX, Scale));
+			_mm_storeu_ps(OutVelocities.Y + Index, _mm_mul_ps(DY, Scale));
+			_mm_storeu_ps(OutVelocities.Z + Index, _mm_mul_ps(DZ, Scale));
+		}
+#endif
+		for (; Index < Count; Index++)
+		{
+			const FVec3 Direction(LaunchDirections.X[Index], LaunchDirections.Y[Index], LaunchDirections.Z[Index]);
+			const FVec3 Velocity = ClampLaunchVelocity(Direction, CurrentSpeeds[Index], MinSpeed, MaxSpeed);
+			OutVelocities.X[Index] = Velocity.X;
+			OutVelocities.Y[Index] = Velocity.Y;
+			OutVelocities.Z[Index] = Velocity.Z;
+		}
+	}
+
+	//Batch version of GetFormationTarget, for actors held from the same view
+	inline void GetFormationTargetBatch(const FVec3& ViewLocation, const FVec3& Forward, const FVec3& Right, const FVec3& Up, FConstVec3Array LocalOffsets, FVec3Array OutTargets, int Count)
+	{
+		int Index = 0;
+#if GRAVITYGUNMATH_SSE
+		const __m128 OriginX = _mm_set1_ps(ViewLocation.X);
+		const __m128 OriginY = _mm_set1_ps(ViewLocation.Y);
+		const __m128 OriginZ = _mm_set1_ps(ViewLocation.Z);
+		for (; Index + 4 <= Count; Index += 4)
+		{
+			const __m128 OX = _mm_loadu_ps(LocalOffsets.X + Index);
+			const __m128 OY = _mm_loadu_ps(LocalOffsets.Y + Index);
+			const __m128 OZ = _mm_loadu_ps(LocalOffsets.Z + Index);
+			_mm_storeu_ps(OutTargets.X + Index, _mm_add_ps(OriginX, _mm_add_ps(_mm_add_ps(_mm_mul_ps(OX, _mm_set1_ps(Forward.X)), _mm_mul_ps(OY, _mm_set1_ps(Right.X))), _mm_mul_ps(OZ, _mm_set1_ps(Up.X)))));
+			_mm_storeu_ps(OutTargets.Y + Index, _mm_add_ps(OriginY, _mm_add_ps(_mm_add_ps(_mm_mul_ps(OX, _mm_set1_ps(Forward.Y)), _mm_mul_ps(OY, _mm_set1_ps(Right.Y))), _mm_mul_ps(OZ, _mm_set1_ps(Up.Y)))));
+			_mm_storeu_ps(OutTargets.Z + Index, _mm_add_ps(OriginZ, _mm_add_ps(_mm_add_ps(_mm_mul_ps(OX, _mm_set1_ps(Forward.Z)), _mm_mul_ps(OY, _mm_set1_ps(Right.Z))), _mm_mul_ps(OZ, _mm_set1_ps(Up.Z)))));
+		}
+#endif
+		for (; Index < Count; Index++)
+		{
+			const FVec3 Offset(LocalOffsets.X[Index], LocalOffsets.Y[Index], LocalOffsets.Z[Index]);
+			const FVec3 Target = GetFormationTarget(ViewLocation, Forward, Right, Up, Offset);
+			OutTargets.X[Index] = Target.X;
+			OutTargets.Y[Index] = Target.Y;
+			OutTargets.Z[Index] = Target.Z;
+		}
+	}
+
+	//Batch version of GetDriveVelocity
+	inline void GetDriveVelocityBatch(FConstVec3Array Targets, FConstVec3Array Locations, float Stiffness, float MaxSpeed, FVec3Array OutVelocities, int Count)
+	{
+		int Index = 0;
+#if GRAVITYGUNMATH_SSE
+		const __m128 Gain = _mm_set1_ps(Stiffness);
+		const __m128 Max = _mm_set1_ps(MaxSpeed);
+		const __m128 One = _mm_set1_ps(1.f);
+		for (; Index + 4 <= Count; Index += 4)
+		{
+			const __m128 VX = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(Targets.X + Index), _mm_loadu_ps(Locations.X + Index)), Gain);
+			const __m128 VY = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(Targets.Y + Index), _mm_loadu_ps(Locations.Y + Index)), Gain);
+			const __m128 VZ = _mm_mul_ps(_mm_sub_ps(_mm_loadu_ps(Targets.Z + Index), _mm_loadu_ps(Locations.Z + Index)), Gain);
+			const __m128 Speed = _mm_sqrt_ps(_mm_add_ps(_mm_add_ps(_mm_mul_ps(VX, VX), _mm_mul_ps(VY, VY)), _mm_mul_ps(VZ, VZ)));
+
+			///Lanes within the maximum speed keep a scale of one
+			const __m128 OverMax = _mm_cmpgt_ps(Speed, Max);
+			const __m128 Scale = _mm_or_ps(_mm_and_ps(OverMax, _mm_div_ps(Max, Speed)), _mm_andnot_ps(OverMax, One));
+
+			_mm_storeu_ps(OutVelocities.X + Index, _mm_mul_ps(VX, Scale));
+			_mm_storeu_ps(OutVelocities.Y + Index, _mm_mul_ps(VY, Scale));
+			_mm_storeu_ps(OutVelocities.Z + Index, _mm_mul_ps(VZ, Scale));
+		}
+#endif
+		for (; Index < Count; Index++)
+		{
+			const FVec3 Target(Targets.X[Index], Targets.Y[Index], Targets.Z[Index]);
+			const FVec3 Location(Locations.X[Index], Locations.Y[Index], Locations.Z[Index]);
+			const FVec3 Velocity = GetDriveVelocity(Target, Location, Stiffness, MaxSpeed);
+			OutVelocities.X[Index] = Velocity.X;
+			OutVelocities.Y[Index] = Velocity.Y;
+			OutVelocities.Z[Index] = Velocity.Z;
+		}
+	}
+}
@@ -0,0 +1,150 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityGunMath.h"
+
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+using namespace GravityGunMath;
+
+namespace
+{
+	const float Tolerance = 1.e-5f;
+
+	int NumChecks = 0;
+	int NumFailures = 0;
+
+	bool NearlyEqual(float A, float B)
+	{
+		const float Scale = std::fabs(B) > 1.f ? std::fabs(B) : 1.f;
+		return std::fabs(A - B) <= Tolerance * Scale;
+	}
+
+	void Check(bool bCondition, const char* Name)
+	{
+		NumChecks++;
+		if (bCondition) { return; }
+		std::printf("FAILED %s\n", Name);
+		NumFailures++;
+	}
+
+	void CheckFloat(float Actual, float Expected, const char* Name)
+	{
+		NumChecks++;
+		if (NearlyEqual(Actual, Expected)) { return; }
+		std::printf("FAILED %s: %.7g, expected %.7g\n", Name, Actual, Expected);
+		NumFailures++;
+	}
+
+	void CheckVec(const FVec3& Actual, const FVec3& Expected, const char* Name)
+	{
+		NumChecks++;
+		if (NearlyEqual(Actual.X, Expected.X) && NearlyEqual(Actual.Y, Expected.Y) && NearlyEqual(Actual.Z, Expected.Z)) { return; }
+		std::printf("FAILED %s: (%.7g, %.7g, %.7g), expected (%.7g, %.7g, %.7g)\n", Name, Actual.X, Actual.Y, Actual.Z, Expected.X, Expected.Y, Expected.Z);
+		NumFailures++;
+	}
+
+	void CheckQuat(const FQuat4& Actual, const FQuat4& Expected, const char* Name)
+	{
+		NumChecks++;
+		if (NearlyEqual(Actual.X, Expected.X) && NearlyEqual(Actual.Y, Expected.Y) && NearlyEqual(Actual.Z, Expected.Z) && NearlyEqual(Actual.W, Expected.W)) { return; }
+		std::printf("FAILED %s: (%.7g, %.7g, %.7g, %.7g), expected (%.7g, %.7g, %.7g, %.7g)\n", Name, Actual.X, Actual.Y, Actual.Z, Actual.W, Expected.X, Expected.Y, Expected.Z, Expected.W);
+		NumFailures++;
+	}
+
+	void TestMultiply()
+	{
+		///Basis quaternions: i * j = k, j * i = -k, i * i = -1
+		const FQuat4 I(1.f, 0.f, 0.f, 0.f), J(0.f, 1.f, 0.f, 0.f);
+		CheckQuat(Multiply(I, J), FQuat4(0.f, 0.f, 1.f, 0.f), "Multiply i*j");
+		CheckQuat(Multiply(J, I), FQuat4(0.f, 0.f, -1.f, 0.f), "Multiply j*i");
+		CheckQuat(Multiply(I, I), FQuat4(0.f, 0.f, 0.f, -1.f), "Multiply i*i");
+
+		///(4 + 1i + 2j + 3k)(8 + 5i + 6j + 7k) = -6 + 24i + 48j + 48k
+		CheckQuat(Multiply(FQuat4(1.f, 2.f, 3.f, 4.f), FQuat4(5.f, 6.f, 7.f, 8.f)), FQuat4(24.f, 48.f, 48.f, -6.f), "Multiply general");
+
+		///Two 45 degree turns around Z make a 90 degree turn
+		const FQuat4 Yaw45(0.f, 0.f, 0.3826834f, 0.9238795f);
+		CheckQuat(Multiply(Yaw45, Yaw45), FQuat4(0.f, 0.f, 0.7071068f, 0.7071068f), "Multiply yaw 45+45");
+	}
+
+	void TestInverse()
+	{
+		const FQuat4 Q(0.5f, 0.5f, 0.5f, 0.5f);
+		CheckQuat(Inverse(Q), FQuat4(-0.5f, -0.5f, -0.5f, 0.5f), "Inverse");
+		CheckQuat(Multiply(Q, Inverse(Q)), FQuat4(), "Inverse q*q^-1");
+		CheckQuat(Multiply(Inverse(Q), Q), FQuat4(), "Inverse q^-1*q");
+
+		///The relative rotation round trip gives back the actor rotation
+		const FQuat4 View(0.f, 0.3826834f, 0.f, 0.9238795f);
+		const FQuat4 Actor(0.1830127f, 0.1830127f, 0.6830127f, 0.6830127f);
+		CheckQuat(ApplyRelativeRotation(View, GetRelativeRotation(View, Actor)), Actor, "Relative rotation round trip");
+	}
+
+	void TestNormalize()
+	{
+		CheckVec(Normalize(FVec3(3.f, 4.f, 0.f)), FVec3(0.6f, 0.8f, 0.f), "Normalize 3-4-5");
+		CheckVec(Normalize(FVec3(0.f, 0.f, -250.f)), FVec3(0.f, 0.f, -1.f), "Normalize axis");
+		CheckFloat(Normalize(FVec3(1.f, -2.f, 3.f)).Size(), 1.f, "Normalize unit length");
+
+		///Squared lengths at or below SmallNumber are returned unchanged, just above it they are normalized
+		CheckVec(Normalize(FVec3()), FVec3(), "Normalize zero");
+		CheckVec(Normalize(FVec3(0.9e-4f, 0.f, 0.f)), FVec3(0.9e-4f, 0.f, 0.f), "Normalize below tolerance");
+		CheckVec(Normalize(FVec3(1.1e-4f, 0.f, 0.f)), FVec3(1.f, 0.f, 0.f), "Normalize above tolerance");
+	}
+
+	void TestLaunchClamp()
+	{
+		///Too slow, too fast and in range, plus a direction that can't be normalized
+		CheckVec(ClampLaunchVelocity(FVec3(0.f, 0.f, 2.f), 100.f, 1400.f, 4200.f), FVec3(0.f, 0.f, 1400.f), "ClampLaunchVelocity minimum");
+		CheckVec(ClampLaunchVelocity(FVec3(3.f, 4.f, 0.f), 5000.f, 1400.f, 4200.f), FVec3(2520.f, 3360.f, 0.f), "ClampLaunchVelocity maximum");
+		CheckVec(ClampLaunchVelocity(FVec3(0.f, 10.f, 0.f), 2000.f, 1400.f, 4200.f), FVec3(0.f, 2000.f, 0.f), "ClampLaunchVelocity in range");
+		CheckVec(ClampLaunchVelocity(FVec3(), 2000.f, 1400.f, 4200.f), FVec3(), "ClampLaunchVelocity zero direction");
+
+		///Five elements run through the SSE loop and the scalar remainder
+		const float DirectionX[] = { 0.f, 3.f, 0.f, 0.f, 3.f };
+		const float DirectionY[] = { 0.f, 4.f, 10.f, 0.f, 4.f };
+		const float DirectionZ[] = { 2.f, 0.f, 0.f, 0.f, 0.f };
+		const float Speeds[] = { 100.f, 5000.f, 2000.f, 2000.f, 100.f };
+		float OutX[5], OutY[5], OutZ[5];
+		ClampLaunchVelocityBatch(FConstVec3Array(DirectionX, DirectionY, DirectionZ), Speeds, 1400.f, 4200.f, FVec3Array{ OutX, OutY, OutZ }, 5);
+		CheckVec(FVec3(OutX[0], OutY[0], OutZ[0]), FVec3(0.f, 0.f, 1400.f), "ClampLaunchVelocityBatch minimum");
+		CheckVec(FVec3(OutX[1], OutY[1], OutZ[1]), FVec3(2520.f, 3360.f, 0.f), "ClampLaunchVelocityBatch maximum");
+		CheckVec(FVec3(OutX[2], OutY[2], OutZ[2]), FVec3(0.f, 2000.f, 0.f), "ClampLaunchVelocityBatch in range");
+		CheckVec(FVec3(OutX[3], OutY[3], OutZ[3]), FVec3(), "ClampLaunchVelocityBatch zero direction");
+		CheckVec(FVec3(OutX[4], OutY[4], OutZ[4]), FVec3(840.f, 1120.f, 0.f), "ClampLaunchVelocityBatch remainder");
+	}
+
+	void TestReleaseLimit()
+	{
+		FVec3 Linear(1800.f, 0.f, 0.f), Angular(2.f, 0.f, -4.f);
+		Check(LimitReleaseVelocity(Linear, Angular, 900.f), "LimitReleaseVelocity limited");
+		CheckVec(Linear, FVec3(900.f, 0.f, 0.f), "LimitReleaseVelocity linear");
+		CheckVec(Angular, FVec3(1.f, 0.f, -2.f), "LimitReleaseVelocity angular");
+
+		FVec3 SlowLinear(300.f, 400.f, 0.f), SlowAngular(1.f, 1.f, 1.f);
+		Check(!LimitReleaseVelocity(SlowLinear, SlowAngular, 900.f), "LimitReleaseVelocity not limited");
+		CheckVec(SlowLinear, FVec3(300.f, 400.f, 0.f), "LimitReleaseVelocity unchanged");
+	}
+}
+
+int main()
+{
+	std::printf("GravityGunMath tests, SSE %s\n", GRAVITYGUNMATH_SSE ? "on" : "off");
+
+	TestMultiply();
+	TestInverse();
+	TestNormalize();
+	TestLaunchClamp();
+	TestReleaseLimit();
+
+	if (NumFailures > 0)
+	{
+		std::printf("%d of %d checks failed\n", NumFailures, NumChecks);
+		return EXIT_FAILURE;
+	}
+	std::printf("All %d checks passed\n", NumChecks);
+	return EXIT_SUCCESS;
+}
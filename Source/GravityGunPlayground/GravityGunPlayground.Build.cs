@@ -1,5 +1,6 @@
 // Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
 
+using System.IO;
 using UnrealBuildTool;
 
 public class GravityGunPlayground : ModuleRules
@@ -9,5 +10,8 @@ public class GravityGunPlayground : ModuleRules
 		PCHUsage = PCHUsageMode.UseExplicitOrSharedPCHs;
 
 		PublicDependencyModuleNames.AddRange(new string[] { "Core", "CoreUObject", "Engine", "InputCore", "HeadMountedDisplay" });
+
+		// Header-only math without engine dependencies, also built standalone through its own CMakeLists.txt
+		PublicIncludePaths.Add(Path.Combine(ModuleDirectory, "..", "GravityGunMath", "Include"));
 	}
 }
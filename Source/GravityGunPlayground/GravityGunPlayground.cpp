@@ -1,7 +1,36 @@
 // Copyright 1998-2019 Epic Games, Inc. All Rights Reserved.
 
 #include "GravityGunPlayground.h"
+#include "GravityGunDeterminism.h"
+#include "GravityGunMemory.h"
+#include "GravityGunTelemetry.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Parse.h"
 #include "Modules/ModuleManager.h"
 
-IMPLEMENT_PRIMARY_GAME_MODULE( FDefaultGameModuleImpl, GravityGunPlayground, "GravityGunPlayground" );
- 
\ No newline at end of file
+DEFINE_LOG_CATEGORY(LogGravityGun);
+
+class FGravityGunPlaygroundModule : public FDefaultGameModuleImpl
+{
+public:
+	virtual void StartupModule() override
+	{
+		FGravityGunMemory::RegisterLLMTags();
+		FGravityGunDeterminism::Initialize();
+		FGravityGunTelemetry::Initialize();
+	}
+
+	virtual void ShutdownModule() override
+	{
+		FGravityGunTelemetry::Shutdown();
+		FGravityGunDeterminism::Shutdown();
+
+		///Soak tests pass -GGPMemReport to get the high-water marks in the log of headless runs
+		if (FParse::Param(FCommandLine::Get(), TEXT("GGPMemReport")))
+		{
+			FGravityGunMemory::DumpToLog();
+		}
+	}
+};
+
+IMPLEMENT_PRIMARY_GAME_MODULE( FGravityGunPlaygroundModule, GravityGunPlayground, "GravityGunPlayground" );
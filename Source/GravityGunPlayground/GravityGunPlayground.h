@@ -3,3 +3,7 @@
 #pragma once
 
 #include "CoreMinimal.h"
+
+DECLARE_LOG_CATEGORY_EXTERN(LogGravityGun, Log, All);
+
+DECLARE_STATS_GROUP(TEXT("GravityGun"), STATGROUP_GravityGun, STATCAT_Advanced);
@@ -2,6 +2,14 @@
 
 #include "GravityGunPlaygroundCharacter.h"
 #include "GravityGunPlaygroundProjectile.h"
+#include "GravityGunPlayground.h"
+#include "GravityGunMemory.h"
+#include "GravityGunDeterminism.h"
+#include "GravityGunTelemetry.h"
+#include "GravityGunLatency.h"
+#include "GravityGunBudget.h"
+#include "Engine/World.h"
+#include "GameFramework/GameStateBase.h"
 #include "Animation/AnimInstance.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
@@ -56,6 +64,13 @@ AGravityGunPlaygroundCharacter::AGravityGunPlaygroundCharacter()
 	// Default offset from the character location for projectiles to spawn
 	GunOffset = FVector(100.0f, 0.0f, 10.0f);
 
+	// Shots go straight by default, clients catch up with shots up to a quarter second old
+	ShotSpreadDegrees = 0.0f;
+	MaxShotFastForwardSeconds = 0.25f;
+	FireMode = EGravityGunFireMode::Projectile;
+	HitscanRange = 10000.0f;
+	NextShotId = 0;
+
 	// Note: The ProjectileClass and the skeletal mesh/anim blueprints for Mesh1P, FP_Gun, and VR_Gun 
 	// are set in the derived blueprint asset named MyCharacter to avoid direct content references in C++.
 
@@ -103,6 +118,9 @@ void AGravityGunPlaygroundCharacter::BeginPlay()
 		VR_Gun->SetHiddenInGame(true, true);
 		Mesh1P->SetHiddenInGame(false, true);
 	}
+
+	// optional gun work is scaled down when the frame goes over budget
+	AGravityGunBudget::Get(GetWorld());
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -140,36 +158,59 @@ void AGravityGunPlaygroundCharacter::SetupPlayerInputComponent(class UInputCompo
 
 void AGravityGunPlaygroundCharacter::OnFire()
 {
+	// measured until the projectile is spawned, see SpawnShotProjectile
+	FGravityGunLatency::MarkInput(EGravityGunLatencyAction::Fire);
+
+	// in deterministic mode the shot is fired on the next fixed step
+	if (FGravityGunDeterminism::ShouldDeferToStep())
+	{
+		TWeakObjectPtr<AGravityGunPlaygroundCharacter> WeakThis(this);
+		FGravityGunDeterminism::RunOnStep(GetWorld(), [WeakThis]() { if (WeakThis.IsValid()) { WeakThis->OnFire(); } });
+		return;
+	}
+
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::Projectiles);
+
 	// try and fire a projectile
-	if (ProjectileClass != NULL)
+	if (ProjectileClass != NULL || FireMode == EGravityGunFireMode::Hitscan)
 	{
 		UWorld* const World = GetWorld();
 		if (World != NULL)
 		{
+			FVector SpawnLocation;
+			FRotator SpawnRotation;
 			if (bUsingMotionControllers)
 			{
-				const FRotator SpawnRotation = VR_MuzzleLocation->GetComponentRotation();
-				const FVector SpawnLocation = VR_MuzzleLocation->GetComponentLocation();
-				World->SpawnActor<AGravityGunPlaygroundProjectile>(ProjectileClass, SpawnLocation, SpawnRotation);
+				SpawnRotation = VR_MuzzleLocation->GetComponentRotation();
+				SpawnLocation = VR_MuzzleLocation->GetComponentLocation();
 			}
 			else
 			{
-				const FRotator SpawnRotation = GetControlRotation();
+				SpawnRotation = GetControlRotation();
 				// MuzzleOffset is in camera space, so transform it to world space before offsetting from the character location to find the final muzzle position
-				const FVector SpawnLocation = ((FP_MuzzleLocation != nullptr) ? FP_MuzzleLocation->GetComponentLocation() : GetActorLocation()) + SpawnRotation.RotateVector(GunOffset);
+				SpawnLocation = ((FP_MuzzleLocation != nullptr) ? FP_MuzzleLocation->GetComponentLocation() : GetActorLocation()) + SpawnRotation.RotateVector(GunOffset);
+			}
 
-				//Set Spawn Collision Handling Override
-				FActorSpawnParameters ActorSpawnParams;
-				ActorSpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButDontSpawnIfColliding;
+			// the server spawns the projectile and tells the clients about it
+			if (HasAuthority())
+			{
+				FireProjectile(SpawnLocation, SpawnRotation);
+			}
+			else
+			{
+				ServerFire(SpawnLocation, SpawnRotation);
 
-				// spawn the projectile at the muzzle
-				World->SpawnActor<AGravityGunPlaygroundProjectile>(ProjectileClass, SpawnLocation, SpawnRotation, ActorSpawnParams);
+				// hitscan shots only take effect on the server
+				if (FireMode == EGravityGunFireMode::Hitscan)
+				{
+					FGravityGunLatency::CancelInput(EGravityGunLatencyAction::Fire);
+				}
 			}
 		}
 	}
 
-	// try and play the sound if specified
-	if (FireSound != NULL)
+	// try and play the sound if specified and the frame budget allows it
+	if (FireSound != NULL && AGravityGunBudget::ShouldSpawnEffect(this, GetActorLocation()))
 	{
 		UGameplayStatics::PlaySoundAtLocation(this, FireSound, GetActorLocation());
 	}
@@ -186,6 +227,191 @@ void AGravityGunPlaygroundCharacter::OnFire()
 	}
 }
 
+void AGravityGunPlaygroundCharacter::FireProjectile(const FVector& MuzzleLocation, const FRotator& MuzzleRotation)
+{
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::Projectiles);
+
+	UWorld* const World = GetWorld();
+	if (World == NULL || (ProjectileClass == NULL && FireMode != EGravityGunFireMode::Hitscan))
+	{
+		return;
+	}
+
+	FGravityGunShotEvent Shot;
+	Shot.MuzzleLocation = MuzzleLocation;
+	Shot.MuzzleRotation = MuzzleRotation;
+	Shot.Seed = (uint16)FMath::Rand();
+	Shot.ShotId = NextShotId++;
+	AGameStateBase* const GameState = World->GetGameState();
+	Shot.ServerTime = GameState ? GameState->GetServerWorldTimeSeconds() : World->GetTimeSeconds();
+
+	// with too many projectiles alive the shot still lands, but without a projectile to simulate
+	if (FireMode == EGravityGunFireMode::Hitscan || AGravityGunBudget::IsOverProjectileBudget())
+	{
+		FireHitscan(Shot);
+		return;
+	}
+
+	// without clients there is nothing to replicate
+	const bool bNetworked = World->GetNetMode() != NM_Standalone;
+	const bool bSendAsEvent = bNetworked && FGravityGunShotReplication::UseShotEvents();
+	if (bSendAsEvent)
+	{
+		// simulate the exact values the clients will receive
+		Shot.Quantize();
+	}
+
+	if (SpawnShotProjectile(Shot, true, bNetworked && !bSendAsEvent, 0.0f) == NULL)
+	{
+		if (IsLocallyControlled())
+		{
+			FGravityGunLatency::CancelInput(EGravityGunLatencyAction::Fire);
+		}
+		return;
+	}
+	FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::Shot, Shot.MuzzleLocation);
+
+	if (bNetworked)
+	{
+		FGravityGunShotReplication::RecordShot(World, Shot, bSendAsEvent);
+	}
+	if (bSendAsEvent)
+	{
+		MulticastShot(Shot);
+	}
+}
+
+void AGravityGunPlaygroundCharacter::FireHitscan(const FGravityGunShotEvent& Shot)
+{
+	AHitscanBatch* Batch = AHitscanBatch::Get(GetWorld());
+	if (Batch == NULL)
+	{
+		if (IsLocallyControlled())
+		{
+			FGravityGunLatency::CancelInput(EGravityGunLatencyAction::Fire);
+		}
+		return;
+	}
+
+	// traced after physics together with every other hitscan shot of this frame, which also marks the latency effect
+	FHitscanShot HitscanShot;
+	HitscanShot.Shooter = this;
+	HitscanShot.Start = Shot.MuzzleLocation;
+	HitscanShot.Direction = Shot.GetShotRotation(ShotSpreadDegrees).Vector();
+	HitscanShot.Range = HitscanRange;
+	HitscanShot.Speed = AHitscanBatch::GetProjectileSpeed(ProjectileClass);
+	Batch->QueueShot(HitscanShot);
+
+	FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::Shot, Shot.MuzzleLocation);
+}
+
+AGravityGunPlaygroundProjectile* AGravityGunPlaygroundCharacter::SpawnShotProjectile(const FGravityGunShotEvent& Shot, bool bAuthoritative, bool bReplicated, float FastForwardSeconds)
+{
+	const FTransform SpawnTransform(Shot.GetShotRotation(ShotSpreadDegrees), Shot.MuzzleLocation);
+
+	// motion controller muzzles always spawn, the first person muzzle doesn't spawn inside geometry
+	const ESpawnActorCollisionHandlingMethod CollisionHandling = bUsingMotionControllers
+		? ESpawnActorCollisionHandlingMethod::AlwaysSpawn
+		: ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButDontSpawnIfColliding;
+
+	AGravityGunPlaygroundProjectile* Projectile = GetWorld()->SpawnActorDeferred<AGravityGunPlaygroundProjectile>(ProjectileClass, SpawnTransform, this, this, CollisionHandling);
+	if (Projectile == NULL)
+	{
+		return NULL;
+	}
+
+	if (bReplicated)
+	{
+		Projectile->SetReplicates(true);
+		Projectile->SetReplicateMovement(true);
+	}
+	Projectile->InitializeShot(Shot.ShotId, bAuthoritative);
+	Projectile->FinishSpawning(SpawnTransform);
+	if (Projectile->IsPendingKill())
+	{
+		return NULL;
+	}
+
+	Projectile->FastForward(FastForwardSeconds);
+
+	// the shot of the local player takes effect here, on the server or in the client's simulated copy
+	if (IsLocallyControlled())
+	{
+		FGravityGunLatency::MarkEffect(EGravityGunLatencyAction::Fire);
+	}
+	return Projectile;
+}
+
+bool AGravityGunPlaygroundCharacter::ServerFire_Validate(FVector_NetQuantize10 MuzzleLocation, FRotator MuzzleRotation)
+{
+	// only malformed data disconnects the client
+	return !MuzzleLocation.ContainsNaN() && !MuzzleRotation.ContainsNaN();
+}
+
+void AGravityGunPlaygroundCharacter::ServerFire_Implementation(FVector_NetQuantize10 MuzzleLocation, FRotator MuzzleRotation)
+{
+	// the muzzle is always close to the character, a shot from elsewhere is dropped without disconnecting a lagging client
+	if (FVector::DistSquared(MuzzleLocation, GetActorLocation()) >= FMath::Square(GunOffset.Size() + 500.0f))
+	{
+		UE_LOG(LogGravityGun, Verbose, TEXT("Ignored shot of %s, its muzzle is too far from the character"), *GetName());
+		return;
+	}
+
+	FireProjectile(MuzzleLocation, MuzzleRotation);
+}
+
+void AGravityGunPlaygroundCharacter::MulticastShot_Implementation(const FGravityGunShotEvent& Shot)
+{
+	// the server already spawned the authoritative projectile, and the local copy is optional when over budget
+	if (HasAuthority() || ProjectileClass == NULL || AGravityGunBudget::IsOverProjectileBudget())
+	{
+		return;
+	}
+
+	AGameStateBase* const GameState = GetWorld()->GetGameState();
+	const float Elapsed = GameState ? GameState->GetServerWorldTimeSeconds() - Shot.ServerTime : 0.0f;
+
+	AGravityGunPlaygroundProjectile* Projectile = SpawnShotProjectile(Shot, false, false, FMath::Clamp(Elapsed, 0.0f, MaxShotFastForwardSeconds));
+	if (Projectile == NULL)
+	{
+		return;
+	}
+
+	// forget projectiles that ended without a replicated hit
+	for (auto It = SimulatedShots.CreateIterator(); It; ++It)
+	{
+		if (!It.Value().IsValid())
+		{
+			It.RemoveCurrent();
+		}
+	}
+	SimulatedShots.Add(Shot.ShotId, Projectile);
+}
+
+void AGravityGunPlaygroundCharacter::NotifyShotHit(uint16 ShotId, const FVector& HitLocation)
+{
+	if (HasAuthority() && GetNetMode() != NM_Standalone && FGravityGunShotReplication::UseShotEvents())
+	{
+		MulticastShotHit(ShotId, HitLocation);
+	}
+}
+
+void AGravityGunPlaygroundCharacter::MulticastShotHit_Implementation(uint16 ShotId, FVector_NetQuantize HitLocation)
+{
+	if (HasAuthority())
+	{
+		return;
+	}
+
+	// the server result wins over the local simulation
+	TWeakObjectPtr<AGravityGunPlaygroundProjectile> Projectile;
+	if (SimulatedShots.RemoveAndCopyValue(ShotId, Projectile) && Projectile.IsValid())
+	{
+		Projectile->SetActorLocation(HitLocation);
+		Projectile->Destroy();
+	}
+}
+
 void AGravityGunPlaygroundCharacter::OnResetVR()
 {
 	UHeadMountedDisplayFunctionLibrary::ResetOrientationAndPosition();
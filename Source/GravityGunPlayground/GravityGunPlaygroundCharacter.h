@@ -4,6 +4,8 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "GravityGunShotEvent.h"
+#include "HitscanBatch.h"
 #include "GravityGunPlaygroundCharacter.generated.h"
 
 class UInputComponent;
@@ -80,11 +82,57 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay)
 	uint32 bUsingMotionControllers : 1;
 
+	/** Random spread of fired projectiles in degrees. Picked from the seed of the shot, so every machine simulates the same direction. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Projectile)
+	float ShotSpreadDegrees;
+
+	/** Whether shots spawn projectiles or are resolved as instant traces, batched with the other hitscan shots of the frame. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Projectile)
+	EGravityGunFireMode FireMode;
+
+	/** Length of the trace of a hitscan shot. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Projectile)
+	float HitscanRange;
+
+	/** Longest time a client fast forwards a shot it received late. Older shots are skipped ahead by this amount only. */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Projectile)
+	float MaxShotFastForwardSeconds;
+
+	/** Called by the server projectile of a shot when it hits a physics object */
+	void NotifyShotHit(uint16 ShotId, const FVector& HitLocation);
+
 protected:
 	
 	/** Fires a projectile. */
 	void OnFire();
 
+	/** Fires a projectile from the supplied muzzle transform on the server and replicates it according to ggp.Net.ShotEvents */
+	void FireProjectile(const FVector& MuzzleLocation, const FRotator& MuzzleRotation);
+
+	/** Queues a hitscan shot on the server. Only its effect on physics objects is replicated. */
+	void FireHitscan(const FGravityGunShotEvent& Shot);
+
+	/** Spawns the projectile of a shot. Only authoritative projectiles push physics objects. */
+	class AGravityGunPlaygroundProjectile* SpawnShotProjectile(const FGravityGunShotEvent& Shot, bool bAuthoritative, bool bReplicated, float FastForwardSeconds);
+
+	/** Sends a shot fired on a client to the server */
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerFire(FVector_NetQuantize10 MuzzleLocation, FRotator MuzzleRotation);
+
+	/** Lets every client simulate a shot fired on the server */
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastShot(const FGravityGunShotEvent& Shot);
+
+	/** Replicates where the server projectile of a shot hit */
+	UFUNCTION(NetMulticast, Unreliable)
+	void MulticastShotHit(uint16 ShotId, FVector_NetQuantize HitLocation);
+
+	/** Id of the next shot fired on the server */
+	uint16 NextShotId;
+
+	/** Locally simulated projectiles on clients, by shot id, until the hit of the server projectile arrives */
+	TMap<uint16, TWeakObjectPtr<class AGravityGunPlaygroundProjectile>> SimulatedShots;
+
 	/** Resets HMD orientation and position in VR. */
 	void OnResetVR();
 
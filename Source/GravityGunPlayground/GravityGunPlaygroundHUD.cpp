@@ -6,12 +6,19 @@
 #include "TextureResource.h"
 #include "CanvasItem.h"
 #include "UObject/ConstructorHelpers.h"
+#include "AimQueryComponent.h"
+#include "LaunchPreviewComponent.h"
 
 AGravityGunPlaygroundHUD::AGravityGunPlaygroundHUD()
 {
 	// Set the crosshair texture
 	static ConstructorHelpers::FObjectFinder<UTexture2D> CrosshairTexObj(TEXT("/Game/External/FirstPerson/Textures/FirstPersonCrosshair"));
 	CrosshairTex = CrosshairTexObj.Object;
+
+	TargetCrosshairColor = FLinearColor::Green;
+	LaunchPathColor = FLinearColor(0.f, 1.f, 1.f, 0.6f);
+	LaunchImpactColor = FLinearColor::Red;
+	LaunchPathThickness = 2.f;
 }
 
 
@@ -28,8 +35,53 @@ void AGravityGunPlaygroundHUD::DrawHUD()
 	const FVector2D CrosshairDrawPosition( (Center.X),
 										   (Center.Y + 20.0f));
 
+	// tint the crosshair when aiming at a physics object, reusing the trace the gun already made this frame
+	UAimQueryComponent* AimQuery = UAimQueryComponent::FindOrAdd(GetOwningPawn());
+	const FLinearColor CrosshairColor = (AimQuery && AimQuery->HasTarget()) ? TargetCrosshairColor : FLinearColor::White;
+
 	// draw the crosshair
-	FCanvasTileItem TileItem( CrosshairDrawPosition, CrosshairTex->Resource, FLinearColor::White);
+	FCanvasTileItem TileItem( CrosshairDrawPosition, CrosshairTex->Resource, CrosshairColor);
 	TileItem.BlendMode = SE_BLEND_Translucent;
 	Canvas->DrawItem( TileItem );
+
+	DrawLaunchPath();
+}
+
+void AGravityGunPlaygroundHUD::DrawLaunchPath()
+{
+	ULaunchPreviewComponent* LaunchPreview = ULaunchPreviewComponent::FindForCarrier(GetOwningPawn());
+	if (!LaunchPreview || !LaunchPreview->HasPrediction())
+	{
+		return;
+	}
+
+	const TArray<FVector> Path = LaunchPreview->GetPredictedPath();
+	for (int32 Index = 1; Index < Path.Num(); Index++)
+	{
+		// project returns a depth of 0 or less for points behind the view, skip the segments that cross it
+		const FVector Start = Project(Path[Index - 1]);
+		const FVector End = Project(Path[Index]);
+		if (Start.Z <= 0.f || End.Z <= 0.f)
+		{
+			continue;
+		}
+
+		FCanvasLineItem LineItem(FVector2D(Start), FVector2D(End));
+		LineItem.SetColor(LaunchPathColor);
+		LineItem.LineThickness = LaunchPathThickness;
+		Canvas->DrawItem(LineItem);
+	}
+
+	FVector ImpactLocation;
+	if (LaunchPreview->GetPredictedImpact(ImpactLocation))
+	{
+		const FVector Impact = Project(ImpactLocation);
+		if (Impact.Z > 0.f)
+		{
+			const float MarkerSize = 8.f;
+			FCanvasTileItem MarkerItem(FVector2D(Impact) - FVector2D(MarkerSize * 0.5f), FVector2D(MarkerSize), LaunchImpactColor);
+			MarkerItem.BlendMode = SE_BLEND_Translucent;
+			Canvas->DrawItem(MarkerItem);
+		}
+	}
 }
@@ -17,7 +17,27 @@ public:
 	/** Primary draw call for the HUD */
 	virtual void DrawHUD() override;
 
+protected:
+	/** Crosshair color while the player is aiming at a physics object */
+	UPROPERTY(EditDefaultsOnly, Category = HUD)
+	FLinearColor TargetCrosshairColor;
+
+	/** Color of the predicted launch path of the held object */
+	UPROPERTY(EditDefaultsOnly, Category = HUD)
+	FLinearColor LaunchPathColor;
+
+	/** Color of the marker where the predicted launch path hits something */
+	UPROPERTY(EditDefaultsOnly, Category = HUD)
+	FLinearColor LaunchImpactColor;
+
+	/** Thickness of the predicted launch path in pixels */
+	UPROPERTY(EditDefaultsOnly, Category = HUD)
+	float LaunchPathThickness;
+
 private:
+	/** Draws the predicted launch path of the object held by the owning pawn */
+	void DrawLaunchPath();
+
 	/** Crosshair asset pointer */
 	class UTexture2D* CrosshairTex;
 
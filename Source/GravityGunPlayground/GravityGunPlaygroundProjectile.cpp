@@ -3,6 +3,10 @@
 #include "GravityGunPlaygroundProjectile.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "Components/SphereComponent.h"
+#include "GravityGunMemory.h"
+#include "GravityGunPlaygroundCharacter.h"
+#include "GravityPropActor.h"
+#include "ImpulseCoalescer.h"
 
 AGravityGunPlaygroundProjectile::AGravityGunPlaygroundProjectile() 
 {
@@ -31,12 +35,61 @@ AGravityGunPlaygroundProjectile::AGravityGunPlaygroundProjectile()
 	InitialLifeSpan = 3.0f;
 }
 
+void AGravityGunPlaygroundProjectile::BeginPlay()
+{
+	Super::BeginPlay();
+
+	TrackedMemoryBytes = FGravityGunMemory::EstimateActorBytes(this);
+	FGravityGunMemory::TrackAllocation(EGravityGunMemoryCategory::Projectiles, TrackedMemoryBytes);
+}
+
+void AGravityGunPlaygroundProjectile::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	FGravityGunMemory::TrackFree(EGravityGunMemoryCategory::Projectiles, TrackedMemoryBytes);
+	TrackedMemoryBytes = 0;
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void AGravityGunPlaygroundProjectile::InitializeShot(uint16 InShotId, bool bInAuthoritative)
+{
+	ShotId = InShotId;
+	bAuthoritative = bInAuthoritative;
+}
+
+void AGravityGunPlaygroundProjectile::FastForward(float Seconds)
+{
+	if (Seconds <= 0.f || !ProjectileMovement->UpdatedComponent) { return; }
+
+	// follow the same ballistic path the movement component would, stopping at the first blocking hit
+	const FVector Gravity(0.f, 0.f, ProjectileMovement->GetGravityZ());
+	const FVector Velocity = ProjectileMovement->Velocity;
+	const FVector Delta = Velocity * Seconds + Gravity * (0.5f * Seconds * Seconds);
+
+	ProjectileMovement->Velocity = Velocity + Gravity * Seconds;
+	SetActorLocation(GetActorLocation() + Delta, true);
+}
+
 void AGravityGunPlaygroundProjectile::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
 {
 	// Only add impulse and destroy projectile if we hit a physics
 	if ((OtherActor != NULL) && (OtherActor != this) && (OtherComp != NULL) && OtherComp->IsSimulatingPhysics())
 	{
-		OtherComp->AddImpulseAtLocation(GetVelocity() * 100.0f, GetActorLocation());
+		// local simulations only disappear, the server projectile pushes the object and its hit is replicated by the shooter
+		if (bAuthoritative)
+		{
+			// summed with the other hits on the body this frame and applied once after physics
+			if (AImpulseCoalescer* Coalescer = AImpulseCoalescer::Get(GetWorld()))
+			{
+				Coalescer->AddImpulseAtLocation(OtherComp, GetVelocity() * 100.0f, GetActorLocation());
+			}
+			AGravityPropActor::NotifyActivity(OtherActor);
+
+			if (AGravityGunPlaygroundCharacter* Shooter = Cast<AGravityGunPlaygroundCharacter>(GetOwner()))
+			{
+				Shooter->NotifyShotHit(ShotId, Hit.ImpactPoint);
+			}
+		}
 
 		Destroy();
 	}
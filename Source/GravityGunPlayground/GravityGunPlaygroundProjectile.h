@@ -26,9 +26,32 @@ public:
 	UFUNCTION()
 	void OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
 
+	/** Sets the shot this projectile belongs to. Projectiles that aren't authoritative are a local simulation of a server shot and don't push physics objects. Call before FinishSpawning. */
+	void InitializeShot(uint16 InShotId, bool bInAuthoritative);
+
+	/** Moves the projectile ahead by the supplied time, used to catch up with a shot that was fired on the server earlier */
+	void FastForward(float Seconds);
+
+	/** Returns the id of the shot this projectile belongs to */
+	FORCEINLINE uint16 GetShotId() const { return ShotId; }
+
 	/** Returns CollisionComp subobject **/
 	FORCEINLINE class USphereComponent* GetCollisionComp() const { return CollisionComp; }
 	/** Returns ProjectileMovement subobject **/
 	FORCEINLINE class UProjectileMovementComponent* GetProjectileMovement() const { return ProjectileMovement; }
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	/** Bytes reported to the gravity gun memory tracker for this projectile */
+	int64 TrackedMemoryBytes = 0;
+
+	/** Id of the shot this projectile belongs to */
+	uint16 ShotId = 0;
+
+	/** Whether this projectile applies impulses and reports its hit to the shooter */
+	bool bAuthoritative = true;
 };
 
@@ -0,0 +1,168 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "AimQueryComponent.h"
+#include "GravityGunPlayground.h"
+#include "GravityGunBudget.h"
+#include "Camera/CameraComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "IXRTrackingSystem.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("Aim Query"), STAT_GGPAimQuery, STATGROUP_GravityGun);
+
+namespace AimQueries
+{
+	static int32 bSameFrameView = 1;
+
+	static FAutoConsoleVariableRef CVarSameFrameView(
+		TEXT("ggp.Aim.SameFrameView"),
+		bSameFrameView,
+		TEXT("If 1, the aim and held objects use the view of the current frame, built from the camera component and control rotation.\n")
+		TEXT("If 0, the view of the camera manager is used, which is updated after the tick groups and so lags a frame behind."));
+}
+
+// Sets default values for this component's properties
+UAimQueryComponent::UAimQueryComponent()
+{
+	// The aim is computed on demand, the component never needs to tick
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+UAimQueryComponent* UAimQueryComponent::FindOrAdd(APawn* Pawn)
+{
+	if (!Pawn) { return nullptr; }
+
+	if (UAimQueryComponent* AimQuery = Pawn->FindComponentByClass<UAimQueryComponent>())
+	{
+		return AimQuery;
+	}
+
+	UAimQueryComponent* AimQuery = NewObject<UAimQueryComponent>(Pawn, TEXT("AimQuery"));
+	AimQuery->RegisterComponent();
+	return AimQuery;
+}
+
+UAimQueryComponent* UAimQueryComponent::FindOrAddForActor(const AActor* Actor)
+{
+	if (!Actor) { return nullptr; }
+
+	APawn* Pawn = Cast<APawn>(Actor->GetAttachParentActor());
+	if (!Pawn)
+	{
+		APlayerController* PlayerController = Actor->GetWorld()->GetFirstPlayerController();
+		Pawn = PlayerController ? PlayerController->GetPawn() : nullptr;
+	}
+	return FindOrAdd(Pawn);
+}
+
+const FAimQueryResult& UAimQueryComponent::GetAim(float MinimumRange, bool bFreshTrace)
+{
+	///Retrace only when this is the first range that is larger than all the ones before
+	const bool bRangeGrew = MinimumRange > TraceRange;
+	TraceRange = FMath::Max(TraceRange, MinimumRange);
+
+	if (LastQueryFrame != GFrameCounter)
+	{
+		LastQueryFrame = GFrameCounter;
+		UpdateView();
+	}
+	if (bRangeGrew || NeedsTrace(bFreshTrace))
+	{
+		LastTraceFrame = GFrameCounter;
+		UpdateTrace();
+	}
+	return CachedResult;
+}
+
+FHitResult UAimQueryComponent::GetHitWithinRange(float Range, bool bFreshTrace)
+{
+	const FAimQueryResult& Aim = GetAim(Range, bFreshTrace);
+	if (!Aim.Hit.bBlockingHit || Aim.Hit.Distance > Range)
+	{
+		return FHitResult();
+	}
+	return Aim.Hit;
+}
+
+bool UAimQueryComponent::HasTarget()
+{
+	return GetAim().Hit.bBlockingHit;
+}
+
+void UAimQueryComponent::GetViewPoint(FVector& OutLocation, FRotator& OutRotation) const
+{
+	APawn* Pawn = Cast<APawn>(GetOwner());
+	if (!Pawn) { return; }
+
+	APlayerController* PlayerController = Cast<APlayerController>(Pawn->GetController());
+	if (!PlayerController)
+	{
+		Pawn->GetActorEyesViewPoint(OutLocation, OutRotation);
+		return;
+	}
+
+	if (UsesSameFrameView())
+	{
+		///Head mounted displays are late-updated by the camera manager, only first person cameras are rebuilt here
+		UCameraComponent* Camera = Pawn->FindComponentByClass<UCameraComponent>();
+		const bool bTrackedByHMD = Camera && Camera->bLockToHmd && GEngine && GEngine->XRSystem.IsValid() && GEngine->XRSystem->IsHeadTrackingAllowed();
+		if (Camera && Camera->IsActive() && !bTrackedByHMD)
+		{
+			///A camera using the control rotation only gets its rotation when the camera manager asks for its view
+			OutLocation = Camera->GetComponentLocation();
+			OutRotation = Camera->bUsePawnControlRotation ? PlayerController->GetControlRotation() : Camera->GetComponentRotation();
+			return;
+		}
+	}
+	PlayerController->GetPlayerViewPoint(OutLocation, OutRotation);
+}
+
+bool UAimQueryComponent::UsesSameFrameView()
+{
+	return AimQueries::bSameFrameView != 0;
+}
+
+bool UAimQueryComponent::NeedsTrace(bool bFreshTrace) const
+{
+	if (LastTraceFrame == GFrameCounter) { return false; }
+	if (bFreshTrace || LastTraceFrame == MAX_uint64) { return true; }
+
+	///Crosshair feedback can use the hit of an earlier frame while the frame is over budget
+	return GFrameCounter - LastTraceFrame >= (uint64)AGravityGunBudget::GetAimTraceInterval();
+}
+
+void UAimQueryComponent::UpdateView()
+{
+	if (Cast<APawn>(GetOwner()))
+	{
+		GetViewPoint(CachedResult.ViewLocation, CachedResult.ViewRotation);
+	}
+}
+
+void UAimQueryComponent::UpdateTrace()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GGPAimQuery);
+
+	APawn* Pawn = Cast<APawn>(GetOwner());
+	if (!Pawn) { return; }
+
+	CachedResult.Hit = FHitResult();
+	if (TraceRange <= 0.f) { return; }
+
+	///Ignore the pawn and everything it carries, like the gun itself
+	FCollisionQueryParams QueryParams(FName(TEXT("AimQuery")), false, Pawn);
+	TArray<AActor*> AttachedActors;
+	Pawn->GetAttachedActors(AttachedActors);
+	QueryParams.AddIgnoredActors(AttachedActors);
+
+	GetWorld()->LineTraceSingleByObjectType(
+		CachedResult.Hit,
+		CachedResult.ViewLocation,
+		CachedResult.ViewLocation + CachedResult.ViewRotation.Vector() * TraceRange,
+		FCollisionObjectQueryParams(ECollisionChannel::ECC_PhysicsBody),
+		QueryParams);
+}
@@ -0,0 +1,91 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "BreakablePropComponent.h"
+#include "DebrisPool.h"
+#include "GravityGunMemory.h"
+#include "GravityGunProps.h"
+#include "ImpulseCoalescer.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "TimerManager.h"
+
+// Sets default values for this component's properties
+UBreakablePropComponent::UBreakablePropComponent()
+{
+	// The component only reacts to hits of the owner, it never needs to tick
+	PrimaryComponentTick.bCanEverTick = false;
+}
+
+// Called when the game starts
+void UBreakablePropComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	UPrimitiveComponent* Body = FGravityGunProps::GetPropComponent(GetOwner());
+	if (!Body) { return; }
+
+	///Falling or knocked over breakables report their own hits, not only the ones of launched and shot props
+	if (AImpulseCoalescer* Coalescer = AImpulseCoalescer::Get(GetWorld()))
+	{
+		Coalescer->WatchBreakable(Body);
+	}
+
+	if (bPrewarmPool && Chunks.Num() > 0)
+	{
+		///Count the chunks per mesh, a mesh can be used by multiple chunks of the same prop
+		TMap<UStaticMesh*, int32> ChunksPerMesh;
+		for (const FBreakableChunk& Chunk : Chunks)
+		{
+			ChunksPerMesh.FindOrAdd(Chunk.Mesh)++;
+		}
+
+		ADebrisPool* Pool = ADebrisPool::Get(GetWorld());
+		for (const TPair<UStaticMesh*, int32>& MeshCount : ChunksPerMesh)
+		{
+			Pool->Prewarm(MeshCount.Key, MeshCount.Value);
+		}
+	}
+}
+
+void UBreakablePropComponent::HandleImpact(UPrimitiveComponent* HitComponent, const FVector& NormalImpulse, const FVector& ImpactLocation)
+{
+	if (bBreakPending || Chunks.Num() == 0) { return; }
+	if (NormalImpulse.Size() < BreakImpulseThreshold) { return; }
+
+	///Held props are safe, the player is carrying them
+	if (FGravityGunProps::IsHeld(HitComponent)) { return; }
+
+	///Hits are reported while physics results are dispatched, the chunks are created on the next tick instead
+	bBreakPending = true;
+	const FTimerDelegate TimerDelegate = FTimerDelegate::CreateUObject(this, &UBreakablePropComponent::Break, ImpactLocation);
+	GetWorld()->GetTimerManager().SetTimerForNextTick(TimerDelegate);
+}
+
+void UBreakablePropComponent::Break(FVector ImpactLocation)
+{
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::Props);
+
+	AActor* Owner = GetOwner();
+	UPrimitiveComponent* Body = FGravityGunProps::GetPropComponent(Owner);
+	ADebrisPool* Pool = ADebrisPool::Get(GetWorld());
+	if (!(Body && Pool)) { return; }
+
+	const FTransform PropTransform = Body->GetComponentTransform();
+	const FVector LinearVelocity = Body->GetPhysicsLinearVelocity();
+	const FVector AngularVelocity = Body->GetPhysicsAngularVelocityInRadians();
+
+	for (const FBreakableChunk& Chunk : Chunks)
+	{
+		const FTransform ChunkTransform = Chunk.RelativeTransform * PropTransform;
+
+		///Chunks keep the motion of the prop and move away from the impact
+		const FVector Separation = (ChunkTransform.GetLocation() - ImpactLocation).GetSafeNormal() * ChunkSeparationSpeed;
+		const FVector ChunkVelocity = LinearVelocity + FVector::CrossProduct(AngularVelocity, ChunkTransform.GetLocation() - PropTransform.GetLocation()) + Separation;
+
+		Pool->SpawnChunk(Chunk.Mesh, ChunkTransform, ChunkVelocity, AngularVelocity);
+	}
+
+	OnBreak.Broadcast();
+	Owner->Destroy();
+}
@@ -0,0 +1,318 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "DebrisPool.h"
+#include "GravityGunPlayground.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Debris Update"), STAT_GGPDebrisUpdate, STATGROUP_GravityGun);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Live Debris Chunks"), STAT_GGPLiveDebrisChunks, STATGROUP_GravityGun);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Free Debris Chunks"), STAT_GGPFreeDebrisChunks, STATGROUP_GravityGun);
+
+namespace DebrisPool
+{
+	static int32 MaxLiveChunks = 64;
+	static int32 bRecycleFurthest = 1;
+	static float SettleSeconds = 1.5f;
+	static float LifetimeSeconds = 5.f;
+	static float FadeSeconds = 0.4f;
+	static float SettleDamping = 2.f;
+
+	static FAutoConsoleVariableRef CVarMaxLiveChunks(
+		TEXT("ggp.Debris.MaxLiveChunks"),
+		MaxLiveChunks,
+		TEXT("Maximum number of simulating debris chunks in the world. Breaking a prop above the limit recycles live chunks."));
+
+	static FAutoConsoleVariableRef CVarRecycleFurthest(
+		TEXT("ggp.Debris.RecycleFurthest"),
+		bRecycleFurthest,
+		TEXT("1: recycle the chunk furthest from the player when over the limit. 0: recycle the oldest chunk."));
+
+	static FAutoConsoleVariableRef CVarSettleSeconds(
+		TEXT("ggp.Debris.SettleSeconds"),
+		SettleSeconds,
+		TEXT("Seconds after which chunks are damped, so they come to rest and fall asleep."));
+
+	static FAutoConsoleVariableRef CVarLifetimeSeconds(
+		TEXT("ggp.Debris.LifetimeSeconds"),
+		LifetimeSeconds,
+		TEXT("Seconds after which chunks fade out, even if they are still moving."));
+
+	static FAutoConsoleVariableRef CVarFadeSeconds(
+		TEXT("ggp.Debris.FadeSeconds"),
+		FadeSeconds,
+		TEXT("Seconds a chunk takes to shrink away before it returns to the pool."));
+
+	static void StatsCommand(const TArray<FString>& Args, UWorld* World)
+	{
+		for (TActorIterator<ADebrisPool> It(World); It; ++It)
+		{
+			UE_LOG(LogGravityGun, Display, TEXT("Debris: %d live chunks, %d free chunks, limit %d"),
+				It->GetNumLiveChunks(), It->GetNumFreeChunks(), MaxLiveChunks);
+		}
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs StatsConsoleCommand(
+		TEXT("ggp.Debris.Stats"),
+		TEXT("Logs the live and free debris chunks of the world."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StatsCommand));
+}
+
+// Sets default values
+ADebrisPool::ADebrisPool()
+{
+	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>("Root");
+}
+
+ADebrisPool* ADebrisPool::Get(UWorld* World)
+{
+	if (!World) { return nullptr; }
+
+	for (TActorIterator<ADebrisPool> It(World); It; ++It)
+	{
+		if (!It->IsPendingKill())
+		{
+			return *It;
+		}
+	}
+	return World->SpawnActor<ADebrisPool>();
+}
+
+// Called when the game starts or when spawned
+void ADebrisPool::BeginPlay()
+{
+	Super::BeginPlay();
+
+	BytesPerChunk = UStaticMeshComponent::StaticClass()->GetStructureSize();
+	OverBudgetHandle = FGravityGunMemory::OnOverBudget.AddUObject(this, &ADebrisPool::OnOverBudget);
+}
+
+void ADebrisPool::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	FGravityGunMemory::OnOverBudget.Remove(OverBudgetHandle);
+
+	///Every chunk, live or free, was tracked when it was created
+	for (int32 Index = 0; Index < LiveChunks.Num(); Index++)
+	{
+		FGravityGunMemory::TrackFree(EGravityGunMemoryCategory::Props, BytesPerChunk);
+	}
+	for (int32 Index = 0; Index < GetNumFreeChunks(); Index++)
+	{
+		FGravityGunMemory::TrackFree(EGravityGunMemoryCategory::Props, BytesPerChunk);
+	}
+	LiveChunks.Empty();
+	Pools.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Called every frame
+void ADebrisPool::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	SCOPE_CYCLE_COUNTER(STAT_GGPDebrisUpdate);
+
+	const float Now = GetWorld()->GetTimeSeconds();
+	for (int32 Index = LiveChunks.Num() - 1; Index >= 0; Index--)
+	{
+		FLiveDebrisChunk& Chunk = LiveChunks[Index];
+		if (!Chunk.Component)
+		{
+			LiveChunks.RemoveAtSwap(Index);
+			continue;
+		}
+
+		const float Age = Now - Chunk.SpawnTime;
+		if (Chunk.FadeStartTime < 0.f)
+		{
+			///Damp settled chunks so they fall asleep quickly, then fade the sleeping ones
+			if (Age >= DebrisPool::SettleSeconds)
+			{
+				Chunk.Component->SetLinearDamping(DebrisPool::SettleDamping);
+				Chunk.Component->SetAngularDamping(DebrisPool::SettleDamping);
+			}
+			if (Age >= DebrisPool::LifetimeSeconds || (Age >= DebrisPool::SettleSeconds && !Chunk.Component->RigidBodyIsAwake()))
+			{
+				Chunk.FadeStartTime = Now;
+				Chunk.Component->SetSimulatePhysics(false);
+				Chunk.Component->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+			}
+			continue;
+		}
+
+		const float FadeAlpha = DebrisPool::FadeSeconds > 0.f ? (Now - Chunk.FadeStartTime) / DebrisPool::FadeSeconds : 1.f;
+		if (FadeAlpha >= 1.f)
+		{
+			ReleaseChunk(Index);
+			continue;
+		}
+		Chunk.Component->SetWorldScale3D(Chunk.SpawnScale * (1.f - FadeAlpha));
+	}
+
+	SET_DWORD_STAT(STAT_GGPLiveDebrisChunks, LiveChunks.Num());
+	SET_DWORD_STAT(STAT_GGPFreeDebrisChunks, GetNumFreeChunks());
+
+	///Nothing to update until the next break
+	if (LiveChunks.Num() == 0)
+	{
+		SetActorTickEnabled(false);
+	}
+}
+
+void ADebrisPool::Prewarm(UStaticMesh* Mesh, int32 NumChunks)
+{
+	if (!Mesh) { return; }
+
+	///Creating chunks can trigger a trim of the pools, so the amount to create is decided up front
+	FDebrisMeshPool& Pool = Pools.FindOrAdd(Mesh);
+	const int32 NumToCreate = NumChunks - Pool.FreeChunks.Num();
+	for (int32 Index = 0; Index < NumToCreate; Index++)
+	{
+		Pool.FreeChunks.Add(CreateChunk(Mesh));
+	}
+}
+
+UStaticMeshComponent* ADebrisPool::SpawnChunk(UStaticMesh* Mesh, const FTransform& Transform, const FVector& LinearVelocity, const FVector& AngularVelocityInRadians)
+{
+	if (!Mesh || DebrisPool::MaxLiveChunks <= 0) { return nullptr; }
+
+	while (LiveChunks.Num() >= DebrisPool::MaxLiveChunks)
+	{
+		ReleaseChunk(FindChunkToRecycle());
+	}
+
+	FDebrisMeshPool& Pool = Pools.FindOrAdd(Mesh);
+	UStaticMeshComponent* Chunk = Pool.FreeChunks.Num() > 0 ? Pool.FreeChunks.Pop(false) : CreateChunk(Mesh);
+
+	Chunk->SetWorldTransform(Transform, false, nullptr, ETeleportType::TeleportPhysics);
+	Chunk->SetVisibility(true);
+	Chunk->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+	Chunk->SetLinearDamping(0.01f);
+	Chunk->SetAngularDamping(0.f);
+	Chunk->SetSimulatePhysics(true);
+	Chunk->SetPhysicsLinearVelocity(LinearVelocity);
+	Chunk->SetPhysicsAngularVelocityInRadians(AngularVelocityInRadians);
+
+	FLiveDebrisChunk& LiveChunk = LiveChunks.AddDefaulted_GetRef();
+	LiveChunk.Component = Chunk;
+	LiveChunk.SpawnTime = GetWorld()->GetTimeSeconds();
+	LiveChunk.SpawnScale = Transform.GetScale3D();
+
+	SetActorTickEnabled(true);
+	return Chunk;
+}
+
+int32 ADebrisPool::GetNumFreeChunks() const
+{
+	int32 NumFree = 0;
+	for (const TPair<UStaticMesh*, FDebrisMeshPool>& Pool : Pools)
+	{
+		NumFree += Pool.Value.FreeChunks.Num();
+	}
+	return NumFree;
+}
+
+int64 ADebrisPool::TrimFreeChunks(int64 BytesToFree)
+{
+	int64 FreedBytes = 0;
+	for (TPair<UStaticMesh*, FDebrisMeshPool>& Pool : Pools)
+	{
+		while (Pool.Value.FreeChunks.Num() > 0 && FreedBytes < BytesToFree)
+		{
+			UStaticMeshComponent* Chunk = Pool.Value.FreeChunks.Pop(false);
+			if (Chunk)
+			{
+				Chunk->DestroyComponent();
+			}
+			FGravityGunMemory::TrackFree(EGravityGunMemoryCategory::Props, BytesPerChunk);
+			FreedBytes += BytesPerChunk;
+		}
+	}
+	return FreedBytes;
+}
+
+UStaticMeshComponent* ADebrisPool::CreateChunk(UStaticMesh* Mesh)
+{
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::Props);
+
+	UStaticMeshComponent* Chunk = NewObject<UStaticMeshComponent>(this);
+	Chunk->SetMobility(EComponentMobility::Movable);
+	Chunk->SetStaticMesh(Mesh);
+	Chunk->SetCollisionProfileName(UCollisionProfile::PhysicsActor_ProfileName);
+	///Debris isn't a physicsbody, so grab and launch traces ignore it
+	Chunk->SetCollisionObjectType(ECC_WorldDynamic);
+	Chunk->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Chunk->SetVisibility(false);
+	Chunk->CanCharacterStepUpOn = ECB_No;
+	Chunk->SetCastShadow(false);
+	Chunk->RegisterComponent();
+
+	FGravityGunMemory::TrackAllocation(EGravityGunMemoryCategory::Props, BytesPerChunk);
+	return Chunk;
+}
+
+void ADebrisPool::ReleaseChunk(int32 LiveIndex)
+{
+	if (!LiveChunks.IsValidIndex(LiveIndex)) { return; }
+
+	UStaticMeshComponent* Chunk = LiveChunks[LiveIndex].Component;
+	LiveChunks.RemoveAtSwap(LiveIndex);
+	if (!Chunk) { return; }
+
+	Chunk->SetSimulatePhysics(false);
+	Chunk->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Chunk->SetVisibility(false);
+	Pools.FindOrAdd(Chunk->GetStaticMesh()).FreeChunks.Add(Chunk);
+}
+
+int32 ADebrisPool::FindChunkToRecycle() const
+{
+	APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	const bool bHasView = DebrisPool::bRecycleFurthest && PlayerController;
+	if (bHasView)
+	{
+		PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+	}
+
+	int32 BestIndex = 0;
+	float BestScore = -MAX_flt;
+	for (int32 Index = 0; Index < LiveChunks.Num(); Index++)
+	{
+		const FLiveDebrisChunk& Chunk = LiveChunks[Index];
+		if (!Chunk.Component) { return Index; }
+
+		///Chunks that are already fading go first, they are about to disappear anyway
+		const float FadeBonus = Chunk.FadeStartTime >= 0.f ? MAX_flt * 0.5f : 0.f;
+		const float Score = FadeBonus + (bHasView
+			? FVector::DistSquared(Chunk.Component->GetComponentLocation(), ViewLocation)
+			: -Chunk.SpawnTime);
+		if (Score > BestScore)
+		{
+			BestScore = Score;
+			BestIndex = Index;
+		}
+	}
+	return BestIndex;
+}
+
+void ADebrisPool::OnOverBudget(EGravityGunMemoryCategory Category, int64 BytesOverBudget)
+{
+	if (Category != EGravityGunMemoryCategory::Props) { return; }
+
+	const int64 FreedBytes = TrimFreeChunks(BytesOverBudget);
+	if (FreedBytes > 0)
+	{
+		UE_LOG(LogGravityGun, Log, TEXT("Debris pool trimmed %lld KB of free chunks"), FreedBytes / 1024);
+	}
+}
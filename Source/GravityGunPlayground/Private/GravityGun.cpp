@@ -2,9 +2,19 @@
 
 
 #include "GravityGun.h"
+#include "GravityGunPlayground.h"
 #include "ObjectGrabberComponent.h"
 #include "ObjectLauncherComponent.h"
+#include "MultiObjectGrabberComponent.h"
+#include "PropRewindComponent.h"
+#include "LaunchPreviewComponent.h"
+#include "GravityGunDeterminism.h"
+#include "GravityGunLatency.h"
+#include "AimQueryComponent.h"
+#include "PropLagCompensation.h"
+#include "Components/PrimitiveComponent.h"
 #include "Engine/World.h"
+#include "GameFramework/Pawn.h"
 
 // Sets default values
 AGravityGun::AGravityGun()
@@ -13,30 +23,325 @@ AGravityGun::AGravityGun()
 	PrimaryActorTick.bCanEverTick = false;
 
 	ObjectGrabber = CreateDefaultSubobject<UObjectGrabberComponent>("ObjectGrabber");
+
+	MultiObjectGrabber = CreateDefaultSubobject<UMultiObjectGrabberComponent>("MultiObjectGrabber");
 	
 	ObjectLauncher = CreateDefaultSubobject<UObjectLauncherComponent>("ObjectLauncher");
+
+	PropRewind = CreateDefaultSubobject<UPropRewindComponent>("PropRewind");
+
+	LaunchPreview = CreateDefaultSubobject<ULaunchPreviewComponent>("LaunchPreview");
+
+	///Replicated so the player carrying the gun can send its commands to the server
+	bReplicates = true;
+}
+
+// Called when the game starts or when spawned
+void AGravityGun::BeginPlay()
+{
+	Super::BeginPlay();
+
+	///Start recording the props before the first client request arrives. Does nothing without remote clients.
+	if (HasAuthority())
+	{
+		APropLagCompensation::Get(GetWorld());
+	}
 }
 
 void AGravityGun::TryGrab()
 {
 	if (!(ObjectGrabber)) return;
+	FGravityGunLatency::MarkInput(EGravityGunLatencyAction::Grab);
+
+	///In deterministic mode input is executed on the next fixed step
+	if (FGravityGunDeterminism::ShouldDeferToStep())
+	{
+		TWeakObjectPtr<AGravityGun> WeakThis(this);
+		FGravityGunDeterminism::RunOnStep(GetWorld(), [WeakThis]() { if (WeakThis.IsValid()) { WeakThis->TryGrab(); } });
+		return;
+	}
+
+	///The server grabs for the client and confirms what it holds. The client predicts the same grab below,
+	///so its grab events fire and the held actor is known on its own machine right away.
+	if (ShouldSendToServer())
+	{
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		GetCarrierView(ViewLocation, ViewRotation);
+		ServerTryGrab(ViewLocation, ViewRotation, (float)APropLagCompensation::GetServerTime(GetWorld()), bMultiGrab);
+		NumPendingRequests++;
+	}
+
+	if (bMultiGrab && MultiObjectGrabber)
+	{
+		MultiObjectGrabber->ToggleGrabActors();
+		if (MultiObjectGrabber->GetNumHeldActors() == 0)
+		{
+			FGravityGunLatency::CancelInput(EGravityGunLatencyAction::Grab);
+		}
+		return;
+	}
 
 	ObjectGrabber->ToggleGrabActor();
+
+	///Only a new grab has an effect to wait for, the grabber marks it when the body first moves
+	AActor* GrabbedObject;
+	if (!ObjectGrabber->GetGrabbedActor(GrabbedObject))
+	{
+		FGravityGunLatency::CancelInput(EGravityGunLatencyAction::Grab);
+	}
 }
 
 void AGravityGun::TryLaunch()
 {
 	if (!(ObjectLauncher && ObjectGrabber)) return;
+	FGravityGunLatency::MarkInput(EGravityGunLatencyAction::Launch);
+
+	///In deterministic mode input is executed on the next fixed step
+	if (FGravityGunDeterminism::ShouldDeferToStep())
+	{
+		TWeakObjectPtr<AGravityGun> WeakThis(this);
+		FGravityGunDeterminism::RunOnStep(GetWorld(), [WeakThis]() { if (WeakThis.IsValid()) { WeakThis->TryLaunch(); } });
+		return;
+	}
+
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	GetCarrierView(ViewLocation, ViewRotation);
+
+	///The server launches for the client and confirms what it still holds, the client predicts the launch like a grab
+	if (ShouldSendToServer())
+	{
+		ServerTryLaunch(ViewLocation, ViewRotation, (float)APropLagCompensation::GetServerTime(GetWorld()));
+		NumPendingRequests++;
+	}
+
+	if (!LaunchHeldActors(ViewLocation, ViewRotation))
+	{
+		ObjectLauncher->TryLaunchActorByLinecast();
+	}
+}
+
+bool AGravityGun::LaunchHeldActors(const FVector& ViewLocation, const FRotator& ViewRotation)
+{
+	AActor* GrabbedObject;
+	const bool bHoldingGroup = MultiObjectGrabber && MultiObjectGrabber->GetNumHeldActors() > 0;
+	const bool bHoldingActor = ObjectGrabber->GetGrabbedActor(GrabbedObject);
+	if (!bHoldingGroup && !bHoldingActor) { return false; }
+
+	///Keep holding while the launcher is cooling down, releasing first would drop the props without launching them
+	if (!ObjectLauncher->CanLaunch())
+	{
+		ObjectLauncher->RecordCooldownRejection();
+		return true;
+	}
+
+	if (bHoldingGroup)
+	{
+		TArray<UPrimitiveComponent*> HeldComponents;
+		MultiObjectGrabber->ReleaseActorsForLaunch(HeldComponents);
+		ObjectLauncher->LaunchComponentsFromView(HeldComponents, ViewRotation);
+		return true;
+	}
+
+	ObjectGrabber->ReleaseActor();
+	ObjectLauncher->LaunchActorFromView(GrabbedObject, ViewLocation, ViewRotation);
+	return true;
+}
+
+void AGravityGun::TryRewind()
+{
+	if (!(PropRewind && ObjectGrabber)) return;
+
+	if (PropRewind->IsRewinding())
+	{
+		PropRewind->StopRewind();
+		return;
+	}
+
+	///Held actors are driven by the physicshandle, release them before their transforms are rewound
+	ObjectGrabber->ReleaseActor();
+	if (MultiObjectGrabber)
+	{
+		MultiObjectGrabber->ReleaseActors();
+	}
+	PropRewind->StartRewind();
+}
+
+bool AGravityGun::ShouldSendToServer() const
+{
+	///A gun spawned by the client itself has authority there and has no counterpart on the server
+	return !HasAuthority() && GetNetConnection() != nullptr;
+}
+
+void AGravityGun::GetCarrierView(FVector& OutLocation, FRotator& OutRotation) const
+{
+	UAimQueryComponent* AimQuery = UAimQueryComponent::FindOrAddForActor(this);
+	if (!AimQuery)
+	{
+		GetActorEyesViewPoint(OutLocation, OutRotation);
+		return;
+	}
+
+	const FAimQueryResult& Aim = AimQuery->GetAim();
+	OutLocation = Aim.ViewLocation;
+	OutRotation = Aim.ViewRotation;
+}
+
+bool AGravityGun::IsViewWellFormed(const FVector& ViewLocation, const FRotator& ViewRotation, float ViewTime)
+{
+	return !ViewLocation.ContainsNaN() && !ViewRotation.ContainsNaN() && FMath::IsFinite(ViewTime);
+}
+
+bool AGravityGun::IsViewPlausible(const FVector& ViewLocation) const
+{
+	///The view is always close to the pawn carrying the gun
+	const AActor* Carrier = GetAttachParentActor() ? GetAttachParentActor() : GetOwner();
+	return !Carrier || FVector::DistSquared(ViewLocation, Carrier->GetActorLocation()) < FMath::Square(500.f);
+}
+
+FHitResult AGravityGun::TraceFromClientView(const FVector& ViewLocation, const FRotator& ViewRotation, float ViewTime, float Range) const
+{
+	///Ignore the pawn and everything it carries, like the aim query
+	APawn* Pawn = Cast<APawn>(GetAttachParentActor());
+	FCollisionQueryParams QueryParams(FName(TEXT("LagCompensatedAim")), false, Pawn);
+	if (Pawn)
+	{
+		TArray<AActor*> AttachedActors;
+		Pawn->GetAttachedActors(AttachedActors);
+		QueryParams.AddIgnoredActors(AttachedActors);
+	}
+
+	if (APropLagCompensation* LagCompensation = APropLagCompensation::Get(GetWorld()))
+	{
+		return LagCompensation->TraceAtTime(ViewLocation, ViewRotation.Vector(), Range, ViewTime, QueryParams);
+	}
+
+	FHitResult Hit;
+	GetWorld()->LineTraceSingleByObjectType(Hit, ViewLocation, ViewLocation + ViewRotation.Vector() * Range, FCollisionObjectQueryParams(ECC_PhysicsBody), QueryParams);
+	return Hit;
+}
+
+bool AGravityGun::ServerTryGrab_Validate(FVector_NetQuantize10 ViewLocation, FRotator ViewRotation, float ViewTime, bool bMultiGrabRequest)
+{
+	return IsViewWellFormed(ViewLocation, ViewRotation, ViewTime);
+}
+
+void AGravityGun::ServerTryGrab_Implementation(FVector_NetQuantize10 ViewLocation, FRotator ViewRotation, float ViewTime, bool bMultiGrabRequest)
+{
+	HandleGrabRequest(ViewLocation, ViewRotation, ViewTime, bMultiGrabRequest);
+
+	///Confirmed even when ignored, so the client drops a prediction the server didn't follow
+	ConfirmHeldToClient();
+}
+
+void AGravityGun::HandleGrabRequest(const FVector& ViewLocation, const FRotator& ViewRotation, float ViewTime, bool bMultiGrabRequest)
+{
+	if (!ObjectGrabber) { return; }
+	if (!IsViewPlausible(ViewLocation))
+	{
+		UE_LOG(LogGravityGun, Verbose, TEXT("Ignored grab request of %s, its view is too far from the pawn carrying the gun"), *GetName());
+		return;
+	}
+
+	///The grab mode of the client, the flag isn't replicated. The scoop of the multiobjectgrabber is not rewound,
+	///it gathers what is in front of the player now.
+	if (bMultiGrabRequest && MultiObjectGrabber)
+	{
+		MultiObjectGrabber->ToggleGrabActors();
+		return;
+	}
 
 	AActor* GrabbedObject;
 	if (ObjectGrabber->GetGrabbedActor(GrabbedObject))
 	{
 		ObjectGrabber->ReleaseActor();
-		ObjectLauncher->LaunchActorFromViewport(GrabbedObject);
+		return;
+	}
+	ObjectGrabber->GrabActorAtHit(TraceFromClientView(ViewLocation, ViewRotation, ViewTime, ObjectGrabber->GetGrabRange()));
+}
+
+bool AGravityGun::ServerTryLaunch_Validate(FVector_NetQuantize10 ViewLocation, FRotator ViewRotation, float ViewTime)
+{
+	return IsViewWellFormed(ViewLocation, ViewRotation, ViewTime);
+}
+
+void AGravityGun::ServerTryLaunch_Implementation(FVector_NetQuantize10 ViewLocation, FRotator ViewRotation, float ViewTime)
+{
+	HandleLaunchRequest(ViewLocation, ViewRotation, ViewTime);
+	ConfirmHeldToClient();
+}
+
+void AGravityGun::HandleLaunchRequest(const FVector& ViewLocation, const FRotator& ViewRotation, float ViewTime)
+{
+	if (!(ObjectLauncher && ObjectGrabber)) { return; }
+	if (!IsViewPlausible(ViewLocation))
+	{
+		UE_LOG(LogGravityGun, Verbose, TEXT("Ignored launch request of %s, its view is too far from the pawn carrying the gun"), *GetName());
+		return;
+	}
+
+	///Held actors and traced targets are both launched along the view the client aimed with
+	if (!LaunchHeldActors(ViewLocation, ViewRotation))
+	{
+		ObjectLauncher->TryLaunchActorAtHit(TraceFromClientView(ViewLocation, ViewRotation, ViewTime, ObjectLauncher->GetHitRange()), ViewLocation, ViewRotation);
+	}
+}
+
+void AGravityGun::ConfirmHeldToClient()
+{
+	TArray<AActor*> HeldActors;
+	const bool bHeldByMultiGrabber = MultiObjectGrabber && MultiObjectGrabber->GetNumHeldActors() > 0;
+	if (bHeldByMultiGrabber)
+	{
+		TArray<UPrimitiveComponent*> HeldComponents;
+		MultiObjectGrabber->GetHeldComponents(HeldComponents);
+		for (UPrimitiveComponent* Component : HeldComponents)
+		{
+			HeldActors.Add(Component->GetOwner());
+		}
 	}
 	else
 	{
-		ObjectLauncher->TryLaunchActorByLinecast();
+		AActor* GrabbedObject;
+		if (ObjectGrabber && ObjectGrabber->GetGrabbedActor(GrabbedObject))
+		{
+			HeldActors.Add(GrabbedObject);
+		}
 	}
+	ClientConfirmHeld(HeldActors, bHeldByMultiGrabber);
 }
 
+void AGravityGun::ClientConfirmHeld_Implementation(const TArray<AActor*>& HeldActors, bool bHeldByMultiGrabber)
+{
+	///Requests made after this one are still on their way, their confirmation decides
+	NumPendingRequests = FMath::Max(NumPendingRequests - 1, 0);
+	if (NumPendingRequests > 0) { return; }
+	if (!(ObjectGrabber && MultiObjectGrabber)) { return; }
+
+	///A predicted actor the server doesn't hold is released, an actor the server holds but the client doesn't is grabbed
+	AActor* PredictedActor = nullptr;
+	ObjectGrabber->GetGrabbedActor(PredictedActor);
+	AActor* ConfirmedActor = !bHeldByMultiGrabber && HeldActors.Num() > 0 ? HeldActors[0] : nullptr;
+	if (PredictedActor != ConfirmedActor)
+	{
+		ObjectGrabber->ReleaseActor();
+		ObjectGrabber->GrabActorDirectly(ConfirmedActor);
+	}
+
+	TArray<UPrimitiveComponent*> PredictedComponents;
+	MultiObjectGrabber->GetHeldComponents(PredictedComponents);
+	bool bGroupMatches = PredictedComponents.Num() == (bHeldByMultiGrabber ? HeldActors.Num() : 0);
+	for (const UPrimitiveComponent* Component : PredictedComponents)
+	{
+		bGroupMatches &= HeldActors.Contains(Component->GetOwner());
+	}
+	if (!bGroupMatches)
+	{
+		MultiObjectGrabber->ReleaseActors();
+		if (bHeldByMultiGrabber)
+		{
+			MultiObjectGrabber->GrabActorsDirectly(HeldActors);
+		}
+	}
+}
@@ -0,0 +1,392 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityGunBudget.h"
+#include "GravityGunPlayground.h"
+#include "GravityGunMemory.h"
+#include "GravityGunProps.h"
+#include "GravityGunTelemetry.h"
+#include "ImpulseCoalescer.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Budget Level"), STAT_GGPBudgetLevel, STATGROUP_GravityGun);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Budget Props Put To Sleep"), STAT_GGPBudgetPropsSlept, STATGROUP_GravityGun);
+
+namespace GravityGunBudget
+{
+	static const int32 MaxTier = 2;
+
+	static int32 bEnabled = 1;
+	static float GameThreadBudgetMs = 16.6f;
+	static float PhysicsBudgetMs = 6.f;
+	static float RecoverFraction = 0.75f;
+	static float DegradeSeconds = 0.5f;
+	static float RecoverSeconds = 3.f;
+	static int32 Tiers[(int32)EGravityGunBudgetSystem::Count] = { 0, 0, 0, 0 };
+
+	static FAutoConsoleVariableRef CVarEnabled(
+		TEXT("ggp.Budget.Enabled"),
+		bEnabled,
+		TEXT("1: the budget controller sets the ggp.Budget.Tier.* console variables from the frame time.\n")
+		TEXT("0: the tiers are left as they are and can be set by hand."));
+
+	static FAutoConsoleVariableRef CVarGameThreadMs(
+		TEXT("ggp.Budget.GameThreadMs"),
+		GameThreadBudgetMs,
+		TEXT("Game thread time per frame in milliseconds above which optional gravity gun work is degraded."));
+
+	static FAutoConsoleVariableRef CVarPhysicsMs(
+		TEXT("ggp.Budget.PhysicsMs"),
+		PhysicsBudgetMs,
+		TEXT("Physics time per frame in milliseconds above which optional gravity gun work is degraded."));
+
+	static FAutoConsoleVariableRef CVarRecoverFraction(
+		TEXT("ggp.Budget.RecoverFraction"),
+		RecoverFraction,
+		TEXT("Fraction of the budgets both frame times have to stay under before the budget level is lowered again."));
+
+	static FAutoConsoleVariableRef CVarDegradeSeconds(
+		TEXT("ggp.Budget.DegradeSeconds"),
+		DegradeSeconds,
+		TEXT("Seconds the frame has to be over budget before the budget level is raised."));
+
+	static FAutoConsoleVariableRef CVarRecoverSeconds(
+		TEXT("ggp.Budget.RecoverSeconds"),
+		RecoverSeconds,
+		TEXT("Seconds the frame has to be well under budget before the budget level is lowered."));
+
+	static FAutoConsoleVariableRef CVarAimTier(
+		TEXT("ggp.Budget.Tier.Aim"),
+		Tiers[(int32)EGravityGunBudgetSystem::AimTrace],
+		TEXT("0: the aim trace for the crosshair runs every frame. 1: every second frame. 2: every fourth frame.\n")
+		TEXT("Grabs and launches always trace in the frame they happen."));
+
+	static FAutoConsoleVariableRef CVarEffectsTier(
+		TEXT("ggp.Budget.Tier.Effects"),
+		Tiers[(int32)EGravityGunBudgetSystem::Effects],
+		TEXT("0: all fire and launch effects are spawned. 1: up to 20 per second near the view. 2: up to 6 per second close to the view."));
+
+	static FAutoConsoleVariableRef CVarProjectilesTier(
+		TEXT("ggp.Budget.Tier.Projectiles"),
+		Tiers[(int32)EGravityGunBudgetSystem::Projectiles],
+		TEXT("0: no projectile limit. 1: up to 64 live projectiles. 2: up to 24 live projectiles.\n")
+		TEXT("Shots over the limit are fired as hitscan shots, local simulations of remote shots are skipped."));
+
+	static FAutoConsoleVariableRef CVarSleepTier(
+		TEXT("ggp.Budget.Tier.Sleep"),
+		Tiers[(int32)EGravityGunBudgetSystem::PhysicsSleep],
+		TEXT("0: props sleep on their own. 1: slow props are put to sleep. 2: props are put to sleep at a higher speed."));
+
+	//Budget level at which each system starts to degrade, one tier per level from there
+	static const int32 FirstDegradedLevel[(int32)EGravityGunBudgetSystem::Count] = { 2, 1, 2, 1 };
+	static const int32 MaxLevel = 3;
+
+	static const int32 AimTraceIntervals[MaxTier + 1] = { 1, 2, 4 };
+	static const float EffectsPerSecond[MaxTier + 1] = { 0.f, 20.f, 6.f };
+	static const float EffectRanges[MaxTier + 1] = { 0.f, 3000.f, 1000.f };
+	static const int32 MaxProjectiles[MaxTier + 1] = { 0, 64, 24 };
+	//Linear speed in cm/s and angular speed in rad/s below which a prop is put to sleep
+	static const float SleepLinearSpeeds[MaxTier + 1] = { 0.f, 10.f, 30.f };
+	static const float SleepAngularSpeeds[MaxTier + 1] = { 0.f, 0.1f, 0.3f };
+	static const float SleepPassInterval = 0.25f;
+	//Distance below a prop that is searched for something it rests on
+	static const float SupportDistance = 5.f;
+
+	//Controller that sets the tiers. The other controllers, of other worlds in the same process, only measure.
+	static TWeakObjectPtr<AGravityGunBudget> DrivingBudget;
+
+	static int32 GetClampedTier(EGravityGunBudgetSystem System)
+	{
+		return FMath::Clamp(Tiers[(int32)System], 0, MaxTier);
+	}
+
+	static void StatusCommand(const TArray<FString>& Args, UWorld* World)
+	{
+		const AGravityGunBudget* Budget = AGravityGunBudget::Get(World);
+		if (!Budget) { return; }
+
+		UE_LOG(LogGravityGun, Display, TEXT("Budget level %d, enabled %d, driving the tiers %d: game thread %.2f/%.2f ms, physics %.2f/%.2f ms"),
+			Budget->GetLevel(), bEnabled, Budget->IsDrivingTiers(), Budget->GetGameThreadMs(), GameThreadBudgetMs, Budget->GetPhysicsMs(), PhysicsBudgetMs);
+		UE_LOG(LogGravityGun, Display, TEXT("Tiers: aim %d, effects %d, projectiles %d, sleep %d"),
+			Tiers[(int32)EGravityGunBudgetSystem::AimTrace],
+			Tiers[(int32)EGravityGunBudgetSystem::Effects],
+			Tiers[(int32)EGravityGunBudgetSystem::Projectiles],
+			Tiers[(int32)EGravityGunBudgetSystem::PhysicsSleep]);
+	}
+
+	//Returns whether the prop rests on something. A slow prop without support is at the top of its arc or was just dropped,
+	//put to sleep it would hang in the air until something touches it. Props pulled up by a gravity volume are never supported.
+	static bool IsSupported(UPrimitiveComponent* Prop)
+	{
+		TArray<FHitResult> Hits;
+		const FComponentQueryParams QueryParams(FName(TEXT("BudgetSleepSupport")), Prop->GetOwner());
+		const FVector Start = Prop->GetComponentLocation();
+		return Prop->GetWorld()->ComponentSweepMulti(Hits, Prop, Start, Start - FVector(0.f, 0.f, SupportDistance), Prop->GetComponentQuat(), QueryParams);
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs StatusConsoleCommand(
+		TEXT("ggp.Budget.Status"),
+		TEXT("Logs the budget level, the measured frame times and the system tiers."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StatusCommand));
+}
+
+void FGravityGunBudgetPhysicsTickFunction::ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent)
+{
+	if (Target && !Target->IsPendingKill())
+	{
+		Target->MarkPhysicsStart();
+	}
+}
+
+FString FGravityGunBudgetPhysicsTickFunction::DiagnosticMessage()
+{
+	return Target ? Target->GetFullName() + TEXT("[PhysicsStart]") : TEXT("GravityGunBudget[PhysicsStart]");
+}
+
+// Sets default values
+AGravityGunBudget::AGravityGunBudget()
+{
+	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	///Runs first in its group, so the measurement starts as close to the start of the simulation as possible
+	PhysicsTickFunction.bCanEverTick = true;
+	PhysicsTickFunction.bHighPriority = true;
+	PhysicsTickFunction.TickGroup = TG_DuringPhysics;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>("Root");
+}
+
+AGravityGunBudget* AGravityGunBudget::Get(UWorld* World)
+{
+	if (!World) { return nullptr; }
+
+	for (TActorIterator<AGravityGunBudget> It(World); It; ++It)
+	{
+		if (!It->IsPendingKill())
+		{
+			return *It;
+		}
+	}
+	return World->SpawnActor<AGravityGunBudget>();
+}
+
+// Called when the game starts or when spawned
+void AGravityGunBudget::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (!GravityGunBudget::DrivingBudget.IsValid())
+	{
+		GravityGunBudget::DrivingBudget = this;
+	}
+}
+
+void AGravityGunBudget::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	///The controller of another world that is still playing takes over on its next tick
+	if (IsDrivingTiers())
+	{
+		GravityGunBudget::DrivingBudget.Reset();
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+bool AGravityGunBudget::IsDrivingTiers() const
+{
+	return GravityGunBudget::DrivingBudget.Get() == this;
+}
+
+void AGravityGunBudget::RegisterActorTickFunctions(bool bRegister)
+{
+	Super::RegisterActorTickFunctions(bRegister);
+
+	if (bRegister)
+	{
+		PhysicsTickFunction.Target = this;
+		PhysicsTickFunction.SetTickFunctionEnable(true);
+		PhysicsTickFunction.RegisterTickFunction(GetLevel());
+	}
+	else if (PhysicsTickFunction.IsTickFunctionRegistered())
+	{
+		PhysicsTickFunction.UnRegisterTickFunction();
+	}
+}
+
+void AGravityGunBudget::MarkPhysicsStart()
+{
+	PhysicsStartTime = FPlatformTime::Seconds();
+}
+
+// Called every frame
+void AGravityGunBudget::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	///The game thread time is the one of the previous frame, the physics time the one of this frame
+	const float SmoothingAlpha = FMath::Clamp(DeltaTime / 0.25f, 0.f, 1.f);
+	GameThreadMs = FMath::Lerp(GameThreadMs, (float)FPlatformTime::ToMilliseconds(GGameThreadTime), SmoothingAlpha);
+	if (PhysicsStartTime > 0.0)
+	{
+		PhysicsMs = FMath::Lerp(PhysicsMs, (float)((FPlatformTime::Seconds() - PhysicsStartTime) * 1000.0), SmoothingAlpha);
+		PhysicsStartTime = 0.0;
+	}
+
+	if (!GravityGunBudget::DrivingBudget.IsValid())
+	{
+		GravityGunBudget::DrivingBudget = this;
+		if (GravityGunBudget::bEnabled)
+		{
+			ApplyTiers();
+		}
+	}
+
+	if (GravityGunBudget::bEnabled && IsDrivingTiers())
+	{
+		UpdateLevel(DeltaTime);
+	}
+	SET_DWORD_STAT(STAT_GGPBudgetLevel, Level);
+
+	TimeSinceSleepPass += DeltaTime;
+	if (TimeSinceSleepPass >= GravityGunBudget::SleepPassInterval)
+	{
+		TimeSinceSleepPass = 0.f;
+		SleepSlowProps();
+	}
+}
+
+int32 AGravityGunBudget::GetTier(EGravityGunBudgetSystem System)
+{
+	return GravityGunBudget::GetClampedTier(System);
+}
+
+int32 AGravityGunBudget::GetAimTraceInterval()
+{
+	return GravityGunBudget::AimTraceIntervals[GetTier(EGravityGunBudgetSystem::AimTrace)];
+}
+
+bool AGravityGunBudget::ShouldSpawnEffect(const UObject* WorldContextObject, FVector Location)
+{
+	const int32 Tier = GetTier(EGravityGunBudgetSystem::Effects);
+	if (Tier == 0) { return true; }
+
+	///Effects far from the local view are the first to go
+	UWorld* World = WorldContextObject ? WorldContextObject->GetWorld() : nullptr;
+	APlayerController* PlayerController = World ? World->GetFirstPlayerController() : nullptr;
+	if (!PlayerController) { return false; }
+
+	FVector ViewLocation;
+	FRotator ViewRotation;
+	PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+	if (FVector::DistSquared(ViewLocation, Location) > FMath::Square(GravityGunBudget::EffectRanges[Tier])) { return false; }
+
+	AGravityGunBudget* Budget = Get(World);
+	if (!Budget) { return false; }
+
+	const float EffectsPerSecond = GravityGunBudget::EffectsPerSecond[Tier];
+	const double Now = FPlatformTime::Seconds();
+	Budget->EffectTokens = FMath::Min(Budget->EffectTokens + (float)(Now - Budget->EffectTokensTime) * EffectsPerSecond, EffectsPerSecond);
+	Budget->EffectTokensTime = Now;
+	if (Budget->EffectTokens < 1.f) { return false; }
+
+	Budget->EffectTokens -= 1.f;
+	return true;
+}
+
+bool AGravityGunBudget::IsOverProjectileBudget()
+{
+	const int32 MaxProjectiles = GravityGunBudget::MaxProjectiles[GetTier(EGravityGunBudgetSystem::Projectiles)];
+	return MaxProjectiles > 0 && FGravityGunMemory::GetLiveAllocations(EGravityGunMemoryCategory::Projectiles) >= MaxProjectiles;
+}
+
+void AGravityGunBudget::UpdateLevel(float DeltaTime)
+{
+	const bool bOverBudget = GameThreadMs > GravityGunBudget::GameThreadBudgetMs || PhysicsMs > GravityGunBudget::PhysicsBudgetMs;
+	const bool bWellUnderBudget = GameThreadMs < GravityGunBudget::GameThreadBudgetMs * GravityGunBudget::RecoverFraction
+		&& PhysicsMs < GravityGunBudget::PhysicsBudgetMs * GravityGunBudget::RecoverFraction;
+
+	///Between the two thresholds the level holds, so a frame time close to the budget doesn't flip it every frame
+	OverBudgetSeconds = bOverBudget ? OverBudgetSeconds + DeltaTime : 0.f;
+	UnderBudgetSeconds = bWellUnderBudget ? UnderBudgetSeconds + DeltaTime : 0.f;
+
+	if (OverBudgetSeconds >= GravityGunBudget::DegradeSeconds && Level < GravityGunBudget::MaxLevel)
+	{
+		OverBudgetSeconds = 0.f;
+		SetLevel(Level + 1);
+	}
+	else if (UnderBudgetSeconds >= GravityGunBudget::RecoverSeconds && Level > 0)
+	{
+		UnderBudgetSeconds = 0.f;
+		SetLevel(Level - 1);
+	}
+}
+
+void AGravityGunBudget::SetLevel(int32 NewLevel)
+{
+	const int32 OldLevel = Level;
+	Level = NewLevel;
+	ApplyTiers();
+
+	UE_LOG(LogGravityGun, Display, TEXT("Budget level %d -> %d: game thread %.2f/%.2f ms, physics %.2f/%.2f ms. Tiers: aim %d, effects %d, projectiles %d, sleep %d"),
+		OldLevel,
+		Level,
+		GameThreadMs,
+		GravityGunBudget::GameThreadBudgetMs,
+		PhysicsMs,
+		GravityGunBudget::PhysicsBudgetMs,
+		GravityGunBudget::Tiers[(int32)EGravityGunBudgetSystem::AimTrace],
+		GravityGunBudget::Tiers[(int32)EGravityGunBudgetSystem::Effects],
+		GravityGunBudget::Tiers[(int32)EGravityGunBudgetSystem::Projectiles],
+		GravityGunBudget::Tiers[(int32)EGravityGunBudgetSystem::PhysicsSleep]);
+
+	APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	APawn* Pawn = PlayerController ? PlayerController->GetPawn() : nullptr;
+	FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::BudgetLevel, Pawn ? Pawn->GetActorLocation() : FVector::ZeroVector, (float)Level);
+}
+
+void AGravityGunBudget::ApplyTiers()
+{
+	for (int32 System = 0; System < (int32)EGravityGunBudgetSystem::Count; System++)
+	{
+		GravityGunBudget::Tiers[System] = FMath::Clamp(Level - GravityGunBudget::FirstDegradedLevel[System] + 1, 0, GravityGunBudget::MaxTier);
+	}
+}
+
+void AGravityGunBudget::SleepSlowProps()
+{
+	const int32 Tier = GetTier(EGravityGunBudgetSystem::PhysicsSleep);
+	if (Tier == 0) { return; }
+
+	TArray<UPrimitiveComponent*> Props;
+	FGravityGunProps::GetAllProps(GetWorld(), Props);
+	TSet<UPrimitiveComponent*> HeldComponents;
+	FGravityGunProps::GetHeldComponents(GetWorld(), HeldComponents);
+	AImpulseCoalescer* Coalescer = AImpulseCoalescer::Get(GetWorld());
+
+	const float LinearSpeedSquared = FMath::Square(GravityGunBudget::SleepLinearSpeeds[Tier]);
+	const float AngularSpeedSquared = FMath::Square(GravityGunBudget::SleepAngularSpeeds[Tier]);
+	int32 NumSlept = 0;
+	for (UPrimitiveComponent* Prop : Props)
+	{
+		if (!Prop->RigidBodyIsAwake() || HeldComponents.Contains(Prop)) { continue; }
+
+		///Props that were just launched or pushed are still in flight, even when they are slow at the top of their arc
+		if (Coalescer && Coalescer->IsInFlight(Prop)) { continue; }
+
+		if (Prop->GetPhysicsLinearVelocity().SizeSquared() < LinearSpeedSquared
+			&& Prop->GetPhysicsAngularVelocityInRadians().SizeSquared() < AngularSpeedSquared
+			&& GravityGunBudget::IsSupported(Prop))
+		{
+			Prop->PutRigidBodyToSleep();
+			NumSlept++;
+		}
+	}
+	SET_DWORD_STAT(STAT_GGPBudgetPropsSlept, NumSlept);
+}
@@ -0,0 +1,278 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityGunDeterminism.h"
+#include "GravityGunPlayground.h"
+#include "GravityGunProps.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/Crc.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "PhysicsEngine/PhysicsSettings.h"
+
+namespace GravityGunDeterminism
+{
+	struct FPendingAction
+	{
+		TWeakObjectPtr<UWorld> World;
+		TFunction<void()> Action;
+	};
+
+	static bool bEnabled = false;
+	static bool bRunningStepActions = false;
+	static float StepDeltaTime = 1.f / 60.f;
+	static uint64 Step = 0;
+	static FDelegateHandle PostActorTickHandle;
+	static FArchive* ChecksumLog = nullptr;
+	static TArray<FPendingAction> PendingActions;
+
+	static void WriteLine(const FString& Line)
+	{
+		if (!ChecksumLog) { return; }
+
+		FTCHARToUTF8 Converted(*Line);
+		ChecksumLog->Serialize(const_cast<ANSICHAR*>(Converted.Get()), Converted.Length());
+	}
+
+	static void OnWorldPostActorTick(UWorld* World, ELevelTick TickType, float DeltaSeconds)
+	{
+		if (!World || !World->IsGameWorld() || TickType != LEVELTICK_All) { return; }
+
+		///All tick groups, including physics, have finished for this step
+		Step++;
+		int32 NumProps = 0;
+		const uint32 Checksum = FGravityGunDeterminism::ComputeWorldChecksum(World, NumProps);
+		WriteLine(FString::Printf(TEXT("%llu,%08x,%d\n"), Step, Checksum, NumProps));
+
+		///Run the input queued during this step, in the order it arrived, so it takes effect at the start of the next step
+		TArray<FPendingAction> Actions = MoveTemp(PendingActions);
+		PendingActions.Reset();
+
+		bRunningStepActions = true;
+		for (FPendingAction& Pending : Actions)
+		{
+			if (Pending.World.Get() == World)
+			{
+				Pending.Action();
+			}
+			else if (Pending.World.IsValid())
+			{
+				PendingActions.Add(MoveTemp(Pending));
+			}
+		}
+		bRunningStepActions = false;
+	}
+
+	static void DiffCommand(const TArray<FString>& Args)
+	{
+		if (Args.Num() < 2)
+		{
+			UE_LOG(LogGravityGun, Display, TEXT("Usage: ggp.Determinism.Diff <LogA> <LogB>"));
+			return;
+		}
+
+		int64 DivergentStep = INDEX_NONE;
+		if (!FGravityGunDeterminism::FindFirstDivergence(Args[0], Args[1], DivergentStep))
+		{
+			UE_LOG(LogGravityGun, Warning, TEXT("Checksum logs could not be compared"));
+		}
+		else if (DivergentStep == INDEX_NONE)
+		{
+			UE_LOG(LogGravityGun, Display, TEXT("Checksum logs match"));
+		}
+		else
+		{
+			UE_LOG(LogGravityGun, Display, TEXT("Checksum logs diverge at step %lld"), DivergentStep);
+		}
+	}
+
+	static void StatusCommand()
+	{
+		UE_LOG(LogGravityGun, Display, TEXT("Deterministic mode %s, step %llu, step delta %.4f s, %d queued actions"),
+			bEnabled ? TEXT("enabled") : TEXT("disabled"), Step, StepDeltaTime, PendingActions.Num());
+	}
+
+	static FAutoConsoleCommand DiffConsoleCommand(
+		TEXT("ggp.Determinism.Diff"),
+		TEXT("Compares two checksum logs and reports the first step where they diverge. Usage: ggp.Determinism.Diff <LogA> <LogB>"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&DiffCommand));
+
+	static FAutoConsoleCommand StatusConsoleCommand(
+		TEXT("ggp.Determinism.Status"),
+		TEXT("Logs the state of the deterministic simulation mode."),
+		FConsoleCommandDelegate::CreateStatic(&StatusCommand));
+
+	//Parses a checksum log into a step to checksum map
+	static bool LoadChecksums(const FString& Filename, TMap<int64, uint32>& OutChecksums)
+	{
+		TArray<FString> Lines;
+		if (!FFileHelper::LoadFileToStringArray(Lines, *Filename))
+		{
+			UE_LOG(LogGravityGun, Warning, TEXT("Failed to read checksum log %s"), *Filename);
+			return false;
+		}
+
+		for (const FString& Line : Lines)
+		{
+			TArray<FString> Columns;
+			Line.ParseIntoArray(Columns, TEXT(","));
+			if (Columns.Num() < 2 || !Columns[0].IsNumeric()) { continue; }
+
+			OutChecksums.Add(FCString::Atoi64(*Columns[0]), FCString::Strtoui64(*Columns[1], nullptr, 16));
+		}
+		if (OutChecksums.Num() == 0)
+		{
+			UE_LOG(LogGravityGun, Warning, TEXT("Checksum log %s holds no checksums"), *Filename);
+			return false;
+		}
+		return true;
+	}
+}
+
+void FGravityGunDeterminism::Initialize()
+{
+	using namespace GravityGunDeterminism;
+
+	if (!FParse::Param(FCommandLine::Get(), TEXT("GGPDeterministic"))) { return; }
+
+	float StepHz = 60.f;
+	FParse::Value(FCommandLine::Get(), TEXT("GGPStepHz="), StepHz);
+	StepDeltaTime = 1.f / FMath::Max(StepHz, 1.f);
+	bEnabled = true;
+
+	///Every frame advances the game by exactly one step, regardless of how long the frame took
+	FApp::SetUseFixedTimeStep(true);
+	FApp::SetFixedDeltaTime(StepDeltaTime);
+
+	///One physics step per frame, with the solver in its deterministic configuration
+	UPhysicsSettings* PhysicsSettings = UPhysicsSettings::Get();
+	PhysicsSettings->bEnableEnhancedDeterminism = true;
+	PhysicsSettings->bSubstepping = false;
+	PhysicsSettings->MaxPhysicsDeltaTime = FMath::Max(PhysicsSettings->MaxPhysicsDeltaTime, StepDeltaTime);
+
+	FString LogName = FDateTime::Now().ToString();
+	FParse::Value(FCommandLine::Get(), TEXT("GGPChecksumLog="), LogName);
+	const FString LogFilename = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Determinism"), LogName + TEXT(".csv"));
+	ChecksumLog = IFileManager::Get().CreateFileWriter(*LogFilename);
+	WriteLine(TEXT("Step,Checksum,Props\n"));
+
+	PostActorTickHandle = FWorldDelegates::OnWorldPostActorTick.AddStatic(&OnWorldPostActorTick);
+
+	UE_LOG(LogGravityGun, Display, TEXT("Deterministic mode enabled at %.1f Hz, writing checksums to %s"), 1.f / StepDeltaTime, *LogFilename);
+}
+
+void FGravityGunDeterminism::Shutdown()
+{
+	using namespace GravityGunDeterminism;
+
+	if (!bEnabled) { return; }
+
+	FWorldDelegates::OnWorldPostActorTick.Remove(PostActorTickHandle);
+	PendingActions.Empty();
+	if (ChecksumLog)
+	{
+		ChecksumLog->Close();
+		delete ChecksumLog;
+		ChecksumLog = nullptr;
+	}
+	bEnabled = false;
+}
+
+bool FGravityGunDeterminism::IsEnabled()
+{
+	return GravityGunDeterminism::bEnabled;
+}
+
+uint64 FGravityGunDeterminism::GetStep()
+{
+	return GravityGunDeterminism::Step;
+}
+
+float FGravityGunDeterminism::GetStepDeltaTime()
+{
+	return GravityGunDeterminism::StepDeltaTime;
+}
+
+bool FGravityGunDeterminism::ShouldDeferToStep()
+{
+	return GravityGunDeterminism::bEnabled && !GravityGunDeterminism::bRunningStepActions;
+}
+
+void FGravityGunDeterminism::RunOnStep(UWorld* World, TFunction<void()> Action)
+{
+	if (!ShouldDeferToStep())
+	{
+		Action();
+		return;
+	}
+
+	GravityGunDeterminism::FPendingAction& Pending = GravityGunDeterminism::PendingActions.AddDefaulted_GetRef();
+	Pending.World = World;
+	Pending.Action = MoveTemp(Action);
+}
+
+uint32 FGravityGunDeterminism::ComputeWorldChecksum(UWorld* World, int32& OutNumProps)
+{
+	TArray<UPrimitiveComponent*> Props;
+	FGravityGunProps::GetAllProps(World, Props);
+	OutNumProps = Props.Num();
+
+	///Hash in id order, so the checksum doesn't depend on actor iteration order
+	TArray<TPair<uint64, UPrimitiveComponent*>> SortedProps;
+	SortedProps.Reserve(Props.Num());
+	for (UPrimitiveComponent* Prop : Props)
+	{
+		SortedProps.Emplace(FGravityGunProps::GetPropId(Prop->GetOwner()), Prop);
+	}
+	SortedProps.Sort([](const TPair<uint64, UPrimitiveComponent*>& A, const TPair<uint64, UPrimitiveComponent*>& B) { return A.Key < B.Key; });
+
+	uint32 Checksum = 0;
+	for (const TPair<uint64, UPrimitiveComponent*>& Prop : SortedProps)
+	{
+		const FVector Location = Prop.Value->GetComponentLocation();
+		const FQuat Rotation = Prop.Value->GetComponentQuat();
+		const FVector LinearVelocity = Prop.Value->GetPhysicsLinearVelocity();
+		const float Values[10] = {
+			Location.X, Location.Y, Location.Z,
+			Rotation.X, Rotation.Y, Rotation.Z, Rotation.W,
+			LinearVelocity.X, LinearVelocity.Y, LinearVelocity.Z
+		};
+		Checksum = FCrc::MemCrc32(&Prop.Key, sizeof(Prop.Key), Checksum);
+		Checksum = FCrc::MemCrc32(Values, sizeof(Values), Checksum);
+	}
+	return Checksum;
+}
+
+bool FGravityGunDeterminism::FindFirstDivergence(const FString& FilenameA, const FString& FilenameB, int64& OutStep)
+{
+	OutStep = INDEX_NONE;
+
+	TMap<int64, uint32> ChecksumsA;
+	TMap<int64, uint32> ChecksumsB;
+	if (!GravityGunDeterminism::LoadChecksums(FilenameA, ChecksumsA) || !GravityGunDeterminism::LoadChecksums(FilenameB, ChecksumsB))
+	{
+		return false;
+	}
+
+	ChecksumsA.KeySort(TLess<int64>());
+	for (const TPair<int64, uint32>& StepA : ChecksumsA)
+	{
+		///Only the steps both runs reached can be compared
+		const uint32* ChecksumB = ChecksumsB.Find(StepA.Key);
+		if (!ChecksumB) { break; }
+
+		if (*ChecksumB != StepA.Value)
+		{
+			OutStep = StepA.Key;
+			break;
+		}
+	}
+	return true;
+}
@@ -0,0 +1,337 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityGunLatency.h"
+#include "GravityGunPlayground.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "ProfilingDebugging/CsvProfiler.h"
+
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Fire Latency (ms)"), STAT_GGPFireLatencyMs, STATGROUP_GravityGun);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Grab Latency (ms)"), STAT_GGPGrabLatencyMs, STATGROUP_GravityGun);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Launch Latency (ms)"), STAT_GGPLaunchLatencyMs, STATGROUP_GravityGun);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Fire Latency (frames)"), STAT_GGPFireLatencyFrames, STATGROUP_GravityGun);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Grab Latency (frames)"), STAT_GGPGrabLatencyFrames, STATGROUP_GravityGun);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Launch Latency (frames)"), STAT_GGPLaunchLatencyFrames, STATGROUP_GravityGun);
+DECLARE_FLOAT_ACCUMULATOR_STAT(TEXT("Hold View Lag (deg)"), STAT_GGPHoldViewLagDegrees, STATGROUP_GravityGun);
+
+CSV_DEFINE_CATEGORY(GravityGunLatency, true);
+
+namespace GravityGunLatency
+{
+	static const int32 NumActions = (int32)EGravityGunLatencyAction::Count;
+
+	//Frame buckets 0 to 15, the last bucket holds everything above
+	static const int32 NumFrameBuckets = 17;
+	//Millisecond buckets of 4 ms up to 200 ms, the last bucket holds everything above
+	static const int32 NumMsBuckets = 51;
+	static const float MsBucketWidth = 4.f;
+	//Hold view lag buckets of a quarter degree up to 10 degrees, the last bucket holds everything above
+	static const int32 NumDegreeBuckets = 41;
+	static const float DegreeBucketWidth = 0.25f;
+
+	static int32 bEnabled = 1;
+	static int32 TimeoutMs = 1000;
+
+	static FAutoConsoleVariableRef CVarEnabled(
+		TEXT("ggp.Latency.Enabled"),
+		bEnabled,
+		TEXT("If 1, the input-to-effect latency of fire, grab and launch is measured."));
+
+	static FAutoConsoleVariableRef CVarTimeoutMs(
+		TEXT("ggp.Latency.TimeoutMs"),
+		TimeoutMs,
+		TEXT("Milliseconds after which an input without an effect is discarded."));
+
+	struct FActionState
+	{
+		bool bPending = false;
+		uint64 InputFrame = 0;
+		double InputTime = 0.0;
+
+		int32 FrameBuckets[NumFrameBuckets] = {};
+		int32 MsBuckets[NumMsBuckets] = {};
+		int32 NumSamples = 0;
+		int32 NumExpired = 0;
+		double TotalMs = 0.0;
+		float MaxMs = 0.f;
+	};
+
+	static FActionState States[NumActions];
+
+	struct FHoldViewLagState
+	{
+		int32 DegreeBuckets[NumDegreeBuckets] = {};
+		int32 NumSamples = 0;
+		//Samples where the held object followed a different view than the one rendered
+		int32 NumLagged = 0;
+		double TotalDegrees = 0.0;
+		double TotalDistance = 0.0;
+		float MaxDegrees = 0.f;
+	};
+
+	//Hold view lag with the camera manager's view, index 0, and with the same frame's view, index 1
+	static FHoldViewLagState HoldViewLag[2];
+	static const TCHAR* HoldViewModeNames[2] = { TEXT("HoldViewCameraManager"), TEXT("HoldViewSameFrame") };
+
+	static bool HasExpired(const FActionState& State, double Now)
+	{
+		return (Now - State.InputTime) * 1000.0 > TimeoutMs;
+	}
+
+	static void UpdateStats(EGravityGunLatencyAction Action, float Ms, uint64 Frames)
+	{
+		switch (Action)
+		{
+		case EGravityGunLatencyAction::Fire:
+			SET_FLOAT_STAT(STAT_GGPFireLatencyMs, Ms);
+			SET_DWORD_STAT(STAT_GGPFireLatencyFrames, Frames);
+			CSV_CUSTOM_STAT(GravityGunLatency, FireMs, Ms, ECsvCustomStatOp::Set);
+			CSV_CUSTOM_STAT(GravityGunLatency, FireFrames, (int32)Frames, ECsvCustomStatOp::Set);
+			break;
+		case EGravityGunLatencyAction::Grab:
+			SET_FLOAT_STAT(STAT_GGPGrabLatencyMs, Ms);
+			SET_DWORD_STAT(STAT_GGPGrabLatencyFrames, Frames);
+			CSV_CUSTOM_STAT(GravityGunLatency, GrabMs, Ms, ECsvCustomStatOp::Set);
+			CSV_CUSTOM_STAT(GravityGunLatency, GrabFrames, (int32)Frames, ECsvCustomStatOp::Set);
+			break;
+		case EGravityGunLatencyAction::Launch:
+			SET_FLOAT_STAT(STAT_GGPLaunchLatencyMs, Ms);
+			SET_DWORD_STAT(STAT_GGPLaunchLatencyFrames, Frames);
+			CSV_CUSTOM_STAT(GravityGunLatency, LaunchMs, Ms, ECsvCustomStatOp::Set);
+			CSV_CUSTOM_STAT(GravityGunLatency, LaunchFrames, (int32)Frames, ECsvCustomStatOp::Set);
+			break;
+		default:
+			break;
+		}
+	}
+
+	//Upper bound in ms of the bucket that contains the percentile, or -1 without samples
+	static float GetPercentileMs(const FActionState& State, float Percentile)
+	{
+		if (State.NumSamples == 0) { return -1.f; }
+
+		const int32 Target = FMath::CeilToInt(State.NumSamples * Percentile);
+		int32 Count = 0;
+		for (int32 Bucket = 0; Bucket < NumMsBuckets; Bucket++)
+		{
+			Count += State.MsBuckets[Bucket];
+			if (Count >= Target)
+			{
+				return Bucket == NumMsBuckets - 1 ? State.MaxMs : (Bucket + 1) * MsBucketWidth;
+			}
+		}
+		return State.MaxMs;
+	}
+
+	//Upper bound in degrees of the bucket that contains the percentile, or -1 without samples
+	static float GetPercentileDegrees(const FHoldViewLagState& State, float Percentile)
+	{
+		if (State.NumSamples == 0) { return -1.f; }
+
+		const int32 Target = FMath::CeilToInt(State.NumSamples * Percentile);
+		int32 Count = 0;
+		for (int32 Bucket = 0; Bucket < NumDegreeBuckets; Bucket++)
+		{
+			Count += State.DegreeBuckets[Bucket];
+			if (Count >= Target)
+			{
+				return Bucket == NumDegreeBuckets - 1 ? State.MaxDegrees : (Bucket + 1) * DegreeBucketWidth;
+			}
+		}
+		return State.MaxDegrees;
+	}
+
+	static void DumpCommand(const TArray<FString>& Args)
+	{
+		FGravityGunLatency::DumpToLog();
+
+		const FString Name = Args.Num() > 0 ? Args[0] : FDateTime::Now().ToString();
+		const FString Filename = FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Latency"), Name + TEXT(".csv"));
+		if (FGravityGunLatency::WriteCsv(Filename))
+		{
+			UE_LOG(LogGravityGun, Display, TEXT("Wrote latency histograms to %s"), *Filename);
+		}
+	}
+
+	static FAutoConsoleCommand DumpConsoleCommand(
+		TEXT("ggp.Latency.Dump"),
+		TEXT("Logs the input-to-effect latency of fire, grab and launch and writes the histograms to Saved/Latency. Usage: ggp.Latency.Dump [Name]"),
+		FConsoleCommandWithArgsDelegate::CreateStatic(&DumpCommand));
+
+	static FAutoConsoleCommand ResetConsoleCommand(
+		TEXT("ggp.Latency.Reset"),
+		TEXT("Clears the input-to-effect latency histograms."),
+		FConsoleCommandDelegate::CreateStatic(&FGravityGunLatency::Reset));
+}
+
+void FGravityGunLatency::MarkInput(EGravityGunLatencyAction Action)
+{
+	using namespace GravityGunLatency;
+	if (!bEnabled) { return; }
+	check(IsInGameThread());
+
+	FActionState& State = States[(int32)Action];
+	const double Now = FPlatformTime::Seconds();
+	if (State.bPending)
+	{
+		if (!HasExpired(State, Now)) { return; }
+		State.NumExpired++;
+	}
+
+	State.bPending = true;
+	State.InputFrame = GFrameCounter;
+	State.InputTime = Now;
+}
+
+void FGravityGunLatency::MarkEffect(EGravityGunLatencyAction Action)
+{
+	using namespace GravityGunLatency;
+	check(IsInGameThread());
+
+	FActionState& State = States[(int32)Action];
+	if (!State.bPending) { return; }
+	State.bPending = false;
+
+	const double Now = FPlatformTime::Seconds();
+	if (HasExpired(State, Now))
+	{
+		State.NumExpired++;
+		return;
+	}
+
+	const uint64 Frames = GFrameCounter - State.InputFrame;
+	const float Ms = (float)((Now - State.InputTime) * 1000.0);
+
+	State.FrameBuckets[FMath::Min<uint64>(Frames, NumFrameBuckets - 1)]++;
+	State.MsBuckets[FMath::Min(FMath::FloorToInt(Ms / MsBucketWidth), NumMsBuckets - 1)]++;
+	State.NumSamples++;
+	State.TotalMs += Ms;
+	State.MaxMs = FMath::Max(State.MaxMs, Ms);
+
+	UpdateStats(Action, Ms, Frames);
+}
+
+void FGravityGunLatency::CancelInput(EGravityGunLatencyAction Action)
+{
+	GravityGunLatency::States[(int32)Action].bPending = false;
+}
+
+bool FGravityGunLatency::IsPending(EGravityGunLatencyAction Action)
+{
+	return GravityGunLatency::States[(int32)Action].bPending;
+}
+
+void FGravityGunLatency::RecordHoldViewLag(float Degrees, float Distance, bool bSameFrameView)
+{
+	using namespace GravityGunLatency;
+	if (!bEnabled) { return; }
+
+	FHoldViewLagState& State = HoldViewLag[bSameFrameView ? 1 : 0];
+	State.DegreeBuckets[FMath::Min(FMath::FloorToInt(Degrees / DegreeBucketWidth), NumDegreeBuckets - 1)]++;
+	State.NumSamples++;
+	State.NumLagged += (Degrees > KINDA_SMALL_NUMBER || Distance > KINDA_SMALL_NUMBER) ? 1 : 0;
+	State.TotalDegrees += Degrees;
+	State.TotalDistance += Distance;
+	State.MaxDegrees = FMath::Max(State.MaxDegrees, Degrees);
+
+	SET_FLOAT_STAT(STAT_GGPHoldViewLagDegrees, Degrees);
+	CSV_CUSTOM_STAT(GravityGunLatency, HoldViewLagDeg, Degrees, ECsvCustomStatOp::Set);
+}
+
+void FGravityGunLatency::Reset()
+{
+	using namespace GravityGunLatency;
+	for (FActionState& State : States)
+	{
+		State = FActionState();
+	}
+	HoldViewLag[0] = FHoldViewLagState();
+	HoldViewLag[1] = FHoldViewLagState();
+}
+
+void FGravityGunLatency::DumpToLog()
+{
+	using namespace GravityGunLatency;
+	UE_LOG(LogGravityGun, Display, TEXT("%-8s %8s %8s %8s %8s %8s %8s"), TEXT("Action"), TEXT("Samples"), TEXT("Expired"), TEXT("AvgMs"), TEXT("P50Ms"), TEXT("P95Ms"), TEXT("MaxMs"));
+	for (int32 Index = 0; Index < NumActions; Index++)
+	{
+		const FActionState& State = States[Index];
+		UE_LOG(LogGravityGun, Display, TEXT("%-8s %8d %8d %8.1f %8.1f %8.1f %8.1f"),
+			GetActionName((EGravityGunLatencyAction)Index),
+			State.NumSamples,
+			State.NumExpired,
+			State.NumSamples > 0 ? State.TotalMs / State.NumSamples : 0.0,
+			GetPercentileMs(State, 0.5f),
+			GetPercentileMs(State, 0.95f),
+			State.MaxMs);
+	}
+
+	///Both modes side by side, toggle ggp.Aim.SameFrameView during one session to fill both rows
+	for (int32 Mode = 0; Mode < 2; Mode++)
+	{
+		const FHoldViewLagState& State = HoldViewLag[Mode];
+		const int32 NumSamples = FMath::Max(State.NumSamples, 1);
+		UE_LOG(LogGravityGun, Display, TEXT("%s: %d samples, %d lagged, avg %.2f deg, p50 %.2f deg, p95 %.2f deg, max %.2f deg, avg %.1f units"),
+			HoldViewModeNames[Mode],
+			State.NumSamples,
+			State.NumLagged,
+			State.TotalDegrees / NumSamples,
+			GetPercentileDegrees(State, 0.5f),
+			GetPercentileDegrees(State, 0.95f),
+			State.MaxDegrees,
+			State.TotalDistance / NumSamples);
+	}
+}
+
+bool FGravityGunLatency::WriteCsv(const FString& Filename)
+{
+	using namespace GravityGunLatency;
+
+	///One row per bucket, an empty upper bound marks the overflow bucket
+	FString Csv = TEXT("Action,Unit,From,To,Count\n");
+	for (int32 Index = 0; Index < NumActions; Index++)
+	{
+		const TCHAR* ActionName = GetActionName((EGravityGunLatencyAction)Index);
+		const FActionState& State = States[Index];
+		for (int32 Bucket = 0; Bucket < NumFrameBuckets; Bucket++)
+		{
+			const FString To = Bucket == NumFrameBuckets - 1 ? FString() : FString::FromInt(Bucket);
+			Csv += FString::Printf(TEXT("%s,Frames,%d,%s,%d\n"), ActionName, Bucket, *To, State.FrameBuckets[Bucket]);
+		}
+		for (int32 Bucket = 0; Bucket < NumMsBuckets; Bucket++)
+		{
+			const FString To = Bucket == NumMsBuckets - 1 ? FString() : FString::SanitizeFloat((Bucket + 1) * MsBucketWidth);
+			Csv += FString::Printf(TEXT("%s,Ms,%s,%s,%d\n"), ActionName, *FString::SanitizeFloat(Bucket * MsBucketWidth), *To, State.MsBuckets[Bucket]);
+		}
+	}
+
+	for (int32 Mode = 0; Mode < 2; Mode++)
+	{
+		for (int32 Bucket = 0; Bucket < NumDegreeBuckets; Bucket++)
+		{
+			const FString To = Bucket == NumDegreeBuckets - 1 ? FString() : FString::SanitizeFloat((Bucket + 1) * DegreeBucketWidth);
+			Csv += FString::Printf(TEXT("%s,Degrees,%s,%s,%d\n"), HoldViewModeNames[Mode], *FString::SanitizeFloat(Bucket * DegreeBucketWidth), *To, HoldViewLag[Mode].DegreeBuckets[Bucket]);
+		}
+	}
+
+	if (!FFileHelper::SaveStringToFile(Csv, *Filename))
+	{
+		UE_LOG(LogGravityGun, Warning, TEXT("Failed to write latency histograms to %s"), *Filename);
+		return false;
+	}
+	return true;
+}
+
+const TCHAR* FGravityGunLatency::GetActionName(EGravityGunLatencyAction Action)
+{
+	switch (Action)
+	{
+	case EGravityGunLatencyAction::Fire: return TEXT("Fire");
+	case EGravityGunLatencyAction::Grab: return TEXT("Grab");
+	case EGravityGunLatencyAction::Launch: return TEXT("Launch");
+	default: return TEXT("Unknown");
+	}
+}
@@ -0,0 +1,268 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityGunMemory.h"
+#include "GravityGunPlayground.h"
+#include "GameFramework/Actor.h"
+#include "Components/ActorComponent.h"
+#include "HAL/IConsoleManager.h"
+#include "Misc/ScopeLock.h"
+#include "Stats/Stats.h"
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+#include "HAL/LowLevelMemStats.h"
+
+DECLARE_LLM_MEMORY_STAT(TEXT("GGP Projectiles"), STAT_GGPProjectilesLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("GGP GrabLaunch"), STAT_GGPGrabLaunchLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("GGP Props"), STAT_GGPPropsLLM, STATGROUP_LLMFULL);
+DECLARE_LLM_MEMORY_STAT(TEXT("GravityGun"), STAT_GGPSummaryLLM, STATGROUP_LLM);
+#endif
+
+DECLARE_MEMORY_STAT(TEXT("Tracked Projectiles"), STAT_GGPTrackedProjectiles, STATGROUP_GravityGun);
+DECLARE_MEMORY_STAT(TEXT("Tracked GrabLaunch"), STAT_GGPTrackedGrabLaunch, STATGROUP_GravityGun);
+DECLARE_MEMORY_STAT(TEXT("Tracked Props"), STAT_GGPTrackedProps, STATGROUP_GravityGun);
+
+FGravityGunMemory::FOverBudgetEvent FGravityGunMemory::OnOverBudget;
+
+namespace GravityGunMemory
+{
+	static const int32 NumCategories = (int32)EGravityGunMemoryCategory::Count;
+
+	struct FCategoryState
+	{
+		int64 CurrentBytes = 0;
+		int64 HighWaterBytes = 0;
+		int32 LiveAllocations = 0;
+		//Set once the over budget warning has been logged, cleared when back under budget
+		bool bWarned = false;
+		//Set once OnOverBudget has been fired, cleared when back under budget
+		bool bBroadcast = false;
+	};
+
+	static FCategoryState States[NumCategories];
+	static FCriticalSection StateLock;
+
+	static int32 BudgetKB[NumCategories] = { 0, 0, 0 };
+	static int32 bTrimOverBudget = 1;
+
+	static FAutoConsoleVariableRef CVarBudgetProjectiles(
+		TEXT("ggp.Memory.BudgetKB.Projectiles"),
+		BudgetKB[(int32)EGravityGunMemoryCategory::Projectiles],
+		TEXT("Memory budget in KB for projectiles. 0 = unlimited."));
+
+	static FAutoConsoleVariableRef CVarBudgetGrabLaunch(
+		TEXT("ggp.Memory.BudgetKB.GrabLaunch"),
+		BudgetKB[(int32)EGravityGunMemoryCategory::GrabLaunch],
+		TEXT("Memory budget in KB for the grab and launch systems. 0 = unlimited."));
+
+	static FAutoConsoleVariableRef CVarBudgetProps(
+		TEXT("ggp.Memory.BudgetKB.Props"),
+		BudgetKB[(int32)EGravityGunMemoryCategory::Props],
+		TEXT("Memory budget in KB for props and their pools and buffers. 0 = unlimited."));
+
+	static FAutoConsoleVariableRef CVarTrimOverBudget(
+		TEXT("ggp.Memory.TrimOverBudget"),
+		bTrimOverBudget,
+		TEXT("If 1, pools are asked to trim themselves when a category goes over budget. If 0, only a warning is logged."));
+
+	static FAutoConsoleCommand DumpCommand(
+		TEXT("ggp.Memory.Dump"),
+		TEXT("Logs the tracked memory, high-water mark and budget of every gravity gun memory category."),
+		FConsoleCommandDelegate::CreateStatic(&FGravityGunMemory::DumpToLog));
+
+	static FAutoConsoleCommand ResetCommand(
+		TEXT("ggp.Memory.ResetHighWater"),
+		TEXT("Resets the gravity gun memory high-water marks to the current values."),
+		FConsoleCommandDelegate::CreateStatic(&FGravityGunMemory::ResetHighWaterMarks));
+
+	static void UpdateStat(EGravityGunMemoryCategory Category, int64 Bytes)
+	{
+		switch (Category)
+		{
+		case EGravityGunMemoryCategory::Projectiles:
+			SET_MEMORY_STAT(STAT_GGPTrackedProjectiles, Bytes);
+			break;
+		case EGravityGunMemoryCategory::GrabLaunch:
+			SET_MEMORY_STAT(STAT_GGPTrackedGrabLaunch, Bytes);
+			break;
+		case EGravityGunMemoryCategory::Props:
+			SET_MEMORY_STAT(STAT_GGPTrackedProps, Bytes);
+			break;
+		default:
+			break;
+		}
+	}
+}
+
+void FGravityGunMemory::RegisterLLMTags()
+{
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+	FLowLevelMemTracker& Tracker = FLowLevelMemTracker::Get();
+	const int32 TagStart = (int32)ELLMTag::ProjectTagStart;
+	Tracker.RegisterProjectTag(TagStart + (int32)EGravityGunMemoryCategory::Projectiles, TEXT("GGP_Projectiles"), GET_STATFNAME(STAT_GGPProjectilesLLM), GET_STATFNAME(STAT_GGPSummaryLLM));
+	Tracker.RegisterProjectTag(TagStart + (int32)EGravityGunMemoryCategory::GrabLaunch, TEXT("GGP_GrabLaunch"), GET_STATFNAME(STAT_GGPGrabLaunchLLM), GET_STATFNAME(STAT_GGPSummaryLLM));
+	Tracker.RegisterProjectTag(TagStart + (int32)EGravityGunMemoryCategory::Props, TEXT("GGP_Props"), GET_STATFNAME(STAT_GGPPropsLLM), GET_STATFNAME(STAT_GGPSummaryLLM));
+#endif
+}
+
+void FGravityGunMemory::TrackAllocation(EGravityGunMemoryCategory Category, int64 Bytes)
+{
+	using namespace GravityGunMemory;
+	const int32 Index = (int32)Category;
+	check(Index < NumCategories);
+
+	const int64 Budget = GetBudgetBytes(Category);
+	int64 BytesOverBudget = 0;
+	bool bShouldWarn = false;
+	bool bShouldBroadcast = false;
+	int64 CurrentBytes = 0;
+	{
+		FScopeLock Lock(&StateLock);
+		FCategoryState& State = States[Index];
+		State.CurrentBytes += Bytes;
+		State.LiveAllocations++;
+		State.HighWaterBytes = FMath::Max(State.HighWaterBytes, State.CurrentBytes);
+		CurrentBytes = State.CurrentBytes;
+
+		if (Budget > 0 && State.CurrentBytes > Budget)
+		{
+			BytesOverBudget = State.CurrentBytes - Budget;
+			bShouldWarn = !State.bWarned;
+			State.bWarned = true;
+
+			///Listeners are only called on the game thread, a crossing on another thread is picked up by the next game thread allocation
+			if (bTrimOverBudget && !State.bBroadcast && IsInGameThread())
+			{
+				bShouldBroadcast = true;
+				State.bBroadcast = true;
+			}
+		}
+	}
+	UpdateStat(Category, CurrentBytes);
+
+	if (BytesOverBudget <= 0) { return; }
+
+	///Only warn on the transition to over budget, not for every allocation after that
+	if (bShouldWarn)
+	{
+		UE_LOG(LogGravityGun, Warning, TEXT("Memory category %s is over budget: %lld KB used, budget %lld KB"),
+			GetCategoryName(Category), CurrentBytes / 1024, Budget / 1024);
+	}
+
+	///Listeners may free memory in response, so the broadcast happens outside of the lock.
+	///Like the warning it is only fired when the category goes over budget, so pools don't trim on every allocation after that.
+	if (bShouldBroadcast)
+	{
+		OnOverBudget.Broadcast(Category, BytesOverBudget);
+	}
+}
+
+void FGravityGunMemory::TrackFree(EGravityGunMemoryCategory Category, int64 Bytes)
+{
+	using namespace GravityGunMemory;
+	const int32 Index = (int32)Category;
+	check(Index < NumCategories);
+
+	const int64 Budget = GetBudgetBytes(Category);
+	int64 CurrentBytes = 0;
+	{
+		FScopeLock Lock(&StateLock);
+		FCategoryState& State = States[Index];
+		State.CurrentBytes = FMath::Max<int64>(State.CurrentBytes - Bytes, 0);
+		State.LiveAllocations = FMath::Max(State.LiveAllocations - 1, 0);
+		CurrentBytes = State.CurrentBytes;
+
+		if (Budget <= 0 || State.CurrentBytes <= Budget)
+		{
+			State.bWarned = false;
+			State.bBroadcast = false;
+		}
+	}
+	UpdateStat(Category, CurrentBytes);
+}
+
+int64 FGravityGunMemory::GetCurrentBytes(EGravityGunMemoryCategory Category)
+{
+	FScopeLock Lock(&GravityGunMemory::StateLock);
+	return GravityGunMemory::States[(int32)Category].CurrentBytes;
+}
+
+int64 FGravityGunMemory::GetHighWaterBytes(EGravityGunMemoryCategory Category)
+{
+	FScopeLock Lock(&GravityGunMemory::StateLock);
+	return GravityGunMemory::States[(int32)Category].HighWaterBytes;
+}
+
+int32 FGravityGunMemory::GetLiveAllocations(EGravityGunMemoryCategory Category)
+{
+	FScopeLock Lock(&GravityGunMemory::StateLock);
+	return GravityGunMemory::States[(int32)Category].LiveAllocations;
+}
+
+int64 FGravityGunMemory::GetBudgetBytes(EGravityGunMemoryCategory Category)
+{
+	return (int64)FMath::Max(GravityGunMemory::BudgetKB[(int32)Category], 0) * 1024;
+}
+
+bool FGravityGunMemory::IsOverBudget(EGravityGunMemoryCategory Category)
+{
+	const int64 Budget = GetBudgetBytes(Category);
+	return Budget > 0 && GetCurrentBytes(Category) > Budget;
+}
+
+void FGravityGunMemory::ResetHighWaterMarks()
+{
+	using namespace GravityGunMemory;
+	FScopeLock Lock(&StateLock);
+	for (FCategoryState& State : States)
+	{
+		State.HighWaterBytes = State.CurrentBytes;
+	}
+}
+
+void FGravityGunMemory::DumpToLog()
+{
+	using namespace GravityGunMemory;
+	UE_LOG(LogGravityGun, Display, TEXT("%-12s %12s %12s %8s %12s"), TEXT("Category"), TEXT("CurrentKB"), TEXT("HighWaterKB"), TEXT("Live"), TEXT("BudgetKB"));
+	for (int32 Index = 0; Index < NumCategories; Index++)
+	{
+		const EGravityGunMemoryCategory Category = (EGravityGunMemoryCategory)Index;
+		FCategoryState State;
+		{
+			FScopeLock Lock(&StateLock);
+			State = States[Index];
+		}
+		UE_LOG(LogGravityGun, Display, TEXT("%-12s %12.1f %12.1f %8d %12lld"),
+			GetCategoryName(Category),
+			State.CurrentBytes / 1024.0,
+			State.HighWaterBytes / 1024.0,
+			State.LiveAllocations,
+			GetBudgetBytes(Category) / 1024);
+	}
+}
+
+const TCHAR* FGravityGunMemory::GetCategoryName(EGravityGunMemoryCategory Category)
+{
+	switch (Category)
+	{
+	case EGravityGunMemoryCategory::Projectiles: return TEXT("Projectiles");
+	case EGravityGunMemoryCategory::GrabLaunch: return TEXT("GrabLaunch");
+	case EGravityGunMemoryCategory::Props: return TEXT("Props");
+	default: return TEXT("Unknown");
+	}
+}
+
+int64 FGravityGunMemory::EstimateActorBytes(const AActor* Actor)
+{
+	if (!Actor) { return 0; }
+
+	int64 Bytes = Actor->GetClass()->GetStructureSize();
+	for (const UActorComponent* Component : Actor->GetComponents())
+	{
+		if (Component)
+		{
+			Bytes += Component->GetClass()->GetStructureSize();
+		}
+	}
+	return Bytes;
+}
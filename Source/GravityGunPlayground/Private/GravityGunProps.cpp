@@ -0,0 +1,147 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityGunProps.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/Actor.h"
+#include "GameFramework/Character.h"
+#include "Hash/CityHash.h"
+#include "PhysicsEngine/PhysicsHandleComponent.h"
+#include "MultiObjectGrabberComponent.h"
+#include "UObject/ObjectKey.h"
+#include "UObject/UObjectIterator.h"
+
+namespace GravityGunProps
+{
+	//Identifiers assigned with SetPropId, in both directions
+	static TMap<FObjectKey, uint64> AssignedIds;
+	static TMap<uint64, FObjectKey> AssignedProps;
+}
+
+UPrimitiveComponent* FGravityGunProps::GetPropComponent(const AActor* Actor)
+{
+	if (!Actor || Actor->IsPendingKill()) { return nullptr; }
+
+	UPrimitiveComponent* RootPrimitive = Cast<UPrimitiveComponent>(Actor->GetRootComponent());
+	if (!RootPrimitive || !RootPrimitive->IsSimulatingPhysics()) { return nullptr; }
+
+	return RootPrimitive;
+}
+
+uint64 FGravityGunProps::GetPropId(const AActor* Actor)
+{
+	if (!Actor) { return 0; }
+
+	if (const uint64* AssignedId = GravityGunProps::AssignedIds.Find(FObjectKey(Actor)))
+	{
+		return *AssignedId;
+	}
+
+	///Strip the PIE prefix, so snapshots taken in PIE also match standalone worlds
+	const FString Path = UWorld::RemovePIEPrefix(Actor->GetPathName());
+	return CityHash64(reinterpret_cast<const char*>(*Path), Path.Len() * sizeof(TCHAR));
+}
+
+void FGravityGunProps::SetPropId(AActor* Actor, uint64 Id)
+{
+	if (!Actor) { return; }
+
+	///An identifier belongs to one prop at a time
+	if (const FObjectKey* PreviousProp = GravityGunProps::AssignedProps.Find(Id))
+	{
+		GravityGunProps::AssignedIds.Remove(*PreviousProp);
+	}
+	GravityGunProps::AssignedIds.Add(FObjectKey(Actor), Id);
+	GravityGunProps::AssignedProps.Add(Id, FObjectKey(Actor));
+}
+
+void FGravityGunProps::ClearPropId(const AActor* Actor)
+{
+	uint64 Id = 0;
+	if (GravityGunProps::AssignedIds.RemoveAndCopyValue(FObjectKey(Actor), Id))
+	{
+		GravityGunProps::AssignedProps.Remove(Id);
+	}
+}
+
+AActor* FGravityGunProps::FindPropWithAssignedId(uint64 Id)
+{
+	const FObjectKey* Prop = GravityGunProps::AssignedProps.Find(Id);
+	return Prop ? Cast<AActor>(Prop->ResolveObjectPtr()) : nullptr;
+}
+
+void FGravityGunProps::GetAllProps(UWorld* World, TArray<UPrimitiveComponent*>& OutProps)
+{
+	OutProps.Reset();
+	if (!World) { return; }
+
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		if (UPrimitiveComponent* Prop = GetPropComponent(*It))
+		{
+			OutProps.Add(Prop);
+		}
+	}
+}
+
+void FGravityGunProps::GetHeldComponents(UWorld* World, TSet<UPrimitiveComponent*>& OutHeld)
+{
+	for (TObjectIterator<UPhysicsHandleComponent> It; It; ++It)
+	{
+		if (It->GetWorld() == World && It->GetGrabbedComponent())
+		{
+			OutHeld.Add(It->GetGrabbedComponent());
+		}
+	}
+
+	TArray<UPrimitiveComponent*> GroupHeld;
+	for (TObjectIterator<UMultiObjectGrabberComponent> It; It; ++It)
+	{
+		if (It->GetWorld() == World)
+		{
+			GroupHeld.Reset();
+			It->GetHeldComponents(GroupHeld);
+			OutHeld.Append(GroupHeld);
+		}
+	}
+}
+
+bool FGravityGunProps::IsHeld(const UPrimitiveComponent* Component)
+{
+	if (!Component) { return false; }
+
+	for (TObjectIterator<UPhysicsHandleComponent> It; It; ++It)
+	{
+		if (It->GetGrabbedComponent() == Component)
+		{
+			return true;
+		}
+	}
+	for (TObjectIterator<UMultiObjectGrabberComponent> It; It; ++It)
+	{
+		if (It->IsHolding(Component))
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+bool FGravityGunProps::IsCarrierTouching(const AActor* Gun, const AActor* Actor)
+{
+	///Check if the gun is attached to a parent (E.g the gun is equipped).
+	///If so, check if the parent is overlapping with the actor.
+	const AActor* ActorParent = Gun ? Gun->GetAttachParentActor() : nullptr;
+	if (!ActorParent) { return false; }
+
+	///A character walking on the actor doesn't always overlap it, check its movement base as well
+	const ACharacter* Character = Cast<ACharacter>(ActorParent);
+	const UPrimitiveComponent* MovementBase = Character ? Character->GetMovementBase() : nullptr;
+	if (MovementBase && MovementBase->GetOwner() == Actor)
+	{
+		return true;
+	}
+	return ActorParent->IsOverlappingActor(Actor);
+}
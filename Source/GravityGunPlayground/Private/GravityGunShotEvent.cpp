@@ -0,0 +1,158 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityGunShotEvent.h"
+#include "GravityGunPlayground.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "Engine/NetSerialization.h"
+#include "HAL/IConsoleManager.h"
+#include "Math/RandomStream.h"
+#include "UObject/CoreNet.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Shot Event Bits"), STAT_GGPShotEventBits, STATGROUP_GravityGun);
+
+namespace GravityGunShotReplication
+{
+	static int32 bUseShotEvents = 1;
+
+	static FAutoConsoleVariableRef CVarShotEvents(
+		TEXT("ggp.Net.ShotEvents"),
+		bUseShotEvents,
+		TEXT("1: projectiles are sent as a single shot event and simulated on every client. 0: every projectile is a replicated actor."));
+
+	//Totals since the last reset of the stats
+	static int32 NumShots = 0;
+	static int32 NumEvents = 0;
+	static int64 EventBits = 0;
+	static uint64 OutBytesAtReset = 0;
+	static TWeakObjectPtr<UWorld> StatsWorld;
+
+	static uint64 GetOutBytes(UWorld* World)
+	{
+		UNetDriver* NetDriver = World ? World->GetNetDriver() : nullptr;
+		return NetDriver ? NetDriver->OutTotalBytes : 0;
+	}
+
+	static void ResetStats(UWorld* World)
+	{
+		NumShots = 0;
+		NumEvents = 0;
+		EventBits = 0;
+		OutBytesAtReset = GetOutBytes(World);
+		StatsWorld = World;
+	}
+
+	static void StatsCommand(const TArray<FString>& Args, UWorld* World)
+	{
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			ResetStats(World);
+			UE_LOG(LogGravityGun, Display, TEXT("Shot replication stats reset"));
+			return;
+		}
+
+		FGravityGunShotEvent Sample;
+		Sample.MuzzleLocation = FVector(12345.6f, -4321.f, 250.f);
+		Sample.MuzzleRotation = FRotator(-10.f, 135.f, 0.f);
+
+		UE_LOG(LogGravityGun, Display, TEXT("Shot replication: %s, shot event payload %d bits"),
+			bUseShotEvents ? TEXT("shot events") : TEXT("replicated actors"),
+			FGravityGunShotReplication::GetEventBits(Sample));
+
+		if (NumShots == 0 || StatsWorld.Get() != World)
+		{
+			UE_LOG(LogGravityGun, Display, TEXT("No shots fired since the last reset. Run 'ggp.Net.ShotStats reset' on the server, fire, then run it again."));
+			return;
+		}
+
+		const uint64 OutBytes = GetOutBytes(World) - OutBytesAtReset;
+		UE_LOG(LogGravityGun, Display, TEXT("%d shots, %d sent as events averaging %.1f bits. Server sent %llu bytes in total, %.1f bytes per shot."),
+			NumShots,
+			NumEvents,
+			NumEvents > 0 ? (double)EventBits / NumEvents : 0.0,
+			OutBytes,
+			(double)OutBytes / NumShots);
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs StatsConsoleCommand(
+		TEXT("ggp.Net.ShotStats"),
+		TEXT("Logs the shot event size and the server bytes sent per shot since the last reset. Usage: ggp.Net.ShotStats [reset]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StatsCommand));
+}
+
+void FGravityGunShotEvent::Quantize()
+{
+	MuzzleLocation = FVector(
+		FMath::RoundToFloat(MuzzleLocation.X * 10.f) / 10.f,
+		FMath::RoundToFloat(MuzzleLocation.Y * 10.f) / 10.f,
+		FMath::RoundToFloat(MuzzleLocation.Z * 10.f) / 10.f);
+	MuzzleRotation.Pitch = FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(MuzzleRotation.Pitch));
+	MuzzleRotation.Yaw = FRotator::DecompressAxisFromShort(FRotator::CompressAxisToShort(MuzzleRotation.Yaw));
+	MuzzleRotation.Roll = 0.f;
+}
+
+FRotator FGravityGunShotEvent::GetShotRotation(float SpreadDegrees) const
+{
+	if (SpreadDegrees <= 0.f) { return MuzzleRotation; }
+
+	const FRandomStream Stream(Seed);
+	return Stream.VRandCone(MuzzleRotation.Vector(), FMath::DegreesToRadians(SpreadDegrees * 0.5f)).Rotation();
+}
+
+bool FGravityGunShotEvent::NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess)
+{
+	bOutSuccess = SerializePackedVector<10, 24>(MuzzleLocation, Ar);
+
+	uint16 Pitch = 0;
+	uint16 Yaw = 0;
+	if (Ar.IsSaving())
+	{
+		Pitch = FRotator::CompressAxisToShort(MuzzleRotation.Pitch);
+		Yaw = FRotator::CompressAxisToShort(MuzzleRotation.Yaw);
+	}
+	Ar << Pitch;
+	Ar << Yaw;
+	if (Ar.IsLoading())
+	{
+		MuzzleRotation = FRotator(FRotator::DecompressAxisFromShort(Pitch), FRotator::DecompressAxisFromShort(Yaw), 0.f);
+	}
+
+	Ar << Seed;
+	Ar << ShotId;
+	Ar << ServerTime;
+	return true;
+}
+
+bool FGravityGunShotReplication::UseShotEvents()
+{
+	return GravityGunShotReplication::bUseShotEvents != 0;
+}
+
+int32 FGravityGunShotReplication::GetEventBits(const FGravityGunShotEvent& Shot)
+{
+	FNetBitWriter Writer(nullptr, 256);
+	bool bSuccess = false;
+	FGravityGunShotEvent Copy = Shot;
+	Copy.NetSerialize(Writer, nullptr, bSuccess);
+	return (int32)Writer.GetNumBits();
+}
+
+void FGravityGunShotReplication::RecordShot(UWorld* World, const FGravityGunShotEvent& Shot, bool bSentAsEvent)
+{
+	using namespace GravityGunShotReplication;
+
+	if (StatsWorld.Get() != World)
+	{
+		ResetStats(World);
+	}
+
+	NumShots++;
+	if (bSentAsEvent)
+	{
+		const int32 Bits = FGravityGunShotReplication::GetEventBits(Shot);
+		NumEvents++;
+		EventBits += Bits;
+		INC_DWORD_STAT_BY(STAT_GGPShotEventBits, Bits);
+	}
+}
@@ -0,0 +1,429 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityGunTelemetry.h"
+#include "GravityGunPlayground.h"
+#include "HAL/FileManager.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformTLS.h"
+#include "HAL/Runnable.h"
+#include "HAL/RunnableThread.h"
+#include "HAL/ThreadSafeBool.h"
+#include "HAL/ThreadSafeCounter.h"
+#include "HAL/TlsAutoCleanup.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/Parse.h"
+#include "Misc/Paths.h"
+#include "Misc/ScopeLock.h"
+#include "Templates/Atomic.h"
+
+namespace GravityGunTelemetry
+{
+	static const int32 NumEvents = (int32)EGravityGunTelemetryEvent::Count;
+
+	static int32 bEnabledSetting = 1;
+	static int32 BufferRecords = 4096;
+	static int32 FlushIntervalMs = 250;
+	static int32 MaxFileKB = 1024;
+	static int32 MaxFiles = 8;
+
+	static FAutoConsoleVariableRef CVarEnabled(
+		TEXT("ggp.Telemetry.Enabled"),
+		bEnabledSetting,
+		TEXT("If 1, gameplay telemetry is recorded. Read on startup, -GGPNoTelemetry disables it as well."));
+
+	static FAutoConsoleVariableRef CVarBufferRecords(
+		TEXT("ggp.Telemetry.BufferRecords"),
+		BufferRecords,
+		TEXT("Number of records in the telemetry buffer of each recording thread, rounded up to a power of two. Read when a thread records its first event."));
+
+	static FAutoConsoleVariableRef CVarFlushIntervalMs(
+		TEXT("ggp.Telemetry.FlushIntervalMs"),
+		FlushIntervalMs,
+		TEXT("Milliseconds between drains of the telemetry buffers by the writer thread."));
+
+	static FAutoConsoleVariableRef CVarMaxFileKB(
+		TEXT("ggp.Telemetry.MaxFileKB"),
+		MaxFileKB,
+		TEXT("Size in KB after which the telemetry writer starts a new file."));
+
+	static FAutoConsoleVariableRef CVarMaxFiles(
+		TEXT("ggp.Telemetry.MaxFiles"),
+		MaxFiles,
+		TEXT("Number of telemetry files kept per session. The oldest file is deleted when a new one is started."));
+
+	//Single producer, single consumer ring. Only the owning thread writes records and WriteIndex, only the writer thread moves ReadIndex.
+	//Buffers are never freed, a recording thread may still be writing into one while telemetry shuts down.
+	//The buffer of an exited thread is handed to the next thread that starts recording once it has been drained.
+	struct FThreadBuffer
+	{
+		FThreadBuffer(uint32 InCapacity)
+			: Capacity(InCapacity)
+			, WriteIndex(0)
+			, ReadIndex(0)
+			, bOwned(true)
+		{
+			Records.SetNumUninitialized(Capacity);
+		}
+
+		TArray<FGravityGunTelemetryRecord> Records;
+		const uint32 Capacity;
+		TAtomic<uint32> WriteIndex;
+		TAtomic<uint32> ReadIndex;
+		//Cleared when the owning thread exits
+		TAtomic<bool> bOwned;
+	};
+
+	//Deleted by the runnable thread when it exits, which releases its buffer for reuse
+	class FThreadBufferOwner : public FTlsAutoCleanup
+	{
+	public:
+		FThreadBufferOwner(FThreadBuffer* InBuffer)
+			: Buffer(InBuffer)
+		{
+		}
+
+		virtual ~FThreadBufferOwner()
+		{
+			Buffer->bOwned.Store(false);
+		}
+
+	private:
+		FThreadBuffer* Buffer;
+	};
+
+	//Set once the buffers and the writer are set up, cleared before they are torn down. Read by every recording thread.
+	static TAtomic<bool> bEnabled(false);
+	//Allocated on the first initialize and kept, like the buffers it points to
+	static uint32 TlsSlot = 0;
+	static bool bTlsSlotAllocated = false;
+	static double SessionStartTime = 0.0;
+	static FString SessionName;
+
+	//Buffers of every thread that has recorded an event. Only locked when a thread records for the first time and when draining.
+	static TArray<FThreadBuffer*> Buffers;
+	static FCriticalSection BuffersLock;
+
+	static FThreadSafeCounter SessionCounts[NumEvents];
+	static FThreadSafeCounter DroppedCount;
+
+	static FThreadBuffer* GetThreadBuffer()
+	{
+		FThreadBuffer* Buffer = (FThreadBuffer*)FPlatformTLS::GetTlsValue(TlsSlot);
+		if (Buffer) { return Buffer; }
+
+		{
+			FScopeLock Lock(&BuffersLock);
+
+			///Reuse the buffer of an exited thread, once everything it recorded has been written
+			for (FThreadBuffer* FreeBuffer : Buffers)
+			{
+				if (!FreeBuffer->bOwned.Load() && FreeBuffer->ReadIndex.Load() == FreeBuffer->WriteIndex.Load())
+				{
+					FreeBuffer->bOwned.Store(true);
+					Buffer = FreeBuffer;
+					break;
+				}
+			}
+			if (!Buffer)
+			{
+				Buffer = new FThreadBuffer(FMath::RoundUpToPowerOfTwo(FMath::Max(BufferRecords, 64)));
+				Buffers.Add(Buffer);
+			}
+		}
+
+		///Threads that aren't runnable threads, like the game thread, keep their buffer until the process exits
+		FThreadBufferOwner* Owner = new FThreadBufferOwner(Buffer);
+		Owner->Register();
+		FPlatformTLS::SetTlsValue(TlsSlot, Buffer);
+		return Buffer;
+	}
+
+	/*
+	 * Background thread that drains the per-thread buffers into the telemetry files.
+	 * The files and their rotation are only touched by this thread.
+	 */
+	class FTelemetryWriter : public FRunnable
+	{
+	public:
+		FTelemetryWriter()
+		{
+			WakeEvent = FPlatformProcess::GetSynchEventFromPool();
+		}
+
+		virtual ~FTelemetryWriter()
+		{
+			FPlatformProcess::ReturnSynchEventToPool(WakeEvent);
+			WakeEvent = nullptr;
+		}
+
+		virtual uint32 Run() override
+		{
+			while (!bStopping)
+			{
+				WakeEvent->Wait(FMath::Max(FlushIntervalMs, 1));
+				DrainBuffers();
+			}
+
+			///Write whatever was recorded before shutdown, followed by the session totals
+			DrainBuffers();
+			WriteSessionSummary();
+			CloseFile();
+			return 0;
+		}
+
+		virtual void Stop() override
+		{
+			bStopping = true;
+			WakeEvent->Trigger();
+		}
+
+	private:
+		FEvent* WakeEvent = nullptr;
+		FThreadSafeBool bStopping;
+
+		FArchive* File = nullptr;
+		int64 FileBytes = 0;
+		int32 FileIndex = -1;
+		int32 ReportedDrops = 0;
+
+		//Scratch buffers, kept to avoid reallocating every drain
+		TArray<FThreadBuffer*> BuffersToDrain;
+		FString Text;
+
+		void DrainBuffers()
+		{
+			{
+				FScopeLock Lock(&BuffersLock);
+				BuffersToDrain = Buffers;
+			}
+
+			Text.Reset();
+			for (FThreadBuffer* Buffer : BuffersToDrain)
+			{
+				///Records up to the write index are complete, the producer only publishes the index after writing the record
+				const uint32 Write = Buffer->WriteIndex.Load();
+				uint32 Read = Buffer->ReadIndex.Load(EMemoryOrder::Relaxed);
+				for (; Read != Write; Read++)
+				{
+					AppendRecord(Buffer->Records[Read & (Buffer->Capacity - 1)]);
+				}
+				Buffer->ReadIndex = Read;
+			}
+
+			const int32 Drops = DroppedCount.GetValue();
+			if (Drops != ReportedDrops)
+			{
+				UE_LOG(LogGravityGun, Warning, TEXT("Telemetry buffers overflowed, %d events dropped this session"), Drops);
+				Text += FString::Printf(TEXT("{\"event\":\"Dropped\",\"t\":%.4f,\"total\":%d}\n"), FPlatformTime::Seconds() - SessionStartTime, Drops);
+				ReportedDrops = Drops;
+			}
+
+			WriteText();
+		}
+
+		void AppendRecord(const FGravityGunTelemetryRecord& Record)
+		{
+			if ((int32)Record.Event >= NumEvents) { return; }
+
+			SessionCounts[(int32)Record.Event].Increment();
+			Text += FString::Printf(TEXT("{\"event\":\"%s\",\"t\":%.4f,\"frame\":%u,\"loc\":[%.1f,%.1f,%.1f],\"value\":%.3f}\n"),
+				FGravityGunTelemetry::GetEventName(Record.Event),
+				Record.Time,
+				Record.Frame,
+				Record.Location[0], Record.Location[1], Record.Location[2],
+				Record.Value);
+		}
+
+		void WriteSessionSummary()
+		{
+			Text = FString::Printf(TEXT("{\"event\":\"Session\",\"t\":%.4f,\"dropped\":%d,\"counts\":{"), FPlatformTime::Seconds() - SessionStartTime, DroppedCount.GetValue());
+			for (int32 EventIndex = 0; EventIndex < NumEvents; EventIndex++)
+			{
+				Text += FString::Printf(TEXT("%s\"%s\":%d"),
+					EventIndex > 0 ? TEXT(",") : TEXT(""),
+					FGravityGunTelemetry::GetEventName((EGravityGunTelemetryEvent)EventIndex),
+					SessionCounts[EventIndex].GetValue());
+			}
+			Text += TEXT("}}\n");
+			WriteText();
+		}
+
+		void WriteText()
+		{
+			if (Text.IsEmpty()) { return; }
+
+			if (!File || FileBytes >= (int64)MaxFileKB * 1024)
+			{
+				OpenNextFile();
+			}
+			if (!File) { return; }
+
+			FTCHARToUTF8 Converted(*Text);
+			File->Serialize(const_cast<ANSICHAR*>(Converted.Get()), Converted.Length());
+			File->Flush();
+			FileBytes += Converted.Length();
+		}
+
+		void OpenNextFile()
+		{
+			CloseFile();
+			FileIndex++;
+			FileBytes = 0;
+
+			///Keep the last MaxFiles files of the session
+			const int32 ExpiredIndex = FileIndex - FMath::Max(MaxFiles, 1);
+			if (ExpiredIndex >= 0)
+			{
+				IFileManager::Get().Delete(*GetFilename(ExpiredIndex), false, false, true);
+			}
+
+			File = IFileManager::Get().CreateFileWriter(*GetFilename(FileIndex));
+			if (!File)
+			{
+				UE_LOG(LogGravityGun, Warning, TEXT("Failed to open telemetry file %s"), *GetFilename(FileIndex));
+			}
+		}
+
+		void CloseFile()
+		{
+			if (!File) { return; }
+
+			File->Close();
+			delete File;
+			File = nullptr;
+		}
+
+		FString GetFilename(int32 Index) const
+		{
+			return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Telemetry"), FString::Printf(TEXT("%s_%03d.jsonl"), *SessionName, Index));
+		}
+	};
+
+	static FTelemetryWriter* Writer = nullptr;
+	static FRunnableThread* WriterThread = nullptr;
+
+	static void StatsCommand()
+	{
+		UE_LOG(LogGravityGun, Display, TEXT("Telemetry %s, session %s, %d recording threads, %d events dropped"),
+			bEnabled.Load() ? TEXT("enabled") : TEXT("disabled"), *SessionName, Buffers.Num(), DroppedCount.GetValue());
+		for (int32 EventIndex = 0; EventIndex < NumEvents; EventIndex++)
+		{
+			UE_LOG(LogGravityGun, Display, TEXT("  %s: %d"),
+				FGravityGunTelemetry::GetEventName((EGravityGunTelemetryEvent)EventIndex),
+				SessionCounts[EventIndex].GetValue());
+		}
+	}
+
+	static FAutoConsoleCommand StatsConsoleCommand(
+		TEXT("ggp.Telemetry.Stats"),
+		TEXT("Logs the telemetry event counts and the dropped events of this session."),
+		FConsoleCommandDelegate::CreateStatic(&StatsCommand));
+}
+
+void FGravityGunTelemetry::Initialize()
+{
+	using namespace GravityGunTelemetry;
+
+	if (bEnabled.Load()) { return; }
+	if (!bEnabledSetting || IsRunningCommandlet() || FParse::Param(FCommandLine::Get(), TEXT("GGPNoTelemetry"))) { return; }
+
+	if (!bTlsSlotAllocated)
+	{
+		TlsSlot = FPlatformTLS::AllocTlsSlot();
+		bTlsSlotAllocated = true;
+	}
+	SessionStartTime = FPlatformTime::Seconds();
+	SessionName = FDateTime::Now().ToString();
+
+	Writer = new FTelemetryWriter();
+	WriterThread = FRunnableThread::Create(Writer, TEXT("GravityGunTelemetry"), 0, TPri_BelowNormal);
+	if (!WriterThread)
+	{
+		UE_LOG(LogGravityGun, Warning, TEXT("Failed to start the telemetry writer thread, telemetry is disabled"));
+		delete Writer;
+		Writer = nullptr;
+		return;
+	}
+	///Publishes the TLS slot and the writer to the recording threads
+	bEnabled.Store(true);
+}
+
+void FGravityGunTelemetry::Shutdown()
+{
+	using namespace GravityGunTelemetry;
+
+	if (!bEnabled.Exchange(false)) { return; }
+
+	///Stopping the thread drains the buffers one last time
+	WriterThread->Kill(true);
+	delete WriterThread;
+	WriterThread = nullptr;
+	delete Writer;
+	Writer = nullptr;
+
+	///A thread that passed the enabled check just before may still be writing a record, so the buffers and the TLS slot are kept
+}
+
+bool FGravityGunTelemetry::IsEnabled()
+{
+	return GravityGunTelemetry::bEnabled.Load();
+}
+
+void FGravityGunTelemetry::Record(EGravityGunTelemetryEvent Event, const FVector& Location, float Value)
+{
+	using namespace GravityGunTelemetry;
+
+	if (!bEnabled.Load()) { return; }
+
+	FThreadBuffer* Buffer = GetThreadBuffer();
+	const uint32 Write = Buffer->WriteIndex.Load(EMemoryOrder::Relaxed);
+	if (Write - Buffer->ReadIndex.Load() >= Buffer->Capacity)
+	{
+		///The writer thread hasn't caught up, drop the event rather than block or grow
+		DroppedCount.Increment();
+		return;
+	}
+
+	FGravityGunTelemetryRecord& Record = Buffer->Records[Write & (Buffer->Capacity - 1)];
+	Record.Time = FPlatformTime::Seconds() - SessionStartTime;
+	Record.Frame = (uint32)GFrameCounter;
+	Record.Event = Event;
+	Record.Location[0] = Location.X;
+	Record.Location[1] = Location.Y;
+	Record.Location[2] = Location.Z;
+	Record.Value = Value;
+
+	///Publish the record to the writer thread
+	Buffer->WriteIndex = Write + 1;
+}
+
+int32 FGravityGunTelemetry::GetSessionCount(EGravityGunTelemetryEvent Event)
+{
+	if ((int32)Event >= GravityGunTelemetry::NumEvents) { return 0; }
+	return GravityGunTelemetry::SessionCounts[(int32)Event].GetValue();
+}
+
+int32 FGravityGunTelemetry::GetDroppedCount()
+{
+	return GravityGunTelemetry::DroppedCount.GetValue();
+}
+
+const TCHAR* FGravityGunTelemetry::GetEventName(EGravityGunTelemetryEvent Event)
+{
+	switch (Event)
+	{
+	case EGravityGunTelemetryEvent::Grab: return TEXT("Grab");
+	case EGravityGunTelemetryEvent::Release: return TEXT("Release");
+	case EGravityGunTelemetryEvent::Launch: return TEXT("Launch");
+	case EGravityGunTelemetryEvent::Shot: return TEXT("Shot");
+	case EGravityGunTelemetryEvent::ForceReleaseDistance: return TEXT("ForceReleaseDistance");
+	case EGravityGunTelemetryEvent::ForceReleaseOverlap: return TEXT("ForceReleaseOverlap");
+	case EGravityGunTelemetryEvent::ForceReleaseDetached: return TEXT("ForceReleaseDetached");
+	case EGravityGunTelemetryEvent::GrabCooldownRejected: return TEXT("GrabCooldownRejected");
+	case EGravityGunTelemetryEvent::LaunchCooldownRejected: return TEXT("LaunchCooldownRejected");
+	case EGravityGunTelemetryEvent::BudgetLevel: return TEXT("BudgetLevel");
+	default: return TEXT("Unknown");
+	}
+}
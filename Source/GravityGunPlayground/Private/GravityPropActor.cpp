@@ -0,0 +1,245 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityPropActor.h"
+#include "GravityGunPlayground.h"
+#include "GravityGunProps.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/NetDriver.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_DWORD_COUNTER_STAT(TEXT("Props Prioritized"), STAT_GGPPropsPrioritized, STATGROUP_GravityGun);
+DECLARE_DWORD_ACCUMULATOR_STAT(TEXT("Awake Net Props"), STAT_GGPAwakeNetProps, STATGROUP_GravityGun);
+
+namespace GravityProps
+{
+	static int32 bAdaptive = 1;
+
+	static FAutoConsoleVariableRef CVarAdaptive(
+		TEXT("ggp.Net.PropAdaptive"),
+		bAdaptive,
+		TEXT("1: gravity props adapt their net update frequency and priority to their activity and go dormant at rest.\n")
+		TEXT("0: gravity props always replicate at their active update frequency. Applies to props that begin play afterwards."));
+
+	//Number of GetNetPriority calls on props since the last reset, once per prop and connection it is considered for
+	static uint64 NumPrioritized = 0;
+	static uint64 FrameAtReset = 0;
+	static double TimeAtReset = 0.0;
+	static uint64 OutBytesAtReset = 0;
+	static TWeakObjectPtr<UWorld> StatsWorld;
+
+	static uint64 GetOutBytes(UWorld* World)
+	{
+		UNetDriver* NetDriver = World ? World->GetNetDriver() : nullptr;
+		return NetDriver ? NetDriver->OutTotalBytes : 0;
+	}
+
+	static void ResetStats(UWorld* World)
+	{
+		NumPrioritized = 0;
+		FrameAtReset = GFrameCounter;
+		TimeAtReset = FPlatformTime::Seconds();
+		OutBytesAtReset = GetOutBytes(World);
+		StatsWorld = World;
+	}
+
+	static void StatsCommand(const TArray<FString>& Args, UWorld* World)
+	{
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			ResetStats(World);
+			UE_LOG(LogGravityGun, Display, TEXT("Prop replication stats reset"));
+			return;
+		}
+
+		int32 NumProps = 0;
+		int32 NumAwake = 0;
+		float TotalFrequency = 0.f;
+		for (TActorIterator<AGravityPropActor> It(World); It; ++It)
+		{
+			NumProps++;
+			if (It->NetDormancy <= DORM_Awake)
+			{
+				NumAwake++;
+				TotalFrequency += It->NetUpdateFrequency;
+			}
+		}
+		UE_LOG(LogGravityGun, Display, TEXT("Props: %d, %d awake with %.1f updates/s in total, adaptive %d"), NumProps, NumAwake, TotalFrequency, bAdaptive);
+
+		if (StatsWorld.Get() != World || GFrameCounter == FrameAtReset)
+		{
+			UE_LOG(LogGravityGun, Display, TEXT("No measurement running. Run 'ggp.Net.PropStats reset' on the server, play, then run it again."));
+			return;
+		}
+
+		const double Seconds = FMath::Max(FPlatformTime::Seconds() - TimeAtReset, 0.001);
+		const uint64 Frames = GFrameCounter - FrameAtReset;
+		const uint64 OutBytes = GetOutBytes(World) - OutBytesAtReset;
+		UE_LOG(LogGravityGun, Display, TEXT("%.1f seconds: server sent %.1f bytes/s, %.2f props prioritized per frame"),
+			Seconds,
+			OutBytes / Seconds,
+			(double)NumPrioritized / Frames);
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs StatsConsoleCommand(
+		TEXT("ggp.Net.PropStats"),
+		TEXT("Logs the server bandwidth and the props prioritized for replication per frame since the last reset. Usage: ggp.Net.PropStats [reset]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StatsCommand));
+}
+
+// Sets default values
+AGravityPropActor::AGravityPropActor()
+{
+	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	UStaticMeshComponent* Body = GetStaticMeshComponent();
+	Body->SetMobility(EComponentMobility::Movable);
+	Body->SetCollisionProfileName(UCollisionProfile::PhysicsActor_ProfileName);
+	Body->SetSimulatePhysics(true);
+	Body->BodyInstance.bGenerateWakeEvents = true;
+
+	bReplicates = true;
+	bStaticMeshReplicateMovement = true;
+	NetUpdateFrequency = RestNetUpdateFrequency;
+	MinNetUpdateFrequency = 1.f;
+
+	///Placed props start at rest, clients already have their initial state from the map
+	NetDormancy = DORM_Initial;
+}
+
+// Called when the game starts or when spawned
+void AGravityPropActor::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (!HasAuthority()) { return; }
+
+	if (!GravityProps::bAdaptive)
+	{
+		NetUpdateFrequency = ActiveNetUpdateFrequency;
+		SetNetDormancy(DORM_Awake);
+		return;
+	}
+
+	UStaticMeshComponent* Body = GetStaticMeshComponent();
+	Body->OnComponentWake.AddDynamic(this, &AGravityPropActor::OnBodyWake);
+	Body->OnComponentSleep.AddDynamic(this, &AGravityPropActor::OnBodySleep);
+	if (Body->IsAnyRigidBodyAwake())
+	{
+		WakeUp();
+	}
+}
+
+// Called every frame
+void AGravityPropActor::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	///Activity follows the speed right away, but only decays slowly, so a prop that bounces to a halt keeps updating
+	const UStaticMeshComponent* Body = GetStaticMeshComponent();
+	const float SpeedActivity = FMath::Clamp(Body->GetPhysicsLinearVelocity().Size() / FMath::Max(FullActivitySpeed, 1.f), 0.f, 1.f);
+	Activity = FMath::Max(SpeedActivity, Activity - ActivityDecayRate * DeltaTime);
+
+	///A held prop can move slowly or hover in place, but the holder watches it up close
+	if (FGravityGunProps::IsHeld(Body))
+	{
+		Activity = 1.f;
+	}
+
+	const float DistanceScale = FMath::Clamp(FullActivityDistance / FMath::Max(GetNearestViewerDistance(GetActorLocation()), 1.f), 0.f, 1.f);
+	NetUpdateFrequency = FMath::Lerp(RestNetUpdateFrequency, ActiveNetUpdateFrequency, Activity * DistanceScale);
+
+	if (Activity <= 0.f && !Body->IsAnyRigidBodyAwake())
+	{
+		Settle();
+	}
+}
+
+float AGravityPropActor::GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth)
+{
+	INC_DWORD_STAT(STAT_GGPPropsPrioritized);
+	GravityProps::NumPrioritized++;
+
+	///Fast props close to this viewer are the ones that visibly stutter when they're starved
+	const float Priority = Super::GetNetPriority(ViewPos, ViewDir, Viewer, ViewTarget, InChannel, Time, bLowBandwidth);
+	const float DistanceScale = FMath::Clamp(FullActivityDistance / FMath::Max(FVector::Dist(GetActorLocation(), ViewPos), 1.f), 0.f, 1.f);
+	return Priority * FMath::Lerp(1.f, ActiveNetPriority, Activity * DistanceScale);
+}
+
+void AGravityPropActor::NotifyActivity(AActor* Actor)
+{
+	AGravityPropActor* Prop = Cast<AGravityPropActor>(Actor);
+	if (!Prop || !Prop->HasAuthority() || !GravityProps::bAdaptive) { return; }
+
+	Prop->Activity = 1.f;
+	Prop->WakeUp();
+}
+
+void AGravityPropActor::WakeUp()
+{
+	if (!IsActorTickEnabled())
+	{
+		INC_DWORD_STAT(STAT_GGPAwakeNetProps);
+		SetActorTickEnabled(true);
+	}
+	if (NetDormancy != DORM_Awake)
+	{
+		SetNetDormancy(DORM_Awake);
+	}
+
+	///Send the change of motion now instead of waiting for the next update at the rest frequency
+	NetUpdateFrequency = FMath::Max(NetUpdateFrequency, FMath::Lerp(RestNetUpdateFrequency, ActiveNetUpdateFrequency, Activity));
+	ForceNetUpdate();
+}
+
+void AGravityPropActor::Settle()
+{
+	if (IsActorTickEnabled())
+	{
+		DEC_DWORD_STAT(STAT_GGPAwakeNetProps);
+		SetActorTickEnabled(false);
+	}
+	Activity = 0.f;
+	NetUpdateFrequency = RestNetUpdateFrequency;
+
+	///The final resting transform is sent before the channel goes dormant
+	ForceNetUpdate();
+	SetNetDormancy(DORM_DormantAll);
+}
+
+float AGravityPropActor::GetNearestViewerDistance(const FVector& Location) const
+{
+	float NearestDistanceSquared = BIG_NUMBER;
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (!PlayerController) { continue; }
+
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+		NearestDistanceSquared = FMath::Min(NearestDistanceSquared, FVector::DistSquared(ViewLocation, Location));
+	}
+	return FMath::Sqrt(NearestDistanceSquared);
+}
+
+void AGravityPropActor::OnBodyWake(UPrimitiveComponent* WakingComponent, FName BoneName)
+{
+	///Woken by a collision or a force, its speed decides the rate from here on
+	WakeUp();
+}
+
+void AGravityPropActor::OnBodySleep(UPrimitiveComponent* SleepingComponent, FName BoneName)
+{
+	if (Activity <= 0.f)
+	{
+		Settle();
+	}
+}
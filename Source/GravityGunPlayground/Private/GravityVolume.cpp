@@ -0,0 +1,85 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityVolume.h"
+#include "GravityVolumeManager.h"
+#include "Components/BoxComponent.h"
+#include "Engine/World.h"
+
+// Sets default values
+AGravityVolume::AGravityVolume()
+{
+	// The manager refreshes the volume, it doesn't tick itself
+	PrimaryActorTick.bCanEverTick = false;
+
+	Bounds = CreateDefaultSubobject<UBoxComponent>("Bounds");
+	Bounds->SetBoxExtent(FVector(500.f));
+	Bounds->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	Bounds->SetGenerateOverlapEvents(false);
+	RootComponent = Bounds;
+}
+
+// Called when the game starts or when spawned
+void AGravityVolume::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (AGravityVolumeManager* Manager = AGravityVolumeManager::Get(GetWorld()))
+	{
+		Manager->RegisterVolume(this);
+	}
+}
+
+void AGravityVolume::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (AGravityVolumeManager* Manager = AGravityVolumeManager::Find(GetWorld()))
+	{
+		Manager->UnregisterVolume(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
+}
+
+FGravityVolumeParams AGravityVolume::GetParams(float WorldGravityZ) const
+{
+	FGravityVolumeParams Params;
+	Params.Mode = Mode;
+	Params.Center = Bounds->GetComponentLocation();
+	Params.AttractorAcceleration = AttractorAcceleration;
+	Params.AttractorRadius = AttractorRadius;
+
+	switch (Mode)
+	{
+	case EGravityVolumeMode::ZeroGravity:
+		Params.GravityCancel = FVector(0.f, 0.f, -WorldGravityZ);
+		break;
+	case EGravityVolumeMode::ReversedGravity:
+		///Cancel the world gravity and apply it the other way around
+		Params.GravityCancel = FVector(0.f, 0.f, -WorldGravityZ);
+		Params.Acceleration = FVector(0.f, 0.f, -WorldGravityZ * GravityScale);
+		break;
+	default:
+		break;
+	}
+	return Params;
+}
+
+void AGravityVolume::GetOverlappingBodies(TArray<UPrimitiveComponent*>& OutBodies) const
+{
+	TArray<FOverlapResult> Overlaps;
+	GetWorld()->OverlapMultiByObjectType(
+		Overlaps,
+		Bounds->GetComponentLocation(),
+		Bounds->GetComponentQuat(),
+		FCollisionObjectQueryParams(ECollisionChannel::ECC_PhysicsBody),
+		FCollisionShape::MakeBox(Bounds->GetScaledBoxExtent()));
+
+	for (const FOverlapResult& Overlap : Overlaps)
+	{
+		UPrimitiveComponent* Component = Overlap.GetComponent();
+		if (Component && Component->IsSimulatingPhysics())
+		{
+			OutBodies.AddUnique(Component);
+		}
+	}
+}
@@ -0,0 +1,203 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "GravityVolumeManager.h"
+#include "GravityGunPlayground.h"
+#include "GravityGunProps.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+#include "PhysicsEngine/BodyInstance.h"
+#include "PhysicsPublic.h"
+
+DECLARE_CYCLE_STAT(TEXT("Gravity Volume Refresh"), STAT_GGPGravityVolumeRefresh, STATGROUP_GravityGun);
+DECLARE_CYCLE_STAT(TEXT("Gravity Volume Step"), STAT_GGPGravityVolumeStep, STATGROUP_GravityGun);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Gravity Volume Bodies"), STAT_GGPGravityVolumeBodies, STATGROUP_GravityGun);
+
+namespace GravityVolumes
+{
+	static float RefreshInterval = 0.2f;
+
+	static FAutoConsoleVariableRef CVarRefreshInterval(
+		TEXT("ggp.GravityVolume.RefreshInterval"),
+		RefreshInterval,
+		TEXT("Seconds between the overlap queries that find the bodies inside gravity volumes."));
+}
+
+// Sets default values
+AGravityVolumeManager::AGravityVolumeManager()
+{
+	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	PrimaryActorTick.bCanEverTick = true;
+	// The arrays read by the physics step are only written before physics starts
+	PrimaryActorTick.TickGroup = TG_PrePhysics;
+}
+
+AGravityVolumeManager* AGravityVolumeManager::Get(UWorld* World)
+{
+	if (AGravityVolumeManager* Manager = Find(World)) { return Manager; }
+	return World ? World->SpawnActor<AGravityVolumeManager>() : nullptr;
+}
+
+AGravityVolumeManager* AGravityVolumeManager::Find(UWorld* World)
+{
+	if (!World) { return nullptr; }
+
+	for (TActorIterator<AGravityVolumeManager> It(World); It; ++It)
+	{
+		if (!It->IsPendingKill())
+		{
+			return *It;
+		}
+	}
+	return nullptr;
+}
+
+// Called when the game starts or when spawned
+void AGravityVolumeManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (FPhysScene* PhysScene = GetWorld()->GetPhysicsScene())
+	{
+		PhysSceneStepHandle = PhysScene->OnPhysSceneStep.AddUObject(this, &AGravityVolumeManager::OnPhysSceneStep);
+	}
+}
+
+void AGravityVolumeManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (FPhysScene* PhysScene = GetWorld()->GetPhysicsScene())
+	{
+		PhysScene->OnPhysSceneStep.Remove(PhysSceneStepHandle);
+	}
+	ActiveBodies.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Called every frame
+void AGravityVolumeManager::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	TimeSinceRefresh += DeltaTime;
+	if (TimeSinceRefresh >= GravityVolumes::RefreshInterval)
+	{
+		TimeSinceRefresh = 0.f;
+		RefreshMembers();
+	}
+	BuildActiveBodies();
+}
+
+void AGravityVolumeManager::RegisterVolume(AGravityVolume* Volume)
+{
+	Volumes.AddUnique(Volume);
+
+	///Pick up the bodies that already are inside on the next frame
+	TimeSinceRefresh = GravityVolumes::RefreshInterval;
+}
+
+void AGravityVolumeManager::UnregisterVolume(AGravityVolume* Volume)
+{
+	Volumes.Remove(Volume);
+
+	///The physics step may be reading the params and bodies right now, they are only rebuilt before the next physics step.
+	///Until then the bodies keep the params of the removed volume, they are copies so the volume itself is never touched.
+	TimeSinceRefresh = GravityVolumes::RefreshInterval;
+}
+
+void AGravityVolumeManager::RefreshMembers()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GGPGravityVolumeRefresh);
+
+	Volumes.RemoveAll([](const AGravityVolume* Volume) { return !Volume || Volume->IsPendingKill(); });
+
+	///Visit the volumes from high to low priority, so the first volume that finds a body keeps it
+	Volumes.Sort([](const AGravityVolume& A, const AGravityVolume& B) { return A.GetPriority() > B.GetPriority(); });
+
+	const float GravityZ = GetWorld()->GetGravityZ();
+	VolumeParams.Reset();
+	Members.Reset();
+
+	TSet<UPrimitiveComponent*> Found;
+	TArray<UPrimitiveComponent*> Bodies;
+	for (int32 VolumeIndex = 0; VolumeIndex < Volumes.Num(); VolumeIndex++)
+	{
+		VolumeParams.Add(Volumes[VolumeIndex]->GetParams(GravityZ));
+
+		Bodies.Reset();
+		Volumes[VolumeIndex]->GetOverlappingBodies(Bodies);
+		for (UPrimitiveComponent* Body : Bodies)
+		{
+			bool bAlreadyFound = false;
+			Found.Add(Body, &bAlreadyFound);
+			if (!bAlreadyFound)
+			{
+				Members.Emplace(Body, VolumeIndex);
+			}
+		}
+	}
+}
+
+void AGravityVolumeManager::BuildActiveBodies()
+{
+	ActiveBodies.Reset();
+	if (Members.Num() == 0)
+	{
+		SET_DWORD_STAT(STAT_GGPGravityVolumeBodies, 0);
+		return;
+	}
+
+	///Held bodies follow the physicshandle, the volume would only fight it
+	TSet<UPrimitiveComponent*> HeldComponents;
+	FGravityGunProps::GetHeldComponents(GetWorld(), HeldComponents);
+
+	for (int32 MemberIndex = Members.Num() - 1; MemberIndex >= 0; MemberIndex--)
+	{
+		UPrimitiveComponent* Component = Members[MemberIndex].Key.Get();
+		if (!Component || Component->IsPendingKill() || !Component->IsSimulatingPhysics())
+		{
+			Members.RemoveAtSwap(MemberIndex);
+			continue;
+		}
+		if (HeldComponents.Contains(Component)) { continue; }
+
+		FGravityVolumeBody& Body = ActiveBodies.AddDefaulted_GetRef();
+		Body.BodyInstance = Component->GetBodyInstance();
+		Body.ParamsIndex = Members[MemberIndex].Value;
+	}
+	SET_DWORD_STAT(STAT_GGPGravityVolumeBodies, ActiveBodies.Num());
+}
+
+void AGravityVolumeManager::OnPhysSceneStep(FPhysScene* PhysScene, float DeltaTime)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GGPGravityVolumeStep);
+
+	for (const FGravityVolumeBody& Body : ActiveBodies)
+	{
+		///A component destroyed since the prephysics tick keeps its body instance memory until garbage collection, but not its physics actor
+		if (!Body.BodyInstance || !Body.BodyInstance->IsValidBodyInstance() || !VolumeParams.IsValidIndex(Body.ParamsIndex)) { continue; }
+		const FGravityVolumeParams& Params = VolumeParams[Body.ParamsIndex];
+
+		FVector Acceleration = Params.Acceleration;
+		if (Params.Mode == EGravityVolumeMode::Attractor && Params.AttractorRadius > 0.f)
+		{
+			///Uses the position of this substep, the scene is locked while the step delegate runs
+			const FVector ToCenter = Params.Center - Body.BodyInstance->GetUnrealWorldTransform_AssumesLocked().GetLocation();
+			const float Distance = ToCenter.Size();
+			const float Falloff = FMath::Clamp(1.f - Distance / Params.AttractorRadius, 0.f, 1.f);
+			Acceleration = ToCenter.GetSafeNormal() * Params.AttractorAcceleration * Falloff;
+		}
+
+		///A body without gravity has none to cancel, it would otherwise float up
+		if (Body.BodyInstance->bEnableGravity)
+		{
+			Acceleration += Params.GravityCancel;
+		}
+		if (Acceleration.IsZero()) { continue; }
+
+		///Applied directly to this substep instead of being spread over the substeps of the frame
+		Body.BodyInstance->AddForce(Acceleration, false, true);
+	}
+}
@@ -0,0 +1,304 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "HitscanBatch.h"
+#include "GravityGunPlayground.h"
+#include "GravityGunLatency.h"
+#include "GravityGunPlaygroundCharacter.h"
+#include "GravityGunPlaygroundProjectile.h"
+#include "GravityPropActor.h"
+#include "ImpulseCoalescer.h"
+#include "Async/ParallelFor.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Hitscan Resolve"), STAT_GGPHitscanResolve, STATGROUP_GravityGun);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Hitscan Shots"), STAT_GGPHitscanShots, STATGROUP_GravityGun);
+
+namespace HitscanBatches
+{
+	static int32 ParallelThreshold = 8;
+
+	static FAutoConsoleVariableRef CVarParallelThreshold(
+		TEXT("ggp.Hitscan.ParallelThreshold"),
+		ParallelThreshold,
+		TEXT("Smallest number of hitscan shots in a frame that are traced in parallel. Smaller batches are traced on the game thread."));
+
+	//Collision profile of the projectiles, so hitscan shots are blocked by the same things
+	static const FName ShotProfile(TEXT("Projectile"));
+
+	static void BenchCommand(const TArray<FString>& Args, UWorld* World)
+	{
+		AHitscanBatch* Batch = AHitscanBatch::Get(World);
+		if (!Batch) { return; }
+
+		const int32 NumPlayers = Args.Num() > 0 ? FCString::Atoi(*Args[0]) : 16;
+		const float ShotsPerSecond = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 20.f;
+		const float PhaseSeconds = Args.Num() > 2 ? FCString::Atof(*Args[2]) : 5.f;
+
+		///Fire the projectiles the player would fire
+		TSubclassOf<AGravityGunPlaygroundProjectile> ProjectileClass = AGravityGunPlaygroundProjectile::StaticClass();
+		APlayerController* PlayerController = World->GetFirstPlayerController();
+		AGravityGunPlaygroundCharacter* Character = PlayerController ? Cast<AGravityGunPlaygroundCharacter>(PlayerController->GetPawn()) : nullptr;
+		if (Character && Character->ProjectileClass)
+		{
+			ProjectileClass = Character->ProjectileClass;
+		}
+
+		Batch->StartBenchmark(FMath::Max(NumPlayers, 1), FMath::Max(ShotsPerSecond, 0.1f), FMath::Max(PhaseSeconds, 1.f), ProjectileClass);
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs BenchConsoleCommand(
+		TEXT("ggp.Hitscan.Bench"),
+		TEXT("Compares the game thread time of batched hitscan, per shot hitscan and projectile shots. Usage: ggp.Hitscan.Bench [Players=16] [ShotsPerSecond=20] [PhaseSeconds=5]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchCommand));
+}
+
+// Sets default values
+AHitscanBatch::AHitscanBatch()
+{
+	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>("Root");
+}
+
+AHitscanBatch* AHitscanBatch::Get(UWorld* World)
+{
+	if (!World) { return nullptr; }
+
+	for (TActorIterator<AHitscanBatch> It(World); It; ++It)
+	{
+		if (!It->IsPendingKill())
+		{
+			return *It;
+		}
+	}
+	return World->SpawnActor<AHitscanBatch>();
+}
+
+float AHitscanBatch::GetProjectileSpeed(TSubclassOf<AGravityGunPlaygroundProjectile> ProjectileClass)
+{
+	const AGravityGunPlaygroundProjectile* Projectile = ProjectileClass ? ProjectileClass->GetDefaultObject<AGravityGunPlaygroundProjectile>() : nullptr;
+	if (!Projectile || !Projectile->GetProjectileMovement()) { return 3000.f; }
+
+	return Projectile->GetProjectileMovement()->InitialSpeed;
+}
+
+// Called every frame
+void AHitscanBatch::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	TickBenchmark(DeltaTime);
+	ResolveShots();
+}
+
+void AHitscanBatch::QueueShot(const FHitscanShot& Shot)
+{
+	QueuedShots.Add(Shot);
+}
+
+void AHitscanBatch::ResolveShots()
+{
+	SET_DWORD_STAT(STAT_GGPHitscanShots, QueuedShots.Num());
+	if (QueuedShots.Num() == 0) { return; }
+
+	SCOPE_CYCLE_COUNTER(STAT_GGPHitscanResolve);
+	const double StartSeconds = FPlatformTime::Seconds();
+
+	///Resolve the shooters on the game thread, the traces only read the snapshot
+	const int32 NumShots = QueuedShots.Num();
+	IgnoredActors.SetNumUninitialized(NumShots);
+	for (int32 Index = 0; Index < NumShots; Index++)
+	{
+		IgnoredActors[Index] = QueuedShots[Index].Shooter.Get();
+	}
+	Hits.Reset();
+	Hits.SetNum(NumShots);
+
+	UWorld* World = GetWorld();
+	ParallelFor(NumShots, [this, World](int32 Index)
+	{
+		const FHitscanShot& Shot = QueuedShots[Index];
+		FCollisionQueryParams QueryParams(FName(TEXT("Hitscan")), false, IgnoredActors[Index]);
+		World->LineTraceSingleByProfile(Hits[Index], Shot.Start, Shot.Start + Shot.Direction * Shot.Range, HitscanBatches::ShotProfile, QueryParams);
+	}, NumShots < HitscanBatches::ParallelThreshold);
+
+	///Same rule as a projectile hit: only physics objects are pushed, with the impulses of all shots on a body applied together
+	AImpulseCoalescer* Coalescer = AImpulseCoalescer::Get(World);
+	for (int32 Index = 0; Index < NumShots; Index++)
+	{
+		const FHitscanShot& Shot = QueuedShots[Index];
+		const FHitResult& Hit = Hits[Index];
+		UPrimitiveComponent* HitComponent = Hit.GetComponent();
+		if (Hit.bBlockingHit && HitComponent && HitComponent->IsSimulatingPhysics() && Coalescer)
+		{
+			Coalescer->AddImpulseAtLocation(HitComponent, Shot.Direction * Shot.Speed * 100.f, Hit.ImpactPoint);
+			AGravityPropActor::NotifyActivity(Hit.GetActor());
+		}
+
+		const APawn* Shooter = Cast<APawn>(IgnoredActors[Index]);
+		if (Shooter && Shooter->IsLocallyControlled())
+		{
+			FGravityGunLatency::MarkEffect(EGravityGunLatencyAction::Fire);
+		}
+	}
+
+	QueuedShots.Reset();
+
+	if (BenchmarkPhase != EBenchmarkPhase::None)
+	{
+		PhaseResolveMs += (FPlatformTime::Seconds() - StartSeconds) * 1000.0;
+	}
+}
+
+void AHitscanBatch::StartBenchmark(int32 NumPlayers, float ShotsPerSecond, float PhaseSeconds, TSubclassOf<AGravityGunPlaygroundProjectile> ProjectileClass)
+{
+	BenchmarkPlayers = NumPlayers;
+	BenchmarkShotsPerSecond = ShotsPerSecond;
+	BenchmarkPhaseSeconds = PhaseSeconds;
+	BenchmarkProjectileClass = ProjectileClass;
+	FMemory::Memzero(BenchmarkMs);
+	FMemory::Memzero(BenchmarkResolveMs);
+	FMemory::Memzero(BenchmarkShots);
+
+	UE_LOG(LogGravityGun, Display, TEXT("Hitscan benchmark: %d players at %.1f shots/s, %.1f seconds per phase"), NumPlayers, ShotsPerSecond, PhaseSeconds);
+	StartBenchmarkPhase(EBenchmarkPhase::Baseline);
+}
+
+void AHitscanBatch::StartBenchmarkPhase(EBenchmarkPhase Phase)
+{
+	BenchmarkPhase = Phase;
+	PhaseTime = 0.f;
+	ShotAccumulator = 0.f;
+	PhaseShots = 0;
+	PhaseFrames = 0;
+	PhaseGameThreadMs = 0.0;
+	PhaseResolveMs = 0.0;
+}
+
+void AHitscanBatch::TickBenchmark(float DeltaTime)
+{
+	if (BenchmarkPhase == EBenchmarkPhase::None) { return; }
+
+	///The game thread time of the previous frame, which includes the shots fired and resolved in it
+	if (PhaseTime > 0.f)
+	{
+		PhaseGameThreadMs += FPlatformTime::ToMilliseconds(GGameThreadTime);
+		PhaseFrames++;
+	}
+	PhaseTime += DeltaTime;
+
+	if (PhaseTime >= BenchmarkPhaseSeconds)
+	{
+		const int32 PhaseIndex = (int32)BenchmarkPhase;
+		BenchmarkMs[PhaseIndex] = PhaseFrames > 0 ? PhaseGameThreadMs / PhaseFrames : 0.0;
+		BenchmarkResolveMs[PhaseIndex] = PhaseResolveMs;
+		BenchmarkShots[PhaseIndex] = PhaseShots;
+
+		switch (BenchmarkPhase)
+		{
+		case EBenchmarkPhase::Baseline:
+			StartBenchmarkPhase(EBenchmarkPhase::Hitscan);
+			break;
+		case EBenchmarkPhase::Hitscan:
+			StartBenchmarkPhase(EBenchmarkPhase::HitscanPerShot);
+			break;
+		case EBenchmarkPhase::HitscanPerShot:
+			StartBenchmarkPhase(EBenchmarkPhase::Projectile);
+			break;
+		default:
+			FinishBenchmark();
+			break;
+		}
+		return;
+	}
+
+	if (BenchmarkPhase == EBenchmarkPhase::Baseline) { return; }
+
+	ShotAccumulator += DeltaTime * BenchmarkPlayers * BenchmarkShotsPerSecond;
+	while (ShotAccumulator >= 1.f)
+	{
+		FireBenchmarkShot();
+		ShotAccumulator -= 1.f;
+	}
+}
+
+void AHitscanBatch::FireBenchmarkShot()
+{
+	APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	const APawn* Pawn = PlayerController ? PlayerController->GetPawn() : nullptr;
+	const FVector Center = Pawn ? Pawn->GetActorLocation() : FVector::ZeroVector;
+
+	///Every shooter stands on a ring around the player and fires outwards
+	const int32 Shooter = NextBenchmarkShooter;
+	NextBenchmarkShooter = (NextBenchmarkShooter + 1) % BenchmarkPlayers;
+	const FRotator MuzzleRotation(-5.f, 360.f * Shooter / BenchmarkPlayers, 0.f);
+	const FVector MuzzleLocation = Center + MuzzleRotation.Vector() * 300.f + FVector(0.f, 0.f, 50.f);
+
+	if (BenchmarkPhase == EBenchmarkPhase::Hitscan || BenchmarkPhase == EBenchmarkPhase::HitscanPerShot)
+	{
+		FHitscanShot Shot;
+		Shot.Start = MuzzleLocation;
+		Shot.Direction = MuzzleRotation.Vector();
+		Shot.Range = 10000.f;
+		Shot.Speed = GetProjectileSpeed(BenchmarkProjectileClass);
+		QueueShot(Shot);
+
+		///Without batching every shot is traced and applied on its own as it is fired
+		if (BenchmarkPhase == EBenchmarkPhase::HitscanPerShot)
+		{
+			ResolveShots();
+		}
+	}
+	else
+	{
+		FActorSpawnParameters SpawnParams;
+		SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+		GetWorld()->SpawnActor<AGravityGunPlaygroundProjectile>(BenchmarkProjectileClass, MuzzleLocation, MuzzleRotation, SpawnParams);
+	}
+	PhaseShots++;
+}
+
+void AHitscanBatch::FinishBenchmark()
+{
+	BenchmarkPhase = EBenchmarkPhase::None;
+
+	const double BaselineMs = BenchmarkMs[(int32)EBenchmarkPhase::Baseline];
+	UE_LOG(LogGravityGun, Display, TEXT("Hitscan benchmark: baseline %.3f ms game thread per frame"), BaselineMs);
+
+	const EBenchmarkPhase ShotPhases[] = { EBenchmarkPhase::Hitscan, EBenchmarkPhase::HitscanPerShot, EBenchmarkPhase::Projectile };
+	const TCHAR* ShotPhaseNames[] = { TEXT("batched hitscan"), TEXT("per shot hitscan"), TEXT("projectile") };
+	for (int32 Index = 0; Index < ARRAY_COUNT(ShotPhases); Index++)
+	{
+		const int32 PhaseIndex = (int32)ShotPhases[Index];
+		const int32 NumShots = BenchmarkShots[PhaseIndex];
+		if (ShotPhases[Index] == EBenchmarkPhase::Projectile)
+		{
+			UE_LOG(LogGravityGun, Display, TEXT("Hitscan benchmark: %s %.3f ms (+%.3f ms), %d shots"),
+				ShotPhaseNames[Index], BenchmarkMs[PhaseIndex], BenchmarkMs[PhaseIndex] - BaselineMs, NumShots);
+			continue;
+		}
+
+		const double ResolveUsPerShot = NumShots > 0 ? BenchmarkResolveMs[PhaseIndex] * 1000.0 / NumShots : 0.0;
+		UE_LOG(LogGravityGun, Display, TEXT("Hitscan benchmark: %s %.3f ms (+%.3f ms), %d shots, resolve %.2f us per shot"),
+			ShotPhaseNames[Index], BenchmarkMs[PhaseIndex], BenchmarkMs[PhaseIndex] - BaselineMs, NumShots, ResolveUsPerShot);
+	}
+
+	///Batched against per shot resolve, the difference the batching makes
+	const double BatchedMs = BenchmarkMs[(int32)EBenchmarkPhase::Hitscan];
+	const double PerShotMs = BenchmarkMs[(int32)EBenchmarkPhase::HitscanPerShot];
+	const int32 BatchedShots = BenchmarkShots[(int32)EBenchmarkPhase::Hitscan];
+	const int32 PerShotShots = BenchmarkShots[(int32)EBenchmarkPhase::HitscanPerShot];
+	const double BatchedResolveMs = BatchedShots > 0 ? BenchmarkResolveMs[(int32)EBenchmarkPhase::Hitscan] / BatchedShots : 0.0;
+	const double PerShotResolveMs = PerShotShots > 0 ? BenchmarkResolveMs[(int32)EBenchmarkPhase::HitscanPerShot] / PerShotShots : 0.0;
+	UE_LOG(LogGravityGun, Display, TEXT("Hitscan benchmark: batched saves %.3f ms game thread per frame, resolve is %.2fx faster than per shot"),
+		PerShotMs - BatchedMs, BatchedResolveMs > 0.0 ? PerShotResolveMs / BatchedResolveMs : 0.0);
+}
@@ -0,0 +1,238 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ImpulseCoalescer.h"
+#include "GravityGunPlayground.h"
+#include "BreakablePropComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Impulse Apply"), STAT_GGPImpulseApply, STATGROUP_GravityGun);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Impulses Queued"), STAT_GGPImpulsesQueued, STATGROUP_GravityGun);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Impulse Bodies"), STAT_GGPImpulseBodies, STATGROUP_GravityGun);
+DECLARE_DWORD_COUNTER_STAT(TEXT("In Flight Bodies"), STAT_GGPInFlightBodies, STATGROUP_GravityGun);
+
+namespace ImpulseCoalescing
+{
+	static int32 bCoalesce = 1;
+	static float NotifySpeed = 150.f;
+
+	static FAutoConsoleVariableRef CVarCoalesce(
+		TEXT("ggp.Impulse.Coalesce"),
+		bCoalesce,
+		TEXT("1: impulses of shots are summed per body and applied once at the end of the frame.\n")
+		TEXT("0: every impulse is applied when it is queued."));
+
+	static FAutoConsoleVariableRef CVarNotifySpeed(
+		TEXT("ggp.Impulse.NotifySpeed"),
+		NotifySpeed,
+		TEXT("Speed in cm/s below which a launched or pushed prop stops reporting its hits."));
+
+	//Seconds a body reports hits at least, so the flight doesn't end before its impulse took effect
+	static const float MinimumFlightSeconds = 0.2f;
+}
+
+// Sets default values
+AImpulseCoalescer::AImpulseCoalescer()
+{
+	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	PrimaryActorTick.bCanEverTick = true;
+	///After the post-physics systems queued their impulses, applied before the next simulation
+	PrimaryActorTick.TickGroup = TG_PostUpdateWork;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>("Root");
+}
+
+AImpulseCoalescer* AImpulseCoalescer::Get(UWorld* World)
+{
+	if (!World) { return nullptr; }
+
+	for (TActorIterator<AImpulseCoalescer> It(World); It; ++It)
+	{
+		if (!It->IsPendingKill())
+		{
+			return *It;
+		}
+	}
+	return World->SpawnActor<AImpulseCoalescer>();
+}
+
+void AImpulseCoalescer::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	for (const TPair<TWeakObjectPtr<UPrimitiveComponent>, FInFlightBody>& InFlightBody : InFlightBodies)
+	{
+		if (UPrimitiveComponent* Body = InFlightBody.Key.Get())
+		{
+			EndFlight(Body, InFlightBody.Value);
+		}
+	}
+	InFlightBodies.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Called every frame
+void AImpulseCoalescer::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	ApplyImpulses();
+	UpdateBreakableBodies();
+	UpdateInFlightBodies();
+}
+
+void AImpulseCoalescer::AddImpulseAtLocation(UPrimitiveComponent* Body, const FVector& Impulse, const FVector& Location)
+{
+	if (!Body || !Body->IsSimulatingPhysics()) { return; }
+
+	if (!ImpulseCoalescing::bCoalesce)
+	{
+		Body->AddImpulseAtLocation(Impulse, Location);
+		NotifyInFlight(Body);
+		return;
+	}
+
+	const int32* ExistingIndex = PendingIndices.Find(Body);
+	const int32 Index = ExistingIndex ? *ExistingIndex : PendingIndices.Add(Body, PendingImpulses.AddDefaulted());
+	if (!ExistingIndex)
+	{
+		PendingImpulses[Index].Body = Body;
+	}
+
+	///An impulse at a location is the same impulse through the center of mass plus its torque around it
+	FPendingImpulse& Pending = PendingImpulses[Index];
+	Pending.LinearImpulse += Impulse;
+	Pending.AngularImpulse += FVector::CrossProduct(Location - Body->GetCenterOfMass(), Impulse);
+	NumQueuedImpulses++;
+}
+
+void AImpulseCoalescer::ApplyImpulses()
+{
+	SET_DWORD_STAT(STAT_GGPImpulsesQueued, NumQueuedImpulses);
+	SET_DWORD_STAT(STAT_GGPImpulseBodies, PendingImpulses.Num());
+	if (PendingImpulses.Num() == 0) { return; }
+
+	SCOPE_CYCLE_COUNTER(STAT_GGPImpulseApply);
+
+	for (const FPendingImpulse& Pending : PendingImpulses)
+	{
+		UPrimitiveComponent* Body = Pending.Body.Get();
+		if (!Body || !Body->IsSimulatingPhysics()) { continue; }
+
+		Body->AddImpulse(Pending.LinearImpulse);
+		if (!Pending.AngularImpulse.IsNearlyZero())
+		{
+			Body->AddAngularImpulseInRadians(Pending.AngularImpulse);
+		}
+		NotifyInFlight(Body);
+	}
+
+	PendingImpulses.Reset();
+	PendingIndices.Reset();
+	NumQueuedImpulses = 0;
+}
+
+void AImpulseCoalescer::NotifyInFlight(UPrimitiveComponent* Body)
+{
+	if (!Body || !Body->IsSimulatingPhysics()) { return; }
+
+	const float Time = GetWorld()->GetTimeSeconds();
+	if (FInFlightBody* InFlightBody = InFlightBodies.Find(Body))
+	{
+		InFlightBody->StartTime = Time;
+		return;
+	}
+
+	FInFlightBody& InFlightBody = InFlightBodies.Add(Body);
+	InFlightBody.StartTime = Time;
+	InFlightBody.bHadNotify = Body->BodyInstance.bNotifyRigidBodyCollision;
+
+	Body->SetNotifyRigidBodyCollision(true);
+	Body->OnComponentHit.AddUniqueDynamic(this, &AImpulseCoalescer::OnInFlightHit);
+}
+
+void AImpulseCoalescer::WatchBreakable(UPrimitiveComponent* Body)
+{
+	if (Body)
+	{
+		BreakableBodies.AddUnique(Body);
+	}
+}
+
+void AImpulseCoalescer::UpdateBreakableBodies()
+{
+	const float NotifySpeedSquared = FMath::Square(ImpulseCoalescing::NotifySpeed);
+	for (int32 Index = BreakableBodies.Num() - 1; Index >= 0; Index--)
+	{
+		UPrimitiveComponent* Body = BreakableBodies[Index].Get();
+		if (!Body)
+		{
+			BreakableBodies.RemoveAtSwap(Index);
+			continue;
+		}
+
+		///Resting breakables cost one awake check, the hit notifications are only enabled while they move
+		if (InFlightBodies.Contains(Body) || !Body->IsSimulatingPhysics() || !Body->RigidBodyIsAwake()) { continue; }
+		if (Body->GetPhysicsLinearVelocity().SizeSquared() >= NotifySpeedSquared)
+		{
+			NotifyInFlight(Body);
+		}
+	}
+}
+
+bool AImpulseCoalescer::IsInFlight(UPrimitiveComponent* Body) const
+{
+	return Body && InFlightBodies.Contains(Body);
+}
+
+void AImpulseCoalescer::UpdateInFlightBodies()
+{
+	SET_DWORD_STAT(STAT_GGPInFlightBodies, InFlightBodies.Num());
+
+	const float Time = GetWorld()->GetTimeSeconds();
+	const float NotifySpeedSquared = FMath::Square(ImpulseCoalescing::NotifySpeed);
+	for (auto It = InFlightBodies.CreateIterator(); It; ++It)
+	{
+		UPrimitiveComponent* Body = It.Key().Get();
+		if (!Body)
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+		if (Time - It.Value().StartTime < ImpulseCoalescing::MinimumFlightSeconds) { continue; }
+
+		const bool bSlow = !Body->IsSimulatingPhysics() || !Body->RigidBodyIsAwake() || Body->GetPhysicsLinearVelocity().SizeSquared() < NotifySpeedSquared;
+		if (bSlow)
+		{
+			EndFlight(Body, It.Value());
+			It.RemoveCurrent();
+		}
+	}
+}
+
+void AImpulseCoalescer::EndFlight(UPrimitiveComponent* Body, const FInFlightBody& InFlightBody)
+{
+	Body->OnComponentHit.RemoveDynamic(this, &AImpulseCoalescer::OnInFlightHit);
+	if (!InFlightBody.bHadNotify)
+	{
+		Body->SetNotifyRigidBodyCollision(false);
+	}
+}
+
+void AImpulseCoalescer::OnInFlightHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
+{
+	///Props at rest don't report hits, so the breakable prop that was hit is told by the prop in flight
+	if (UBreakablePropComponent* Breakable = HitComponent->GetOwner()->FindComponentByClass<UBreakablePropComponent>())
+	{
+		Breakable->HandleImpact(HitComponent, NormalImpulse, Hit.ImpactPoint);
+	}
+	if (OtherActor && OtherComp && OtherActor != HitComponent->GetOwner())
+	{
+		if (UBreakablePropComponent* OtherBreakable = OtherActor->FindComponentByClass<UBreakablePropComponent>())
+		{
+			OtherBreakable->HandleImpact(OtherComp, NormalImpulse, Hit.ImpactPoint);
+		}
+	}
+}
@@ -0,0 +1,251 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "LaunchPreviewComponent.h"
+#include "GravityGunPlayground.h"
+#include "AimQueryComponent.h"
+#include "ObjectGrabberComponent.h"
+#include "ObjectLauncherComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "DrawDebugHelpers.h"
+#include "Engine/World.h"
+#include "GameFramework/Pawn.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Launch Preview Start"), STAT_GGPLaunchPreviewStart, STATGROUP_GravityGun);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Launch Preview Sweeps"), STAT_GGPLaunchPreviewSweeps, STATGROUP_GravityGun);
+
+namespace LaunchPreviews
+{
+	static int32 bDraw = 0;
+
+	static FAutoConsoleVariableRef CVarDraw(
+		TEXT("ggp.LaunchPreview.Draw"),
+		bDraw,
+		TEXT("If 1, the predicted launch path of held actors is drawn with debug lines."));
+}
+
+// Sets default values for this component's properties
+ULaunchPreviewComponent::ULaunchPreviewComponent()
+{
+	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
+	// off to improve performance if you don't need them.
+	PrimaryComponentTick.bCanEverTick = true;
+}
+
+// Called when the game starts
+void ULaunchPreviewComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	ObjectGrabber = GetOwner()->FindComponentByClass<UObjectGrabberComponent>();
+	ObjectLauncher = GetOwner()->FindComponentByClass<UObjectLauncherComponent>();
+	TimeSinceRefresh = RefreshInterval;
+
+	///Nobody looks at the preview on a dedicated server
+	if (GetNetMode() == NM_DedicatedServer)
+	{
+		SetComponentTickEnabled(false);
+	}
+}
+
+void ULaunchPreviewComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	ClearPrediction();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Called every frame
+void ULaunchPreviewComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	///Only the player carrying the gun sees the preview
+	if (!ObjectGrabber || !ObjectLauncher || !IsLocallyCarried())
+	{
+		ClearPrediction();
+		return;
+	}
+	CollectPrediction();
+
+	///Only held actors are previewed, they are launched with their root component
+	AActor* HeldActor = nullptr;
+	UPrimitiveComponent* HeldComponent = ObjectGrabber->GetGrabbedActor(HeldActor) ? Cast<UPrimitiveComponent>(HeldActor->GetRootComponent()) : nullptr;
+	if (!HeldComponent)
+	{
+		ClearPrediction();
+		return;
+	}
+
+	UAimQueryComponent* AimQuery = UAimQueryComponent::FindOrAddForActor(GetOwner());
+	if (!AimQuery) { return; }
+	const FRotator Aim = AimQuery->GetAim().ViewRotation;
+
+	TimeSinceRefresh += DeltaTime;
+	if (PendingSweeps.Num() == 0 && TimeSinceRefresh >= RefreshInterval && NeedsRefresh(HeldComponent, Aim))
+	{
+		StartPrediction(HeldComponent, Aim);
+		TimeSinceRefresh = 0.f;
+	}
+
+	DrawPrediction();
+}
+
+bool ULaunchPreviewComponent::GetPredictedImpact(FVector& OutLocation) const
+{
+	if (!bHasPrediction || !Prediction.bHit) { return false; }
+	OutLocation = Prediction.HitLocation;
+	return true;
+}
+
+ULaunchPreviewComponent* ULaunchPreviewComponent::FindForCarrier(const APawn* Carrier)
+{
+	if (!Carrier) { return nullptr; }
+
+	TArray<AActor*> AttachedActors;
+	Carrier->GetAttachedActors(AttachedActors);
+	for (AActor* Attached : AttachedActors)
+	{
+		if (ULaunchPreviewComponent* LaunchPreview = Attached->FindComponentByClass<ULaunchPreviewComponent>())
+		{
+			return LaunchPreview;
+		}
+	}
+	return nullptr;
+}
+
+bool ULaunchPreviewComponent::IsLocallyCarried() const
+{
+	const APawn* Carrier = Cast<APawn>(GetOwner()->GetAttachParentActor());
+	return Carrier && Carrier->IsLocallyControlled();
+}
+
+bool ULaunchPreviewComponent::NeedsRefresh(UPrimitiveComponent* HeldComponent, const FRotator& Aim) const
+{
+	if (PredictedComponent.Get() != HeldComponent) { return true; }
+
+	const float AimDelta = FMath::RadiansToDegrees(Aim.Quaternion().AngularDistance(PredictedAim.Quaternion()));
+	if (AimDelta > AimThresholdDegrees) { return true; }
+
+	return FVector::DistSquared(HeldComponent->Bounds.Origin, PredictedStart) > FMath::Square(MoveThreshold);
+}
+
+void ULaunchPreviewComponent::StartPrediction(UPrimitiveComponent* HeldComponent, const FRotator& Aim)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GGPLaunchPreviewStart);
+
+	const FVector Start = HeldComponent->Bounds.Origin;
+	const FVector Gravity(0.f, 0.f, HeldComponent->IsGravityEnabled() ? GetWorld()->GetGravityZ() : 0.f);
+	const float StepTime = FMath::Max(SimStepTime, 0.005f);
+	const int32 NumSteps = FMath::CeilToInt(MaxSimTime / StepTime);
+
+	///The arc itself is cheap, only the sweeps along it are deferred
+	FVector Position = Start;
+	FVector Velocity = ObjectLauncher->PredictLaunchVelocity(HeldComponent, Aim.Vector());
+	PendingPath.Reset(NumSteps + 1);
+	PendingPath.Add(Position);
+	for (int32 Step = 0; Step < NumSteps; Step++)
+	{
+		Position += Velocity * StepTime + 0.5f * Gravity * FMath::Square(StepTime);
+		Velocity += Gravity * StepTime;
+		PendingPath.Add(Position);
+	}
+
+	FCollisionObjectQueryParams ObjectParams;
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldStatic);
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldDynamic);
+	ObjectParams.AddObjectTypesToQuery(ECC_PhysicsBody);
+
+	///Geometry the held actor already touches, like the floor below it or the room around it, only blocks the path once it's moved into
+	FCollisionQueryParams QueryParams(FName(TEXT("LaunchPreview")), false, GetOwner());
+	QueryParams.bFindInitialOverlaps = false;
+	QueryParams.AddIgnoredActor(HeldComponent->GetOwner());
+	if (AActor* Carrier = GetOwner()->GetAttachParentActor())
+	{
+		QueryParams.AddIgnoredActor(Carrier);
+	}
+
+	const FCollisionShape Shape = FCollisionShape::MakeSphere(HeldComponent->Bounds.BoxExtent.GetMin());
+	PendingSweeps.Reset(NumSteps);
+	for (int32 Step = 0; Step < NumSteps; Step++)
+	{
+		PendingSweeps.Add(GetWorld()->AsyncSweepByObjectType(EAsyncTraceType::Single, PendingPath[Step], PendingPath[Step + 1], FQuat::Identity, ObjectParams, Shape, QueryParams));
+	}
+	INC_DWORD_STAT_BY(STAT_GGPLaunchPreviewSweeps, NumSteps);
+
+	PredictedComponent = HeldComponent;
+	PredictedAim = Aim;
+	PredictedStart = Start;
+}
+
+void ULaunchPreviewComponent::CollectPrediction()
+{
+	if (PendingSweeps.Num() == 0) { return; }
+
+	///All sweeps were started in the same frame, so they finish together
+	FTraceDatum Datum;
+	if (!GetWorld()->QueryTraceData(PendingSweeps.Last(), Datum))
+	{
+		///Results are only kept for one frame, if that frame was missed they are gone and a new prediction has to be started
+		if (!GetWorld()->IsTraceHandleValid(PendingSweeps.Last(), false))
+		{
+			PendingSweeps.Reset();
+			PendingPath.Reset();
+			PredictedComponent.Reset();
+			TimeSinceRefresh = RefreshInterval;
+		}
+		return;
+	}
+
+	///The held actor may have been released or launched while the sweeps were running
+	if (PredictedComponent.IsValid())
+	{
+		Prediction = FLaunchPreviewResult();
+		Prediction.Path.Add(PendingPath[0]);
+		for (int32 Step = 0; Step < PendingSweeps.Num(); Step++)
+		{
+			if (GetWorld()->QueryTraceData(PendingSweeps[Step], Datum) && Datum.OutHits.Num() > 0 && Datum.OutHits[0].bBlockingHit)
+			{
+				Prediction.bHit = true;
+				Prediction.HitLocation = Datum.OutHits[0].Location;
+				Prediction.Path.Add(Prediction.HitLocation);
+				break;
+			}
+			Prediction.Path.Add(PendingPath[Step + 1]);
+		}
+		bHasPrediction = true;
+	}
+	PendingSweeps.Reset();
+	PendingPath.Reset();
+}
+
+void ULaunchPreviewComponent::ClearPrediction()
+{
+	Prediction = FLaunchPreviewResult();
+	bHasPrediction = false;
+	PredictedComponent.Reset();
+
+	///Results of sweeps still in flight are dropped with their handles
+	PendingSweeps.Reset();
+	PendingPath.Reset();
+
+	///Predict right away on the next grab
+	TimeSinceRefresh = RefreshInterval;
+}
+
+void ULaunchPreviewComponent::DrawPrediction() const
+{
+#if ENABLE_DRAW_DEBUG
+	if (!LaunchPreviews::bDraw || !bHasPrediction) { return; }
+
+	for (int32 Index = 1; Index < Prediction.Path.Num(); Index++)
+	{
+		DrawDebugLine(GetWorld(), Prediction.Path[Index - 1], Prediction.Path[Index], FColor::Cyan);
+	}
+	if (Prediction.bHit)
+	{
+		DrawDebugSphere(GetWorld(), Prediction.HitLocation, 12.f, 8, FColor::Red);
+	}
+#endif
+}
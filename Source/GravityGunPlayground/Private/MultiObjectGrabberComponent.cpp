@@ -0,0 +1,464 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "MultiObjectGrabberComponent.h"
+#include "GravityGunPlayground.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "GravityGunMemory.h"
+#include "GravityGunProps.h"
+#include "GravityGunTelemetry.h"
+#include "GravityGunLatency.h"
+#include "GravityGunMathConversions.h"
+#include "PropRewindComponent.h"
+#include "AimQueryComponent.h"
+#include "GravityPropActor.h"
+#include "GravityGunEvents.h"
+#include "ImpulseCoalescer.h"
+
+DECLARE_CYCLE_STAT(TEXT("Multi Grab Update"), STAT_GGPMultiGrabUpdate, STATGROUP_GravityGun);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Multi Grab Held Actors"), STAT_GGPMultiGrabHeld, STATGROUP_GravityGun);
+
+// Sets default values for this component's properties
+UMultiObjectGrabberComponent::UMultiObjectGrabberComponent()
+{
+	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
+	// off to improve performance if you don't need them.
+	PrimaryComponentTick.bCanEverTick = true;
+
+	///The drive velocities are set before physics, so they're simulated in the same frame
+	PrimaryComponentTick.TickGroup = TG_PrePhysics;
+}
+
+// Called when the game starts
+void UMultiObjectGrabberComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	RewindComponent = GetOwner()->FindComponentByClass<UPropRewindComponent>();
+
+	TrackedMemoryBytes = GetClass()->GetStructureSize();
+	FGravityGunMemory::TrackAllocation(EGravityGunMemoryCategory::GrabLaunch, TrackedMemoryBytes);
+}
+
+void UMultiObjectGrabberComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	while (HeldComponents.Num() > 0)
+	{
+		RemoveHeldComponent(HeldComponents.Num() - 1, false);
+	}
+
+	FGravityGunMemory::TrackFree(EGravityGunMemoryCategory::GrabLaunch, TrackedMemoryBytes);
+	TrackedMemoryBytes = 0;
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Called every frame
+void UMultiObjectGrabberComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (HeldComponents.Num() == 0) { return; }
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::GrabLaunch);
+
+	///Check if the owning actor is attached to a parent (E.g the gun is equipped).
+	///If not, release the held group.
+	if (!GetOwner()->GetAttachParentActor())
+	{
+		FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::ForceReleaseDetached, GetOwner()->GetActorLocation(), HeldComponents.Num());
+		ReleaseActors();
+		return;
+	}
+
+	UpdateViewportValues(true);
+	UpdateHeldComponents();
+}
+
+void UMultiObjectGrabberComponent::ToggleGrabActors()
+{
+	if (HeldComponents.Num() > 0)
+	{
+		ReleaseActors();
+	}
+	else
+	{
+		GrabActors();
+	}
+}
+
+void UMultiObjectGrabberComponent::GrabActors()
+{
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::GrabLaunch);
+
+	///Not enough time has passed since the most recent release
+	if (!GrabCooldown.HasReloaded(GetWorld()))
+	{
+		FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::GrabCooldownRejected, ViewportLocation, GrabCooldown.GetRemainingSeconds(GetWorld()));
+		return;
+	}
+
+	///Already holding a group
+	if (HeldComponents.Num() > 0) { return; }
+
+	UpdateViewportValues(false);
+	if (!AimQuery) { return; }
+
+	const FHitResult Hit = AimQuery->GetHitWithinRange(GrabRange, true);
+	if (!Hit.GetActor()) { return; }
+
+	///Scoop the props around the aimed point, the aimed actor is the nearest one
+	FCollisionObjectQueryParams ObjectParams;
+	ObjectParams.AddObjectTypesToQuery(ECC_PhysicsBody);
+	FCollisionQueryParams QueryParams(FName(TEXT("MultiGrab")), false, GetOwner());
+	if (AActor* Carrier = GetOwner()->GetAttachParentActor())
+	{
+		QueryParams.AddIgnoredActor(Carrier);
+	}
+
+	TArray<FOverlapResult> Overlaps;
+	GetWorld()->OverlapMultiByObjectType(Overlaps, Hit.ImpactPoint, FQuat::Identity, ObjectParams, FCollisionShape::MakeSphere(ScoopRadius), QueryParams);
+
+	TArray<UPrimitiveComponent*> Candidates;
+	for (const FOverlapResult& Overlap : Overlaps)
+	{
+		UPrimitiveComponent* Prop = FGravityGunProps::GetPropComponent(Overlap.GetActor());
+		if (Prop && !Candidates.Contains(Prop) && !FGravityGunProps::IsHeld(Prop) && !FGravityGunProps::IsCarrierTouching(GetOwner(), Prop->GetOwner()))
+		{
+			Candidates.Add(Prop);
+		}
+	}
+	if (Candidates.Num() == 0) { return; }
+
+	const FVector ScoopCenter = Hit.ImpactPoint;
+	Candidates.Sort([&ScoopCenter](const UPrimitiveComponent& A, const UPrimitiveComponent& B)
+	{
+		return FVector::DistSquared(A.Bounds.Origin, ScoopCenter) < FVector::DistSquared(B.Bounds.Origin, ScoopCenter);
+	});
+	HoldComponents(Candidates, ScoopCenter);
+}
+
+void UMultiObjectGrabberComponent::GrabActorsDirectly(const TArray<AActor*>& ActorsToGrab)
+{
+	if (HeldComponents.Num() > 0) { return; }
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::GrabLaunch);
+
+	TArray<UPrimitiveComponent*> Components;
+	for (AActor* Actor : ActorsToGrab)
+	{
+		UPrimitiveComponent* Prop = FGravityGunProps::GetPropComponent(Actor);
+		if (Prop && !Components.Contains(Prop) && !FGravityGunProps::IsHeld(Prop))
+		{
+			Components.Add(Prop);
+		}
+	}
+	if (Components.Num() == 0) { return; }
+
+	UpdateViewportValues(false);
+	HoldComponents(Components, Components[0]->Bounds.Origin);
+}
+
+void UMultiObjectGrabberComponent::HoldComponents(const TArray<UPrimitiveComponent*>& Components, const FVector& GrabLocation)
+{
+	///The player's movement ignores the held group, so the player can't stand on it and lift themselves
+	AActor* Carrier = GetOwner()->GetAttachParentActor();
+	PlayerPrimitive = Carrier ? Cast<UPrimitiveComponent>(Carrier->GetRootComponent()) : nullptr;
+
+	for (int32 Index = 0; Index < Components.Num() && Index < MaxHeldActors; Index++)
+	{
+		AddHeldComponent(Components[Index]);
+	}
+	LayoutFormation();
+	GrabStartLocation = Components[0]->GetComponentLocation();
+
+	FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::Grab, GrabLocation, HeldComponents.Num());
+	FGravityGunEvents::BroadcastForCarrier(GetOwner(), OnGrabNative, OnGrab);
+}
+
+void UMultiObjectGrabberComponent::ReleaseActors()
+{
+	TArray<UPrimitiveComponent*> Released;
+	ReleaseActorsForLaunch(Released);
+}
+
+void UMultiObjectGrabberComponent::ReleaseActorsForLaunch(TArray<UPrimitiveComponent*>& OutReleased)
+{
+	OutReleased.Reset();
+	RemoveInvalidComponents();
+	if (HeldComponents.Num() == 0) { return; }
+
+	///Limit the release velocity of the whole group in one pass, the angular velocity by the same factor as the linear velocity
+	const int32 NumHeld = HeldComponents.Num();
+	TArray<float> AngularX, AngularY, AngularZ;
+	AngularX.SetNumUninitialized(NumHeld);
+	AngularY.SetNumUninitialized(NumHeld);
+	AngularZ.SetNumUninitialized(NumHeld);
+	for (int32 Index = 0; Index < NumHeld; Index++)
+	{
+		const FVector Linear = HeldComponents[Index]->GetPhysicsLinearVelocity();
+		const FVector Angular = HeldComponents[Index]->GetPhysicsAngularVelocityInRadians();
+		VelocityX[Index] = Linear.X;
+		VelocityY[Index] = Linear.Y;
+		VelocityZ[Index] = Linear.Z;
+		AngularX[Index] = Angular.X;
+		AngularY[Index] = Angular.Y;
+		AngularZ[Index] = Angular.Z;
+	}
+	GravityGunMath::LimitReleaseVelocityBatch(
+		GravityGunMath::FVec3Array{ VelocityX.GetData(), VelocityY.GetData(), VelocityZ.GetData() },
+		GravityGunMath::FVec3Array{ AngularX.GetData(), AngularY.GetData(), AngularZ.GetData() },
+		MaxActorVelocityOnRelease,
+		NumHeld);
+
+	float TotalSpeed = 0.f;
+	for (int32 Index = 0; Index < NumHeld; Index++)
+	{
+		UPrimitiveComponent* Component = HeldComponents[Index].Get();
+		const FVector LinearVelocity(VelocityX[Index], VelocityY[Index], VelocityZ[Index]);
+		Component->SetPhysicsLinearVelocity(LinearVelocity);
+		Component->SetPhysicsAngularVelocityInRadians(FVector(AngularX[Index], AngularY[Index], AngularZ[Index]));
+		OutReleased.Add(Component);
+		TotalSpeed += LinearVelocity.Size();
+	}
+
+	///Same value as a single release, the average release speed of the group
+	FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::Release, OutReleased[0]->GetComponentLocation(), TotalSpeed / NumHeld);
+	while (HeldComponents.Num() > 0)
+	{
+		RemoveHeldComponent(HeldComponents.Num() - 1, false);
+	}
+
+	///A dropped or thrown prop can still break things it lands on
+	if (AImpulseCoalescer* Coalescer = AImpulseCoalescer::Get(GetWorld()))
+	{
+		for (UPrimitiveComponent* Component : OutReleased)
+		{
+			Coalescer->NotifyInFlight(Component);
+		}
+	}
+
+	FGravityGunLatency::CancelInput(EGravityGunLatencyAction::Grab);
+	FGravityGunEvents::BroadcastForCarrier(GetOwner(), OnReleaseNative, OnRelease);
+
+	GrabCooldown.Start(GetWorld());
+}
+
+void UMultiObjectGrabberComponent::GetHeldComponents(TArray<UPrimitiveComponent*>& OutHeld) const
+{
+	for (const TWeakObjectPtr<UPrimitiveComponent>& Component : HeldComponents)
+	{
+		if (Component.IsValid())
+		{
+			OutHeld.Add(Component.Get());
+		}
+	}
+}
+
+bool UMultiObjectGrabberComponent::IsHolding(const UPrimitiveComponent* Component) const
+{
+	return Component && HeldComponents.Contains(Component);
+}
+
+void UMultiObjectGrabberComponent::UpdateViewportValues(bool bHolding)
+{
+	///Resolved every frame, the gun can be picked up by another pawn
+	AimQuery = UAimQueryComponent::FindOrAddForActor(GetOwner());
+	if (!AimQuery) { return; }
+
+	///The shared aim may have been computed earlier this frame, before the pawn moved. Holding needs the latest view.
+	if (bHolding && UAimQueryComponent::UsesSameFrameView())
+	{
+		AimQuery->GetViewPoint(ViewportLocation, ViewportRotator);
+		return;
+	}
+
+	const FAimQueryResult& Aim = AimQuery->GetAim(GrabRange);
+	ViewportLocation = Aim.ViewLocation;
+	ViewportRotator = Aim.ViewRotation;
+}
+
+void UMultiObjectGrabberComponent::UpdateHeldComponents()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GGPMultiGrabUpdate);
+
+	RemoveInvalidComponents();
+	SET_DWORD_STAT(STAT_GGPMultiGrabHeld, HeldComponents.Num());
+	if (HeldComponents.Num() == 0) { return; }
+
+	///Gather the locations into contiguous arrays
+	const int32 NumHeld = HeldComponents.Num();
+	for (int32 Index = 0; Index < NumHeld; Index++)
+	{
+		const FVector Location = HeldComponents[Index]->GetComponentLocation();
+		LocationX[Index] = Location.X;
+		LocationY[Index] = Location.Y;
+		LocationZ[Index] = Location.Z;
+	}
+
+	///The grab takes hold once the group has moved
+	if (FGravityGunLatency::IsPending(EGravityGunLatencyAction::Grab) && !FVector(LocationX[0], LocationY[0], LocationZ[0]).Equals(GrabStartLocation))
+	{
+		FGravityGunLatency::MarkEffect(EGravityGunLatencyAction::Grab);
+	}
+
+	///Formation targets and drive velocities of the whole group in one pass each
+	const FQuat ViewQuat = ViewportRotator.Quaternion();
+	GravityGunMath::GetFormationTargetBatch(
+		GravityGunMath::ToMath(ViewportLocation),
+		GravityGunMath::ToMath(ViewQuat.GetForwardVector()),
+		GravityGunMath::ToMath(ViewQuat.GetRightVector()),
+		GravityGunMath::ToMath(ViewQuat.GetUpVector()),
+		GravityGunMath::FConstVec3Array(OffsetX.GetData(), OffsetY.GetData(), OffsetZ.GetData()),
+		GravityGunMath::FVec3Array{ TargetX.GetData(), TargetY.GetData(), TargetZ.GetData() },
+		NumHeld);
+	GravityGunMath::GetDriveVelocityBatch(
+		GravityGunMath::FConstVec3Array(TargetX.GetData(), TargetY.GetData(), TargetZ.GetData()),
+		GravityGunMath::FConstVec3Array(LocationX.GetData(), LocationY.GetData(), LocationZ.GetData()),
+		HoldStiffness,
+		MaxHoldSpeed,
+		GravityGunMath::FVec3Array{ VelocityX.GetData(), VelocityY.GetData(), VelocityZ.GetData() },
+		NumHeld);
+
+	///Apply the velocities in a single update, collecting the actors that got stuck too far from their slot
+	TArray<int32, TInlineAllocator<8>> Dropped;
+	const float ForceReleaseDistanceSquared = FMath::Square(ForceReleaseDistance);
+	for (int32 Index = 0; Index < NumHeld; Index++)
+	{
+		UPrimitiveComponent* Component = HeldComponents[Index].Get();
+		const FVector Location(LocationX[Index], LocationY[Index], LocationZ[Index]);
+		const FVector Target(TargetX[Index], TargetY[Index], TargetZ[Index]);
+		if (FVector::DistSquared(Location, Target) > ForceReleaseDistanceSquared)
+		{
+			FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::ForceReleaseDistance, Location, FVector::Dist(Location, Target));
+			Dropped.Add(Index);
+			continue;
+		}
+		Component->SetPhysicsLinearVelocity(FVector(VelocityX[Index], VelocityY[Index], VelocityZ[Index]));
+
+		///Turn towards the rotation relative to the view the actor had when grabbed, along the shortest arc
+		const FQuat TargetRotation = GravityGunMath::ToEngine(GravityGunMath::ApplyRelativeRotation(GravityGunMath::ToMath(ViewQuat), GravityGunMath::ToMath(RelativeRotations[Index])));
+		FQuat Delta = TargetRotation * Component->GetComponentQuat().Inverse();
+		Delta.EnforceShortestArcWith(FQuat::Identity);
+		FVector Axis;
+		float Angle;
+		Delta.ToAxisAndAngle(Axis, Angle);
+		Component->SetPhysicsAngularVelocityInRadians(Axis * Angle * RotationStiffness);
+	}
+
+	for (int32 Drop = Dropped.Num() - 1; Drop >= 0; Drop--)
+	{
+		RemoveHeldComponent(Dropped[Drop], true);
+	}
+	if (Dropped.Num() > 0)
+	{
+		LayoutFormation();
+	}
+}
+
+void UMultiObjectGrabberComponent::RemoveInvalidComponents()
+{
+	bool bRemoved = false;
+	for (int32 Index = HeldComponents.Num() - 1; Index >= 0; Index--)
+	{
+		const UPrimitiveComponent* Component = HeldComponents[Index].Get();
+		if (!Component || Component->IsPendingKill() || !Component->IsSimulatingPhysics())
+		{
+			RemoveHeldComponent(Index, false);
+			bRemoved = true;
+		}
+	}
+	if (bRemoved)
+	{
+		LayoutFormation();
+	}
+}
+
+void UMultiObjectGrabberComponent::LayoutFormation()
+{
+	const int32 NumHeld = HeldComponents.Num();
+	if (NumHeld == 0) { return; }
+
+	///A grid facing the view, as square as possible, with cells fitting the largest held actor
+	float MaxRadius = 0.f;
+	for (float Radius : Radii)
+	{
+		MaxRadius = FMath::Max(MaxRadius, Radius);
+	}
+	const float CellSize = MaxRadius * 2.f + FormationSpacing;
+	const int32 Columns = FMath::CeilToInt(FMath::Sqrt((float)NumHeld));
+	const int32 Rows = FMath::DivideAndRoundUp(NumHeld, Columns);
+
+	for (int32 Index = 0; Index < NumHeld; Index++)
+	{
+		const int32 Column = Index % Columns;
+		const int32 Row = Index / Columns;
+		OffsetX[Index] = FormationDistance + MaxRadius;
+		OffsetY[Index] = (Column - (Columns - 1) * 0.5f) * CellSize;
+		OffsetZ[Index] = ((Rows - 1) * 0.5f - Row) * CellSize;
+	}
+}
+
+void UMultiObjectGrabberComponent::AddHeldComponent(UPrimitiveComponent* Component)
+{
+	HeldComponents.Add(Component);
+	RelativeRotations.Add(GravityGunMath::ToEngine(GravityGunMath::GetRelativeRotation(
+		GravityGunMath::ToMath(ViewportRotator.Quaternion()),
+		GravityGunMath::ToMath(Component->GetComponentQuat()))));
+	GravityEnabled.Add(Component->IsGravityEnabled());
+	Radii.Add(Component->Bounds.SphereRadius);
+
+	for (TArray<float>* Array : { &OffsetX, &OffsetY, &OffsetZ, &TargetX, &TargetY, &TargetZ, &LocationX, &LocationY, &LocationZ, &VelocityX, &VelocityY, &VelocityZ })
+	{
+		Array->Add(0.f);
+	}
+
+	///Held actors float in their slot, the drive velocity does the rest
+	Component->SetEnableGravity(false);
+	if (UPrimitiveComponent* Player = PlayerPrimitive.Get())
+	{
+		Player->IgnoreComponentWhenMoving(Component, true);
+	}
+	if (RewindComponent)
+	{
+		RewindComponent->TrackActor(Component->GetOwner());
+	}
+	AGravityPropActor::NotifyActivity(Component->GetOwner());
+}
+
+void UMultiObjectGrabberComponent::RemoveHeldComponent(int32 Index, bool bLimitVelocity)
+{
+	if (UPrimitiveComponent* Component = HeldComponents[Index].Get())
+	{
+		Component->SetEnableGravity(GravityEnabled[Index]);
+		if (UPrimitiveComponent* Player = PlayerPrimitive.Get())
+		{
+			Player->IgnoreComponentWhenMoving(Component, false);
+		}
+
+		if (bLimitVelocity)
+		{
+			GravityGunMath::FVec3 LinearVelocity = GravityGunMath::ToMath(Component->GetPhysicsLinearVelocity());
+			GravityGunMath::FVec3 AngularVelocity = GravityGunMath::ToMath(Component->GetPhysicsAngularVelocityInRadians());
+			if (GravityGunMath::LimitReleaseVelocity(LinearVelocity, AngularVelocity, MaxActorVelocityOnRelease))
+			{
+				Component->SetPhysicsLinearVelocity(GravityGunMath::ToEngine(LinearVelocity));
+				Component->SetPhysicsAngularVelocityInRadians(GravityGunMath::ToEngine(AngularVelocity));
+			}
+		}
+	}
+
+	///Removing with swap keeps the arrays contiguous, the formation is laid out again by the caller
+	HeldComponents.RemoveAtSwap(Index);
+	RelativeRotations.RemoveAtSwap(Index);
+	GravityEnabled.RemoveAtSwap(Index);
+	Radii.RemoveAtSwap(Index);
+	for (TArray<float>* Array : { &OffsetX, &OffsetY, &OffsetZ, &TargetX, &TargetY, &TargetZ, &LocationX, &LocationY, &LocationZ, &VelocityX, &VelocityY, &VelocityZ })
+	{
+		Array->RemoveAtSwap(Index);
+	}
+
+	if (HeldComponents.Num() == 0)
+	{
+		PlayerPrimitive.Reset();
+	}
+}
@@ -2,11 +2,87 @@
 
 
 #include "ObjectGrabberComponent.h"
+#include "GravityGunPlayground.h"
 #include "PhysicsEngine/PhysicsHandleComponent.h"
 #include "Engine/World.h"
-#include "GameFramework/PlayerController.h"
 #include "Components/PrimitiveComponent.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PawnMovementComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
 #include "UnrealNetwork.h"
+#include "GravityGunMemory.h"
+#include "PropRewindComponent.h"
+#include "GravityGunTelemetry.h"
+#include "GravityGunLatency.h"
+#include "GravityGunMathConversions.h"
+#include "AimQueryComponent.h"
+#include "GravityPropActor.h"
+#include "GravityGunProps.h"
+#include "GravityGunEvents.h"
+#include "ImpulseCoalescer.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Grab Hover Sweep"), STAT_GGPHoverSweep, STATGROUP_GravityGun);
+
+namespace HoverSweeps
+{
+	static int32 Mode = 1;
+
+	static FAutoConsoleVariableRef CVarMode(
+		TEXT("ggp.Grab.HoverSweep"),
+		Mode,
+		TEXT("0: the held object is pulled straight to the hover target, even when it is inside geometry.\n")
+		TEXT("1: the shape of the held object is swept from the view to the hover target, the target is clamped at the first blocking hit.\n")
+		TEXT("2: the shape is swept for ggp.Grab.HoverStats, but the target is not clamped."));
+
+	//Shape scale of the sweep, slightly smaller than the bounds so resting contacts at the target don't count as blocking
+	static const float ShapeScale = 0.9f;
+
+	//Distance the clamped target is kept from the blocking geometry
+	static const float SkinDistance = 2.f;
+
+	//Hold frames and how far the held body trails its target, with the target blocked by geometry and without, for the measuring and the clamping mode.
+	//The trailing distance is what the solver fights for the held body alone, unlike the frame's physics time.
+	struct FHoldStats
+	{
+		int32 Frames = 0;
+		int32 BlockedFrames = 0;
+		double TargetError = 0.0;
+		double BlockedTargetError = 0.0;
+	};
+	static FHoldStats Stats[2];
+
+	static void HoldStatsCommand(const TArray<FString>& Args, UWorld* World)
+	{
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			Stats[0] = FHoldStats();
+			Stats[1] = FHoldStats();
+			return;
+		}
+
+		static const TCHAR* ModeNames[2] = { TEXT("Unclamped (mode 2)"), TEXT("Clamped (mode 1)") };
+		for (int32 Index = 0; Index < 2; Index++)
+		{
+			const FHoldStats& ModeStats = Stats[Index];
+			const int32 FreeFrames = ModeStats.Frames - ModeStats.BlockedFrames;
+			UE_LOG(LogGravityGun, Display, TEXT("%s: %d hold frames, %d against geometry trailing the target by %.1f cm, %d free trailing by %.1f cm"),
+				ModeNames[Index],
+				ModeStats.Frames,
+				ModeStats.BlockedFrames,
+				ModeStats.BlockedFrames > 0 ? ModeStats.BlockedTargetError / ModeStats.BlockedFrames : 0.0,
+				FreeFrames,
+				FreeFrames > 0 ? (ModeStats.TargetError - ModeStats.BlockedTargetError) / FreeFrames : 0.0);
+		}
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs HoldStatsConsoleCommand(
+		TEXT("ggp.Grab.HoverStats"),
+		TEXT("Logs how far a held object trails its hover target on average, against geometry and free, for the clamped and the unclamped hover target. ")
+		TEXT("Hold an object against a wall with ggp.Grab.HoverSweep 2 and then 1 to compare. Usage: ggp.Grab.HoverStats [reset]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&HoldStatsCommand));
+}
 
 // Sets default values for this component's properties
 UObjectGrabberComponent::UObjectGrabberComponent()
@@ -25,27 +101,65 @@ void UObjectGrabberComponent::BeginPlay()
 
 	PhysicsHandle = GetOwner()->FindComponentByClass<UPhysicsHandleComponent>();
 
-	PlayerController = GetWorld()->GetFirstPlayerController();
+	///The handle interpolates towards and applies the target in its own tick, which has to see the target set this frame
+	if (PhysicsHandle)
+	{
+		PhysicsHandle->AddTickPrerequisiteComponent(this);
+	}
+
+	RewindComponent = GetOwner()->FindComponentByClass<UPropRewindComponent>();
 
 	///Set the forcereleasedistance to at least to grabrange. This to prevent unintended releasing of actors
 	if(ForceReleaseDistance <  GrabRange)
 	{
 		ForceReleaseDistance = GrabRange + 5;
 	}
-	OnCanGrabChanged.Broadcast(false);
+	FGravityGunEvents::BroadcastForCarrier(GetOwner(), OnCanGrabChangedNative, OnCanGrabChanged, false);
+
+	TrackedMemoryBytes = GetClass()->GetStructureSize() + (PhysicsHandle ? PhysicsHandle->GetClass()->GetStructureSize() : 0);
+	FGravityGunMemory::TrackAllocation(EGravityGunMemoryCategory::GrabLaunch, TrackedMemoryBytes);
+}
+
+void UObjectGrabberComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	RestorePlayerCollision();
+
+	FGravityGunMemory::TrackFree(EGravityGunMemoryCategory::GrabLaunch, TrackedMemoryBytes);
+	TrackedMemoryBytes = 0;
+
+	Super::EndPlay(EndPlayReason);
 }
 
 // Called every frame
 void UObjectGrabberComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
 	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::GrabLaunch);
 
 	if (!PhysicsHandle) { return; }
 	UpdateViewportValues();
+	UpdateTickOrdering();
+
+	if (bWaitingForSeparation)
+	{
+		RestorePlayerCollisionWhenSeparated();
+	}
 
 	if (PhysicsHandle->GrabbedComponent)
-	{		
+	{
+		RecordHoldViewLag();
+
+		///The shared aim may have been computed earlier this frame, before the pawn moved. Holding needs the latest view.
+		if (AimQuery && UAimQueryComponent::UsesSameFrameView())
+		{
+			AimQuery->GetViewPoint(ViewportLocation, ViewportRotator);
+		}
 		UpdateGrabbedComponent();
+
+		HoldViewLocation = ViewportLocation;
+		HoldViewRotator = ViewportRotator;
+		HoldViewFrame = GFrameCounter;
+		bHoldViewSameFrame = UAimQueryComponent::UsesSameFrameView();
 	}
 	else
 	{
@@ -69,29 +183,60 @@ void UObjectGrabberComponent::ToggleGrabActor()
 
 void UObjectGrabberComponent::GrabActor()
 {
+	GrabActorAtHit(GetAimHit(true));
+}
+
+void UObjectGrabberComponent::GrabActorAtHit(const FHitResult& Hit)
+{
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::GrabLaunch);
+
 	///Not enough time has passed since most recent release of an object
-	if (!HasReloaded()) { return; }
+	if (!HasReloaded())
+	{
+		FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::GrabCooldownRejected, ViewportLocation, GrabCooldown.GetRemainingSeconds(GetWorld()));
+		return;
+	}
 	
 	if (!(PhysicsHandle)) { return; }
 
 	///Player is already holding an object
 	if (PhysicsHandle->GrabbedComponent) { return; }
 
-	const FHitResult Hit = LineTrace(ViewportLocation, ViewportRotator.Vector());
 	AActor* HitActor = Hit.GetActor();
 	
 	///No valid actor hit
 	if (!HitActor) { return; }
 
-	///Don't grab the actor if the player is standing on top of the grabbed actor.
+	///Don't grab the actor if the player is standing on top of or inside the grabbed actor.
 	///This is done to prevent the player from lifting themselves through grabbing objects.
-	if (IsPlayerOverlappingActor(HitActor))
+	///After this check the player's movement ignores the held actor, so it doesn't have to be repeated every tick.
+	if (FGravityGunProps::IsCarrierTouching(GetOwner(), HitActor))
 	{
 		return;
 	}
 
+	HoldComponent(Hit.GetComponent());
+}
+
+void UObjectGrabberComponent::GrabActorDirectly(AActor* ActorToGrab)
+{
+	UPrimitiveComponent* Component = FGravityGunProps::GetPropComponent(ActorToGrab);
+	if (!(PhysicsHandle && Component)) { return; }
+	if (PhysicsHandle->GrabbedComponent) { return; }
+
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::GrabLaunch);
+	UpdateViewportValues();
+	HoldComponent(Component);
+}
+
+void UObjectGrabberComponent::HoldComponent(UPrimitiveComponent* Component)
+{
+	AActor* HitActor = Component->GetOwner();
+
 	///Calculate the initial rotation of the grabbed actor relative to the player's viewport
-	InitialRelativeRotation = ViewportRotator.Quaternion().Inverse() * Hit.GetComponent()->GetOwner()->GetActorRotation().Quaternion();
+	InitialRelativeRotation = GravityGunMath::ToEngine(GravityGunMath::GetRelativeRotation(
+		GravityGunMath::ToMath(ViewportRotator.Quaternion()),
+		GravityGunMath::ToMath(HitActor->GetActorRotation().Quaternion())));
 
 	///Calculate the actor center
 	FVector ActorCenter, ActorBounds;
@@ -99,19 +244,25 @@ void UObjectGrabberComponent::GrabActor()
 	
 	///Attach the actor to the physicshandle, using the actor's center and current rotation
 	PhysicsHandle->GrabComponentAtLocationWithRotation(
-		Hit.GetComponent(),
+		Component,
 		NAME_None,
 		ActorCenter,
-		Hit.GetActor()->GetActorRotation()
+		HitActor->GetActorRotation()
 	);
+	IgnoreComponentForPlayer(Component);
+	CacheHoverSweepShape(Component, ActorCenter);
+	GrabStartLocation = Component->GetComponentLocation();
 
 	///Calculate the initial grabdistance. Set it to the max hover distance if the value is greater.
-	InitialGrabDistance = (Hit.GetComponent()->GetOwner()->GetActorLocation() - ViewportLocation).Size();
-	if(InitialGrabDistance > MaximumHoverDistance)
+	InitialGrabDistance = GravityGunMath::GetInitialGrabDistance((HitActor->GetActorLocation() - ViewportLocation).Size(), MaximumHoverDistance);
+
+	if (RewindComponent)
 	{
-		InitialGrabDistance = MaximumHoverDistance;
+		RewindComponent->TrackActor(HitActor);
 	}
-	OnGrab.Broadcast();
+	AGravityPropActor::NotifyActivity(HitActor);
+	FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::Grab, ActorCenter, InitialGrabDistance);
+	FGravityGunEvents::BroadcastForCarrier(GetOwner(), OnGrabNative, OnGrab);
 }
 
 void UObjectGrabberComponent::ReleaseActor()
@@ -120,26 +271,28 @@ void UObjectGrabberComponent::ReleaseActor()
 	if (!GrabbedComponent) { return; }
 
 	///If the object has too much linear velocity, limit both the linear and angular velocity.
-	FVector LinearVelocity = GrabbedComponent->GetPhysicsLinearVelocity();
-	if(LinearVelocity.Size() > MaxActorVelocityOnRelease)
+	///The angular velocity is limited by the same factor as the linear velocity.
+	GravityGunMath::FVec3 LinearVelocity = GravityGunMath::ToMath(GrabbedComponent->GetPhysicsLinearVelocity());
+	GravityGunMath::FVec3 AngularVelocity = GravityGunMath::ToMath(GrabbedComponent->GetPhysicsAngularVelocity());
+	if (GravityGunMath::LimitReleaseVelocity(LinearVelocity, AngularVelocity, MaxActorVelocityOnRelease))
 	{
-		FVector AngularVelocity = GrabbedComponent->GetPhysicsAngularVelocity();
-
-		///Normalize the linear velocity, and limit the angular velocity by an equal amount.
-		AngularVelocity /= LinearVelocity.Size();
-		LinearVelocity.Normalize();
-		
-		LinearVelocity *= MaxActorVelocityOnRelease;
-		AngularVelocity *= MaxActorVelocityOnRelease;
-
-		GrabbedComponent->SetPhysicsLinearVelocity(LinearVelocity);
-		GrabbedComponent->SetPhysicsAngularVelocity(AngularVelocity);
+		GrabbedComponent->SetPhysicsLinearVelocity(GravityGunMath::ToEngine(LinearVelocity));
+		GrabbedComponent->SetPhysicsAngularVelocity(GravityGunMath::ToEngine(AngularVelocity));
 	}
 
+	FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::Release, GrabbedComponent->GetComponentLocation(), LinearVelocity.Size());
+	RestorePlayerCollisionWhenSeparated();
+	FGravityGunLatency::CancelInput(EGravityGunLatencyAction::Grab);
 	PhysicsHandle->ReleaseComponent();
-	OnRelease.Broadcast();
 
-	LastReleaseTime = GetWorld()->GetTimeSeconds();
+	///A dropped or thrown prop can still break things it lands on
+	if (AImpulseCoalescer* Coalescer = AImpulseCoalescer::Get(GetWorld()))
+	{
+		Coalescer->NotifyInFlight(GrabbedComponent);
+	}
+	FGravityGunEvents::BroadcastForCarrier(GetOwner(), OnReleaseNative, OnRelease);
+
+	GrabCooldown.Start(GetWorld());
 }
 
 bool UObjectGrabberComponent::GetGrabbedActor(AActor*& OutGrabbedActor)
@@ -164,17 +317,10 @@ void UObjectGrabberComponent::UpdateGrabbedComponent()
 	///If not, release held object.
 	if(!GetOwner()->GetAttachParentActor())
 	{
+		FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::ForceReleaseDetached, GrabbedComponent->GetComponentLocation());
 		ReleaseActor();
 		return;
 	}
-	///Release the actor if the player is standing on top of the grabbed actor.
-	///This is done to prevent the player from lifting themselves through grabbing objects.
-	if (IsPlayerOverlappingActor(GrabbedComponent->GetOwner()))
-	{
-		ReleaseActor();
-		return;
-	}
-
 	///Decide the hover distance based on object size. 
 	///Object size is calculated by subtracting distance to the closest point on the actor from the distance to the actor location.
 	FVector ActorCenter, ActorBounds;
@@ -182,71 +328,249 @@ void UObjectGrabberComponent::UpdateGrabbedComponent()
 	const float DistanceToCenter = (ActorCenter - ViewportLocation).Size();
 	FVector ClosestPointOnCollision;
 	const float DistanceToClosestPoint = PhysicsHandle->GetGrabbedComponent()->GetDistanceToCollision(ViewportLocation, ClosestPointOnCollision);
-	const float DistanceDelta = DistanceToCenter - DistanceToClosestPoint;
-	const float HoverDistance = DistanceDelta + InitialGrabDistance;
+	const float HoverDistance = GravityGunMath::GetHoverDistance(DistanceToCenter, DistanceToClosestPoint, InitialGrabDistance);
 
 	///Release the actor if it's too far away from the player. 
 	if (DistanceToClosestPoint > ForceReleaseDistance)
 	{
+		FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::ForceReleaseDistance, GrabbedComponent->GetComponentLocation(), DistanceToClosestPoint);
 		ReleaseActor();
 		return;
 	}
 
 	///Update transform values on the hovering object.
-	PhysicsHandle->SetTargetLocationAndRotation(ViewportLocation + ViewportRotator.Vector() * HoverDistance,
-		FRotator(ViewportRotator.Quaternion() * InitialRelativeRotation));
+	const GravityGunMath::FVec3 HoverTarget = GravityGunMath::GetHoverTarget(GravityGunMath::ToMath(ViewportLocation), GravityGunMath::ToMath(ViewportRotator.Vector()), HoverDistance);
+	const GravityGunMath::FQuat4 HoverRotation = GravityGunMath::ApplyRelativeRotation(GravityGunMath::ToMath(ViewportRotator.Quaternion()), GravityGunMath::ToMath(InitialRelativeRotation));
+	const FVector ClampedTarget = ClampHoverTarget(GrabbedComponent, GravityGunMath::ToEngine(HoverTarget), GravityGunMath::ToEngine(HoverRotation));
+	PhysicsHandle->SetTargetLocationAndRotation(ClampedTarget, FRotator(GravityGunMath::ToEngine(HoverRotation)));
+
+	///The grab takes hold once the physicshandle has moved the body
+	if (FGravityGunLatency::IsPending(EGravityGunLatencyAction::Grab) && !GrabbedComponent->GetComponentLocation().Equals(GrabStartLocation))
+	{
+		FGravityGunLatency::MarkEffect(EGravityGunLatencyAction::Grab);
+	}
+}
+
+void UObjectGrabberComponent::CacheHoverSweepShape(UPrimitiveComponent* Component, const FVector& GrabLocation)
+{
+	///Bounds in the space of the component without its rotation, so the box can be swept with the rotation of the hover target
+	const FTransform& Transform = Component->GetComponentTransform();
+	const FBoxSphereBounds LocalBounds = Component->CalcBounds(FTransform(FQuat::Identity, FVector::ZeroVector, Transform.GetScale3D()));
+	HoverSweepShape = FCollisionShape::MakeBox(LocalBounds.BoxExtent * HoverSweeps::ShapeScale);
+
+	///The physicshandle moves the grab location to the target, the box is centered on the bounds
+	HoverSweepOffset = LocalBounds.Origin - Transform.GetRotation().UnrotateVector(GrabLocation - Transform.GetLocation());
+}
+
+FVector UObjectGrabberComponent::ClampHoverTarget(UPrimitiveComponent* GrabbedComponent, const FVector& HoverTarget, const FQuat& HoverRotation)
+{
+	if (HoverSweeps::Mode == 0) { return HoverTarget; }
+	SCOPE_CYCLE_COUNTER(STAT_GGPHoverSweep);
+
+	///Only solid geometry clamps the target, other props are pushed aside by the held object
+	FCollisionObjectQueryParams ObjectParams;
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldStatic);
+	ObjectParams.AddObjectTypesToQuery(ECC_WorldDynamic);
+
+	FCollisionQueryParams QueryParams(FName(TEXT("HoverSweep")), false, GrabbedComponent->GetOwner());
+	if (AActor* Pawn = AimQuery ? AimQuery->GetOwner() : nullptr)
+	{
+		TArray<AActor*> AttachedActors;
+		Pawn->GetAttachedActors(AttachedActors);
+		QueryParams.AddIgnoredActor(Pawn);
+		QueryParams.AddIgnoredActors(AttachedActors);
+	}
+
+	const FVector ShapeOffset = HoverRotation.RotateVector(HoverSweepOffset);
+	const FVector SweepEnd = HoverTarget + ShapeOffset;
+	FVector SweepStart = ViewportLocation + ShapeOffset;
+	FHitResult Hit;
+	bool bHit = GetWorld()->SweepSingleByObjectType(Hit, SweepStart, SweepEnd, HoverRotation, ObjectParams, HoverSweepShape, QueryParams);
+
+	///The shape already overlaps something at the view, e.g. when the player stands against a wall.
+	///Sweep from where the held object is instead, the solver keeps it out of the geometry.
+	if (bHit && Hit.bStartPenetrating)
+	{
+		SweepStart = GrabbedComponent->Bounds.Origin;
+		bHit = GetWorld()->SweepSingleByObjectType(Hit, SweepStart, SweepEnd, HoverRotation, ObjectParams, HoverSweepShape, QueryParams);
+	}
+	const bool bBlocked = bHit && !Hit.bStartPenetrating;
+
+	///How far the body trails the target of the previous frame
+	FVector PreviousTarget;
+	FRotator PreviousRotation;
+	PhysicsHandle->GetTargetLocationAndRotation(PreviousTarget, PreviousRotation);
+	const float TargetError = FVector::Dist(GrabbedComponent->Bounds.Origin, PreviousTarget + PreviousRotation.RotateVector(HoverSweepOffset));
+
+	HoverSweeps::FHoldStats& Stats = HoverSweeps::Stats[HoverSweeps::Mode == 1 ? 1 : 0];
+	Stats.Frames++;
+	Stats.TargetError += TargetError;
+	if (bBlocked)
+	{
+		Stats.BlockedFrames++;
+		Stats.BlockedTargetError += TargetError;
+	}
+
+	///A shape overlapping at both starts can't be clamped, the target is left where it is
+	if (!bBlocked || HoverSweeps::Mode != 1) { return HoverTarget; }
+
+	const FVector Direction = (SweepEnd - SweepStart).GetSafeNormal();
+	return SweepStart - ShapeOffset + Direction * FMath::Max(Hit.Distance - HoverSweeps::SkinDistance, 0.f);
 }
 
 void UObjectGrabberComponent::UpdateViewportValues()
 {
-	if(PlayerController)
+	///Resolved every frame, the gun can be picked up by another pawn
+	AimQuery = UAimQueryComponent::FindOrAddForActor(GetOwner());
+	if(AimQuery)
+	{
+		const FAimQueryResult& Aim = AimQuery->GetAim(GrabRange);
+		ViewportLocation = Aim.ViewLocation;
+		ViewportRotator = Aim.ViewRotation;
+	}
+}
+
+void UObjectGrabberComponent::UpdateTickOrdering()
+{
+	const ETickingGroup TickGroup = UAimQueryComponent::UsesSameFrameView() ? TG_PrePhysics : TG_DuringPhysics;
+	if (PrimaryComponentTick.TickGroup != TickGroup)
+	{
+		SetTickGroup(TickGroup);
+		if (PhysicsHandle)
+		{
+			PhysicsHandle->SetTickGroup(TickGroup);
+		}
+	}
+
+	APawn* Pawn = AimQuery ? Cast<APawn>(AimQuery->GetOwner()) : nullptr;
+	AController* Controller = Pawn ? Pawn->GetController() : nullptr;
+	UActorComponent* Movement = Pawn ? Pawn->GetMovementComponent() : nullptr;
+	if (Pawn == PrerequisitePawn.Get() && Controller == PrerequisiteController.Get() && Movement == PrerequisiteMovement.Get()) { return; }
+
+	///The carrying pawn or its controller changed, the new ordering applies from the next frame
+	if (AActor* OldController = PrerequisiteController.Get())
+	{
+		RemoveTickPrerequisiteActor(OldController);
+	}
+	if (UActorComponent* OldMovement = PrerequisiteMovement.Get())
+	{
+		RemoveTickPrerequisiteComponent(OldMovement);
+	}
+
+	///The controller applies the look input to the control rotation, the movement component moves the pawn and its camera
+	if (Controller)
+	{
+		AddTickPrerequisiteActor(Controller);
+	}
+	if (Movement)
 	{
-		PlayerController->GetPlayerViewPoint(ViewportLocation, ViewportRotator);
+		AddTickPrerequisiteComponent(Movement);
 	}
+	PrerequisitePawn = Pawn;
+	PrerequisiteController = Controller;
+	PrerequisiteMovement = Movement;
+}
+
+void UObjectGrabberComponent::RecordHoldViewLag()
+{
+	///Only compare consecutive hold updates, the camera cache still holds the view of the previous frame at this point
+	if (HoldViewFrame + 1 != GFrameCounter) { return; }
+
+	APawn* Pawn = PrerequisitePawn.Get();
+	APlayerController* PlayerController = Pawn ? Cast<APlayerController>(Pawn->GetController()) : nullptr;
+	if (!PlayerController || !PlayerController->PlayerCameraManager) { return; }
+
+	const FMinimalViewInfo& RenderedView = PlayerController->PlayerCameraManager->GetCameraCachePOV();
+	const float Degrees = FMath::RadiansToDegrees(HoldViewRotator.Quaternion().AngularDistance(RenderedView.Rotation.Quaternion()));
+	FGravityGunLatency::RecordHoldViewLag(Degrees, (RenderedView.Location - HoldViewLocation).Size(), bHoldViewSameFrame);
 }
 
 void UObjectGrabberComponent::UpdateActorInRange()
 {
-	FHitResult HitResult = LineTrace(ViewportLocation, ViewportRotator.Vector());
+	FHitResult HitResult = GetAimHit();
 	AActor* HitActor = HitResult.GetActor();
 	if (HitResult.GetActor() != nullptr && ActorCurrentlyAimedAt == nullptr)
 	{
-		OnCanGrabChanged.Broadcast(true);
+		FGravityGunEvents::BroadcastForCarrier(GetOwner(), OnCanGrabChangedNative, OnCanGrabChanged, true);
 		ActorCurrentlyAimedAt = HitResult.GetActor();
 	}
 	else if (HitResult.GetActor() == nullptr && ActorCurrentlyAimedAt != nullptr)
 	{
-		OnCanGrabChanged.Broadcast(false);
+		FGravityGunEvents::BroadcastForCarrier(GetOwner(), OnCanGrabChangedNative, OnCanGrabChanged, false);
 		ActorCurrentlyAimedAt = nullptr;
 	}
 }
 
-bool UObjectGrabberComponent::IsPlayerOverlappingActor(AActor* ActorToCheck) const
+void UObjectGrabberComponent::IgnoreComponentForPlayer(UPrimitiveComponent* Component)
 {
-	///Check if the owning actor is attached to a parent (E.g the gun is equipped). 
-	///If so, check if the parent is overlapping with the grabbed actor.
+	RestorePlayerCollision();
+
 	AActor* ActorParent = GetOwner()->GetAttachParentActor();
-	if (!ActorParent) { return false; }
-	return ActorParent->IsOverlappingActor(ActorToCheck);
+	UPrimitiveComponent* ParentPrimitive = ActorParent ? Cast<UPrimitiveComponent>(ActorParent->GetRootComponent()) : nullptr;
+	if (!ParentPrimitive || !Component) { return; }
+
+	///The movement sweeps and floor checks of the capsule skip ignored components, so the player can't be carried by it
+	ParentPrimitive->IgnoreComponentWhenMoving(Component, true);
+	PlayerPrimitive = ParentPrimitive;
+	IgnoredComponent = Component;
+}
+
+void UObjectGrabberComponent::RestorePlayerCollision()
+{
+	UPrimitiveComponent* ParentPrimitive = PlayerPrimitive.Get();
+	UPrimitiveComponent* Component = IgnoredComponent.Get();
+	if (ParentPrimitive && Component)
+	{
+		ParentPrimitive->IgnoreComponentWhenMoving(Component, false);
+	}
+	PlayerPrimitive.Reset();
+	IgnoredComponent.Reset();
+	bWaitingForSeparation = false;
+}
+
+void UObjectGrabberComponent::RestorePlayerCollisionWhenSeparated()
+{
+	UPrimitiveComponent* ParentPrimitive = PlayerPrimitive.Get();
+	UPrimitiveComponent* Component = IgnoredComponent.Get();
+	if (!ParentPrimitive || !Component)
+	{
+		RestorePlayerCollision();
+		return;
+	}
+
+	///Only the player shape against the released component, a single overlap query per tick while they separate
+	static const FName OverlapTag(TEXT("GrabberSeparation"));
+	const bool bOverlapping = Component->ComponentOverlapComponent(ParentPrimitive, ParentPrimitive->GetComponentLocation(), ParentPrimitive->GetComponentQuat(), FCollisionQueryParams(OverlapTag));
+	if (bOverlapping)
+	{
+		bWaitingForSeparation = true;
+		return;
+	}
+	RestorePlayerCollision();
 }
 
 bool UObjectGrabberComponent::HasReloaded()
 {
-	return GetWorld()->GetTimeSeconds() > LastReleaseTime + GrabCooldownSeconds;
+	return GrabCooldown.HasReloaded(GetWorld());
 }
 
-FHitResult UObjectGrabberComponent::LineTrace(FVector CastOrigin, FVector CastDirection) const
+void FGrabCooldown::Start(const UWorld* World)
 {
-	FHitResult OutHit;
-	GetWorld()->LineTraceSingleByObjectType(
-		OutHit, 
-		CastOrigin, 
-		CastOrigin + CastDirection * GrabRange, 
-		FCollisionObjectQueryParams(ECollisionChannel::ECC_PhysicsBody), 
-		FCollisionQueryParams(FName(TEXT("")), 
-		false, 
-		GetOwner()
-		));
-	return OutHit;
+	LastReleaseTime = World->GetTimeSeconds();
 }
 
+bool FGrabCooldown::HasReloaded(const UWorld* World) const
+{
+	return World->GetTimeSeconds() > LastReleaseTime + Seconds;
+}
+
+float FGrabCooldown::GetRemainingSeconds(const UWorld* World) const
+{
+	return FMath::Max(0.f, LastReleaseTime + Seconds - World->GetTimeSeconds());
+}
+
+FHitResult UObjectGrabberComponent::GetAimHit(bool bFreshTrace) const
+{
+	if (!AimQuery) { return FHitResult(); }
+	return AimQuery->GetHitWithinRange(GrabRange, bFreshTrace);
+}
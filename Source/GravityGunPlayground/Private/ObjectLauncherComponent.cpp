@@ -4,8 +4,16 @@
 #include "ObjectLauncherComponent.h"
 #include "GameFramework/Actor.h"
 #include "Components/PrimitiveComponent.h"
-#include "GameFramework/PlayerController.h"
 #include "TimerManager.h"
+#include "GravityGunMemory.h"
+#include "PropRewindComponent.h"
+#include "GravityGunTelemetry.h"
+#include "GravityGunLatency.h"
+#include "GravityGunMathConversions.h"
+#include "AimQueryComponent.h"
+#include "GravityPropActor.h"
+#include "GravityGunEvents.h"
+#include "ImpulseCoalescer.h"
 
 // Sets default values for this component's properties
 UObjectLauncherComponent::UObjectLauncherComponent()
@@ -15,6 +23,25 @@ UObjectLauncherComponent::UObjectLauncherComponent()
 	PrimaryComponentTick.bCanEverTick = true;
 }
 
+// Called when the game starts
+void UObjectLauncherComponent::BeginPlay()
+{
+	Super::BeginPlay();
+
+	RewindComponent = GetOwner()->FindComponentByClass<UPropRewindComponent>();
+
+	TrackedMemoryBytes = GetClass()->GetStructureSize();
+	FGravityGunMemory::TrackAllocation(EGravityGunMemoryCategory::GrabLaunch, TrackedMemoryBytes);
+}
+
+void UObjectLauncherComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	FGravityGunMemory::TrackFree(EGravityGunMemoryCategory::GrabLaunch, TrackedMemoryBytes);
+	TrackedMemoryBytes = 0;
+
+	Super::EndPlay(EndPlayReason);
+}
+
 // Called every frame
 void UObjectLauncherComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
 {
@@ -23,23 +50,133 @@ void UObjectLauncherComponent::TickComponent(float DeltaTime, ELevelTick TickTyp
 
 void UObjectLauncherComponent::LaunchActorFromViewport(AActor* ActorToLaunch)
 {
-	if (!CanLaunch()) { return; }
+	if (!CanLaunch())
+	{
+		RecordCooldownRejection();
+		return;
+	}
 
 	UpdateViewportValues();
 	LaunchActorFromLocation(ActorToLaunch, ViewportLocation);
 }
 
-void UObjectLauncherComponent::TryLaunchActorByLinecast()
+void UObjectLauncherComponent::LaunchActorFromView(AActor* ActorToLaunch, const FVector& ViewLocation, const FRotator& ViewRotation)
 {
-	if (!CanLaunch()) { return; }
+	if (!CanLaunch())
+	{
+		RecordCooldownRejection();
+		return;
+	}
+
+	ViewportLocation = ViewLocation;
+	ViewportRotator = ViewRotation;
+	LaunchActorFromLocation(ActorToLaunch, ViewportLocation);
+}
+
+void UObjectLauncherComponent::LaunchComponentsFromViewport(const TArray<UPrimitiveComponent*>& ComponentsToLaunch)
+{
+	UpdateViewportValues();
+	LaunchComponentsFromView(ComponentsToLaunch, ViewportRotator);
+}
+
+void UObjectLauncherComponent::LaunchComponentsFromView(const TArray<UPrimitiveComponent*>& ComponentsToLaunch, const FRotator& ViewRotation)
+{
+	if (!CanLaunch())
+	{
+		RecordCooldownRejection();
+		return;
+	}
+	if (ComponentsToLaunch.Num() == 0)
+	{
+		FGravityGunLatency::CancelInput(EGravityGunLatencyAction::Launch);
+		FGravityGunEvents::BroadcastForCarrier(GetOwner(), OnLaunchFailNative, OnLaunchFail);
+		return;
+	}
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::GrabLaunch);
+
+	const FVector LaunchDirection = ViewRotation.Vector();
+
+	///Each component gets the velocity change of the launch impulse, the whole group is clamped in one pass.
+	///The velocity is set right away instead of clamping on the next frame like a single launch.
+	const int32 NumComponents = ComponentsToLaunch.Num();
+	TArray<float> DirectionX, DirectionY, DirectionZ, Speeds, VelocityX, VelocityY, VelocityZ;
+	for (TArray<float>* Array : { &DirectionX, &DirectionY, &DirectionZ, &Speeds, &VelocityX, &VelocityY, &VelocityZ })
+	{
+		Array->SetNumUninitialized(NumComponents);
+	}
+	for (int32 Index = 0; Index < NumComponents; Index++)
+	{
+		const UPrimitiveComponent* Component = ComponentsToLaunch[Index];
+		const FVector Velocity = Component && Component->IsSimulatingPhysics() ? Component->GetPhysicsLinearVelocity() + LaunchDirection * LinearLaunchForce / FMath::Max(Component->GetMass(), KINDA_SMALL_NUMBER) : FVector::ZeroVector;
+		DirectionX[Index] = VelocityX[Index] = Velocity.X;
+		DirectionY[Index] = VelocityY[Index] = Velocity.Y;
+		DirectionZ[Index] = VelocityZ[Index] = Velocity.Z;
+		Speeds[Index] = Velocity.Size();
+	}
+	if (bClampLaunchVelocitySize)
+	{
+		for (int32 Index = 0; Index < NumComponents; Index++)
+		{
+			DirectionX[Index] = LaunchDirection.X;
+			DirectionY[Index] = LaunchDirection.Y;
+			DirectionZ[Index] = LaunchDirection.Z;
+		}
+		GravityGunMath::ClampLaunchVelocityBatch(
+			GravityGunMath::FConstVec3Array(DirectionX.GetData(), DirectionY.GetData(), DirectionZ.GetData()),
+			Speeds.GetData(),
+			MinimumLaunchVelocitySize,
+			MaximumLaunchVelocitySize,
+			GravityGunMath::FVec3Array{ VelocityX.GetData(), VelocityY.GetData(), VelocityZ.GetData() },
+			NumComponents);
+	}
+
+	AImpulseCoalescer* Coalescer = AImpulseCoalescer::Get(GetWorld());
+	for (int32 Index = 0; Index < NumComponents; Index++)
+	{
+		UPrimitiveComponent* Component = ComponentsToLaunch[Index];
+		if (!Component || !Component->IsSimulatingPhysics()) { continue; }
+
+		Component->SetPhysicsLinearVelocity(FVector(VelocityX[Index], VelocityY[Index], VelocityZ[Index]));
+		if (Coalescer)
+		{
+			Coalescer->NotifyInFlight(Component);
+		}
+		if (RewindComponent)
+		{
+			RewindComponent->TrackActor(Component->GetOwner());
+		}
+		AGravityPropActor::NotifyActivity(Component->GetOwner());
+		FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::Launch, Component->GetComponentLocation(), LinearLaunchForce);
+	}
+	FGravityGunLatency::MarkEffect(EGravityGunLatencyAction::Launch);
 
+	LastSuccesfulLaunchTime = GetWorld()->GetTimeSeconds();
+	FGravityGunEvents::BroadcastForCarrier(GetOwner(), OnLaunchSuccessNative, OnLaunchSuccess);
+}
+
+void UObjectLauncherComponent::TryLaunchActorByLinecast()
+{
+	///The aim query is resolved from the pawn carrying the gun now, before its hit is read
 	UpdateViewportValues();
-	FHitResult Hit = LineTrace(ViewportLocation, ViewportRotator.Vector());
+	TryLaunchActorAtHit(GetAimHit(), ViewportLocation, ViewportRotator);
+}
+
+void UObjectLauncherComponent::TryLaunchActorAtHit(const FHitResult& Hit, const FVector& ViewLocation, const FRotator& ViewRotation)
+{
+	if (!CanLaunch())
+	{
+		RecordCooldownRejection();
+		return;
+	}
+
+	ViewportLocation = ViewLocation;
+	ViewportRotator = ViewRotation;
 	
 	///No valid actor hit
 	if (!Hit.GetActor())
 	{
-		OnLaunchFail.Broadcast();
+		FGravityGunLatency::CancelInput(EGravityGunLatencyAction::Launch);
+		FGravityGunEvents::BroadcastForCarrier(GetOwner(), OnLaunchFailNative, OnLaunchFail);
 		return;
 	}
 
@@ -49,12 +186,19 @@ void UObjectLauncherComponent::TryLaunchActorByLinecast()
 void UObjectLauncherComponent::LaunchActorFromLocation(AActor* ActorToLaunch, FVector LaunchLocation)
 {
 	if (!CanLaunch()) { return; }
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::GrabLaunch);
 
-	UpdateViewportValues();
-	
+	///The viewport values were already updated by the caller
 	UPrimitiveComponent* ComponentToLaunch = Cast<UPrimitiveComponent>(ActorToLaunch->GetRootComponent());
 	ComponentToLaunch->AddImpulseAtLocation(ViewportRotator.Vector() * LinearLaunchForce, LaunchLocation);
 
+	///Applied right away rather than coalesced, the velocity clamp below expects it to take effect on the next frame.
+	///The prop reports its hits until it slows down, so it can break what it flies into.
+	if (AImpulseCoalescer* Coalescer = AImpulseCoalescer::Get(GetWorld()))
+	{
+		Coalescer->NotifyInFlight(ComponentToLaunch);
+	}
+
 	///If velocity should be clamped, set a timer to clamp velocity on the next frame.
 	///Done this way because the impulse won't have an effect on the actor until the next frame
 	if(bClampLaunchVelocitySize)
@@ -63,9 +207,35 @@ void UObjectLauncherComponent::LaunchActorFromLocation(AActor* ActorToLaunch, FV
 		const FTimerDelegate TimerDelegate = FTimerDelegate::CreateUObject(this, &UObjectLauncherComponent::AdjustLaunchedComponentVelocity, ComponentToLaunch, ViewportRotator.Vector());
 		GetWorld()->GetTimerManager().SetTimerForNextTick(TimerDelegate);
 	}
+	else
+	{
+		FGravityGunLatency::MarkEffect(EGravityGunLatencyAction::Launch);
+	}
 	
+	if (RewindComponent)
+	{
+		RewindComponent->TrackActor(ActorToLaunch);
+	}
+	AGravityPropActor::NotifyActivity(ActorToLaunch);
+
 	LastSuccesfulLaunchTime = GetWorld()->GetTimeSeconds();
-	OnLaunchSuccess.Broadcast();
+	FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::Launch, LaunchLocation, LinearLaunchForce);
+	FGravityGunEvents::BroadcastForCarrier(GetOwner(), OnLaunchSuccessNative, OnLaunchSuccess);
+}
+
+FVector UObjectLauncherComponent::PredictLaunchVelocity(UPrimitiveComponent* Component, const FVector& LaunchDirection) const
+{
+	if (!Component || !Component->IsSimulatingPhysics()) { return FVector::ZeroVector; }
+
+	///The impulse changes the velocity by the force divided by the mass, the clamp then uses the resulting speed
+	const FVector LaunchVelocity = Component->GetPhysicsLinearVelocity() + LaunchDirection.GetSafeNormal() * LinearLaunchForce / FMath::Max(Component->GetMass(), KINDA_SMALL_NUMBER);
+	if (!bClampLaunchVelocitySize) { return LaunchVelocity; }
+
+	return GravityGunMath::ToEngine(GravityGunMath::ClampLaunchVelocity(
+		GravityGunMath::ToMath(LaunchDirection),
+		LaunchVelocity.Size(),
+		MinimumLaunchVelocitySize,
+		MaximumLaunchVelocitySize));
 }
 
 bool UObjectLauncherComponent::CanLaunch()
@@ -73,35 +243,37 @@ bool UObjectLauncherComponent::CanLaunch()
 	return GetWorld()->GetTimeSeconds() > LastSuccesfulLaunchTime + LaunchCooldownSeconds;
 }
 
+void UObjectLauncherComponent::RecordCooldownRejection() const
+{
+	FGravityGunLatency::CancelInput(EGravityGunLatencyAction::Launch);
+	FGravityGunTelemetry::Record(EGravityGunTelemetryEvent::LaunchCooldownRejected, GetOwner()->GetActorLocation(), LastSuccesfulLaunchTime + LaunchCooldownSeconds - GetWorld()->GetTimeSeconds());
+}
+
 void UObjectLauncherComponent::UpdateViewportValues()
 {
-	APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
-	PlayerController->GetPlayerViewPoint(ViewportLocation, ViewportRotator);
+	AimQuery = UAimQueryComponent::FindOrAddForActor(GetOwner());
+	if (!AimQuery) { return; }
+
+	const FAimQueryResult& Aim = AimQuery->GetAim(HitRange);
+	ViewportLocation = Aim.ViewLocation;
+	ViewportRotator = Aim.ViewRotation;
 }
 
 void UObjectLauncherComponent::AdjustLaunchedComponentVelocity(UPrimitiveComponent* LaunchedComponent, FVector LaunchDirection)
 {
 	///Override the launch velocity in the launch direction to ensure the actor being shot in a straight line from the players viewport
-	FVector NewLaunchVelocity = LaunchDirection;
-
-	///Normalize the velocity and clamp it between the minimum and maximum sizes
-	NewLaunchVelocity.Normalize();
-	NewLaunchVelocity *= FMath::Clamp(LaunchedComponent->GetPhysicsLinearVelocity().Size(), MinimumLaunchVelocitySize, MaximumLaunchVelocitySize);
-	LaunchedComponent->SetPhysicsLinearVelocity(NewLaunchVelocity);
+	///The speed is clamped between the minimum and maximum sizes
+	const GravityGunMath::FVec3 NewLaunchVelocity = GravityGunMath::ClampLaunchVelocity(
+		GravityGunMath::ToMath(LaunchDirection),
+		LaunchedComponent->GetPhysicsLinearVelocity().Size(),
+		MinimumLaunchVelocitySize,
+		MaximumLaunchVelocitySize);
+	LaunchedComponent->SetPhysicsLinearVelocity(GravityGunMath::ToEngine(NewLaunchVelocity));
+	FGravityGunLatency::MarkEffect(EGravityGunLatencyAction::Launch);
 }
 
-FHitResult UObjectLauncherComponent::LineTrace(FVector CastOrigin, FVector CastDirection)
+FHitResult UObjectLauncherComponent::GetAimHit() const
 {
-	FHitResult OutHit;
-	GetWorld()->LineTraceSingleByObjectType(
-		OutHit,
-		CastOrigin,
-		CastOrigin + CastDirection * HitRange,
-		FCollisionObjectQueryParams(ECollisionChannel::ECC_PhysicsBody),
-		FCollisionQueryParams(FName(TEXT("")),
-			false,
-			GetOwner()
-		));
-	return OutHit;
+	if (!AimQuery) { return FHitResult(); }
+	return AimQuery->GetHitWithinRange(HitRange, true);
 }
-
@@ -0,0 +1,312 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PhysicsCostAuditCommandlet.h"
+#include "GravityGunPlayground.h"
+#include "ObjectLauncherComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/Level.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+#include "Misc/FileHelper.h"
+#include "Misc/PackageName.h"
+#include "Misc/Parse.h"
+#include "PhysicsEngine/BodySetup.h"
+#include "UObject/Package.h"
+
+namespace PhysicsCostAudit
+{
+	//Average hull size above which hulls are reported as heavy. The cooker limits hulls to 255 vertices.
+	static const int32 HeavyHullVertices = 48;
+
+	//Factor outside of the launcher clamp range at which the mass is reported
+	static const float LaunchSpeedTolerance = 4.f;
+
+	static const TCHAR* GetCollisionTypeName(ECollisionTraceFlag Flag)
+	{
+		switch (Flag)
+		{
+		case CTF_UseSimpleAndComplex: return TEXT("SimpleAndComplex");
+		case CTF_UseSimpleAsComplex: return TEXT("SimpleAsComplex");
+		case CTF_UseComplexAsSimple: return TEXT("ComplexAsSimple");
+		default: return TEXT("Default");
+		}
+	}
+
+	static const TCHAR* GetSleepFamilyName(ESleepFamily SleepFamily)
+	{
+		switch (SleepFamily)
+		{
+		case ESleepFamily::Normal: return TEXT("Normal");
+		case ESleepFamily::Sensitive: return TEXT("Sensitive");
+		case ESleepFamily::Custom: return TEXT("Custom");
+		default: return TEXT("Unknown");
+		}
+	}
+}
+
+UPhysicsCostAuditCommandlet::UPhysicsCostAuditCommandlet()
+{
+	IsClient = false;
+	IsServer = false;
+	IsEditor = true;
+	LogToConsole = true;
+}
+
+int32 UPhysicsCostAuditCommandlet::Main(const FString& Params)
+{
+	FString MapName = TEXT("/Game/Levels/GravityMap");
+	FParse::Value(*Params, TEXT("Map="), MapName);
+	FString CsvFilename;
+	FParse::Value(*Params, TEXT("Csv="), CsvFilename);
+	const bool bFix = FParse::Param(*Params, TEXT("Fix"));
+	float FixThreshold = 20.f;
+	FParse::Value(*Params, TEXT("FixThreshold="), FixThreshold);
+
+	UPackage* MapPackage = LoadPackage(nullptr, *MapName, LOAD_None);
+	UWorld* World = MapPackage ? UWorld::FindWorldInPackage(MapPackage) : nullptr;
+	if (!World || !World->PersistentLevel)
+	{
+		UE_LOG(LogGravityGun, Error, TEXT("Failed to load map %s"), *MapName);
+		return 1;
+	}
+
+	///The map is not initialized, so the audit reads the body settings instead of the simulated state
+	TArray<FPhysicsCostAuditEntry> Entries;
+	TArray<UStaticMesh*> Offenders;
+	for (AActor* Actor : World->PersistentLevel->Actors)
+	{
+		if (!Actor) { continue; }
+
+		TArray<UPrimitiveComponent*> Components;
+		Actor->GetComponents<UPrimitiveComponent>(Components);
+		for (const UPrimitiveComponent* Component : Components)
+		{
+			if (!Component->BodyInstance.bSimulatePhysics) { continue; }
+
+			const FPhysicsCostAuditEntry& Entry = Entries.Add_GetRef(AuditComponent(Component));
+
+			const UStaticMeshComponent* MeshComponent = Cast<UStaticMeshComponent>(Component);
+			if (MeshComponent && MeshComponent->GetStaticMesh() && Entry.bCollisionProblem && Entry.EstimatedCost >= FixThreshold)
+			{
+				Offenders.AddUnique(MeshComponent->GetStaticMesh());
+			}
+		}
+	}
+
+	Entries.Sort([](const FPhysicsCostAuditEntry& A, const FPhysicsCostAuditEntry& B) { return A.EstimatedCost > B.EstimatedCost; });
+	Report(Entries, CsvFilename);
+
+	if (bFix)
+	{
+#if WITH_EDITOR
+		int32 NumFixed = 0;
+		for (UStaticMesh* Mesh : Offenders)
+		{
+			if (RegenerateBoxCollision(Mesh))
+			{
+				NumFixed++;
+			}
+		}
+		UE_LOG(LogGravityGun, Display, TEXT("Regenerated box collision for %d of %d meshes with collision problems"), NumFixed, Offenders.Num());
+#else
+		UE_LOG(LogGravityGun, Warning, TEXT("-Fix is only available in editor builds"));
+#endif
+	}
+	return 0;
+}
+
+FPhysicsCostAuditEntry UPhysicsCostAuditCommandlet::AuditComponent(const UPrimitiveComponent* Component)
+{
+	FPhysicsCostAuditEntry Entry;
+	Entry.Name = Component->GetOwner() ? FString::Printf(TEXT("%s.%s"), *Component->GetOwner()->GetName(), *Component->GetName()) : Component->GetName();
+	Entry.SleepFamily = PhysicsCostAudit::GetSleepFamilyName(Component->BodyInstance.SleepFamily);
+	Entry.bUseCCD = Component->BodyInstance.bUseCCD;
+
+	if (const UStaticMeshComponent* MeshComponent = Cast<UStaticMeshComponent>(Component))
+	{
+		if (UStaticMesh* Mesh = MeshComponent->GetStaticMesh())
+		{
+			Entry.Mesh = Mesh->GetPathName();
+			Entry.NumMeshVertices = Mesh->HasValidRenderData() ? Mesh->GetNumVertices(0) : 0;
+		}
+	}
+
+	UBodySetup* BodySetup = const_cast<UPrimitiveComponent*>(Component)->GetBodySetup();
+	if (BodySetup)
+	{
+		const FKAggregateGeom& Geometry = BodySetup->AggGeom;
+		const ECollisionTraceFlag TraceFlag = BodySetup->GetCollisionTraceFlag();
+		Entry.CollisionType = PhysicsCostAudit::GetCollisionTypeName(TraceFlag);
+		Entry.NumSimpleShapes = Geometry.SphereElems.Num() + Geometry.BoxElems.Num() + Geometry.SphylElems.Num() + Geometry.ConvexElems.Num();
+		Entry.NumConvexHulls = Geometry.ConvexElems.Num();
+		for (const FKConvexElem& Hull : Geometry.ConvexElems)
+		{
+			Entry.NumHullVertices += Hull.VertexData.Num();
+		}
+		Entry.Mass = BodySetup->CalculateMass(Component);
+
+		if (TraceFlag == CTF_UseComplexAsSimple)
+		{
+			Entry.Problems.Add(TEXT("Complex collision used as simple on a simulating body"));
+			Entry.bCollisionProblem = true;
+		}
+		else if (Entry.NumSimpleShapes == 0)
+		{
+			Entry.Problems.Add(TEXT("No simple collision"));
+			Entry.bCollisionProblem = true;
+		}
+		if (Entry.NumConvexHulls > 0 && Entry.NumHullVertices / Entry.NumConvexHulls > PhysicsCostAudit::HeavyHullVertices)
+		{
+			Entry.Problems.Add(FString::Printf(TEXT("Heavy convex hulls, %d vertices in %d hulls"), Entry.NumHullVertices, Entry.NumConvexHulls));
+			Entry.bCollisionProblem = true;
+		}
+	}
+	else
+	{
+		Entry.CollisionType = TEXT("None");
+		Entry.Problems.Add(TEXT("No body setup"));
+	}
+
+	///The launcher applies a fixed impulse and clamps the resulting velocity one frame later
+	const UObjectLauncherComponent* Launcher = GetDefault<UObjectLauncherComponent>();
+	if (Entry.Mass > KINDA_SMALL_NUMBER)
+	{
+		Entry.UnclampedLaunchSpeed = Launcher->GetLinearLaunchForce() / Entry.Mass;
+		if (Entry.UnclampedLaunchSpeed > Launcher->GetMaximumLaunchVelocitySize() * PhysicsCostAudit::LaunchSpeedTolerance)
+		{
+			Entry.Problems.Add(FString::Printf(TEXT("Very light, travels at %.0f for a frame before the launch clamp"), Entry.UnclampedLaunchSpeed));
+		}
+		else if (Entry.UnclampedLaunchSpeed < Launcher->GetMinimumLaunchVelocitySize() / PhysicsCostAudit::LaunchSpeedTolerance)
+		{
+			Entry.Problems.Add(FString::Printf(TEXT("Very heavy, launched at %.0f before the launch clamp"), Entry.UnclampedLaunchSpeed));
+		}
+	}
+	else
+	{
+		Entry.Problems.Add(TEXT("Zero mass"));
+	}
+
+	if (Component->BodyInstance.SleepFamily == ESleepFamily::Custom && Component->BodyInstance.CustomSleepThresholdMultiplier < 0.5f)
+	{
+		Entry.Problems.Add(TEXT("Custom sleep threshold keeps the body awake"));
+	}
+
+	Entry.EstimatedCost = EstimateCost(Entry);
+	if (Component->BodyInstance.SleepFamily == ESleepFamily::Custom)
+	{
+		///A lower threshold keeps the body awake longer
+		Entry.EstimatedCost /= FMath::Max(Component->BodyInstance.CustomSleepThresholdMultiplier, 0.1f);
+	}
+	return Entry;
+}
+
+float UPhysicsCostAuditCommandlet::EstimateCost(const FPhysicsCostAuditEntry& Entry)
+{
+	const int32 NumPrimitiveShapes = Entry.NumSimpleShapes - Entry.NumConvexHulls;
+	float Cost = NumPrimitiveShapes * 1.5f + Entry.NumConvexHulls * 2.f + Entry.NumHullVertices / 16.f;
+
+	///Triangle meshes are tested against every contact, and can't collide with other triangle meshes at all
+	if (Entry.CollisionType == TEXT("ComplexAsSimple"))
+	{
+		Cost += 50.f + Entry.NumMeshVertices / 16.f;
+	}
+	if (Entry.bUseCCD)
+	{
+		Cost *= 2.f;
+	}
+	if (Entry.SleepFamily == TEXT("Sensitive"))
+	{
+		Cost *= 1.5f;
+	}
+	return FMath::Max(Cost, 1.f);
+}
+
+void UPhysicsCostAuditCommandlet::Report(const TArray<FPhysicsCostAuditEntry>& Entries, const FString& CsvFilename) const
+{
+	FString Csv = TEXT("Cost,Name,Mesh,Collision,SimpleShapes,Hulls,HullVertices,MeshVertices,Mass,UnclampedLaunchSpeed,SleepFamily,CCD,Problems\n");
+	float TotalCost = 0.f;
+	int32 NumOffenders = 0;
+
+	for (const FPhysicsCostAuditEntry& Entry : Entries)
+	{
+		const FString Problems = FString::Join(Entry.Problems, TEXT("; "));
+		UE_LOG(LogGravityGun, Display, TEXT("%8.1f  %s  [%s, %d shapes, %d hulls, %d hull verts, %d mesh verts, %.1f kg, sleep %s%s]%s%s"),
+			Entry.EstimatedCost,
+			*Entry.Name,
+			*Entry.CollisionType,
+			Entry.NumSimpleShapes,
+			Entry.NumConvexHulls,
+			Entry.NumHullVertices,
+			Entry.NumMeshVertices,
+			Entry.Mass,
+			*Entry.SleepFamily,
+			Entry.bUseCCD ? TEXT(", CCD") : TEXT(""),
+			Problems.IsEmpty() ? TEXT("") : TEXT("  "),
+			*Problems);
+
+		Csv += FString::Printf(TEXT("%.1f,%s,%s,%s,%d,%d,%d,%d,%.2f,%.0f,%s,%d,\"%s\"\n"),
+			Entry.EstimatedCost,
+			*Entry.Name,
+			*Entry.Mesh,
+			*Entry.CollisionType,
+			Entry.NumSimpleShapes,
+			Entry.NumConvexHulls,
+			Entry.NumHullVertices,
+			Entry.NumMeshVertices,
+			Entry.Mass,
+			Entry.UnclampedLaunchSpeed,
+			*Entry.SleepFamily,
+			Entry.bUseCCD ? 1 : 0,
+			*Problems);
+
+		TotalCost += Entry.EstimatedCost;
+		if (Entry.Problems.Num() > 0)
+		{
+			NumOffenders++;
+		}
+	}
+
+	UE_LOG(LogGravityGun, Display, TEXT("%d simulating primitives, total estimated cost %.1f, %d with problems"), Entries.Num(), TotalCost, NumOffenders);
+
+	if (!CsvFilename.IsEmpty())
+	{
+		if (FFileHelper::SaveStringToFile(Csv, *CsvFilename))
+		{
+			UE_LOG(LogGravityGun, Display, TEXT("Wrote audit to %s"), *CsvFilename);
+		}
+		else
+		{
+			UE_LOG(LogGravityGun, Error, TEXT("Failed to write audit to %s"), *CsvFilename);
+		}
+	}
+}
+
+#if WITH_EDITOR
+bool UPhysicsCostAuditCommandlet::RegenerateBoxCollision(UStaticMesh* Mesh) const
+{
+	UBodySetup* BodySetup = Mesh ? Mesh->BodySetup : nullptr;
+	if (!BodySetup) { return false; }
+
+	const FBox Bounds = Mesh->GetBoundingBox();
+	const FVector Size = Bounds.GetSize();
+
+	BodySetup->Modify();
+	BodySetup->RemoveSimpleCollision();
+	FKBoxElem Box(Size.X, Size.Y, Size.Z);
+	Box.Center = Bounds.GetCenter();
+	BodySetup->AggGeom.BoxElems.Add(Box);
+	BodySetup->CollisionTraceFlag = CTF_UseDefault;
+	BodySetup->InvalidatePhysicsData();
+	BodySetup->CreatePhysicsMeshes();
+	Mesh->MarkPackageDirty();
+
+	UPackage* Package = Mesh->GetOutermost();
+	const FString Filename = FPackageName::LongPackageNameToFilename(Package->GetName(), FPackageName::GetAssetPackageExtension());
+	const bool bSaved = UPackage::SavePackage(Package, nullptr, RF_Standalone, *Filename, GError, nullptr, false, true, SAVE_NoError);
+	UE_LOG(LogGravityGun, Display, TEXT("%s box collision for %s"), bSaved ? TEXT("Regenerated") : TEXT("Failed to save"), *Mesh->GetPathName());
+	return bSaved;
+}
+#endif
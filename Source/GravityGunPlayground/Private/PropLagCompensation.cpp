@@ -0,0 +1,342 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PropLagCompensation.h"
+#include "GravityGunPlayground.h"
+#include "GravityGunMemory.h"
+#include "GravityGunProps.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "EngineUtils.h"
+#include "GameFramework/GameStateBase.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Lag Compensation Record"), STAT_GGPLagCompRecord, STATGROUP_GravityGun);
+DECLARE_CYCLE_STAT(TEXT("Lag Compensation Trace"), STAT_GGPLagCompTrace, STATGROUP_GravityGun);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Lag Compensation Bodies"), STAT_GGPLagCompBodies, STATGROUP_GravityGun);
+
+namespace PropLagCompensation
+{
+	static int32 bEnabled = 1;
+	static float MaxRewindMs = 400.f;
+	static float SampleRate = 60.f;
+	static int32 MaxBodies = 512;
+	static int32 BufferKB = 512;
+
+	static FAutoConsoleVariableRef CVarEnabled(
+		TEXT("ggp.LagComp.Enabled"),
+		bEnabled,
+		TEXT("1: grab and launch requests of clients are traced against the props as the client saw them.\n")
+		TEXT("0: the requests are traced against the current props. The history keeps recording, so the two can be compared."));
+
+	static FAutoConsoleVariableRef CVarMaxRewindMs(
+		TEXT("ggp.LagComp.MaxRewindMs"),
+		MaxRewindMs,
+		TEXT("Milliseconds a request can be rewound at most, requests from further back are traced at the oldest allowed time.\n")
+		TEXT("The history is sized for it when it is created."));
+
+	static FAutoConsoleVariableRef CVarSampleRate(
+		TEXT("ggp.LagComp.SampleRate"),
+		SampleRate,
+		TEXT("Number of history samples recorded per second. Read when the history is created."));
+
+	static FAutoConsoleVariableRef CVarMaxBodies(
+		TEXT("ggp.LagComp.MaxBodies"),
+		MaxBodies,
+		TEXT("Maximum number of moving props recorded at once. Props that start moving while all slots are in use are traced where they are."));
+
+	static FAutoConsoleVariableRef CVarBufferKB(
+		TEXT("ggp.LagComp.BufferKB"),
+		BufferKB,
+		TEXT("Size of the history ring buffer. When full, the oldest history is dropped. Read when the history is created."));
+
+	//Number of samples between two full keyframes. Samples in between only store the bodies that moved.
+	static const int32 KeyframeInterval = 15;
+
+	//Seconds between two scans for props that started moving
+	static const double ScanIntervalSeconds = 0.1;
+
+	static void StatsCommand(const TArray<FString>& Args, UWorld* World)
+	{
+		APropLagCompensation* LagCompensation = APropLagCompensation::Get(World);
+		if (!LagCompensation)
+		{
+			UE_LOG(LogGravityGun, Display, TEXT("Lag compensation only runs on servers with remote clients"));
+			return;
+		}
+
+		if (Args.Num() > 0 && Args[0] == TEXT("reset"))
+		{
+			LagCompensation->ResetStats();
+			return;
+		}
+		LagCompensation->LogStats();
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs StatsConsoleCommand(
+		TEXT("ggp.LagComp.Stats"),
+		TEXT("Logs the memory of the server-side prop history and the number and cost of the rewound grab and launch traces. Usage: ggp.LagComp.Stats [reset]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StatsCommand));
+}
+
+// Sets default values
+APropLagCompensation::APropLagCompensation()
+{
+	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.TickGroup = TG_PostPhysics;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>("Root");
+}
+
+APropLagCompensation* APropLagCompensation::Get(UWorld* World)
+{
+	///Without remote clients every request is made on the props as they are
+	if (!World || World->GetNetMode() == NM_Client || World->GetNetMode() == NM_Standalone) { return nullptr; }
+
+	for (TActorIterator<APropLagCompensation> It(World); It; ++It)
+	{
+		if (!It->IsPendingKill())
+		{
+			return *It;
+		}
+	}
+	return World->SpawnActor<APropLagCompensation>();
+}
+
+double APropLagCompensation::GetServerTime(const UWorld* World)
+{
+	if (!World) { return 0.0; }
+
+	const AGameStateBase* GameState = World->GetGameState();
+	return GameState ? GameState->GetServerWorldTimeSeconds() : World->GetTimeSeconds();
+}
+
+// Called when the game starts or when spawned
+void APropLagCompensation::BeginPlay()
+{
+	Super::BeginPlay();
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::GrabLaunch);
+
+	///Frames before the oldest keyframe can't be decoded, so the frames kept cover the rewind window plus one keyframe interval
+	const float SampleRate = FMath::Max(PropLagCompensation::SampleRate, 1.f);
+	const int32 MaxFrames = FMath::CeilToInt(PropLagCompensation::MaxRewindMs / 1000.f * SampleRate) + PropLagCompensation::KeyframeInterval + 1;
+	History = FPropRewindBuffer(PropLagCompensation::BufferKB * 1024, MaxFrames, PropLagCompensation::KeyframeInterval);
+	UpdateTrackedMemory();
+}
+
+void APropLagCompensation::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	FGravityGunMemory::TrackFree(EGravityGunMemoryCategory::GrabLaunch, TrackedMemoryBytes);
+	TrackedMemoryBytes = 0;
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Called every frame
+void APropLagCompensation::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::GrabLaunch);
+
+	const double Time = GetServerTime(GetWorld());
+	if (LastScanTime < 0.0 || Time - LastScanTime >= PropLagCompensation::ScanIntervalSeconds)
+	{
+		ScanForMovingBodies(Time);
+		LastScanTime = Time;
+	}
+
+	if (TrackedBodies.Num() > 0 && Time > LastSampleTime && (LastSampleTime < 0.0 || Time - LastSampleTime >= 1.0 / FMath::Max(PropLagCompensation::SampleRate, 1.f)))
+	{
+		RecordSample(Time);
+		LastSampleTime = Time;
+	}
+	SET_DWORD_STAT(STAT_GGPLagCompBodies, TrackedBodies.Num());
+}
+
+void APropLagCompensation::ScanForMovingBodies(double Time)
+{
+	TArray<UPrimitiveComponent*> Props;
+	FGravityGunProps::GetAllProps(GetWorld(), Props);
+
+	const int32 MaxBodies = FMath::Clamp(PropLagCompensation::MaxBodies, 0, 32768);
+	bool bSlotsChanged = false;
+	for (UPrimitiveComponent* Prop : Props)
+	{
+		///Only the props the grab and launch traces can hit, and only while they move
+		if (Prop->GetCollisionObjectType() != ECC_PhysicsBody || !Prop->RigidBodyIsAwake()) { continue; }
+		if (BodySlots.Contains(Prop)) { continue; }
+
+		int32 Slot = FindFreeSlot(Time);
+		if (Slot == INDEX_NONE)
+		{
+			if (TrackedBodies.Num() >= MaxBodies) { continue; }
+
+			Slot = TrackedBodies.AddDefaulted();
+			SlotStartTimes.AddZeroed();
+			LastMoveTimes.AddZeroed();
+			RecordedStates.AddDefaulted();
+		}
+		else
+		{
+			BodySlots.Remove(TrackedBodies[Slot]);
+		}
+
+		TrackedBodies[Slot] = Prop;
+		SlotStartTimes[Slot] = Time;
+		LastMoveTimes[Slot] = Time;
+		BodySlots.Add(Prop, Slot);
+		bSlotsChanged = true;
+	}
+
+	if (bSlotsChanged)
+	{
+		UpdateTrackedMemory();
+	}
+}
+
+int32 APropLagCompensation::FindFreeSlot(double Time) const
+{
+	///A body at rest for the whole rewind window has the same transform in all of it, so it doesn't need a history
+	const double RestSeconds = PropLagCompensation::MaxRewindMs / 1000.0;
+	for (int32 Slot = 0; Slot < TrackedBodies.Num(); Slot++)
+	{
+		if (!TrackedBodies[Slot].IsValid() || Time - LastMoveTimes[Slot] > RestSeconds)
+		{
+			return Slot;
+		}
+	}
+	return INDEX_NONE;
+}
+
+void APropLagCompensation::RecordSample(double Time)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GGPLagCompRecord);
+
+	for (int32 Slot = 0; Slot < TrackedBodies.Num(); Slot++)
+	{
+		///Destroyed bodies keep their last state, so they don't produce any deltas
+		const UPrimitiveComponent* Body = TrackedBodies[Slot].Get();
+		if (!Body) { continue; }
+
+		RecordedStates[Slot].Location = Body->GetComponentLocation();
+		RecordedStates[Slot].Rotation = Body->GetComponentQuat();
+		if (Body->RigidBodyIsAwake())
+		{
+			LastMoveTimes[Slot] = Time;
+		}
+	}
+	History.RecordFrame(Time, RecordedStates);
+}
+
+FHitResult APropLagCompensation::TraceAtTime(const FVector& Start, const FVector& Direction, float Range, double Time, const FCollisionQueryParams& Params)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GGPLagCompTrace);
+	const double TraceStartTime = FPlatformTime::Seconds();
+
+	const FVector End = Start + Direction.GetSafeNormal() * Range;
+	const double Now = GetServerTime(GetWorld());
+	const double RewindTime = FMath::Clamp(Time, Now - PropLagCompensation::MaxRewindMs / 1000.0, Now);
+
+	FHitResult BestHit;
+	bool bRewoundHit = false;
+	FCollisionQueryParams WorldParams(Params);
+
+	if (PropLagCompensation::bEnabled && History.Sample(RewindTime, SampledStates, SampledValid))
+	{
+		const int32 NumBodies = FMath::Min(SampledStates.Num(), TrackedBodies.Num());
+		for (int32 Slot = 0; Slot < NumBodies; Slot++)
+		{
+			UPrimitiveComponent* Body = TrackedBodies[Slot].Get();
+			if (!Body || !SampledValid[Slot] || RewindTime < SlotStartTimes[Slot]) { continue; }
+
+			///The body is traced at its rewound transform only, not where it is now
+			WorldParams.AddIgnoredComponent(Body);
+
+			const FPropRewindState& State = SampledStates[Slot];
+			const float BoundsRadius = Body->Bounds.SphereRadius + FVector::Dist(Body->Bounds.Origin, Body->GetComponentLocation());
+			if (FMath::PointDistToSegmentSquared(State.Location, Start, End) > FMath::Square(BoundsRadius)) { continue; }
+
+			///Move the ray from the rewound transform into the current one, so the collision of the body is traced without moving the body
+			const FTransform RewoundTransform(State.Rotation, State.Location, Body->GetComponentScale());
+			const FTransform& CurrentTransform = Body->GetComponentTransform();
+			const FVector MovedStart = CurrentTransform.TransformPosition(RewoundTransform.InverseTransformPosition(Start));
+			const FVector MovedEnd = CurrentTransform.TransformPosition(RewoundTransform.InverseTransformPosition(End));
+
+			FHitResult BodyHit;
+			if (!Body->LineTraceComponent(BodyHit, MovedStart, MovedEnd, Params)) { continue; }
+
+			BodyHit.Distance = BodyHit.Time * Range;
+			if (BestHit.bBlockingHit && BodyHit.Distance >= BestHit.Distance) { continue; }
+
+			BodyHit.bBlockingHit = true;
+			BodyHit.Actor = Body->GetOwner();
+			BodyHit.Component = Body;
+			BodyHit.TraceStart = Start;
+			BodyHit.TraceEnd = End;
+			BestHit = BodyHit;
+			bRewoundHit = true;
+		}
+	}
+
+	///Props without history at that time haven't moved since, they are traced where they are
+	FHitResult WorldHit;
+	if (GetWorld()->LineTraceSingleByObjectType(WorldHit, Start, End, FCollisionObjectQueryParams(ECC_PhysicsBody), WorldParams)
+		&& (!BestHit.bBlockingHit || WorldHit.Distance < BestHit.Distance))
+	{
+		BestHit = WorldHit;
+		bRewoundHit = false;
+	}
+
+	const double TraceMs = (FPlatformTime::Seconds() - TraceStartTime) * 1000.0;
+	NumTraces++;
+	NumRewoundHits += bRewoundHit ? 1 : 0;
+	TotalTraceMs += TraceMs;
+	WorstTraceMs = FMath::Max(WorstTraceMs, TraceMs);
+	return BestHit;
+}
+
+float APropLagCompensation::GetHistorySeconds() const
+{
+	if (History.GetNumFrames() < 2) { return 0.f; }
+	return (float)(History.GetNewestTime() - History.GetOldestTime());
+}
+
+void APropLagCompensation::LogStats() const
+{
+	UE_LOG(LogGravityGun, Display, TEXT("Lag compensation history: %d bodies, %.2f s, %.1f of %.1f KB used, %.1f KB per second, %.1f KB tracked in total"),
+		TrackedBodies.Num(),
+		GetHistorySeconds(),
+		History.GetUsedBytes() / 1024.f,
+		History.GetAllocatedBytes() / 1024.f,
+		History.GetBytesPerSecond() / 1024.f,
+		TrackedMemoryBytes / 1024.f);
+	UE_LOG(LogGravityGun, Display, TEXT("Lag compensation traces: %d, %d hit a rewound prop, %.3f ms average, %.3f ms worst"),
+		NumTraces,
+		NumRewoundHits,
+		NumTraces > 0 ? TotalTraceMs / NumTraces : 0.0,
+		WorstTraceMs);
+}
+
+void APropLagCompensation::ResetStats()
+{
+	NumTraces = 0;
+	NumRewoundHits = 0;
+	TotalTraceMs = 0.0;
+	WorstTraceMs = 0.0;
+}
+
+void APropLagCompensation::UpdateTrackedMemory()
+{
+	if (TrackedMemoryBytes > 0)
+	{
+		FGravityGunMemory::TrackFree(EGravityGunMemoryCategory::GrabLaunch, TrackedMemoryBytes);
+	}
+	TrackedMemoryBytes = History.GetAllocatedBytes()
+		+ TrackedBodies.GetAllocatedSize()
+		+ SlotStartTimes.GetAllocatedSize()
+		+ LastMoveTimes.GetAllocatedSize()
+		+ RecordedStates.GetAllocatedSize()
+		+ BodySlots.GetAllocatedSize();
+	FGravityGunMemory::TrackAllocation(EGravityGunMemoryCategory::GrabLaunch, TrackedMemoryBytes);
+}
@@ -0,0 +1,247 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PropLayout.h"
+#include "GravityGunPlayground.h"
+#include "GravityGunProps.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+static_assert(sizeof(FPropLayoutHeader) == 24, "Layout header layout changed, bump FPropLayout::Version");
+static_assert(sizeof(FPropLayoutMesh) == 8, "Layout mesh table layout changed, bump FPropLayout::Version");
+static_assert(sizeof(FPropLayoutRecord) == 56, "Layout record layout changed, bump FPropLayout::Version");
+
+namespace PropLayouts
+{
+	static void ExportCommand(const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World) { return; }
+
+		const FString Name = Args.Num() > 0 ? Args[0] : UWorld::RemovePIEPrefix(World->GetMapName());
+		const FString Filename = FPropLayout::GetLayoutFilename(Name);
+		if (FPropLayout::SaveToFile(World, Filename))
+		{
+			UE_LOG(LogGravityGun, Display, TEXT("Saved prop layout to %s"), *Filename);
+		}
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs ExportConsoleCommand(
+		TEXT("ggp.Layout.Export"),
+		TEXT("Writes all static mesh props of the world to a layout file. Usage: ggp.Layout.Export [Name=map name]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&ExportCommand));
+}
+
+void FPropLayout::Write(UWorld* World, TArray<uint8>& OutData)
+{
+	TArray<UPrimitiveComponent*> Props;
+	FGravityGunProps::GetAllProps(World, Props);
+
+	TArray<FPropLayoutRecord> Records;
+	Records.Reserve(Props.Num());
+	TMap<const UStaticMesh*, uint16> MeshIds;
+	TArray<FString> MeshPaths;
+
+	for (const UPrimitiveComponent* Prop : Props)
+	{
+		const UStaticMeshComponent* MeshComponent = Cast<UStaticMeshComponent>(Prop);
+		const UStaticMesh* Mesh = MeshComponent ? MeshComponent->GetStaticMesh() : nullptr;
+		if (!Mesh) { continue; }
+
+		const uint16* ExistingId = MeshIds.Find(Mesh);
+		if (!ExistingId && MeshPaths.Num() > MAX_uint16) { continue; }
+		const uint16 MeshId = ExistingId ? *ExistingId : MeshIds.Add(Mesh, (uint16)MeshPaths.Add(Mesh->GetPathName()));
+
+		const FTransform& Transform = MeshComponent->GetComponentTransform();
+		const FVector Location = Transform.GetLocation();
+		const FQuat Rotation = Transform.GetRotation();
+		const FVector Scale = Transform.GetScale3D();
+		const FBodyInstance& BodyInstance = MeshComponent->BodyInstance;
+
+		FPropLayoutRecord& Record = Records.AddDefaulted_GetRef();
+		Record.MeshId = MeshId;
+		Record.Flags = 0;
+		if (MeshComponent->GetCollisionObjectType() == ECC_PhysicsBody)
+		{
+			Record.Flags |= Flag_Grabbable;
+		}
+		if (!MeshComponent->RigidBodyIsAwake())
+		{
+			Record.Flags |= Flag_Asleep;
+		}
+		if (MeshComponent->IsGravityEnabled())
+		{
+			Record.Flags |= Flag_EnableGravity;
+		}
+		Record.Location[0] = Location.X;
+		Record.Location[1] = Location.Y;
+		Record.Location[2] = Location.Z;
+		Record.Rotation[0] = Rotation.X;
+		Record.Rotation[1] = Rotation.Y;
+		Record.Rotation[2] = Rotation.Z;
+		Record.Rotation[3] = Rotation.W;
+		Record.Scale[0] = Scale.X;
+		Record.Scale[1] = Scale.Y;
+		Record.Scale[2] = Scale.Z;
+		Record.Mass = BodyInstance.bOverrideMass ? BodyInstance.GetMassOverride() : 0.f;
+		Record.LinearDamping = BodyInstance.LinearDamping;
+		Record.AngularDamping = BodyInstance.AngularDamping;
+	}
+
+	///Mesh paths are appended as UTF-8 after the mesh table
+	TArray<uint8> PathData;
+	TArray<FPropLayoutMesh> Meshes;
+	Meshes.Reserve(MeshPaths.Num());
+	for (const FString& Path : MeshPaths)
+	{
+		const FTCHARToUTF8 Utf8Path(*Path);
+		FPropLayoutMesh& Mesh = Meshes.AddDefaulted_GetRef();
+		Mesh.PathOffset = PathData.Num();
+		Mesh.PathLength = Utf8Path.Length();
+		PathData.Append(reinterpret_cast<const uint8*>(Utf8Path.Get()), Utf8Path.Length());
+	}
+
+	const int64 RecordBytes = Records.Num() * sizeof(FPropLayoutRecord);
+	const int64 MeshTableOffset = sizeof(FPropLayoutHeader) + RecordBytes;
+	const int64 MeshTableBytes = Meshes.Num() * sizeof(FPropLayoutMesh);
+	const int64 PathOffset = MeshTableOffset + MeshTableBytes;
+	for (FPropLayoutMesh& Mesh : Meshes)
+	{
+		Mesh.PathOffset += (uint32)PathOffset;
+	}
+	OutData.SetNumUninitialized(PathOffset + PathData.Num());
+
+	FPropLayoutHeader* Header = reinterpret_cast<FPropLayoutHeader*>(OutData.GetData());
+	Header->Magic = Magic;
+	Header->Version = Version;
+	Header->RecordSize = sizeof(FPropLayoutRecord);
+	Header->NumRecords = Records.Num();
+	Header->NumMeshes = Meshes.Num();
+	Header->MeshTableOffset = (uint32)MeshTableOffset;
+
+	FMemory::Memcpy(OutData.GetData() + sizeof(FPropLayoutHeader), Records.GetData(), RecordBytes);
+	FMemory::Memcpy(OutData.GetData() + MeshTableOffset, Meshes.GetData(), MeshTableBytes);
+	FMemory::Memcpy(OutData.GetData() + PathOffset, PathData.GetData(), PathData.Num());
+}
+
+bool FPropLayout::SaveToFile(UWorld* World, const FString& Filename)
+{
+	TArray<uint8> Data;
+	Write(World, Data);
+	if (!FFileHelper::SaveArrayToFile(Data, *Filename))
+	{
+		UE_LOG(LogGravityGun, Warning, TEXT("Failed to write prop layout %s"), *Filename);
+		return false;
+	}
+	return true;
+}
+
+const FPropLayoutHeader* FPropLayout::GetHeader(const uint8* Data, int64 DataSize)
+{
+	if (!Data || DataSize < (int64)sizeof(FPropLayoutHeader)) { return nullptr; }
+
+	const FPropLayoutHeader* Header = reinterpret_cast<const FPropLayoutHeader*>(Data);
+	if (Header->Magic != Magic || Header->Version > Version || Header->RecordSize < sizeof(FPropLayoutRecord))
+	{
+		UE_LOG(LogGravityGun, Warning, TEXT("Invalid prop layout (version %u, record size %u)"), Header->Version, Header->RecordSize);
+		return nullptr;
+	}
+
+	const int64 RecordsEnd = (int64)sizeof(FPropLayoutHeader) + (int64)Header->NumRecords * Header->RecordSize;
+	const int64 MeshTableEnd = (int64)Header->MeshTableOffset + (int64)Header->NumMeshes * sizeof(FPropLayoutMesh);
+	if (Header->MeshTableOffset < RecordsEnd || DataSize < MeshTableEnd)
+	{
+		UE_LOG(LogGravityGun, Warning, TEXT("Truncated prop layout, expected %u records and %u meshes"), Header->NumRecords, Header->NumMeshes);
+		return nullptr;
+	}
+
+	///Check the references once here, so the loader can read records without bounds checks
+	const FPropLayoutMesh* Meshes = reinterpret_cast<const FPropLayoutMesh*>(Data + Header->MeshTableOffset);
+	for (uint32 Index = 0; Index < Header->NumMeshes; Index++)
+	{
+		if ((int64)Meshes[Index].PathOffset + Meshes[Index].PathLength > DataSize)
+		{
+			UE_LOG(LogGravityGun, Warning, TEXT("Truncated prop layout, mesh path %u is out of bounds"), Index);
+			return nullptr;
+		}
+	}
+	for (uint32 Index = 0; Index < Header->NumRecords; Index++)
+	{
+		if (GetRecord(Data, Index).MeshId >= Header->NumMeshes)
+		{
+			UE_LOG(LogGravityGun, Warning, TEXT("Invalid prop layout, record %u references mesh %u"), Index, GetRecord(Data, Index).MeshId);
+			return nullptr;
+		}
+	}
+	return Header;
+}
+
+const FPropLayoutRecord& FPropLayout::GetRecord(const uint8* Data, uint32 Index)
+{
+	const FPropLayoutHeader* Header = reinterpret_cast<const FPropLayoutHeader*>(Data);
+	return *reinterpret_cast<const FPropLayoutRecord*>(Data + sizeof(FPropLayoutHeader) + (int64)Index * Header->RecordSize);
+}
+
+FString FPropLayout::GetMeshPath(const uint8* Data, uint32 MeshId)
+{
+	const FPropLayoutHeader* Header = reinterpret_cast<const FPropLayoutHeader*>(Data);
+	const FPropLayoutMesh& Mesh = reinterpret_cast<const FPropLayoutMesh*>(Data + Header->MeshTableOffset)[MeshId];
+	const FUTF8ToTCHAR Path(reinterpret_cast<const ANSICHAR*>(Data + Mesh.PathOffset), Mesh.PathLength);
+	return FString(Path.Length(), Path.Get());
+}
+
+FString FPropLayout::GetLayoutFilename(const FString& Name)
+{
+	return FPaths::Combine(FPaths::ProjectContentDir(), TEXT("Levels"), TEXT("Layouts"), Name + TEXT(".ggpl"));
+}
+
+bool FPropLayoutFile::Open(const FString& Filename)
+{
+	Close();
+
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+	MappedFile.Reset(PlatformFile.OpenMapped(*Filename));
+	if (MappedFile)
+	{
+		MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	}
+
+	int64 DataSize = 0;
+	if (MappedRegion)
+	{
+		Data = MappedRegion->GetMappedPtr();
+		DataSize = MappedRegion->GetMappedSize();
+	}
+	else
+	{
+		MappedFile.Reset();
+		if (!FFileHelper::LoadFileToArray(FileData, *Filename))
+		{
+			UE_LOG(LogGravityGun, Warning, TEXT("Failed to read prop layout %s"), *Filename);
+			return false;
+		}
+		Data = FileData.GetData();
+		DataSize = FileData.Num();
+	}
+
+	Header = FPropLayout::GetHeader(Data, DataSize);
+	if (!Header)
+	{
+		Close();
+		return false;
+	}
+	return true;
+}
+
+void FPropLayoutFile::Close()
+{
+	Header = nullptr;
+	Data = nullptr;
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	FileData.Empty();
+}
@@ -0,0 +1,306 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PropLayoutLoader.h"
+#include "GravityGunPlayground.h"
+#include "GravityGunMemory.h"
+#include "GravityPropActor.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+
+DECLARE_CYCLE_STAT(TEXT("Prop Layout Load"), STAT_GGPPropLayoutLoad, STATGROUP_GravityGun);
+
+namespace PropLayoutLoading
+{
+	static void BenchCommand(const TArray<FString>& Args, UWorld* World)
+	{
+		if (!World) { return; }
+
+		const FString Name = Args.Num() > 0 ? Args[0] : UWorld::RemovePIEPrefix(World->GetMapName());
+		const float FrameBudgetMs = Args.Num() > 1 ? FCString::Atof(*Args[1]) : 2.f;
+		APropLayoutLoader::Benchmark(World, Name, FMath::Max(FrameBudgetMs, 0.f));
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs BenchConsoleCommand(
+		TEXT("ggp.Layout.Bench"),
+		TEXT("Compares loading a layout in batches with spawning its props as fully set up actors in one frame. ")
+		TEXT("Run it in a map that doesn't contain the props already. Usage: ggp.Layout.Bench [Name=map name] [BudgetMs=2]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&BenchCommand));
+}
+
+// Sets default values
+APropLayoutLoader::APropLayoutLoader()
+{
+	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	PrimaryActorTick.bCanEverTick = true;
+	PrimaryActorTick.bStartWithTickEnabled = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>("Root");
+
+	PropClass = AGravityPropActor::StaticClass();
+}
+
+// Called when the game starts or when spawned
+void APropLayoutLoader::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (!ShouldSpawnProps())
+	{
+		if (bBenchmark)
+		{
+			UE_LOG(LogGravityGun, Warning, TEXT("Layout benchmark: run it on the server, clients receive replicated props from it"));
+			Destroy();
+		}
+		return;
+	}
+
+	const FString Filename = FPropLayout::GetLayoutFilename(GetLayoutName());
+	if (bBenchmark)
+	{
+		BenchmarkPlacedProps(Filename);
+	}
+	if (!StartLoading(Filename) && bBenchmark)
+	{
+		Destroy();
+	}
+}
+
+void APropLayoutLoader::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	LayoutFile.Close();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+void APropLayoutLoader::Benchmark(UWorld* World, const FString& Name, float FrameBudgetMs)
+{
+	if (!World) { return; }
+
+	APropLayoutLoader* Loader = World->SpawnActorDeferred<APropLayoutLoader>(StaticClass(), FTransform::Identity);
+	if (!Loader) { return; }
+
+	Loader->LayoutName = Name;
+	Loader->FrameBudgetMs = FrameBudgetMs;
+	Loader->bBenchmark = true;
+	Loader->FinishSpawning(FTransform::Identity);
+}
+
+FString APropLayoutLoader::GetLayoutName() const
+{
+	return LayoutName.IsEmpty() ? UWorld::RemovePIEPrefix(GetWorld()->GetMapName()) : LayoutName;
+}
+
+bool APropLayoutLoader::ShouldSpawnProps() const
+{
+	const AActor* PropDefaults = PropClass ? PropClass->GetDefaultObject<AActor>() : nullptr;
+	///The loader itself is not replicated, so it has authority on clients too
+	return PropDefaults && (GetNetMode() != NM_Client || !PropDefaults->GetIsReplicated());
+}
+
+bool APropLayoutLoader::StartLoading(const FString& Filename)
+{
+	const double StartTime = FPlatformTime::Seconds();
+	if (!LayoutFile.Open(Filename)) { return false; }
+
+	SpawnedProps.Reset(LayoutFile.GetNumRecords());
+	NextRecord = 0;
+	NumPhysicsProps = 0;
+	ResolveMeshes();
+
+	LoadStartTime = StartTime;
+	LoadMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+	WorstFrameMs = LoadMs;
+	LoadFrames = 0;
+	SetActorTickEnabled(true);
+	return true;
+}
+
+// Called every frame
+void APropLayoutLoader::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	if (!IsLoading()) { return; }
+
+	SCOPE_CYCLE_COUNTER(STAT_GGPPropLayoutLoad);
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::Props);
+
+	const double FrameStartTime = FPlatformTime::Seconds();
+	const double Deadline = FrameStartTime + FrameBudgetMs / 1000.0;
+	const uint32 NumRecords = LayoutFile.GetNumRecords();
+	int32 NumHandled = 0;
+
+	///Bodies of the props spawned in earlier frames come first, so no prop stays without collision for longer than necessary
+	while (NumPhysicsProps < SpawnedProps.Num() && (NumHandled == 0 || FPlatformTime::Seconds() < Deadline))
+	{
+		if (AStaticMeshActor* Prop = SpawnedProps[NumPhysicsProps].Get())
+		{
+			CreatePhysics(Prop, LayoutFile.GetRecord(NumPhysicsProps));
+		}
+		NumPhysicsProps++;
+		NumHandled++;
+	}
+
+	while (NextRecord < NumRecords && (NumHandled == 0 || FPlatformTime::Seconds() < Deadline))
+	{
+		SpawnedProps.Add(SpawnProp(NextRecord, false));
+		NextRecord++;
+		NumHandled++;
+	}
+
+	const double FrameMs = (FPlatformTime::Seconds() - FrameStartTime) * 1000.0;
+	LoadMs += FrameMs;
+	WorstFrameMs = FMath::Max(WorstFrameMs, FrameMs);
+	LoadFrames++;
+
+	if (NextRecord == NumRecords && NumPhysicsProps == SpawnedProps.Num())
+	{
+		FinishLoading();
+	}
+}
+
+void APropLayoutLoader::ResolveMeshes()
+{
+	const uint32 NumMeshes = LayoutFile.GetHeader()->NumMeshes;
+	Meshes.SetNum(NumMeshes);
+	for (uint32 MeshId = 0; MeshId < NumMeshes; MeshId++)
+	{
+		const FString MeshPath = FPropLayout::GetMeshPath(LayoutFile.GetData(), MeshId);
+		Meshes[MeshId] = LoadObject<UStaticMesh>(nullptr, *MeshPath);
+		if (!Meshes[MeshId])
+		{
+			UE_LOG(LogGravityGun, Warning, TEXT("Prop layout mesh %s not found, its props are skipped"), *MeshPath);
+		}
+	}
+}
+
+AStaticMeshActor* APropLayoutLoader::SpawnProp(uint32 RecordIndex, bool bWithPhysics)
+{
+	const FPropLayoutRecord& Record = LayoutFile.GetRecord(RecordIndex);
+	UStaticMesh* Mesh = Meshes[Record.MeshId];
+	if (!Mesh) { return nullptr; }
+
+	const FTransform Transform(
+		FQuat(Record.Rotation[0], Record.Rotation[1], Record.Rotation[2], Record.Rotation[3]),
+		FVector(Record.Location[0], Record.Location[1], Record.Location[2]),
+		FVector(Record.Scale[0], Record.Scale[1], Record.Scale[2]));
+
+	///Set up the mesh before the components are registered, so the render state is only created once
+	AStaticMeshActor* Prop = GetWorld()->SpawnActorDeferred<AStaticMeshActor>(PropClass, Transform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if (!Prop) { return nullptr; }
+
+	UStaticMeshComponent* Body = Prop->GetStaticMeshComponent();
+	Body->SetMobility(EComponentMobility::Movable);
+	Body->SetStaticMesh(Mesh);
+	if (bWithPhysics)
+	{
+		ApplyPhysicsSettings(Body, Record);
+	}
+	else
+	{
+		///Without collision no physics state is created on registration, the body is created later in the budgeted pass
+		Body->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+	}
+	Prop->FinishSpawning(Transform);
+
+	if (bWithPhysics && (Record.Flags & FPropLayout::Flag_Asleep))
+	{
+		Body->PutRigidBodyToSleep();
+	}
+	return Prop;
+}
+
+void APropLayoutLoader::ApplyPhysicsSettings(UStaticMeshComponent* Body, const FPropLayoutRecord& Record) const
+{
+	///The grabbers only look for the physicsbody object type
+	Body->SetCollisionObjectType((Record.Flags & FPropLayout::Flag_Grabbable) ? ECC_PhysicsBody : ECC_WorldDynamic);
+	if (Record.Mass > 0.f)
+	{
+		Body->BodyInstance.SetMassOverride(Record.Mass);
+	}
+	Body->BodyInstance.LinearDamping = Record.LinearDamping;
+	Body->BodyInstance.AngularDamping = Record.AngularDamping;
+	Body->SetEnableGravity((Record.Flags & FPropLayout::Flag_EnableGravity) != 0);
+	Body->SetSimulatePhysics(true);
+}
+
+void APropLayoutLoader::CreatePhysics(AStaticMeshActor* Prop, const FPropLayoutRecord& Record) const
+{
+	UStaticMeshComponent* Body = Prop->GetStaticMeshComponent();
+	ApplyPhysicsSettings(Body, Record);
+	Body->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+
+	if (Record.Flags & FPropLayout::Flag_Asleep)
+	{
+		Body->PutRigidBodyToSleep();
+	}
+}
+
+void APropLayoutLoader::BenchmarkPlacedProps(const FString& Filename)
+{
+	if (!LayoutFile.Open(Filename)) { return; }
+	ResolveMeshes();
+
+	///A map creates the body of every placed prop when its components are registered, all in the frame the map is loaded
+	const double StartTime = FPlatformTime::Seconds();
+	TArray<AStaticMeshActor*> Props;
+	Props.Reserve(LayoutFile.GetNumRecords());
+	for (uint32 RecordIndex = 0; RecordIndex < LayoutFile.GetNumRecords(); RecordIndex++)
+	{
+		if (AStaticMeshActor* Prop = SpawnProp(RecordIndex, true))
+		{
+			Props.Add(Prop);
+		}
+	}
+	const double PlacedMs = (FPlatformTime::Seconds() - StartTime) * 1000.0;
+
+	for (AStaticMeshActor* Prop : Props)
+	{
+		Prop->Destroy();
+	}
+	LayoutFile.Close();
+
+	UE_LOG(LogGravityGun, Display, TEXT("Layout benchmark: %d props as placed actors took %.2f ms in a single frame"), Props.Num(), PlacedMs);
+}
+
+void APropLayoutLoader::FinishLoading()
+{
+	int32 NumProps = 0;
+	for (const TWeakObjectPtr<AStaticMeshActor>& Prop : SpawnedProps)
+	{
+		if (Prop.IsValid())
+		{
+			NumProps++;
+		}
+	}
+
+	UE_LOG(LogGravityGun, Display, TEXT("%sLoaded %d props of layout %s in %.2f ms over %d frames, worst frame %.2f ms, %.2f s until complete"),
+		bBenchmark ? TEXT("Layout benchmark: ") : TEXT(""),
+		NumProps,
+		*GetLayoutName(),
+		LoadMs,
+		LoadFrames,
+		WorstFrameMs,
+		FPlatformTime::Seconds() - LoadStartTime);
+
+	LayoutFile.Close();
+	Meshes.Empty();
+	SetActorTickEnabled(false);
+
+	if (bBenchmark)
+	{
+		for (const TWeakObjectPtr<AStaticMeshActor>& Prop : SpawnedProps)
+		{
+			if (Prop.IsValid())
+			{
+				Prop->Destroy();
+			}
+		}
+		SpawnedProps.Empty();
+		Destroy();
+	}
+}
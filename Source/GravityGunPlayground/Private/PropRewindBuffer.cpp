@@ -0,0 +1,395 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PropRewindBuffer.h"
+
+namespace PropRewindBuffer
+{
+	//Set on the body index of an entry that holds a full location instead of a delta
+	static const uint16 FullEntryFlag = 0x8000;
+	static const uint16 BodyIndexMask = 0x7FFF;
+
+	//Rotations that differ less than this (1 - |dot|) are considered unchanged
+	static const float RotationEpsilon = 1.e-6f;
+
+	template<typename T>
+	static void Write(TArray<uint8>& Buffer, const T& Value)
+	{
+		const int32 Offset = Buffer.AddUninitialized(sizeof(T));
+		FMemory::Memcpy(Buffer.GetData() + Offset, &Value, sizeof(T));
+	}
+
+	template<typename T>
+	static T Read(const uint8*& Data)
+	{
+		T Value;
+		FMemory::Memcpy(&Value, Data, sizeof(T));
+		Data += sizeof(T);
+		return Value;
+	}
+
+	static int16 QuantizeUnit(float Value)
+	{
+		return (int16)FMath::RoundToInt(FMath::Clamp(Value, -1.f, 1.f) * 32767.f);
+	}
+
+	static void WriteRotation(TArray<uint8>& Buffer, const FQuat& Rotation)
+	{
+		Write<int16>(Buffer, QuantizeUnit(Rotation.X));
+		Write<int16>(Buffer, QuantizeUnit(Rotation.Y));
+		Write<int16>(Buffer, QuantizeUnit(Rotation.Z));
+		Write<int16>(Buffer, QuantizeUnit(Rotation.W));
+	}
+
+	static FQuat ReadRotation(const uint8*& Data)
+	{
+		FQuat Rotation;
+		Rotation.X = Read<int16>(Data) / 32767.f;
+		Rotation.Y = Read<int16>(Data) / 32767.f;
+		Rotation.Z = Read<int16>(Data) / 32767.f;
+		Rotation.W = Read<int16>(Data) / 32767.f;
+		Rotation.Normalize();
+		return Rotation;
+	}
+
+	//Returns the rotation as the decoder will reconstruct it
+	static FQuat QuantizedRotation(const FQuat& Rotation)
+	{
+		FQuat Result(QuantizeUnit(Rotation.X) / 32767.f, QuantizeUnit(Rotation.Y) / 32767.f, QuantizeUnit(Rotation.Z) / 32767.f, QuantizeUnit(Rotation.W) / 32767.f);
+		Result.Normalize();
+		return Result;
+	}
+}
+
+FPropRewindBuffer::FPropRewindBuffer()
+	: CapacityBytes(0)
+	, MaxFrames(0)
+	, KeyframeInterval(1)
+{
+}
+
+FPropRewindBuffer::FPropRewindBuffer(int32 InCapacityBytes, int32 InMaxFrames, int32 InKeyframeInterval)
+	: CapacityBytes(FMath::Max(InCapacityBytes, 1024))
+	, MaxFrames(FMath::Max(InMaxFrames, 2))
+	, KeyframeInterval(FMath::Max(InKeyframeInterval, 1))
+{
+	Storage.SetNumUninitialized(CapacityBytes);
+	Frames.SetNum(MaxFrames);
+}
+
+void FPropRewindBuffer::Reset()
+{
+	FirstFrame = 0;
+	NumFrames = 0;
+	WriteOffset = 0;
+	FramesSinceKeyframe = 0;
+	NumEncodedBodies = 0;
+	EncodedStates.Reset();
+	CachedSegmentStart = INDEX_NONE;
+}
+
+void FPropRewindBuffer::RecordFrame(double Time, const TArray<FPropRewindState>& States)
+{
+	using namespace PropRewindBuffer;
+
+	if (MaxFrames == 0) { return; }
+
+	const int32 NumBodies = FMath::Min(States.Num(), (int32)BodyIndexMask + 1);
+	const bool bKeyframe = NumFrames == 0 || FramesSinceKeyframe >= KeyframeInterval || GetFirstKeyframe() == INDEX_NONE;
+
+	EncodedStates.SetNum(NumBodies);
+	FrameScratch.Reset();
+
+	for (int32 BodyIndex = 0; BodyIndex < NumBodies; BodyIndex++)
+	{
+		const FPropRewindState& State = States[BodyIndex];
+		FPropRewindState& Encoded = EncodedStates[BodyIndex];
+		const bool bNewBody = BodyIndex >= NumEncodedBodies;
+
+		const FVector Delta = (State.Location - Encoded.Location) / PositionQuantum;
+		const bool bDeltaInRange = Delta.GetAbsMax() < 32767.f;
+
+		if (!bKeyframe && !bNewBody)
+		{
+			///Skip bodies that didn't move since the previous frame
+			const bool bMoved = Delta.GetAbsMax() >= 0.5f;
+			const bool bRotated = 1.f - FMath::Abs(State.Rotation | Encoded.Rotation) > RotationEpsilon;
+			if (!bMoved && !bRotated) { continue; }
+		}
+
+		if (bKeyframe || bNewBody || !bDeltaInRange)
+		{
+			Write<uint16>(FrameScratch, (uint16)BodyIndex | FullEntryFlag);
+			Write<float>(FrameScratch, State.Location.X);
+			Write<float>(FrameScratch, State.Location.Y);
+			Write<float>(FrameScratch, State.Location.Z);
+			Encoded.Location = State.Location;
+		}
+		else
+		{
+			const int16 DeltaX = (int16)FMath::RoundToInt(Delta.X);
+			const int16 DeltaY = (int16)FMath::RoundToInt(Delta.Y);
+			const int16 DeltaZ = (int16)FMath::RoundToInt(Delta.Z);
+			Write<uint16>(FrameScratch, (uint16)BodyIndex);
+			Write<int16>(FrameScratch, DeltaX);
+			Write<int16>(FrameScratch, DeltaY);
+			Write<int16>(FrameScratch, DeltaZ);
+			Encoded.Location += FVector(DeltaX, DeltaY, DeltaZ) * PositionQuantum;
+		}
+		WriteRotation(FrameScratch, State.Rotation);
+		Encoded.Rotation = QuantizedRotation(State.Rotation);
+	}
+	NumEncodedBodies = NumBodies;
+
+	AppendFrame(Time, bKeyframe);
+	FramesSinceKeyframe = bKeyframe ? 1 : FramesSinceKeyframe + 1;
+}
+
+int32 FPropRewindBuffer::GetNumFrames() const
+{
+	const int32 FirstKeyframe = GetFirstKeyframe();
+	return FirstKeyframe == INDEX_NONE ? 0 : NumFrames - FirstKeyframe;
+}
+
+double FPropRewindBuffer::GetFrameTime(int32 FrameIndex) const
+{
+	return GetFrame(GetFirstKeyframe() + FrameIndex).Time;
+}
+
+double FPropRewindBuffer::GetOldestTime() const
+{
+	return GetNumFrames() > 0 ? GetFrameTime(0) : 0.0;
+}
+
+double FPropRewindBuffer::GetNewestTime() const
+{
+	return NumFrames > 0 ? GetFrame(NumFrames - 1).Time : 0.0;
+}
+
+bool FPropRewindBuffer::Sample(double Time, TArray<FPropRewindState>& OutStates, TBitArray<>& OutValid)
+{
+	const int32 FirstKeyframe = GetFirstKeyframe();
+	if (FirstKeyframe == INDEX_NONE || Time < GetFrame(FirstKeyframe).Time) { return false; }
+
+	///Find the last frame at or before the requested time
+	int32 Low = FirstKeyframe;
+	int32 High = NumFrames - 1;
+	while (Low < High)
+	{
+		const int32 Mid = (Low + High + 1) / 2;
+		if (GetFrame(Mid).Time <= Time)
+		{
+			Low = Mid;
+		}
+		else
+		{
+			High = Mid - 1;
+		}
+	}
+	const int32 FrameA = Low;
+	const int32 FrameB = FMath::Min(FrameA + 1, NumFrames - 1);
+
+	DecodeSegment(FrameA);
+	OutStates = SegmentCache[FrameA - CachedSegmentStart];
+	OutValid = SegmentValidCache[FrameA - CachedSegmentStart];
+
+	if (FrameB == FrameA) { return true; }
+
+	///The next frame is either in the cached segment, or it is the keyframe that starts the next segment
+	TArray<FPropRewindState> StatesB;
+	TBitArray<> ValidB;
+	if (FrameB - CachedSegmentStart < SegmentCache.Num())
+	{
+		StatesB = SegmentCache[FrameB - CachedSegmentStart];
+		ValidB = SegmentValidCache[FrameB - CachedSegmentStart];
+	}
+	else
+	{
+		const FFrameEntry& Keyframe = GetFrame(FrameB);
+		DecodeFrame(Storage.GetData() + Keyframe.Offset, Keyframe.Size, StatesB, ValidB);
+	}
+
+	const double TimeA = GetFrame(FrameA).Time;
+	const double TimeB = GetFrame(FrameB).Time;
+	const float Alpha = TimeB > TimeA ? (float)((Time - TimeA) / (TimeB - TimeA)) : 0.f;
+
+	for (int32 BodyIndex = 0; BodyIndex < OutStates.Num(); BodyIndex++)
+	{
+		if (!OutValid[BodyIndex] || BodyIndex >= StatesB.Num() || !ValidB[BodyIndex]) { continue; }
+
+		FPropRewindState& State = OutStates[BodyIndex];
+		State.Location = FMath::Lerp(State.Location, StatesB[BodyIndex].Location, Alpha);
+		State.Rotation = FQuat::Slerp(State.Rotation, StatesB[BodyIndex].Rotation, Alpha);
+	}
+	return true;
+}
+
+int32 FPropRewindBuffer::GetUsedBytes() const
+{
+	int32 UsedBytes = 0;
+	for (int32 FrameIndex = 0; FrameIndex < NumFrames; FrameIndex++)
+	{
+		UsedBytes += GetFrame(FrameIndex).Size;
+	}
+	return UsedBytes;
+}
+
+int32 FPropRewindBuffer::GetAllocatedBytes() const
+{
+	return Storage.GetAllocatedSize() + Frames.GetAllocatedSize() + EncodedStates.GetAllocatedSize() + FrameScratch.GetAllocatedSize();
+}
+
+float FPropRewindBuffer::GetBytesPerSecond() const
+{
+	if (NumFrames < 2) { return 0.f; }
+
+	const double Duration = GetFrame(NumFrames - 1).Time - GetFrame(0).Time;
+	return Duration > 0.0 ? (float)(GetUsedBytes() / Duration) : 0.f;
+}
+
+const FPropRewindBuffer::FFrameEntry& FPropRewindBuffer::GetFrame(int32 FrameIndex) const
+{
+	check(FrameIndex >= 0 && FrameIndex < NumFrames);
+	return Frames[(FirstFrame + FrameIndex) % MaxFrames];
+}
+
+int32 FPropRewindBuffer::GetFirstKeyframe() const
+{
+	for (int32 FrameIndex = 0; FrameIndex < NumFrames; FrameIndex++)
+	{
+		if (GetFrame(FrameIndex).bKeyframe)
+		{
+			return FrameIndex;
+		}
+	}
+	return INDEX_NONE;
+}
+
+void FPropRewindBuffer::AppendFrame(double Time, bool bKeyframe)
+{
+	const int32 Size = FrameScratch.Num();
+	if (Size > CapacityBytes)
+	{
+		///A single frame doesn't fit, the history can't be kept for this many bodies
+		Reset();
+		return;
+	}
+
+	CachedSegmentStart = INDEX_NONE;
+
+	if (NumFrames == MaxFrames)
+	{
+		DropOldestFrame();
+	}
+
+	int32 Offset = WriteOffset;
+	if (Offset + Size > CapacityBytes)
+	{
+		///Wrap around. The frames at the end of the storage are the oldest ones and are dropped first.
+		while (NumFrames > 0 && GetFrame(0).Offset >= WriteOffset)
+		{
+			DropOldestFrame();
+		}
+		Offset = 0;
+	}
+
+	///Drop the oldest frames that overlap the region that will be written
+	while (NumFrames > 0)
+	{
+		const FFrameEntry& Oldest = GetFrame(0);
+		const bool bOverlaps = Oldest.Offset < Offset + Size && Offset < Oldest.Offset + Oldest.Size;
+		if (!bOverlaps) { break; }
+		DropOldestFrame();
+	}
+
+	FMemory::Memcpy(Storage.GetData() + Offset, FrameScratch.GetData(), Size);
+
+	FFrameEntry& Entry = Frames[(FirstFrame + NumFrames) % MaxFrames];
+	Entry.Time = Time;
+	Entry.Offset = Offset;
+	Entry.Size = Size;
+	Entry.bKeyframe = bKeyframe;
+	NumFrames++;
+
+	WriteOffset = Offset + Size;
+}
+
+void FPropRewindBuffer::DropOldestFrame()
+{
+	check(NumFrames > 0);
+	FirstFrame = (FirstFrame + 1) % MaxFrames;
+	NumFrames--;
+	CachedSegmentStart = INDEX_NONE;
+}
+
+void FPropRewindBuffer::DecodeSegment(int32 FrameIndex)
+{
+	if (CachedSegmentStart != INDEX_NONE && FrameIndex >= CachedSegmentStart && FrameIndex - CachedSegmentStart < SegmentCache.Num())
+	{
+		return;
+	}
+
+	int32 SegmentStart = FrameIndex;
+	while (SegmentStart > 0 && !GetFrame(SegmentStart).bKeyframe)
+	{
+		SegmentStart--;
+	}
+	int32 SegmentEnd = FrameIndex + 1;
+	while (SegmentEnd < NumFrames && !GetFrame(SegmentEnd).bKeyframe)
+	{
+		SegmentEnd++;
+	}
+
+	const int32 SegmentLength = SegmentEnd - SegmentStart;
+	SegmentCache.SetNum(SegmentLength);
+	SegmentValidCache.SetNum(SegmentLength);
+
+	TArray<FPropRewindState> States;
+	TBitArray<> Valid;
+	for (int32 Index = 0; Index < SegmentLength; Index++)
+	{
+		const FFrameEntry& Frame = GetFrame(SegmentStart + Index);
+		DecodeFrame(Storage.GetData() + Frame.Offset, Frame.Size, States, Valid);
+		SegmentCache[Index] = States;
+		SegmentValidCache[Index] = Valid;
+	}
+	CachedSegmentStart = SegmentStart;
+}
+
+void FPropRewindBuffer::DecodeFrame(const uint8* Data, int32 Size, TArray<FPropRewindState>& InOutStates, TBitArray<>& InOutValid)
+{
+	using namespace PropRewindBuffer;
+
+	const uint8* End = Data + Size;
+	while (Data < End)
+	{
+		const uint16 RawIndex = Read<uint16>(Data);
+		const int32 BodyIndex = RawIndex & BodyIndexMask;
+
+		if (BodyIndex >= InOutStates.Num())
+		{
+			InOutStates.SetNum(BodyIndex + 1);
+		}
+		if (BodyIndex >= InOutValid.Num())
+		{
+			InOutValid.Add(false, BodyIndex + 1 - InOutValid.Num());
+		}
+
+		FPropRewindState& State = InOutStates[BodyIndex];
+		if (RawIndex & FullEntryFlag)
+		{
+			State.Location.X = Read<float>(Data);
+			State.Location.Y = Read<float>(Data);
+			State.Location.Z = Read<float>(Data);
+			InOutValid[BodyIndex] = true;
+		}
+		else
+		{
+			const int16 DeltaX = Read<int16>(Data);
+			const int16 DeltaY = Read<int16>(Data);
+			const int16 DeltaZ = Read<int16>(Data);
+			State.Location += FVector(DeltaX, DeltaY, DeltaZ) * PositionQuantum;
+		}
+		State.Rotation = ReadRotation(Data);
+	}
+}
@@ -0,0 +1,264 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PropRewindComponent.h"
+#include "GravityGunPlayground.h"
+#include "GravityGunMemory.h"
+#include "GravityGunProps.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "UObject/UObjectIterator.h"
+
+DECLARE_CYCLE_STAT(TEXT("Rewind Record"), STAT_GGPRewindRecord, STATGROUP_GravityGun);
+DECLARE_CYCLE_STAT(TEXT("Rewind Playback"), STAT_GGPRewindPlayback, STATGROUP_GravityGun);
+
+namespace PropRewind
+{
+	static void StatsCommand(const TArray<FString>& Args, UWorld* World)
+	{
+		for (TObjectIterator<UPropRewindComponent> It; It; ++It)
+		{
+			if (It->GetWorld() != World) { continue; }
+
+			UE_LOG(LogGravityGun, Display, TEXT("%s: %d bodies, %.2f s history, %.1f KB used, %.1f KB per second"),
+				*It->GetOwner()->GetName(),
+				It->GetNumTrackedBodies(),
+				It->GetAvailableRewindSeconds(),
+				It->GetHistoryUsedBytes() / 1024.f,
+				It->GetHistoryBytesPerSecond() / 1024.f);
+		}
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs StatsConsoleCommand(
+		TEXT("ggp.Rewind.Stats"),
+		TEXT("Logs the tracked bodies and memory per second of history of every rewind component."),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&StatsCommand));
+}
+
+// Sets default values for this component's properties
+UPropRewindComponent::UPropRewindComponent()
+{
+	// Set this component to be initialized when the game starts, and to be ticked every frame.  You can turn these features
+	// off to improve performance if you don't need them.
+	PrimaryComponentTick.bCanEverTick = true;
+	PrimaryComponentTick.TickGroup = TG_PostPhysics;
+}
+
+// Called when the game starts
+void UPropRewindComponent::BeginPlay()
+{
+	Super::BeginPlay();
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::GrabLaunch);
+
+	const int32 MaxFrames = FMath::CeilToInt(MaximumHistorySeconds * SampleRate) + 1;
+	History = FPropRewindBuffer(HistoryBufferKB * 1024, MaxFrames, KeyframeInterval);
+	UpdateTrackedMemory();
+}
+
+void UPropRewindComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	FGravityGunMemory::TrackFree(EGravityGunMemoryCategory::GrabLaunch, TrackedMemoryBytes);
+	TrackedMemoryBytes = 0;
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Called every frame
+void UPropRewindComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+	Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+	if (bRewinding)
+	{
+		PlaybackTime -= DeltaTime * RewindSpeed;
+
+		///Reached the start of the history
+		if (PlaybackTime <= History.GetOldestTime())
+		{
+			PlaybackTime = History.GetOldestTime();
+			ApplyPlayback();
+			StopRewind();
+			return;
+		}
+		ApplyPlayback();
+		return;
+	}
+
+	RecordTime += DeltaTime;
+	if (TrackedBodies.Num() == 0) { return; }
+
+	if (RecordTime - LastSampleTime >= 1.0 / SampleRate)
+	{
+		RecordSample();
+		LastSampleTime = RecordTime;
+	}
+}
+
+void UPropRewindComponent::TrackActor(AActor* Actor)
+{
+	if (bRewinding) { return; }
+
+	UPrimitiveComponent* Body = FGravityGunProps::GetPropComponent(Actor);
+	if (!Body) { return; }
+
+	if (TrackedBodies.Contains(Body)) { return; }
+
+	int32 Slot = INDEX_NONE;
+	if (TrackedBodies.Num() > 0 && TrackedBodies.Num() >= MaximumTrackedBodies)
+	{
+		///The history of the other bodies is kept, only the history of the replaced body is no longer played back
+		Slot = FindReusableSlot();
+	}
+	else
+	{
+		Slot = TrackedBodies.AddDefaulted();
+		TrackedIds.AddZeroed();
+		SlotStartTimes.AddZeroed();
+		LastMoveTimes.AddZeroed();
+	}
+	TrackedBodies[Slot] = Body;
+	TrackedIds[Slot] = FGravityGunProps::GetPropId(Actor);
+	SlotStartTimes[Slot] = -1.0;
+	LastMoveTimes[Slot] = RecordTime;
+}
+
+int32 UPropRewindComponent::FindReusableSlot()
+{
+	int32 OldestSlot = 0;
+	double OldestStartTime = RecordTime;
+	for (int32 Slot = 0; Slot < TrackedBodies.Num(); Slot++)
+	{
+		///A body at rest for the whole history has the same transform in all of it, rewinding wouldn't move it
+		if (!GetTrackedBody(Slot) || RecordTime - LastMoveTimes[Slot] > MaximumHistorySeconds)
+		{
+			return Slot;
+		}
+
+		///Bodies that haven't been sampled yet were only just tracked
+		if (SlotStartTimes[Slot] >= 0.0 && SlotStartTimes[Slot] < OldestStartTime)
+		{
+			OldestSlot = Slot;
+			OldestStartTime = SlotStartTimes[Slot];
+		}
+	}
+	return OldestSlot;
+}
+
+void UPropRewindComponent::StartRewind()
+{
+	if (bRewinding || History.GetNumFrames() < 2) { return; }
+
+	bRewinding = true;
+	PlaybackTime = History.GetNewestTime();
+
+	///Tracked bodies are moved kinematically while rewinding, so the solver doesn't fight the written transforms
+	for (int32 BodyIndex = 0; BodyIndex < TrackedBodies.Num(); BodyIndex++)
+	{
+		if (UPrimitiveComponent* Body = GetTrackedBody(BodyIndex))
+		{
+			Body->SetSimulatePhysics(false);
+		}
+	}
+	OnRewindStart.Broadcast();
+}
+
+void UPropRewindComponent::StopRewind()
+{
+	if (!bRewinding) { return; }
+
+	bRewinding = false;
+	for (int32 BodyIndex = 0; BodyIndex < TrackedBodies.Num(); BodyIndex++)
+	{
+		if (UPrimitiveComponent* Body = GetTrackedBody(BodyIndex))
+		{
+			Body->SetSimulatePhysics(true);
+			Body->WakeRigidBody();
+		}
+	}
+
+	///The history after the playback time no longer happened, start recording from the current state
+	History.Reset();
+	LastSampleTime = -1.0;
+	OnRewindStop.Broadcast();
+}
+
+float UPropRewindComponent::GetAvailableRewindSeconds() const
+{
+	if (History.GetNumFrames() < 2) { return 0.f; }
+	return (float)(History.GetNewestTime() - History.GetOldestTime());
+}
+
+UPrimitiveComponent* UPropRewindComponent::GetTrackedBody(int32 BodyIndex)
+{
+	if (UPrimitiveComponent* Body = TrackedBodies[BodyIndex].Get())
+	{
+		return Body;
+	}
+
+	///Streamed props are respawned as new actors with the identifier of the old one
+	UPrimitiveComponent* Body = FGravityGunProps::GetPropComponent(FGravityGunProps::FindPropWithAssignedId(TrackedIds[BodyIndex]));
+	if (!Body) { return nullptr; }
+
+	TrackedBodies[BodyIndex] = Body;
+	if (bRewinding)
+	{
+		Body->SetSimulatePhysics(false);
+	}
+	return Body;
+}
+
+void UPropRewindComponent::RecordSample()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GGPRewindRecord);
+
+	BodyStates.SetNum(TrackedBodies.Num());
+	for (int32 BodyIndex = 0; BodyIndex < TrackedBodies.Num(); BodyIndex++)
+	{
+		///Destroyed and streamed out bodies keep their last state, so they don't produce any deltas
+		const UPrimitiveComponent* Body = GetTrackedBody(BodyIndex);
+		if (!Body) { continue; }
+
+		BodyStates[BodyIndex].Location = Body->GetComponentLocation();
+		BodyStates[BodyIndex].Rotation = Body->GetComponentQuat();
+		if (SlotStartTimes[BodyIndex] < 0.0)
+		{
+			SlotStartTimes[BodyIndex] = RecordTime;
+		}
+		if (Body->RigidBodyIsAwake())
+		{
+			LastMoveTimes[BodyIndex] = RecordTime;
+		}
+	}
+	History.RecordFrame(RecordTime, BodyStates);
+}
+
+void UPropRewindComponent::ApplyPlayback()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GGPRewindPlayback);
+
+	if (!History.Sample(PlaybackTime, BodyStates, ValidStates)) { return; }
+
+	///Decoding and interpolation happen for all bodies at once above, the transforms are written in one pass here
+	const int32 NumBodies = FMath::Min(BodyStates.Num(), TrackedBodies.Num());
+	for (int32 BodyIndex = 0; BodyIndex < NumBodies; BodyIndex++)
+	{
+		///Before its first sample the slot held the history of a previous body
+		if (!ValidStates[BodyIndex] || SlotStartTimes[BodyIndex] < 0.0 || PlaybackTime < SlotStartTimes[BodyIndex]) { continue; }
+
+		UPrimitiveComponent* Body = GetTrackedBody(BodyIndex);
+		if (!Body) { continue; }
+
+		Body->SetWorldLocationAndRotation(BodyStates[BodyIndex].Location, BodyStates[BodyIndex].Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+	}
+}
+
+void UPropRewindComponent::UpdateTrackedMemory()
+{
+	if (TrackedMemoryBytes > 0)
+	{
+		FGravityGunMemory::TrackFree(EGravityGunMemoryCategory::GrabLaunch, TrackedMemoryBytes);
+	}
+	TrackedMemoryBytes = History.GetAllocatedBytes();
+	FGravityGunMemory::TrackAllocation(EGravityGunMemoryCategory::GrabLaunch, TrackedMemoryBytes);
+}
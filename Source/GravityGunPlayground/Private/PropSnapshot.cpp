@@ -0,0 +1,217 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PropSnapshot.h"
+#include "GravityGunPlayground.h"
+#include "GravityGunMemory.h"
+#include "GravityGunProps.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+#include "HAL/IConsoleManager.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+static_assert(sizeof(FPropSnapshotHeader) == 24, "Snapshot header layout changed, bump FPropSnapshot::Version");
+static_assert(sizeof(FPropSnapshotRecord) == 64, "Snapshot record layout changed, bump FPropSnapshot::Version");
+
+DECLARE_CYCLE_STAT(TEXT("Snapshot Capture"), STAT_GGPSnapshotCapture, STATGROUP_GravityGun);
+DECLARE_CYCLE_STAT(TEXT("Snapshot Restore"), STAT_GGPSnapshotRestore, STATGROUP_GravityGun);
+
+namespace PropSnapshot
+{
+	static FString GetNameArg(const TArray<FString>& Args)
+	{
+		return Args.Num() > 0 ? Args[0] : FString(TEXT("Default"));
+	}
+
+	static void SaveCommand(const TArray<FString>& Args, UWorld* World)
+	{
+		const FString Filename = FPropSnapshot::GetSnapshotFilename(GetNameArg(Args));
+		if (FPropSnapshot::SaveToFile(World, Filename))
+		{
+			UE_LOG(LogGravityGun, Display, TEXT("Saved prop snapshot to %s"), *Filename);
+		}
+	}
+
+	static void RestoreCommand(const TArray<FString>& Args, UWorld* World)
+	{
+		const FString Filename = FPropSnapshot::GetSnapshotFilename(GetNameArg(Args));
+		const double StartTime = FPlatformTime::Seconds();
+		const int32 NumRestored = FPropSnapshot::RestoreFromFile(World, Filename);
+		if (NumRestored != INDEX_NONE)
+		{
+			UE_LOG(LogGravityGun, Display, TEXT("Restored %d props from %s in %.2f ms"), NumRestored, *Filename, (FPlatformTime::Seconds() - StartTime) * 1000.0);
+		}
+	}
+
+	static FAutoConsoleCommandWithWorldAndArgs SaveConsoleCommand(
+		TEXT("ggp.Snapshot.Save"),
+		TEXT("Saves the physics state of all props. Usage: ggp.Snapshot.Save [Name]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&SaveCommand));
+
+	static FAutoConsoleCommandWithWorldAndArgs RestoreConsoleCommand(
+		TEXT("ggp.Snapshot.Restore"),
+		TEXT("Restores the physics state of all props from a snapshot. Usage: ggp.Snapshot.Restore [Name]"),
+		FConsoleCommandWithWorldAndArgsDelegate::CreateStatic(&RestoreCommand));
+}
+
+void FPropSnapshot::Capture(UWorld* World, TArray<uint8>& OutData)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GGPSnapshotCapture);
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::Props);
+
+	TArray<UPrimitiveComponent*> Props;
+	FGravityGunProps::GetAllProps(World, Props);
+
+	OutData.SetNumUninitialized(sizeof(FPropSnapshotHeader) + Props.Num() * sizeof(FPropSnapshotRecord));
+
+	FPropSnapshotHeader* Header = reinterpret_cast<FPropSnapshotHeader*>(OutData.GetData());
+	Header->Magic = Magic;
+	Header->Version = Version;
+	Header->RecordSize = sizeof(FPropSnapshotRecord);
+	Header->NumRecords = Props.Num();
+	Header->WorldTime = World ? World->GetTimeSeconds() : 0.0;
+
+	FPropSnapshotRecord* Records = reinterpret_cast<FPropSnapshotRecord*>(OutData.GetData() + sizeof(FPropSnapshotHeader));
+	for (int32 Index = 0; Index < Props.Num(); Index++)
+	{
+		const UPrimitiveComponent* Prop = Props[Index];
+		const FVector Location = Prop->GetComponentLocation();
+		const FQuat Rotation = Prop->GetComponentQuat();
+		const FVector LinearVelocity = Prop->GetPhysicsLinearVelocity();
+		const FVector AngularVelocity = Prop->GetPhysicsAngularVelocityInRadians();
+
+		FPropSnapshotRecord& Record = Records[Index];
+		Record.PropId = FGravityGunProps::GetPropId(Prop->GetOwner());
+		Record.Location[0] = Location.X;
+		Record.Location[1] = Location.Y;
+		Record.Location[2] = Location.Z;
+		Record.Rotation[0] = Rotation.X;
+		Record.Rotation[1] = Rotation.Y;
+		Record.Rotation[2] = Rotation.Z;
+		Record.Rotation[3] = Rotation.W;
+		Record.LinearVelocity[0] = LinearVelocity.X;
+		Record.LinearVelocity[1] = LinearVelocity.Y;
+		Record.LinearVelocity[2] = LinearVelocity.Z;
+		Record.AngularVelocity[0] = AngularVelocity.X;
+		Record.AngularVelocity[1] = AngularVelocity.Y;
+		Record.AngularVelocity[2] = AngularVelocity.Z;
+		Record.Flags = Prop->RigidBodyIsAwake() ? 0 : Flag_Asleep;
+	}
+}
+
+int32 FPropSnapshot::Restore(UWorld* World, const uint8* Data, int64 DataSize)
+{
+	SCOPE_CYCLE_COUNTER(STAT_GGPSnapshotRestore);
+
+	if (!World || !Data || DataSize < (int64)sizeof(FPropSnapshotHeader)) { return INDEX_NONE; }
+
+	const FPropSnapshotHeader* Header = reinterpret_cast<const FPropSnapshotHeader*>(Data);
+	if (Header->Magic != Magic || Header->Version > Version || Header->RecordSize < sizeof(FPropSnapshotRecord))
+	{
+		UE_LOG(LogGravityGun, Warning, TEXT("Invalid prop snapshot (version %u, record size %u)"), Header->Version, Header->RecordSize);
+		return INDEX_NONE;
+	}
+	if (DataSize < (int64)sizeof(FPropSnapshotHeader) + (int64)Header->NumRecords * Header->RecordSize)
+	{
+		UE_LOG(LogGravityGun, Warning, TEXT("Truncated prop snapshot, expected %u records"), Header->NumRecords);
+		return INDEX_NONE;
+	}
+
+	///Map the ids of the props currently in the world to their components
+	TArray<UPrimitiveComponent*> Props;
+	FGravityGunProps::GetAllProps(World, Props);
+	TMap<uint64, UPrimitiveComponent*> PropsById;
+	PropsById.Reserve(Props.Num());
+	for (UPrimitiveComponent* Prop : Props)
+	{
+		PropsById.Add(FGravityGunProps::GetPropId(Prop->GetOwner()), Prop);
+	}
+
+	///Resolve all records first, so the writes below are one tight pass over the matched props
+	TArray<TPair<UPrimitiveComponent*, const FPropSnapshotRecord*>> Matches;
+	Matches.Reserve(Header->NumRecords);
+	const uint8* RecordData = Data + sizeof(FPropSnapshotHeader);
+	for (uint32 Index = 0; Index < Header->NumRecords; Index++)
+	{
+		const FPropSnapshotRecord* Record = reinterpret_cast<const FPropSnapshotRecord*>(RecordData + Index * Header->RecordSize);
+		if (UPrimitiveComponent** Prop = PropsById.Find(Record->PropId))
+		{
+			Matches.Emplace(*Prop, Record);
+		}
+	}
+
+	///Teleport all bodies before touching velocities, so no body is woken by a neighbour that has not been moved yet
+	for (const TPair<UPrimitiveComponent*, const FPropSnapshotRecord*>& Match : Matches)
+	{
+		const FPropSnapshotRecord& Record = *Match.Value;
+		Match.Key->SetWorldLocationAndRotation(
+			FVector(Record.Location[0], Record.Location[1], Record.Location[2]),
+			FQuat(Record.Rotation[0], Record.Rotation[1], Record.Rotation[2], Record.Rotation[3]),
+			false,
+			nullptr,
+			ETeleportType::TeleportPhysics);
+	}
+
+	for (const TPair<UPrimitiveComponent*, const FPropSnapshotRecord*>& Match : Matches)
+	{
+		const FPropSnapshotRecord& Record = *Match.Value;
+		UPrimitiveComponent* Prop = Match.Key;
+		if (Record.Flags & Flag_Asleep)
+		{
+			Prop->SetPhysicsLinearVelocity(FVector::ZeroVector);
+			Prop->SetPhysicsAngularVelocityInRadians(FVector::ZeroVector);
+			Prop->PutRigidBodyToSleep();
+		}
+		else
+		{
+			Prop->SetPhysicsLinearVelocity(FVector(Record.LinearVelocity[0], Record.LinearVelocity[1], Record.LinearVelocity[2]));
+			Prop->SetPhysicsAngularVelocityInRadians(FVector(Record.AngularVelocity[0], Record.AngularVelocity[1], Record.AngularVelocity[2]));
+			Prop->WakeRigidBody();
+		}
+	}
+
+	return Matches.Num();
+}
+
+bool FPropSnapshot::SaveToFile(UWorld* World, const FString& Filename)
+{
+	TArray<uint8> Data;
+	Capture(World, Data);
+	if (!FFileHelper::SaveArrayToFile(Data, *Filename))
+	{
+		UE_LOG(LogGravityGun, Warning, TEXT("Failed to write prop snapshot %s"), *Filename);
+		return false;
+	}
+	return true;
+}
+
+int32 FPropSnapshot::RestoreFromFile(UWorld* World, const FString& Filename)
+{
+	IPlatformFile& PlatformFile = FPlatformFileManager::Get().GetPlatformFile();
+
+	///The region has to be released before the file handle, hence the declaration order
+	TUniquePtr<IMappedFileHandle> MappedFile(PlatformFile.OpenMapped(*Filename));
+	if (MappedFile)
+	{
+		TUniquePtr<IMappedFileRegion> MappedRegion(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+		if (MappedRegion)
+		{
+			return Restore(World, MappedRegion->GetMappedPtr(), MappedRegion->GetMappedSize());
+		}
+	}
+
+	TArray<uint8> Data;
+	if (!FFileHelper::LoadFileToArray(Data, *Filename))
+	{
+		UE_LOG(LogGravityGun, Warning, TEXT("Failed to read prop snapshot %s"), *Filename);
+		return INDEX_NONE;
+	}
+	return Restore(World, Data.GetData(), Data.Num());
+}
+
+FString FPropSnapshot::GetSnapshotFilename(const FString& Name)
+{
+	return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("Snapshots"), Name + TEXT(".ggps"));
+}
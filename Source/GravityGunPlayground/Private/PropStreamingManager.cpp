@@ -0,0 +1,347 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PropStreamingManager.h"
+#include "GravityGunPlayground.h"
+#include "GravityGunMemory.h"
+#include "GravityGunProps.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+DECLARE_CYCLE_STAT(TEXT("Prop Streaming Update"), STAT_GGPPropStreamingUpdate, STATGROUP_GravityGun);
+DECLARE_DWORD_COUNTER_STAT(TEXT("Streamed Props Loaded"), STAT_GGPStreamedPropsLoaded, STATGROUP_GravityGun);
+
+namespace PropStreaming
+{
+	enum ERecordFlags : uint16
+	{
+		Flag_Asleep = 1 << 0
+	};
+}
+
+// Sets default values
+APropStreamingManager::APropStreamingManager()
+{
+	// Set this actor to call Tick() every frame.  You can turn this off to improve performance if you don't need it.
+	PrimaryActorTick.bCanEverTick = true;
+}
+
+// Called when the game starts or when spawned
+void APropStreamingManager::BeginPlay()
+{
+	Super::BeginPlay();
+
+	///Start with every placed prop loaded. The first update unloads everything that isn't near a player.
+	TArray<UPrimitiveComponent*> Props;
+	FGravityGunProps::GetAllProps(GetWorld(), Props);
+	for (UPrimitiveComponent* Prop : Props)
+	{
+		if (Cast<UStaticMeshComponent>(Prop))
+		{
+			LoadedProps.Add(Prop->GetOwner());
+			LoadedCells.Add(GetCell(Prop->GetComponentLocation()));
+		}
+	}
+	UpdateStreaming();
+}
+
+void APropStreamingManager::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::Props);
+	for (const TWeakObjectPtr<AActor>& Prop : LoadedProps)
+	{
+		FGravityGunProps::ClearPropId(Prop.Get());
+	}
+	for (const TPair<FIntPoint, TArray<FPropStreamingRecord>>& Cell : UnloadedCells)
+	{
+		FGravityGunMemory::TrackFree(EGravityGunMemoryCategory::Props, Cell.Value.GetAllocatedSize());
+	}
+	UnloadedCells.Empty();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+// Called every frame
+void APropStreamingManager::Tick(float DeltaTime)
+{
+	Super::Tick(DeltaTime);
+
+	TimeSinceUpdate += DeltaTime;
+	if (TimeSinceUpdate >= UpdateInterval)
+	{
+		TimeSinceUpdate = 0.f;
+		UpdateStreaming();
+	}
+}
+
+FIntPoint APropStreamingManager::GetCell(const FVector& Location) const
+{
+	return FIntPoint(FMath::FloorToInt(Location.X / CellSize), FMath::FloorToInt(Location.Y / CellSize));
+}
+
+int32 APropStreamingManager::GetNumUnloadedProps() const
+{
+	int32 NumProps = 0;
+	for (const TPair<FIntPoint, TArray<FPropStreamingRecord>>& Cell : UnloadedCells)
+	{
+		NumProps += Cell.Value.Num();
+	}
+	return NumProps;
+}
+
+int64 APropStreamingManager::GetUnloadedBytes() const
+{
+	int64 Bytes = 0;
+	for (const TPair<FIntPoint, TArray<FPropStreamingRecord>>& Cell : UnloadedCells)
+	{
+		Bytes += Cell.Value.GetAllocatedSize();
+	}
+	return Bytes;
+}
+
+void APropStreamingManager::UpdateStreaming()
+{
+	SCOPE_CYCLE_COUNTER(STAT_GGPPropStreamingUpdate);
+
+	TSet<FIntPoint> DesiredCells;
+	GetDesiredCells(DesiredCells);
+
+	UnloadProps(DesiredCells);
+
+	for (const FIntPoint& Cell : DesiredCells)
+	{
+		if (!LoadedCells.Contains(Cell))
+		{
+			LoadCell(Cell);
+		}
+	}
+	LoadedCells = MoveTemp(DesiredCells);
+
+	SET_DWORD_STAT(STAT_GGPStreamedPropsLoaded, LoadedProps.Num());
+}
+
+void APropStreamingManager::GetDesiredCells(TSet<FIntPoint>& OutCells) const
+{
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		const APlayerController* PlayerController = It->Get();
+		if (!PlayerController) { continue; }
+
+		///The view follows the pawn while playing, and keeps the cells around a spectating or dead player loaded as well
+		FVector ViewLocation;
+		FRotator ViewRotation;
+		PlayerController->GetPlayerViewPoint(ViewLocation, ViewRotation);
+
+		const FIntPoint Center = GetCell(ViewLocation);
+		for (int32 X = -LoadRadiusCells; X <= LoadRadiusCells; X++)
+		{
+			for (int32 Y = -LoadRadiusCells; Y <= LoadRadiusCells; Y++)
+			{
+				OutCells.Add(Center + FIntPoint(X, Y));
+			}
+		}
+	}
+}
+
+void APropStreamingManager::UnloadProps(const TSet<FIntPoint>& DesiredCells)
+{
+	GRAVITYGUN_LLM_SCOPE(EGravityGunMemoryCategory::Props);
+
+	///Held props are never unloaded
+	TSet<UPrimitiveComponent*> HeldComponents;
+	FGravityGunProps::GetHeldComponents(GetWorld(), HeldComponents);
+
+	for (int32 Index = LoadedProps.Num() - 1; Index >= 0; Index--)
+	{
+		AActor* Prop = LoadedProps[Index].Get();
+		UPrimitiveComponent* Body = FGravityGunProps::GetPropComponent(Prop);
+		if (!Body)
+		{
+			///Destroyed, or no longer simulating. Either way this streamer can't restore it.
+			LoadedProps.RemoveAtSwap(Index);
+			continue;
+		}
+
+		const FIntPoint Cell = GetCell(Body->GetComponentLocation());
+		if (DesiredCells.Contains(Cell) || HeldComponents.Contains(Body)) { continue; }
+
+		const int32 Archetype = FindOrAddArchetype(Prop);
+		if (Archetype == INDEX_NONE) { continue; }
+
+		const FTransform Transform = Body->GetComponentTransform();
+		const FVector Location = Transform.GetLocation();
+		const FQuat Rotation = Transform.GetRotation();
+		const FVector Scale = Transform.GetScale3D();
+		const FVector LinearVelocity = Body->GetPhysicsLinearVelocity();
+		const FVector AngularVelocity = Body->GetPhysicsAngularVelocityInRadians();
+
+		FPropStreamingRecord Record;
+		Record.PropId = FGravityGunProps::GetPropId(Prop);
+		Record.Archetype = (uint16)Archetype;
+		Record.Flags = Body->RigidBodyIsAwake() ? 0 : PropStreaming::Flag_Asleep;
+		Record.Location[0] = Location.X;
+		Record.Location[1] = Location.Y;
+		Record.Location[2] = Location.Z;
+		Record.Rotation[0] = Rotation.X;
+		Record.Rotation[1] = Rotation.Y;
+		Record.Rotation[2] = Rotation.Z;
+		Record.Rotation[3] = Rotation.W;
+		Record.Scale[0] = Scale.X;
+		Record.Scale[1] = Scale.Y;
+		Record.Scale[2] = Scale.Z;
+		Record.LinearVelocity[0] = LinearVelocity.X;
+		Record.LinearVelocity[1] = LinearVelocity.Y;
+		Record.LinearVelocity[2] = LinearVelocity.Z;
+		Record.AngularVelocity[0] = AngularVelocity.X;
+		Record.AngularVelocity[1] = AngularVelocity.Y;
+		Record.AngularVelocity[2] = AngularVelocity.Z;
+
+		TArray<FPropStreamingRecord>& CellRecords = UnloadedCells.FindOrAdd(Cell);
+		const int64 PreviousBytes = CellRecords.GetAllocatedSize();
+		CellRecords.Add(Record);
+		if (CellRecords.GetAllocatedSize() != PreviousBytes)
+		{
+			if (PreviousBytes > 0)
+			{
+				FGravityGunMemory::TrackFree(EGravityGunMemoryCategory::Props, PreviousBytes);
+			}
+			FGravityGunMemory::TrackAllocation(EGravityGunMemoryCategory::Props, CellRecords.GetAllocatedSize());
+		}
+
+		FGravityGunProps::ClearPropId(Prop);
+		Prop->Destroy();
+		LoadedProps.RemoveAtSwap(Index);
+	}
+}
+
+void APropStreamingManager::LoadCell(const FIntPoint& Cell)
+{
+	TArray<FPropStreamingRecord>* CellRecords = UnloadedCells.Find(Cell);
+	if (!CellRecords) { return; }
+
+	///Free the size that was tracked while unloading, a copy of the array would be allocated to fit
+	FGravityGunMemory::TrackFree(EGravityGunMemoryCategory::Props, CellRecords->GetAllocatedSize());
+	const TArray<FPropStreamingRecord> Records = MoveTemp(*CellRecords);
+	UnloadedCells.Remove(Cell);
+
+	for (const FPropStreamingRecord& Record : Records)
+	{
+		if (!Archetypes.IsValidIndex(Record.Archetype)) { continue; }
+		const FPropStreamingArchetype& Archetype = Archetypes[Record.Archetype];
+		if (!Archetype.ActorClass) { continue; }
+
+		const FTransform Transform(
+			FQuat(Record.Rotation[0], Record.Rotation[1], Record.Rotation[2], Record.Rotation[3]),
+			FVector(Record.Location[0], Record.Location[1], Record.Location[2]),
+			FVector(Record.Scale[0], Record.Scale[1], Record.Scale[2]));
+
+		///Set up the mesh before the components are registered, so the physics body is only created once
+		AActor* Prop = GetWorld()->SpawnActorDeferred<AActor>(Archetype.ActorClass, Transform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+		if (!Prop) { continue; }
+
+		if (UStaticMeshComponent* MeshComponent = Cast<UStaticMeshComponent>(Prop->GetRootComponent()))
+		{
+			MeshComponent->SetStaticMesh(Archetype.Mesh);
+			for (int32 MaterialIndex = 0; MaterialIndex < Archetype.Materials.Num(); MaterialIndex++)
+			{
+				MeshComponent->SetMaterial(MaterialIndex, Archetype.Materials[MaterialIndex]);
+			}
+			Archetype.ApplyBodySettings(MeshComponent);
+		}
+		Prop->FinishSpawning(Transform);
+		FGravityGunProps::SetPropId(Prop, Record.PropId);
+
+		UPrimitiveComponent* Body = FGravityGunProps::GetPropComponent(Prop);
+		if (!Body) { continue; }
+
+		if (Record.Flags & PropStreaming::Flag_Asleep)
+		{
+			Body->PutRigidBodyToSleep();
+		}
+		else
+		{
+			Body->SetPhysicsLinearVelocity(FVector(Record.LinearVelocity[0], Record.LinearVelocity[1], Record.LinearVelocity[2]));
+			Body->SetPhysicsAngularVelocityInRadians(FVector(Record.AngularVelocity[0], Record.AngularVelocity[1], Record.AngularVelocity[2]));
+		}
+		LoadedProps.Add(Prop);
+	}
+}
+
+int32 APropStreamingManager::FindOrAddArchetype(const AActor* Prop)
+{
+	const UStaticMeshComponent* MeshComponent = Cast<UStaticMeshComponent>(Prop->GetRootComponent());
+	if (!MeshComponent) { return INDEX_NONE; }
+
+	FPropStreamingArchetype BodySettings;
+	BodySettings.SetBodySettings(MeshComponent);
+	const int32 ExistingIndex = Archetypes.IndexOfByPredicate([Prop, MeshComponent, &BodySettings](const FPropStreamingArchetype& Archetype)
+	{
+		return Archetype.ActorClass == Prop->GetClass()
+			&& Archetype.Mesh == MeshComponent->GetStaticMesh()
+			&& Archetype.Materials == MeshComponent->OverrideMaterials
+			&& Archetype.HasSameBodySettings(BodySettings);
+	});
+	if (ExistingIndex != INDEX_NONE) { return ExistingIndex; }
+
+	///Records store the archetype as 16 bit index
+	if (Archetypes.Num() > MAX_uint16) { return INDEX_NONE; }
+
+	FPropStreamingArchetype& Archetype = Archetypes.Add_GetRef(BodySettings);
+	Archetype.ActorClass = Prop->GetClass();
+	Archetype.Mesh = MeshComponent->GetStaticMesh();
+	Archetype.Materials = MeshComponent->OverrideMaterials;
+	return Archetypes.Num() - 1;
+}
+
+void FPropStreamingArchetype::SetBodySettings(const UStaticMeshComponent* Component)
+{
+	const FBodyInstance& Body = Component->BodyInstance;
+	Mobility = Component->Mobility;
+	CollisionProfile = Component->GetCollisionProfileName();
+	CollisionEnabled = Component->GetCollisionEnabled();
+	ObjectType = Component->GetCollisionObjectType();
+	CollisionResponses = Component->GetCollisionResponseToChannels();
+	bSimulatePhysics = Body.bSimulatePhysics;
+	bEnableGravity = Body.bEnableGravity;
+	bOverrideMass = Body.bOverrideMass;
+	MassInKg = Body.GetMassOverride();
+	LinearDamping = Body.LinearDamping;
+	AngularDamping = Body.AngularDamping;
+}
+
+void FPropStreamingArchetype::ApplyBodySettings(UStaticMeshComponent* Component) const
+{
+	Component->SetMobility(Mobility);
+	if (CollisionProfile == UCollisionProfile::CustomCollisionProfileName)
+	{
+		Component->SetCollisionEnabled(CollisionEnabled);
+		Component->SetCollisionObjectType(ObjectType);
+		Component->SetCollisionResponseToChannels(CollisionResponses);
+	}
+	else
+	{
+		Component->SetCollisionProfileName(CollisionProfile);
+	}
+	Component->SetSimulatePhysics(bSimulatePhysics);
+	Component->SetEnableGravity(bEnableGravity);
+	Component->SetMassOverrideInKg(NAME_None, MassInKg, bOverrideMass);
+	Component->SetLinearDamping(LinearDamping);
+	Component->SetAngularDamping(AngularDamping);
+}
+
+bool FPropStreamingArchetype::HasSameBodySettings(const FPropStreamingArchetype& Other) const
+{
+	return Mobility == Other.Mobility
+		&& CollisionProfile == Other.CollisionProfile
+		&& CollisionEnabled == Other.CollisionEnabled
+		&& ObjectType == Other.ObjectType
+		&& FMemory::Memcmp(&CollisionResponses, &Other.CollisionResponses, sizeof(FCollisionResponseContainer)) == 0
+		&& bSimulatePhysics == Other.bSimulatePhysics
+		&& bEnableGravity == Other.bEnableGravity
+		&& bOverrideMass == Other.bOverrideMass
+		&& MassInKg == Other.MassInKg
+		&& LinearDamping == Other.LinearDamping
+		&& AngularDamping == Other.AngularDamping;
+}
@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "AimQueryComponent.generated.h"
+
+class APawn;
+
+//Viewpoint of a pawn and what it is aiming at, computed once per frame
+USTRUCT(BlueprintType)
+struct FAimQueryResult
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly, Category = "Aim")
+	FVector ViewLocation = FVector::ZeroVector;
+
+	UPROPERTY(BlueprintReadOnly, Category = "Aim")
+	FRotator ViewRotation = FRotator::ZeroRotator;
+
+	//First physicsbody along the view direction, within the trace range
+	UPROPERTY(BlueprintReadOnly, Category = "Aim")
+	FHitResult Hit;
+};
+
+/*
+ * Aim query service of a pawn. Computes the viewpoint and a single physicsbody trace at most once per frame,
+ * shared by the objectgrabber, the objectlauncher and the HUD.
+ * The trace goes out to the largest range any user has asked for, users filter the hit by their own range.
+ * The view is updated every frame. When the frame is over budget the trace is spread over several frames, see ggp.Budget.Tier.Aim,
+ * users that act on the hit like a grab or a launch ask for a fresh trace.
+ * Added to the pawn on first use, so pawns don't need to set it up.
+ */
+UCLASS(ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class GRAVITYGUNPLAYGROUND_API UAimQueryComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UAimQueryComponent();
+
+	//Returns the aim query of the pawn, adding one if it doesn't have one yet
+	static UAimQueryComponent* FindOrAdd(APawn* Pawn);
+
+	//Returns the aim query of the pawn holding the actor. Falls back to the pawn of the first player when the actor isn't held.
+	//Example Usage: A gravity gun finds the aim of the player carrying it.
+	static UAimQueryComponent* FindOrAddForActor(const AActor* Actor);
+
+	//Returns the aim of this frame. The first call in a frame computes it, traces at least out to MinimumRange.
+	//The hit can be from an earlier frame when the aim trace is throttled, unless a fresh trace is asked for.
+	const FAimQueryResult& GetAim(float MinimumRange = 0.f, bool bFreshTrace = false);
+
+	//Returns the hit of this frame if it's within the range, or an empty hit result otherwise
+	FHitResult GetHitWithinRange(float Range, bool bFreshTrace = false);
+
+	//Returns whether the pawn is aiming at a physicsbody within the trace range this frame
+	UFUNCTION(BlueprintCallable)
+	bool HasTarget();
+
+	//Computes the current viewpoint of the pawn, without caching.
+	//In same-frame view mode the view is built from the camera component and the control rotation, so it already contains
+	//this frame's input and movement. The camera manager only updates after all tick groups, so its view is a frame behind until then.
+	void GetViewPoint(FVector& OutLocation, FRotator& OutRotation) const;
+
+	//Returns whether ggp.Aim.SameFrameView is enabled
+	static bool UsesSameFrameView();
+
+private:
+	//Distance of the trace. Grows to the largest range that was asked for.
+	float TraceRange = 0.f;
+
+	//Frames the view and the hit of the cached result were computed in
+	uint64 LastQueryFrame = MAX_uint64;
+	uint64 LastTraceFrame = MAX_uint64;
+
+	FAimQueryResult CachedResult;
+
+	//Returns whether the hit has to be traced again this frame
+	bool NeedsTrace(bool bFreshTrace) const;
+
+	void UpdateView();
+
+	void UpdateTrace();
+};
@@ -0,0 +1,79 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "BreakablePropComponent.generated.h"
+
+class UStaticMesh;
+class UPrimitiveComponent;
+
+//A pre-authored piece of a breakable prop
+USTRUCT(BlueprintType)
+struct FBreakableChunk
+{
+	GENERATED_BODY()
+
+	UPROPERTY(EditAnywhere, Category = "Chunk")
+	UStaticMesh* Mesh = nullptr;
+
+	//Transform of the chunk relative to the prop
+	UPROPERTY(EditAnywhere, Category = "Chunk")
+	FTransform RelativeTransform;
+};
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FBreakEvent);
+
+/*
+ * Component that shatters the owning prop into pre-authored chunks when it is hit hard enough.
+ * The chunks come from the debris pool of the world, which also enforces the global debris budget.
+ * Hits are reported by the impulse coalescer while the prop, or the prop hitting it, is in flight after a launch, a shot or a release,
+ * or while the prop itself moves fast enough, e.g. when it falls.
+ * Props held by a physicshandle don't break.
+ */
+UCLASS(Blueprintable, ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class GRAVITYGUNPLAYGROUND_API UBreakablePropComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UBreakablePropComponent();
+
+	//Replaces the prop with its chunks, spreading them away from the supplied location
+	UFUNCTION(BlueprintCallable)
+	virtual void Break(FVector ImpactLocation);
+
+	//Breaks the prop if the impulse of the hit is over the threshold. The hit component is the body of the owner.
+	//Called by the impulse coalescer for hits of bodies in flight.
+	void HandleImpact(UPrimitiveComponent* HitComponent, const FVector& NormalImpulse, const FVector& ImpactLocation);
+
+	//Event called when the prop breaks, just before the owner is destroyed
+	UPROPERTY(BlueprintAssignable, Category = "Interaction")
+	FBreakEvent OnBreak;
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+
+private:
+	//The chunks that replace the prop when it breaks
+	UPROPERTY(EditAnywhere, Category = "BreakSettings")
+	TArray<FBreakableChunk> Chunks;
+
+	//Minimum impulse of a single hit that breaks the prop
+	UPROPERTY(EditAnywhere, Category = "BreakSettings")
+	float BreakImpulseThreshold = 250000.f;
+
+	//Speed with which chunks move away from the impact, on top of the velocity of the prop
+	UPROPERTY(EditAnywhere, Category = "BreakSettings")
+	float ChunkSeparationSpeed = 250.f;
+
+	//If true, free chunks are created in the debris pool when the game starts, so breaking doesn't create components
+	UPROPERTY(EditAnywhere, Category = "BreakSettings")
+	bool bPrewarmPool = true;
+
+	//Set when a break is scheduled, so multiple hits in the same frame only break the prop once
+	bool bBreakPending = false;
+};
@@ -0,0 +1,106 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "GravityGunMemory.h"
+#include "DebrisPool.generated.h"
+
+class UStaticMesh;
+class UStaticMeshComponent;
+
+//Free chunk components of a single mesh
+USTRUCT()
+struct FDebrisMeshPool
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	TArray<UStaticMeshComponent*> FreeChunks;
+};
+
+//A chunk that is currently simulating
+USTRUCT()
+struct FLiveDebrisChunk
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	UStaticMeshComponent* Component = nullptr;
+
+	float SpawnTime = 0.f;
+
+	//Scale the chunk was spawned with, the fade shrinks it from here
+	FVector SpawnScale = FVector::OneVector;
+
+	//Time at which the chunk started shrinking, negative while it hasn't started fading yet
+	float FadeStartTime = -1.f;
+};
+
+/*
+ * Pools the chunk components spawned by breakable props, one pool per chunk mesh.
+ * The number of live chunks is capped by ggp.Debris.MaxLiveChunks. When the cap is reached the oldest or the furthest chunk is recycled,
+ * depending on ggp.Debris.RecycleFurthest. Chunks are damped after ggp.Debris.SettleSeconds, shrink away once asleep or after
+ * ggp.Debris.LifetimeSeconds, and then return to their pool.
+ * Chunks are components of the pool rather than actors and can't be grabbed.
+ * Free chunks are destroyed when the Props memory category goes over budget.
+ * One pool is spawned per world on first use.
+ */
+UCLASS(NotPlaceable)
+class GRAVITYGUNPLAYGROUND_API ADebrisPool : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	ADebrisPool();
+
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	//Returns the pool of the world, spawning it if there is none yet
+	static ADebrisPool* Get(UWorld* World);
+
+	//Makes sure at least the supplied number of free chunks exists for the mesh, so the first break doesn't create components
+	void Prewarm(UStaticMesh* Mesh, int32 NumChunks);
+
+	//Takes a chunk from the pool, recycling a live chunk if the budget is reached, and starts simulating it
+	UStaticMeshComponent* SpawnChunk(UStaticMesh* Mesh, const FTransform& Transform, const FVector& LinearVelocity, const FVector& AngularVelocityInRadians);
+
+	int32 GetNumLiveChunks() const { return LiveChunks.Num(); }
+
+	int32 GetNumFreeChunks() const;
+
+	//Destroys free chunks until the supplied amount of bytes is freed or no free chunks are left. Returns the freed bytes.
+	int64 TrimFreeChunks(int64 BytesToFree);
+
+protected:
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	UPROPERTY()
+	TMap<UStaticMesh*, FDebrisMeshPool> Pools;
+
+	UPROPERTY()
+	TArray<FLiveDebrisChunk> LiveChunks;
+
+	//Bytes reported to the memory tracker per chunk component
+	int64 BytesPerChunk = 0;
+
+	FDelegateHandle OverBudgetHandle;
+
+	//Creates a new, inactive chunk component
+	UStaticMeshComponent* CreateChunk(UStaticMesh* Mesh);
+
+	//Stops simulating the chunk and returns it to the pool of its mesh
+	void ReleaseChunk(int32 LiveIndex);
+
+	//Returns the index of the live chunk to recycle when the budget is reached
+	int32 FindChunkToRecycle() const;
+
+	void OnOverBudget(EGravityGunMemoryCategory Category, int64 BytesOverBudget);
+};
@@ -4,11 +4,15 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Actor.h"
+#include "Engine/NetSerialization.h"
 #include "ObjectGrabberComponent.h"
 #include "GravityGun.generated.h"
 
 class UObjectGrabberComponent;
 class UObjectLauncherComponent;
+class UMultiObjectGrabberComponent;
+class UPropRewindComponent;
+class ULaunchPreviewComponent;
 
 UCLASS()
 class GRAVITYGUNPLAYGROUND_API AGravityGun : public AActor
@@ -19,31 +23,99 @@ public:
 	// Sets default values for this actor's properties
 	AGravityGun();
 
-	//Input the grab command to the objectgrabbercomponent.
+	//Input the grab command to the objectgrabbercomponent, or to the multiobjectgrabber in multi-grab mode.
 	//When not holding an actor, the grabber will try to grab an actor within range.
 	//When holding an object, the grabber will release the actor.
+	//On a client the grab is predicted locally and sent to the server, which traces from the client's view against the props as the client saw them.
+	//The server confirms the actors it holds afterwards, and the client corrects its prediction to match.
 	UFUNCTION(BlueprintCallable)
 	virtual void TryGrab();
 
 	//Input the launch command to the objectlauncher.
-	//If the objectgrabber is holding an actor, this actor will be launcher.
+	//If the objectgrabber is holding an actor, this actor will be launcher. In multi-grab mode the whole held group is launched.
 	//If not, the launcher will attempt to launch an actor within range.
+	//On a client the launch is predicted locally and sent to the server, like the grab command.
 	UFUNCTION(BlueprintCallable)
 	virtual void TryLaunch();
 
+	//Input the rewind command to the rewind component.
+	//When not rewinding, a held actor is released and the recent movement of grabbed and launched actors is played back in reverse.
+	//When rewinding, the playback is stopped.
+	UFUNCTION(BlueprintCallable)
+	virtual void TryRewind();
+
 protected:
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
 	//Objectgrabber reference. The component will be created and attached to this actor on construction
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "ObjectInteraction")
 	UObjectGrabberComponent* ObjectGrabber = nullptr;
 
+	//Multi objectgrabber reference. The component will be created and attached to this actor on construction
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "ObjectInteraction")
+	UMultiObjectGrabberComponent* MultiObjectGrabber = nullptr;
+
+	//If set, grab input scoops up a group of actors with the multi objectgrabber instead of grabbing a single actor
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ObjectInteraction")
+	bool bMultiGrab = false;
+
 	//ObjectLauncher reference. The component will be created and attached to this actor on construction
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "ObjectInteraction")
 	UObjectLauncherComponent* ObjectLauncher = nullptr;
 
+	//Rewind reference. The component will be created and attached to this actor on construction
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "ObjectInteraction")
+	UPropRewindComponent* PropRewind = nullptr;
+
+	//Launch preview reference. The component will be created and attached to this actor on construction
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "ObjectInteraction")
+	ULaunchPreviewComponent* LaunchPreview = nullptr;
+
 	UPROPERTY(EditAnywhere)
 	USceneComponent* ObjectTransformPlaceholder = nullptr;
 
 private:
-	
-	
+	//Sends a grab command made on a client to the server, with the view and server time the client aimed from and the client's grab mode
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerTryGrab(FVector_NetQuantize10 ViewLocation, FRotator ViewRotation, float ViewTime, bool bMultiGrabRequest);
+
+	//Sends a launch command made on a client to the server, with the view and server time the client aimed from
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerTryLaunch(FVector_NetQuantize10 ViewLocation, FRotator ViewRotation, float ViewTime);
+
+	//Sent by the server after every grab and launch request of the client, with the actors it holds for the client afterwards
+	UFUNCTION(Client, Reliable)
+	void ClientConfirmHeld(const TArray<AActor*>& HeldActors, bool bHeldByMultiGrabber);
+
+	//Number of requests sent to the server that haven't been confirmed yet. The prediction is only corrected when none are left.
+	int32 NumPendingRequests = 0;
+
+	//Runs a grab request of a client on the server
+	void HandleGrabRequest(const FVector& ViewLocation, const FRotator& ViewRotation, float ViewTime, bool bMultiGrabRequest);
+
+	//Runs a launch request of a client on the server
+	void HandleLaunchRequest(const FVector& ViewLocation, const FRotator& ViewRotation, float ViewTime);
+
+	//Sends the actors held for the client to it, after one of its requests was handled
+	void ConfirmHeldToClient();
+
+	//Returns whether commands have to be sent to the server. A gun spawned by the client itself handles them locally.
+	bool ShouldSendToServer() const;
+
+	//Returns the view of the pawn carrying the gun, as used by the grab and launch traces
+	void GetCarrierView(FVector& OutLocation, FRotator& OutRotation) const;
+
+	//Returns whether a view sent by a client is made of finite values. Malformed views disconnect the client.
+	static bool IsViewWellFormed(const FVector& ViewLocation, const FRotator& ViewRotation, float ViewTime);
+
+	//Returns whether a view sent by a client is close enough to the pawn carrying the gun.
+	//Requests from other views are ignored, the view can be off for a moment after a correction or a teleport.
+	bool IsViewPlausible(const FVector& ViewLocation) const;
+
+	//Traces for a physicsbody from a client's view, against the props as they were at the client's view time
+	FHitResult TraceFromClientView(const FVector& ViewLocation, const FRotator& ViewRotation, float ViewTime, float Range) const;
+
+	//Launches the actors held by the objectgrabber or the multiobjectgrabber away from the view. Returns false if nothing is held.
+	bool LaunchHeldActors(const FVector& ViewLocation, const FRotator& ViewRotation);
 };
@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineBaseTypes.h"
+#include "GameFramework/Actor.h"
+#include "GravityGunBudget.generated.h"
+
+class AGravityGunBudget;
+
+//Optional work that is scaled down when the frame goes over budget
+enum class EGravityGunBudgetSystem : uint8
+{
+	//Rate of the shared aim trace, used by the can-grab check and the HUD
+	AimTrace,
+	//Sounds and effects on fire and launch
+	Effects,
+	//Number of live projectiles
+	Projectiles,
+	//How early slow props are put to sleep
+	PhysicsSleep,
+	Count
+};
+
+//Starts the physics time measurement at the start of TG_DuringPhysics, after the world kicked off the physics simulation
+USTRUCT()
+struct FGravityGunBudgetPhysicsTickFunction : public FTickFunction
+{
+	GENERATED_BODY()
+
+	AGravityGunBudget* Target = nullptr;
+
+	virtual void ExecuteTick(float DeltaTime, ELevelTick TickType, ENamedThreads::Type CurrentThread, const FGraphEventRef& MyCompletionGraphEvent) override;
+
+	virtual FString DiagnosticMessage() override;
+};
+
+template<>
+struct TStructOpsTypeTraits<FGravityGunBudgetPhysicsTickFunction> : public TStructOpsTypeTraitsBase2<FGravityGunBudgetPhysicsTickFunction>
+{
+	enum
+	{
+		WithCopy = false
+	};
+};
+
+/*
+ * Frame budget controller that degrades optional gravity gun work when the frame gets too expensive, instead of letting it hitch.
+ * Watches the game thread time and the physics time, from the start of the simulation until its results are fetched, against the budgets
+ * in ggp.Budget.GameThreadMs and ggp.Budget.PhysicsMs. Going over either budget for ggp.Budget.DegradeSeconds raises the budget level,
+ * staying below ggp.Budget.RecoverFraction of both for ggp.Budget.RecoverSeconds lowers it again.
+ * Every level sets the tiers of the systems in EGravityGunBudgetSystem through the ggp.Budget.Tier.* console variables, effects and
+ * sleep degrade first, the aim trace and projectiles later. Tier 0 is full quality, tier 2 the cheapest.
+ * Every level change is logged and recorded in the telemetry. Set ggp.Budget.Enabled to 0 to set the tiers by hand.
+ * One controller is spawned per world on first use. The tiers are shared by all worlds, so only one controller drives them:
+ * the first one that started playing, e.g. the server world in a play in editor session with clients. The others only measure.
+ */
+UCLASS(NotPlaceable)
+class GRAVITYGUNPLAYGROUND_API AGravityGunBudget : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	AGravityGunBudget();
+
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	virtual void RegisterActorTickFunctions(bool bRegister) override;
+
+	//Returns the controller of the world, spawning one if there is none yet
+	static AGravityGunBudget* Get(UWorld* World);
+
+	//Returns the current tier of the system, 0 for full quality up to 2
+	static int32 GetTier(EGravityGunBudgetSystem System);
+
+	//Returns the number of frames between aim traces
+	static int32 GetAimTraceInterval();
+
+	//Returns whether an optional sound or effect at the location should be spawned. Call once per effect, the effects are rate limited.
+	//Example Usage: Only spawn the launch effect if this returns true.
+	UFUNCTION(BlueprintCallable, Category = "Budget", meta = (WorldContext = "WorldContextObject"))
+	static bool ShouldSpawnEffect(const UObject* WorldContextObject, FVector Location);
+
+	//Returns whether there are more live projectiles than the projectile tier allows.
+	//Example Usage: Fire a hitscan shot instead, or skip the local simulation of a remote shot.
+	static bool IsOverProjectileBudget();
+
+	//Returns the smoothed game thread time in milliseconds
+	float GetGameThreadMs() const { return GameThreadMs; }
+
+	//Returns the smoothed physics time in milliseconds
+	float GetPhysicsMs() const { return PhysicsMs; }
+
+	int32 GetLevel() const { return Level; }
+
+	//Returns whether this controller sets the tiers, only one controller in the process does
+	bool IsDrivingTiers() const;
+
+	//Called by the physics tick function
+	void MarkPhysicsStart();
+
+protected:
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	FGravityGunBudgetPhysicsTickFunction PhysicsTickFunction;
+
+	//Time the physics simulation of this frame started, zero if it didn't run
+	double PhysicsStartTime = 0.0;
+
+	float GameThreadMs = 0.f;
+	float PhysicsMs = 0.f;
+
+	//Current budget level, every level degrades more systems
+	int32 Level = 0;
+
+	//Seconds the frame has been over, or well under, the budget
+	float OverBudgetSeconds = 0.f;
+	float UnderBudgetSeconds = 0.f;
+
+	float TimeSinceSleepPass = 0.f;
+
+	//Effect tokens left, refilled at the rate of the effects tier. Every world limits its own effects.
+	float EffectTokens = 0.f;
+	double EffectTokensTime = 0.0;
+
+	//Raises or lowers the level with hysteresis
+	void UpdateLevel(float DeltaTime);
+
+	void SetLevel(int32 NewLevel);
+
+	//Sets the tiers of all systems from the current level
+	void ApplyTiers();
+
+	//Puts slow props that rest on something to sleep, depending on the sleep tier. Props in flight are left awake.
+	void SleepSlowProps();
+};
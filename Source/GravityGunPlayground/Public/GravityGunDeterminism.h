@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+
+/*
+ * Fixed-step deterministic simulation mode, enabled with -GGPDeterministic (optionally -GGPStepHz=<Rate>, default 60).
+ * The game and physics run with the same fixed delta time every frame, independent of real time, with enhanced physics determinism
+ * and without substepping. Grab, launch and fire input is queued and executed on the next step boundary instead of whenever input arrives.
+ * After every step a checksum of all prop transforms is appended to Saved/Determinism/<Name>.csv,
+ * so two runs or two builds can be compared with ggp.Determinism.Diff to find the first step where they diverge.
+ */
+class GRAVITYGUNPLAYGROUND_API FGravityGunDeterminism
+{
+public:
+	//Reads the command line and applies the engine and physics settings. Must run before the first world is created.
+	static void Initialize();
+
+	static void Shutdown();
+
+	static bool IsEnabled();
+
+	//Number of fixed steps simulated so far
+	static uint64 GetStep();
+
+	//Fixed delta time of a step in seconds
+	static float GetStepDeltaTime();
+
+	//Returns whether input should be queued for the next step. False when the mode is disabled or while queued input is being executed.
+	static bool ShouldDeferToStep();
+
+	//Runs the action on the next step boundary of the supplied world. When the mode is disabled the action runs immediately.
+	static void RunOnStep(UWorld* World, TFunction<void()> Action);
+
+	//Hashes the transforms and velocities of all props in the world, in prop id order
+	static uint32 ComputeWorldChecksum(UWorld* World, int32& OutNumProps);
+
+	//Compares two checksum logs. Returns false if either log can't be read or holds no checksums.
+	//Otherwise OutStep is the first step with a different checksum, or INDEX_NONE if the logs match.
+	static bool FindFirstDivergence(const FString& FilenameA, const FString& FilenameB, int64& OutStep);
+};
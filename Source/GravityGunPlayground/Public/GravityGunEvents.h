@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "UObject/Object.h"
+#include "GravityGunEvents.generated.h"
+
+class AActor;
+
+/*
+ * The grab and launch events of the gravity gun components come in two versions: a native multicast delegate for C++ listeners
+ * and a dynamic one for Blueprints. A dynamic broadcast calls every listener through ProcessEvent, the native one calls them directly.
+ * Both are fired together, the dynamic one only when something is bound to it.
+ * The events of a gun fire on the machine of the player carrying it. A server also grabs and launches for the guns of remote players,
+ * those players predict the same actions on their own machine and hear them there.
+ * ggp.Events.Bench measures the broadcast cost per event of both versions.
+ */
+class GRAVITYGUNPLAYGROUND_API FGravityGunEvents
+{
+public:
+	//Broadcasts the native event, and the dynamic event if it has listeners
+	template<typename NativeEventType, typename DynamicEventType, typename... ArgTypes>
+	static void Broadcast(NativeEventType& NativeEvent, DynamicEventType& DynamicEvent, ArgTypes... Args)
+	{
+		NativeEvent.Broadcast(Args...);
+		if (DynamicEvent.IsBound())
+		{
+			DynamicEvent.Broadcast(Args...);
+		}
+	}
+
+	//Broadcasts the events of the gun like Broadcast, if the gun is carried by a locally controlled pawn or by no pawn at all
+	template<typename NativeEventType, typename DynamicEventType, typename... ArgTypes>
+	static void BroadcastForCarrier(const AActor* Gun, NativeEventType& NativeEvent, DynamicEventType& DynamicEvent, ArgTypes... Args)
+	{
+		if (IsLocallyCarried(Gun))
+		{
+			Broadcast(NativeEvent, DynamicEvent, Args...);
+		}
+	}
+
+	//Returns whether the gun is carried by a locally controlled pawn, or lies around without a pawn carrying it
+	static bool IsLocallyCarried(const AActor* Gun);
+};
+
+//Listener bound to the events broadcast by ggp.Events.Bench
+UCLASS(Transient)
+class GRAVITYGUNPLAYGROUND_API UGravityGunDelegateBenchListener : public UObject
+{
+	GENERATED_BODY()
+
+public:
+	UFUNCTION()
+	void OnCanGrabChanged(bool bCanGrab);
+
+	int32 NumCalls = 0;
+};
@@ -0,0 +1,58 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Player actions whose input-to-effect latency is measured
+enum class EGravityGunLatencyAction : uint8
+{
+	Fire,
+	Grab,
+	Launch,
+	Count
+};
+
+/*
+ * Measures the latency between a player input and the frame in which its effect takes hold, in frames and milliseconds.
+ * The input is marked where the action enters the game code, the effect where it first changes the world:
+ * the projectile is spawned, the physicshandle first moves the grabbed body, or the launch velocity is applied.
+ * Only the earliest pending input of an action is kept, so inputs that are deferred and re-entered (e.g. in deterministic mode) are measured from the press.
+ * Inputs without an effect are cancelled, or expire after ggp.Latency.TimeoutMs.
+ *
+ * The lag between the rendered view and the view a held object follows is recorded next to the actions.
+ * Results go to the GravityGun stat group and the csv profiler, and ggp.Latency.Dump writes the histograms to Saved/Latency.
+ * Game thread only.
+ */
+class GRAVITYGUNPLAYGROUND_API FGravityGunLatency
+{
+public:
+	//Marks the input of an action. Ignored if the action already has a pending input.
+	static void MarkInput(EGravityGunLatencyAction Action);
+
+	//Marks the effect of an action and records its latency, if it has a pending input
+	static void MarkEffect(EGravityGunLatencyAction Action);
+
+	//Discards the pending input of an action that ended without an effect
+	//Example Usage: A grab input that didn't hit anything.
+	static void CancelInput(EGravityGunLatencyAction Action);
+
+	//Returns whether the action has an input waiting for its effect
+	static bool IsPending(EGravityGunLatencyAction Action);
+
+	//Records how far the view used for a held object's target was behind the view the frame was rendered with.
+	//Kept separately for the camera manager's view and the same frame's view.
+	//Example Usage: Toggle ggp.Aim.SameFrameView while holding an object, then compare both rows of ggp.Latency.Dump.
+	static void RecordHoldViewLag(float Degrees, float Distance, bool bSameFrameView);
+
+	//Clears the histograms and the pending inputs
+	static void Reset();
+
+	//Writes the sample counts and percentiles of every action to the log
+	static void DumpToLog();
+
+	//Writes the frame and millisecond histograms of every action to a csv file. Returns whether the file was written.
+	static bool WriteCsv(const FString& Filename);
+
+	static const TCHAR* GetActionName(EGravityGunLatencyAction Action);
+};
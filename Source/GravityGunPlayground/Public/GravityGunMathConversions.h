@@ -0,0 +1,30 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GravityGunMath.h"
+
+//Conversions between the engine math types and the types of the engine independent GravityGunMath library
+namespace GravityGunMath
+{
+	FORCEINLINE FVec3 ToMath(const FVector& V)
+	{
+		return FVec3(V.X, V.Y, V.Z);
+	}
+
+	FORCEINLINE FQuat4 ToMath(const FQuat& Q)
+	{
+		return FQuat4(Q.X, Q.Y, Q.Z, Q.W);
+	}
+
+	FORCEINLINE FVector ToEngine(const FVec3& V)
+	{
+		return FVector(V.X, V.Y, V.Z);
+	}
+
+	FORCEINLINE FQuat ToEngine(const FQuat4& Q)
+	{
+		return FQuat(Q.X, Q.Y, Q.Z, Q.W);
+	}
+}
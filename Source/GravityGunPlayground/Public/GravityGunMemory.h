@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "HAL/LowLevelMemTracker.h"
+
+class AActor;
+
+//Memory categories of the gravity gun subsystems.
+//Every category has its own LLM tag, tracked byte count and configurable budget.
+enum class EGravityGunMemoryCategory : uint8
+{
+	Projectiles,
+	GrabLaunch,
+	Props,
+	Count
+};
+
+#if ENABLE_LOW_LEVEL_MEM_TRACKER
+//Opens an LLM scope for the supplied category. Project tags are placed directly after ELLMTag::ProjectTagStart.
+#define GRAVITYGUN_LLM_SCOPE(Category) LLM_SCOPE((ELLMTag)((uint8)ELLMTag::ProjectTagStart + (uint8)(Category)))
+#else
+#define GRAVITYGUN_LLM_SCOPE(Category)
+#endif
+
+/*
+ * Tracks the memory used by the gravity gun subsystems, independent of LLM and stats so it also works in headless and shipping builds.
+ * Systems report their own allocations. When a category goes over its budget a warning is logged and OnOverBudget is fired,
+ * so pools can trim themselves.
+ * Budgets are set through the ggp.Memory.BudgetKB.* console variables, for example from the [SystemSettings] section of DefaultEngine.ini.
+ */
+class GRAVITYGUNPLAYGROUND_API FGravityGunMemory
+{
+public:
+	//Registers the project LLM tags. Called on module startup.
+	static void RegisterLLMTags();
+
+	//Report an allocation of the supplied size. The category budget is checked afterwards.
+	static void TrackAllocation(EGravityGunMemoryCategory Category, int64 Bytes);
+
+	//Report that a previously tracked allocation has been freed
+	static void TrackFree(EGravityGunMemoryCategory Category, int64 Bytes);
+
+	//Returns the number of bytes currently tracked in the category
+	static int64 GetCurrentBytes(EGravityGunMemoryCategory Category);
+
+	//Returns the highest number of bytes tracked in the category since startup or the last reset
+	static int64 GetHighWaterBytes(EGravityGunMemoryCategory Category);
+
+	//Returns the number of live tracked allocations in the category
+	static int32 GetLiveAllocations(EGravityGunMemoryCategory Category);
+
+	//Returns the budget of the category in bytes. Zero means unlimited.
+	static int64 GetBudgetBytes(EGravityGunMemoryCategory Category);
+
+	//Returns whether the category currently uses more memory than its budget
+	static bool IsOverBudget(EGravityGunMemoryCategory Category);
+
+	//Resets the high-water marks to the current values
+	static void ResetHighWaterMarks();
+
+	//Writes the per-category usage, high-water marks and budgets to the log
+	static void DumpToLog();
+
+	static const TCHAR* GetCategoryName(EGravityGunMemoryCategory Category);
+
+	//Rough footprint of an actor and its components, used by systems that track whole actors
+	static int64 EstimateActorBytes(const AActor* Actor);
+
+	//Event fired on the game thread when a category goes over its budget. Fired again only after the category was back under budget.
+	//The second parameter is the amount of bytes over budget.
+	//Example Usage: A pool releases its free entries until it is back under budget.
+	DECLARE_MULTICAST_DELEGATE_TwoParams(FOverBudgetEvent, EGravityGunMemoryCategory, int64);
+	static FOverBudgetEvent OnOverBudget;
+};
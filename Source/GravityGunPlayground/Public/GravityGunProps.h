@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class AActor;
+class UPrimitiveComponent;
+class UWorld;
+
+/*
+ * Helpers shared by the systems that work on physics props.
+ * A prop is an actor with a simulating primitive as root component, the same assumption the objectlauncher makes when launching.
+ */
+class GRAVITYGUNPLAYGROUND_API FGravityGunProps
+{
+public:
+	//Returns the simulating root primitive of the actor, or nullptr if the actor is not a physics prop
+	static UPrimitiveComponent* GetPropComponent(const AActor* Actor);
+
+	//Returns an identifier for the prop based on its path in the level.
+	//The identifier is stable between sessions and between PIE and standalone for placed actors.
+	//Props that were assigned an identifier with SetPropId return that identifier instead.
+	static uint64 GetPropId(const AActor* Actor);
+
+	//Assigns a fixed identifier to a prop. Used for respawned props, so they keep the identifier of the actor they replace.
+	static void SetPropId(AActor* Actor, uint64 Id);
+
+	//Removes the identifier assigned with SetPropId, call before destroying the prop
+	static void ClearPropId(const AActor* Actor);
+
+	//Returns the prop that was assigned the identifier with SetPropId, or nullptr
+	static AActor* FindPropWithAssignedId(uint64 Id);
+
+	//Collects the root primitives of all props in the world
+	static void GetAllProps(UWorld* World, TArray<UPrimitiveComponent*>& OutProps);
+
+	//Collects the components currently held by a physicshandle or a multi objectgrabber in the world
+	static void GetHeldComponents(UWorld* World, TSet<UPrimitiveComponent*>& OutHeld);
+
+	//Returns whether the component is currently held by a physicshandle or a multi objectgrabber
+	static bool IsHeld(const UPrimitiveComponent* Component);
+
+	//Returns whether the pawn carrying the gun overlaps or stands on the actor. False if the gun isn't carried.
+	static bool IsCarrierTouching(const AActor* Gun, const AActor* Actor);
+};
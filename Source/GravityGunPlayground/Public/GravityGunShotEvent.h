@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GravityGunShotEvent.generated.h"
+
+class UWorld;
+
+//Everything a client needs to simulate a projectile locally. Sent once per shot instead of replicating the projectile actor.
+USTRUCT()
+struct GRAVITYGUNPLAYGROUND_API FGravityGunShotEvent
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	FVector MuzzleLocation = FVector::ZeroVector;
+
+	UPROPERTY()
+	FRotator MuzzleRotation = FRotator::ZeroRotator;
+
+	//Seed of the spread of the shot, so every machine picks the same direction
+	UPROPERTY()
+	uint16 Seed = 0;
+
+	//Identifies the shot in the authoritative hit event
+	UPROPERTY()
+	uint16 ShotId = 0;
+
+	//Server world time at which the shot was fired. Clients fast forward their projectile by the time since then.
+	UPROPERTY()
+	float ServerTime = 0.f;
+
+	//Rounds the values to the precision they are sent with, so the server simulates exactly what the clients receive
+	void Quantize();
+
+	//Returns the direction of the shot after applying the seeded spread
+	FRotator GetShotRotation(float SpreadDegrees) const;
+
+	//Location with 0.1 precision, pitch and yaw as 16 bit angles. Roll doesn't affect the projectile and isn't sent.
+	bool NetSerialize(FArchive& Ar, class UPackageMap* Map, bool& bOutSuccess);
+};
+
+template<>
+struct TStructOpsTypeTraits<FGravityGunShotEvent> : public TStructOpsTypeTraitsBase2<FGravityGunShotEvent>
+{
+	enum
+	{
+		WithNetSerializer = true
+	};
+};
+
+/*
+ * Settings and bandwidth accounting of projectile replication.
+ * With ggp.Net.ShotEvents enabled the server sends one shot event per projectile and every client simulates its own copy.
+ * Only hits of the server projectile are replicated. With it disabled every projectile is a replicated actor.
+ * ggp.Net.ShotStats logs the size of a shot event and the bytes the server sent per shot since the last reset,
+ * so both modes can be compared on a loopback server by firing the same number of shots with each.
+ */
+class GRAVITYGUNPLAYGROUND_API FGravityGunShotReplication
+{
+public:
+	static bool UseShotEvents();
+
+	//Number of bits the event takes on the wire
+	static int32 GetEventBits(const FGravityGunShotEvent& Shot);
+
+	//Call on the server for every fired shot, in both modes
+	static void RecordShot(UWorld* World, const FGravityGunShotEvent& Shot, bool bSentAsEvent);
+};
@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Gameplay events recorded by the telemetry sink
+enum class EGravityGunTelemetryEvent : uint8
+{
+	Grab,
+	Release,
+	Launch,
+	Shot,
+	//The held actor got further away than the ForceReleaseDistance
+	ForceReleaseDistance,
+	//The player was standing on the held actor
+	ForceReleaseOverlap,
+	//The gun was unequipped while holding an actor
+	ForceReleaseDetached,
+	//A grab was rejected because the grab cooldown hadn't passed
+	GrabCooldownRejected,
+	//A launch was rejected because the launch cooldown hadn't passed
+	LaunchCooldownRejected,
+	//The frame budget controller changed its level, the value is the new level
+	BudgetLevel,
+	Count
+};
+
+//Fixed-size event record, copied as-is into the per-thread buffers
+struct FGravityGunTelemetryRecord
+{
+	double Time;
+	uint32 Frame;
+	EGravityGunTelemetryEvent Event;
+	uint8 Padding[3];
+	float Location[3];
+	//Event specific value, for example the distance of a forced release or the remaining cooldown of a rejection
+	float Value;
+};
+
+/*
+ * Always-on gameplay telemetry with a fixed cost per event on the recording thread.
+ * Every recording thread gets its own single producer, single consumer ring buffer, so Record never locks or allocates after the first call on a thread.
+ * Buffers live until the process exits. The buffer of an exited thread is reused by the next thread that starts recording.
+ * A background thread drains the buffers into rotating JSONL files in Saved/Telemetry and keeps the per-session counts.
+ * Events that don't fit in a full buffer are dropped and counted. Drops are logged and written to the file by the background thread.
+ * Configured through the ggp.Telemetry.* console variables, ggp.Telemetry.Stats logs the session counts.
+ */
+class GRAVITYGUNPLAYGROUND_API FGravityGunTelemetry
+{
+public:
+	//Starts the writer thread. Called on module startup.
+	static void Initialize();
+
+	//Stops the writer thread after writing the remaining events and the session summary. Called on module shutdown.
+	static void Shutdown();
+
+	static bool IsEnabled();
+
+	//Records an event. Safe to call from any thread.
+	static void Record(EGravityGunTelemetryEvent Event, const FVector& Location, float Value = 0.f);
+
+	//Number of events of the type written this session
+	static int32 GetSessionCount(EGravityGunTelemetryEvent Event);
+
+	//Number of events dropped this session because a buffer was full
+	static int32 GetDroppedCount();
+
+	static const TCHAR* GetEventName(EGravityGunTelemetryEvent Event);
+};
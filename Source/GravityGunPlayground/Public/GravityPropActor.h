@@ -0,0 +1,87 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/StaticMeshActor.h"
+#include "GravityPropActor.generated.h"
+
+/*
+ * Replicated physics prop whose net update rate and priority follow how much it is moving.
+ * A prop at rest is dormant and isn't considered for replication at all. Launching, grabbing, hitting or waking the body
+ * raises its update frequency and priority, which decay back to the rest values as the prop slows down and falls asleep.
+ * The update frequency scales with the speed and the distance to the nearest viewer, the priority with the speed and the
+ * distance to each viewer.
+ * A held prop stays fully active, the grabbers move it without it gaining much speed.
+ * ggp.Net.PropStats measures the bandwidth and the number of props prioritized per frame on the server,
+ * compare a session with ggp.Net.PropAdaptive 0 against one with 1 to see the difference.
+ * Only props of this class adapt. BP_PhysicsActor in Content derives from AActor and isn't affected until it is reparented to this class.
+ */
+UCLASS()
+class GRAVITYGUNPLAYGROUND_API AGravityPropActor : public AStaticMeshActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	AGravityPropActor();
+
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	virtual float GetNetPriority(const FVector& ViewPos, const FVector& ViewDir, AActor* Viewer, AActor* ViewTarget, UActorChannel* InChannel, float Time, bool bLowBandwidth) override;
+
+	//Raises the replication rate of the actor if it is a gravity prop. Does nothing on clients or for other actors.
+	//Example Usage: A prop was launched, grabbed or hit by a shot.
+	static void NotifyActivity(AActor* Actor);
+
+	//Returns the current activity of the prop, 0 at rest and 1 at full speed
+	float GetActivity() const { return Activity; }
+
+protected:
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+private:
+	//Update frequency of a prop at rest, just before it goes dormant
+	UPROPERTY(EditAnywhere, Category = "Replication")
+	float RestNetUpdateFrequency = 2.f;
+
+	//Update frequency of a prop at full speed, close to a viewer
+	UPROPERTY(EditAnywhere, Category = "Replication")
+	float ActiveNetUpdateFrequency = 60.f;
+
+	//Net priority of a prop at full speed. A prop at rest has a priority of 1.
+	UPROPERTY(EditAnywhere, Category = "Replication")
+	float ActiveNetPriority = 3.f;
+
+	//Speed at which a prop counts as fully active, the maximum launch speed of the objectlauncher by default
+	UPROPERTY(EditAnywhere, Category = "Replication")
+	float FullActivitySpeed = 4200.f;
+
+	//Props within this distance of a viewer use the full update frequency and priority. Further away they drop with the distance.
+	UPROPERTY(EditAnywhere, Category = "Replication")
+	float FullActivityDistance = 2000.f;
+
+	//Activity lost per second once the prop slows down
+	UPROPERTY(EditAnywhere, Category = "Replication")
+	float ActivityDecayRate = 1.5f;
+
+	//Current activity, 0 at rest and 1 at full speed
+	float Activity = 0.f;
+
+	//Wakes the prop from dormancy and starts updating its replication rate
+	void WakeUp();
+
+	//Lets the prop go dormant once its body is asleep and its activity decayed
+	void Settle();
+
+	//Returns the distance between the location and the nearest player view
+	float GetNearestViewerDistance(const FVector& Location) const;
+
+	UFUNCTION()
+	void OnBodyWake(UPrimitiveComponent* WakingComponent, FName BoneName);
+
+	UFUNCTION()
+	void OnBodySleep(UPrimitiveComponent* SleepingComponent, FName BoneName);
+};
@@ -0,0 +1,86 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "GravityVolume.generated.h"
+
+class UBoxComponent;
+
+UENUM(BlueprintType)
+enum class EGravityVolumeMode : uint8
+{
+	//Cancels the world gravity, bodies keep floating with the velocity they entered with
+	ZeroGravity,
+	//Applies the world gravity in the opposite direction, scaled by GravityScale
+	ReversedGravity,
+	//Pulls bodies towards the center of the volume, on top of the world gravity
+	Attractor
+};
+
+//Copy of the settings of a volume, read by the physics step without touching the actor
+struct FGravityVolumeParams
+{
+	EGravityVolumeMode Mode = EGravityVolumeMode::ZeroGravity;
+	//Constant acceleration of the reversed gravity mode, on top of cancelling the world gravity
+	FVector Acceleration = FVector::ZeroVector;
+	//Cancels the world gravity in the zero and reversed gravity modes, only applied to bodies that have gravity enabled
+	FVector GravityCancel = FVector::ZeroVector;
+	FVector Center = FVector::ZeroVector;
+	float AttractorAcceleration = 0.f;
+	float AttractorRadius = 0.f;
+};
+
+/*
+ * Box shaped zone that changes the gravity of the physics bodies inside it.
+ * The forces are not applied by the volume itself. The gravity volume manager of the world tracks the bodies in all volumes
+ * and applies their forces in one batched pass per physics substep. Bodies held by a physicshandle are excluded.
+ */
+UCLASS()
+class GRAVITYGUNPLAYGROUND_API AGravityVolume : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	AGravityVolume();
+
+	//Returns the settings of the volume for a world with the supplied gravity
+	FGravityVolumeParams GetParams(float WorldGravityZ) const;
+
+	//Collects the simulating physics bodies that overlap the volume
+	void GetOverlappingBodies(TArray<UPrimitiveComponent*>& OutBodies) const;
+
+	int32 GetPriority() const { return Priority; }
+
+protected:
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+	//Shape of the volume. Only used for its extent, it doesn't collide.
+	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "Gravity")
+	UBoxComponent* Bounds = nullptr;
+
+private:
+	UPROPERTY(EditAnywhere, Category = "GravitySettings")
+	EGravityVolumeMode Mode = EGravityVolumeMode::ZeroGravity;
+
+	//Strength of the reversed gravity relative to the world gravity
+	UPROPERTY(EditAnywhere, Category = "GravitySettings")
+	float GravityScale = 1.f;
+
+	//Acceleration towards the center in the attractor mode, at the center of the volume
+	UPROPERTY(EditAnywhere, Category = "GravitySettings")
+	float AttractorAcceleration = 1500.f;
+
+	//Distance from the center at which the attractor has no effect anymore. The pull falls off linearly towards it.
+	UPROPERTY(EditAnywhere, Category = "GravitySettings")
+	float AttractorRadius = 1000.f;
+
+	//When volumes overlap, a body is only affected by the volume with the highest priority
+	UPROPERTY(EditAnywhere, Category = "GravitySettings")
+	int32 Priority = 0;
+};
@@ -0,0 +1,84 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "GravityVolume.h"
+#include "GravityVolumeManager.generated.h"
+
+class FPhysScene;
+struct FBodyInstance;
+
+//A body affected by a gravity volume this frame
+struct FGravityVolumeBody
+{
+	FBodyInstance* BodyInstance = nullptr;
+	//Index into the volume parameters of the manager
+	int32 ParamsIndex = INDEX_NONE;
+};
+
+/*
+ * Applies the gravity of all gravity volumes in the world in one batched pass per physics substep.
+ * Volume membership is refreshed with an overlap query every ggp.GravityVolume.RefreshInterval seconds.
+ * Every frame, before physics starts, the members are validated and flattened into one array of body instances,
+ * so the physics step only walks that array and doesn't touch any actor or component.
+ * Spawned once per world by the first gravity volume.
+ */
+UCLASS(NotPlaceable)
+class GRAVITYGUNPLAYGROUND_API AGravityVolumeManager : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	AGravityVolumeManager();
+
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	//Returns the manager of the world, spawning it if there is none yet
+	static AGravityVolumeManager* Get(UWorld* World);
+
+	//Returns the manager of the world, or nullptr if there is none
+	static AGravityVolumeManager* Find(UWorld* World);
+
+	void RegisterVolume(AGravityVolume* Volume);
+
+	void UnregisterVolume(AGravityVolume* Volume);
+
+	//Number of bodies affected by a volume this frame
+	int32 GetNumActiveBodies() const { return ActiveBodies.Num(); }
+
+protected:
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	UPROPERTY()
+	TArray<AGravityVolume*> Volumes;
+
+	//Members found by the last overlap refresh, with the index of the volume that affects them
+	TArray<TPair<TWeakObjectPtr<UPrimitiveComponent>, int32>> Members;
+
+	//Settings of every volume, indexed like Volumes after the last refresh. Read by the physics step, only written in the prephysics tick.
+	TArray<FGravityVolumeParams> VolumeParams;
+
+	//Validated members of this frame. Read by the physics step, only written in the prephysics tick.
+	TArray<FGravityVolumeBody> ActiveBodies;
+
+	float TimeSinceRefresh = 0.f;
+
+	FDelegateHandle PhysSceneStepHandle;
+
+	//Finds the bodies in every volume. A body in multiple volumes belongs to the one with the highest priority.
+	void RefreshMembers();
+
+	//Drops members that were destroyed, stopped simulating or are being held, and builds the arrays for the physics step
+	void BuildActiveBodies();
+
+	//Called by the physics scene before every substep, or once per frame without substepping
+	void OnPhysSceneStep(FPhysScene* PhysScene, float DeltaTime);
+};
@@ -0,0 +1,114 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "HitscanBatch.generated.h"
+
+class AGravityGunPlaygroundProjectile;
+
+//How a weapon resolves its shots
+UENUM(BlueprintType)
+enum class EGravityGunFireMode : uint8
+{
+	//Every shot spawns a projectile that flies and bounces
+	Projectile,
+	//Every shot is an instant trace, resolved together with the other shots of the frame
+	Hitscan
+};
+
+//A hitscan shot waiting to be resolved
+struct FHitscanShot
+{
+	TWeakObjectPtr<AActor> Shooter;
+	FVector Start = FVector::ZeroVector;
+	FVector Direction = FVector::ForwardVector;
+	float Range = 0.f;
+	//Speed a projectile of the weapon would have, the impulse on hit is based on it
+	float Speed = 0.f;
+};
+
+/*
+ * Resolves the hitscan shots of all weapons in the world once per frame, as one batch of traces.
+ * Large batches are traced in parallel after physics has finished, the impulses are applied on the game thread afterwards.
+ * A hit simulating component gets the same impulse a projectile of the same speed would give it on hit.
+ * ggp.Hitscan.Bench compares the frame cost of batched hitscan, hitscan resolved shot by shot and projectiles.
+ * One batch is spawned per world on first use.
+ */
+UCLASS(NotPlaceable)
+class GRAVITYGUNPLAYGROUND_API AHitscanBatch : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	AHitscanBatch();
+
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	//Returns the batch of the world, spawning it if there is none yet
+	static AHitscanBatch* Get(UWorld* World);
+
+	//Queues a shot to be resolved with the other shots of this frame
+	void QueueShot(const FHitscanShot& Shot);
+
+	//Traces all queued shots and applies their impulses
+	void ResolveShots();
+
+	//Returns the speed projectiles of the supplied class are fired with, the impulse of a hitscan shot is based on it
+	static float GetProjectileSpeed(TSubclassOf<AGravityGunPlaygroundProjectile> ProjectileClass);
+
+	//Fires shots of the supplied number of players at the supplied rate, first without shots, then with batched hitscan,
+	//then with hitscan resolved as each shot is fired and then with projectiles.
+	//Logs the average game thread time of each phase and the resolve time per shot of both hitscan phases.
+	void StartBenchmark(int32 NumPlayers, float ShotsPerSecond, float PhaseSeconds, TSubclassOf<AGravityGunPlaygroundProjectile> ProjectileClass);
+
+	int32 GetNumQueuedShots() const { return QueuedShots.Num(); }
+
+private:
+	enum class EBenchmarkPhase : uint8
+	{
+		None,
+		Baseline,
+		Hitscan,
+		HitscanPerShot,
+		Projectile
+	};
+
+	TArray<FHitscanShot> QueuedShots;
+
+	//Per shot trace results, reused between frames
+	TArray<FHitResult> Hits;
+
+	//Per shot actor ignored by the trace, resolved on the game thread before tracing
+	TArray<const AActor*> IgnoredActors;
+
+	EBenchmarkPhase BenchmarkPhase = EBenchmarkPhase::None;
+	int32 BenchmarkPlayers = 0;
+	float BenchmarkShotsPerSecond = 0.f;
+	float BenchmarkPhaseSeconds = 0.f;
+	TSubclassOf<AGravityGunPlaygroundProjectile> BenchmarkProjectileClass;
+	float PhaseTime = 0.f;
+	float ShotAccumulator = 0.f;
+	int32 PhaseShots = 0;
+	int32 PhaseFrames = 0;
+	double PhaseGameThreadMs = 0.0;
+	double PhaseResolveMs = 0.0;
+	int32 NextBenchmarkShooter = 0;
+
+	//Average game thread time, total hitscan resolve time and number of shots of the finished phases
+	double BenchmarkMs[5] = {};
+	double BenchmarkResolveMs[5] = {};
+	int32 BenchmarkShots[5] = {};
+
+	void TickBenchmark(float DeltaTime);
+
+	//Fires one benchmark shot from a muzzle on a ring around the first player
+	void FireBenchmarkShot();
+
+	void StartBenchmarkPhase(EBenchmarkPhase Phase);
+
+	void FinishBenchmark();
+};
@@ -0,0 +1,101 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "ImpulseCoalescer.generated.h"
+
+class UPrimitiveComponent;
+
+/*
+ * Collects the impulses shots apply to physics props and applies them once per body, after all systems of the frame queued theirs.
+ * Several shots hitting the same body in a frame then cost a single impulse and a single wake.
+ * Also keeps rigid body collision notifications of props enabled only while they are in flight: from being launched or pushed
+ * until they slow down below ggp.Impulse.NotifySpeed. Hits of in-flight props are passed on to the breakable props on both sides.
+ * Breakable props are also put in flight whenever they move faster than ggp.Impulse.NotifySpeed, e.g. when they fall or are knocked over.
+ * One coalescer is spawned per world on first use.
+ */
+UCLASS(NotPlaceable)
+class GRAVITYGUNPLAYGROUND_API AImpulseCoalescer : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	AImpulseCoalescer();
+
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	//Returns the coalescer of the world, spawning one if there is none yet
+	static AImpulseCoalescer* Get(UWorld* World);
+
+	//Queues an impulse at a world location. All impulses on a body are applied together at the end of the frame.
+	//Example Usage: A projectile hits a physics prop.
+	void AddImpulseAtLocation(UPrimitiveComponent* Body, const FVector& Impulse, const FVector& Location);
+
+	//Enables hit notifications of the body until it slows down again
+	//Example Usage: A prop was launched, its impacts should break breakable props.
+	void NotifyInFlight(UPrimitiveComponent* Body);
+
+	//Puts the body in flight whenever it moves faster than ggp.Impulse.NotifySpeed, however it was set in motion
+	//Example Usage: A breakable prop that falls off a ledge should break on landing.
+	void WatchBreakable(UPrimitiveComponent* Body);
+
+	//Returns whether the body was launched or pushed recently and hasn't slowed down yet
+	bool IsInFlight(UPrimitiveComponent* Body) const;
+
+	int32 GetNumInFlightBodies() const { return InFlightBodies.Num(); }
+
+protected:
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	//Sum of the impulses queued on a body this frame
+	struct FPendingImpulse
+	{
+		TWeakObjectPtr<UPrimitiveComponent> Body;
+		FVector LinearImpulse = FVector::ZeroVector;
+		//Sum of the torques of the impulses around the center of mass
+		FVector AngularImpulse = FVector::ZeroVector;
+	};
+
+	//A body with notifications enabled by the coalescer
+	struct FInFlightBody
+	{
+		//Time the body was last launched or pushed
+		float StartTime = 0.f;
+		//Whether the body had hit notifications enabled before, they are left on when its flight ends
+		bool bHadNotify = false;
+	};
+
+	TArray<FPendingImpulse> PendingImpulses;
+
+	//Index in PendingImpulses of every body with queued impulses
+	TMap<UPrimitiveComponent*, int32> PendingIndices;
+
+	//Number of impulses queued this frame
+	int32 NumQueuedImpulses = 0;
+
+	TMap<TWeakObjectPtr<UPrimitiveComponent>, FInFlightBody> InFlightBodies;
+
+	//Bodies of breakable props, checked every frame against the notify speed
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> BreakableBodies;
+
+	//Applies the summed impulses of the frame, one call per body
+	void ApplyImpulses();
+
+	//Puts the breakable bodies that move fast enough in flight
+	void UpdateBreakableBodies();
+
+	//Disables the notifications of bodies that slowed down
+	void UpdateInFlightBodies();
+
+	//Restores the notifications of the body as they were before its flight
+	void EndFlight(UPrimitiveComponent* Body, const FInFlightBody& InFlightBody);
+
+	//Passes hits of in-flight bodies on to the breakable props they hit or are
+	UFUNCTION()
+	void OnInFlightHit(UPrimitiveComponent* HitComponent, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
+};
@@ -0,0 +1,117 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "WorldCollision.h"
+#include "LaunchPreviewComponent.generated.h"
+
+class UObjectGrabberComponent;
+class UObjectLauncherComponent;
+class UPrimitiveComponent;
+class APawn;
+
+//Predicted path of a launch
+struct FLaunchPreviewResult
+{
+	TArray<FVector> Path;
+	bool bHit = false;
+	FVector HitLocation = FVector::ZeroVector;
+};
+
+/*
+ * Predicts the arc a held actor would follow if it were launched now, with the velocity the objectlauncher would give it.
+ * The arc is stepped on the game thread and every step is swept against the scene with an async sweep, at a reduced rate.
+ * The results arrive the next frame, the previous path is reused while the aim and the held actor move less than the thresholds.
+ * Only runs for the player carrying the gun. The HUD draws the path, ggp.LaunchPreview.Draw draws it with debug lines as well.
+ */
+UCLASS(Blueprintable, ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class GRAVITYGUNPLAYGROUND_API ULaunchPreviewComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	ULaunchPreviewComponent();
+
+	// Called every frame
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	//Returns whether there is a predicted path for the actor currently held
+	UFUNCTION(BlueprintCallable)
+	bool HasPrediction() const { return bHasPrediction; }
+
+	//Returns the points of the predicted path. Empty if nothing is held.
+	UFUNCTION(BlueprintCallable)
+	TArray<FVector> GetPredictedPath() const { return Prediction.Path; }
+
+	//Returns whether the predicted path ends on an obstacle, and where
+	UFUNCTION(BlueprintCallable)
+	bool GetPredictedImpact(FVector& OutLocation) const;
+
+	//Returns the launch preview of the gun the pawn carries, or nullptr
+	static ULaunchPreviewComponent* FindForCarrier(const APawn* Carrier);
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	//Seconds between two predictions
+	UPROPERTY(EditAnywhere, Category = "PreviewSettings")
+	float RefreshInterval = 0.1f;
+
+	//The prediction is only refreshed when the aim turned more than this many degrees since the last one
+	UPROPERTY(EditAnywhere, Category = "PreviewSettings")
+	float AimThresholdDegrees = 1.f;
+
+	//The prediction is only refreshed when the held actor moved more than this distance since the last one
+	UPROPERTY(EditAnywhere, Category = "PreviewSettings")
+	float MoveThreshold = 10.f;
+
+	//Seconds of flight that are predicted
+	UPROPERTY(EditAnywhere, Category = "PreviewSettings")
+	float MaxSimTime = 1.5f;
+
+	//Seconds between two points of the predicted path
+	UPROPERTY(EditAnywhere, Category = "PreviewSettings")
+	float SimStepTime = 1.f / 30.f;
+
+	UObjectGrabberComponent* ObjectGrabber = nullptr;
+
+	UObjectLauncherComponent* ObjectLauncher = nullptr;
+
+	//Path being swept and the async sweep of each of its segments, empty when no prediction is running
+	TArray<FVector> PendingPath;
+	TArray<FTraceHandle> PendingSweeps;
+
+	//Latest finished prediction
+	FLaunchPreviewResult Prediction;
+	bool bHasPrediction = false;
+
+	//Held component, aim and location the latest started prediction was made for
+	TWeakObjectPtr<UPrimitiveComponent> PredictedComponent;
+	FRotator PredictedAim = FRotator::ZeroRotator;
+	FVector PredictedStart = FVector::ZeroVector;
+
+	float TimeSinceRefresh = 0.f;
+
+	//Returns whether the gun is carried by a locally controlled pawn
+	bool IsLocallyCarried() const;
+
+	//Returns whether the cached prediction no longer matches the aim or the held component
+	bool NeedsRefresh(UPrimitiveComponent* HeldComponent, const FRotator& Aim) const;
+
+	//Steps the arc and starts an async sweep along every step
+	void StartPrediction(UPrimitiveComponent* HeldComponent, const FRotator& Aim);
+
+	//Builds the path from the results of the async sweeps once they're done
+	void CollectPrediction();
+
+	void ClearPrediction();
+
+	void DrawPrediction() const;
+};
@@ -0,0 +1,180 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "ObjectGrabberComponent.h"
+#include "MultiObjectGrabberComponent.generated.h"
+
+class UPrimitiveComponent;
+class UPropRewindComponent;
+class UAimQueryComponent;
+
+/*
+ * Component that allows the actor to scoop up several physicsactors at once and hold them in a formation in front of the view.
+ * Unlike the objectgrabber there is no physicshandle per actor. The held bodies are kept in contiguous arrays,
+ * their formation targets and drive velocities are computed in one batched pass per frame and applied in a single velocity update.
+ * Bounds are only measured at grab time, the formation is laid out from them.
+ */
+UCLASS(Blueprintable, ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class GRAVITYGUNPLAYGROUND_API UMultiObjectGrabberComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UMultiObjectGrabberComponent();
+
+	// Called every frame
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	//Scoops up actors if none are held, releases the whole group otherwise
+	UFUNCTION(BlueprintCallable)
+	virtual void ToggleGrabActors();
+
+	//Grabs the actor aimed at and the props around it, up to the maximum number of held actors
+	UFUNCTION(BlueprintCallable)
+	virtual void GrabActors();
+
+	//Grabs the supplied actors without the range, cooldown and overlap checks
+	//Example Usage: Correct a predicted grab to the group the server grabbed.
+	virtual void GrabActorsDirectly(const TArray<AActor*>& ActorsToGrab);
+
+	//Releases all held actors
+	UFUNCTION(BlueprintCallable)
+	virtual void ReleaseActors();
+
+	//Releases all held actors and returns their components
+	//Example Usage: Launch the whole group.
+	void ReleaseActorsForLaunch(TArray<UPrimitiveComponent*>& OutReleased);
+
+	UFUNCTION(BlueprintCallable)
+	int32 GetNumHeldActors() const { return HeldComponents.Num(); }
+
+	//Collects the components currently held
+	void GetHeldComponents(TArray<UPrimitiveComponent*>& OutHeld) const;
+
+	//Returns whether the component is part of the held group
+	bool IsHolding(const UPrimitiveComponent* Component) const;
+
+	//Event called when the grabber grabs a group
+	UPROPERTY(BlueprintAssignable, Category = "Interaction")
+	FGrabEvent OnGrab;
+
+	//Event called when the grabber releases its group
+	UPROPERTY(BlueprintAssignable, Category = "Interaction")
+	FGrabEvent OnRelease;
+
+	//Native versions of OnGrab and OnRelease
+	FGrabNativeEvent OnGrabNative;
+	FGrabNativeEvent OnReleaseNative;
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	//The maximum distance from which actors can be grabbed
+	UPROPERTY(EditAnywhere, Category = "GrabSettings")
+	float GrabRange = 950.f;
+
+	//Props within this distance of the aimed point are scooped up with the aimed actor
+	UPROPERTY(EditAnywhere, Category = "GrabSettings")
+	float ScoopRadius = 300.f;
+
+	//The maximum number of actors held at once
+	UPROPERTY(EditAnywhere, Category = "GrabSettings", meta = (ClampMin = "1"))
+	int32 MaxHeldActors = 8;
+
+	//Distance between the view and the nearest side of the formation
+	UPROPERTY(EditAnywhere, Category = "GrabSettings")
+	float FormationDistance = 250.f;
+
+	//Gap between neighbouring actors in the formation
+	UPROPERTY(EditAnywhere, Category = "GrabSettings")
+	float FormationSpacing = 20.f;
+
+	//Fraction of the distance to its target a held actor covers per second
+	UPROPERTY(EditAnywhere, Category = "GrabSettings")
+	float HoldStiffness = 12.f;
+
+	//Fraction of the angle to its target rotation a held actor turns per second
+	UPROPERTY(EditAnywhere, Category = "GrabSettings")
+	float RotationStiffness = 8.f;
+
+	//The maximum speed at which held actors are moved towards their targets
+	UPROPERTY(EditAnywhere, Category = "GrabSettings")
+	float MaxHoldSpeed = 3000.f;
+
+	//The maximum velocity an actor is allowed to have when releasing
+	UPROPERTY(EditAnywhere, Category = "GrabSettings")
+	float MaxActorVelocityOnRelease = 900.f;
+
+	//Held actors further than this distance from their target are dropped from the group
+	UPROPERTY(EditAnywhere, Category = "GrabSettings")
+	float ForceReleaseDistance = 800.f;
+
+	UPROPERTY(EditAnywhere, Category = "GrabSettings")
+	FGrabCooldown GrabCooldown;
+
+	//Held components and their per actor state, all arrays are indexed alike
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> HeldComponents;
+	//Rotation of every held actor relative to the view when grabbed
+	TArray<FQuat> RelativeRotations;
+	//Whether gravity was enabled on the held actor before it was grabbed
+	TArray<bool> GravityEnabled;
+	//Bounding sphere radius of every held actor, measured at grab time
+	TArray<float> Radii;
+
+	//View space offsets of the formation slots, in structure-of-arrays layout for the batched update
+	TArray<float> OffsetX, OffsetY, OffsetZ;
+	//Scratch arrays of the batched update
+	TArray<float> TargetX, TargetY, TargetZ;
+	TArray<float> LocationX, LocationY, LocationZ;
+	TArray<float> VelocityX, VelocityY, VelocityZ;
+
+	//Location of the first held component when grabbed
+	//Used to detect the first frame the group is moved
+	FVector GrabStartLocation = FVector::ZeroVector;
+
+	//Bytes reported to the memory tracker for this component
+	int64 TrackedMemoryBytes = 0;
+
+	//Root primitive of the player whose movement ignores the held components
+	TWeakObjectPtr<UPrimitiveComponent> PlayerPrimitive;
+
+	//Optional rewind component on the owner. Grabbed actors are registered to it so their movement can be rewound.
+	UPropRewindComponent* RewindComponent = nullptr;
+
+	//Aim query of the pawn carrying the gun
+	UAimQueryComponent* AimQuery = nullptr;
+
+	//The location of the viewport(and thus the player) this frame
+	FVector ViewportLocation;
+	//The rotator of the viewport(and thus the player) this frame
+	FRotator ViewportRotator;
+
+	//Updates the viewport location and rotator, from the latest view when holding in same-frame view mode
+	void UpdateViewportValues(bool bHolding);
+
+	//Moves all held actors towards their formation targets in one batched pass
+	void UpdateHeldComponents();
+
+	//Drops held components that were destroyed or stopped simulating
+	void RemoveInvalidComponents();
+
+	//Computes the formation slots from the radii of the held actors
+	void LayoutFormation();
+
+	//Starts holding the components, the first one nearest to the view, up to the maximum number of held actors
+	void HoldComponents(const TArray<UPrimitiveComponent*>& Components, const FVector& GrabLocation);
+
+	//Adds the component to the held arrays
+	void AddHeldComponent(UPrimitiveComponent* Component);
+
+	//Restores the state of the held component at the index and removes it from the held arrays
+	void RemoveHeldComponent(int32 Index, bool bLimitVelocity);
+};
@@ -4,14 +4,44 @@
 
 #include "CoreMinimal.h"
 #include "Components/ActorComponent.h"
+#include "CollisionShape.h"
 #include "ObjectGrabberComponent.generated.h"
 
 
 class UPhysicsHandleComponent;
+class UPropRewindComponent;
+class UAimQueryComponent;
+class APawn;
 
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FGrabEvent);
 DECLARE_DYNAMIC_MULTICAST_DELEGATE_OneParam(FCanGrabEvent, bool, CanGrab);
 
+//Native versions of the events for C++ listeners, fired together with the dynamic ones without going through reflection
+DECLARE_MULTICAST_DELEGATE(FGrabNativeEvent);
+DECLARE_MULTICAST_DELEGATE_OneParam(FCanGrabNativeEvent, bool);
+
+//Cooldown between a release and the next grab, shared by the objectgrabber and the multi objectgrabber
+USTRUCT()
+struct GRAVITYGUNPLAYGROUND_API FGrabCooldown
+{
+	GENERATED_BODY()
+
+	//The cooldown in seconds between consecutive grabs
+	UPROPERTY(EditAnywhere, Category = "GrabSettings")
+	float Seconds = 0.25f;
+
+	//Most recent time at which an actor was released
+	float LastReleaseTime = 0.f;
+
+	//Starts the cooldown, call when releasing
+	void Start(const UWorld* World);
+
+	bool HasReloaded(const UWorld* World) const;
+
+	//Seconds left before the next grab is allowed
+	float GetRemainingSeconds(const UWorld* World) const;
+};
+
 /*
  * Component that allows the actor to grab, release and hold physicsactors.
  */
@@ -36,6 +66,14 @@ public:
 	UFUNCTION(BlueprintCallable)
 	virtual void GrabActor();
 
+	//Grab the actor of the supplied hit, instead of the one found by linecasting from the players viewport.
+	//Example Usage: Grab the target the server resolved from a client's view.
+	virtual void GrabActorAtHit(const FHitResult& Hit);
+
+	//Grab the supplied actor without the range, cooldown and overlap checks.
+	//Example Usage: Correct a predicted grab to the actor the server grabbed.
+	virtual void GrabActorDirectly(AActor* ActorToGrab);
+
 	//Release the object currently being held
 	UFUNCTION(BlueprintCallable)
 	virtual void ReleaseActor();
@@ -52,12 +90,21 @@ public:
 	UPROPERTY(BlueprintAssignable, Category = "Interaction")
 		FCanGrabEvent OnCanGrabChanged;
 
+	//Native versions of OnGrab, OnRelease and OnCanGrabChanged
+	FGrabNativeEvent OnGrabNative;
+	FGrabNativeEvent OnReleaseNative;
+	FCanGrabNativeEvent OnCanGrabChangedNative;
+
 	//Returns whether or not there's an actor currently being held. Assigns the GrabbedActor to the supplied out parameter
 	UFUNCTION(BlueprintCallable)
 	virtual bool GetGrabbedActor(AActor*& OutGrabbedActor);
+
+	float GetGrabRange() const { return GrabRange; }
 protected:
 	// Called when the game starts
 	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
 	
 private:
 	//The maximum distance from which an actor can be grabbed
@@ -72,22 +119,28 @@ private:
 	UPROPERTY(EditAnywhere, Category = "GrabSettings")
 	float MaxActorVelocityOnRelease = 900.f;
 
-	//The cooldown in seconds between consecutive grabs
 	UPROPERTY(EditAnywhere, Category = "GrabSettings")
-	float GrabCooldownSeconds = 0.25f;
+	FGrabCooldown GrabCooldown;
 
 	//If the hovering actor is more than this distance separated from the player, it will automatically be released.
 	//If lower than the grabrange, it will automatically be set to the same value as the grabrange to prevent unintended releasing of the object.
 	UPROPERTY(EditAnywhere, Category = "GrabSettings")
 	float ForceReleaseDistance = 800.f;
 
-	//Most recent time at which an actor was released
-	float LastReleaseTime = 0.f;
-
 	//Distance at which an actor is first grabbed
 	//Used to calculate the hover distance
 	float InitialGrabDistance = 0.f;
 
+	//Location of the grabbed component when first grabbed
+	//Used to detect the first frame the physicshandle moves it
+	FVector GrabStartLocation = FVector::ZeroVector;
+
+	//Simplified shape of the grabbed component, cached when first grabbed for the hover sweep
+	FCollisionShape HoverSweepShape;
+
+	//Offset of the center of the sweep shape from the grab location, in the space of the grabbed component
+	FVector HoverSweepOffset = FVector::ZeroVector;
+
 	//Rotation of the grabbed actor when first grabbed
 	//This is later applied to the actor to keep the same relative rotation to the player
 	FQuat InitialRelativeRotation;
@@ -98,31 +151,79 @@ private:
 	//Reference to the attached physicshandle. The grabbed component will be attached to this component.
 	UPhysicsHandleComponent* PhysicsHandle = nullptr;
 
-	//Cached reference to the playercontroller, because this reference will be used every tick.
-	APlayerController* PlayerController = nullptr;
+	//Bytes reported to the memory tracker for this component and its physicshandle
+	int64 TrackedMemoryBytes = 0;
+
+	//Root primitive of the player whose movement ignores the grabbed component, and the component it ignores
+	TWeakObjectPtr<UPrimitiveComponent> PlayerPrimitive;
+	TWeakObjectPtr<UPrimitiveComponent> IgnoredComponent;
+
+	//Whether the released component still overlapped the player, and is ignored until they separate
+	bool bWaitingForSeparation = false;
+
+	//Optional rewind component on the owner. Grabbed actors are registered to it so their movement can be rewound.
+	UPropRewindComponent* RewindComponent = nullptr;
+
+	//Aim query of the pawn carrying the gun. Shared with the objectlauncher and the HUD, so the view is only traced once per frame.
+	UAimQueryComponent* AimQuery = nullptr;
+
+	//Tick prerequisites currently added for the pawn carrying the grabber
+	TWeakObjectPtr<APawn> PrerequisitePawn;
+	TWeakObjectPtr<AActor> PrerequisiteController;
+	TWeakObjectPtr<UActorComponent> PrerequisiteMovement;
+
+	//View the held actor followed in the most recent hold update, the frame of that update and whether it was the same frame's view
+	FVector HoldViewLocation = FVector::ZeroVector;
+	FRotator HoldViewRotator = FRotator::ZeroRotator;
+	uint64 HoldViewFrame = 0;
+	bool bHoldViewSameFrame = false;
 
 	//The location of the viewport(and thus the player) this frame
 	FVector ViewportLocation;
 	//The rotator of the viewport(and thus the player) this frame
 	FRotator ViewportRotator;
 
-	//Updates the viewport location and rotator 
+	//Updates the viewport location and rotator from the shared aim query
 	virtual void UpdateViewportValues();
+
+	//Orders this tick after the controller and movement of the pawn carrying the grabber, so a held actor follows this frame's view.
+	//In same-frame view mode the tick also moves to TG_PrePhysics, so the new target is simulated in the same frame.
+	void UpdateTickOrdering();
+
+	//Records how far the view the held actor followed last frame was behind the view that frame was rendered with
+	void RecordHoldViewLag();
 	
+	//Attaches the component to the physicshandle and starts holding it in front of the view
+	void HoldComponent(UPrimitiveComponent* Component);
+
 	//Updates the transform values on the grabbed component
 	virtual void UpdateGrabbedComponent();
 	
+	//Caches a box around the bounds of the grabbed component, so the hover sweep doesn't depend on its collision geometry
+	void CacheHoverSweepShape(UPrimitiveComponent* Component, const FVector& GrabLocation);
+
+	//Sweeps the cached shape from the view towards the hover target, depending on ggp.Grab.HoverSweep.
+	//Returns the target clamped in front of the first blocking geometry, so the physicshandle doesn't pull the held actor into it.
+	FVector ClampHoverTarget(UPrimitiveComponent* GrabbedComponent, const FVector& HoverTarget, const FQuat& HoverRotation);
+
 	//Updates if there's an actor in the right range and location to initiate a grab
 	//Fires an event if this state changes
 	//Example Usage: Update player crosshair color when aiming at a potential grab target
 	void UpdateActorInRange();
 
-	//Check if player is overlapping an actor
-	//Mainly used to prevent player from lifting themselves with grabbed objects
-	bool IsPlayerOverlappingActor(AActor* ActorToCheck) const;
+	//Makes the movement of the player carrying the grabber ignore the component, so the player can't stand on it and lift themselves
+	void IgnoreComponentForPlayer(UPrimitiveComponent* Component);
+
+	//Restores the collision between the player and the component passed to IgnoreComponentForPlayer
+	void RestorePlayerCollision();
+
+	//Restores the collision with a released component once it no longer overlaps the player.
+	//Restoring it while they overlap would make the movement of the player push against the component, or get stuck in it.
+	void RestorePlayerCollisionWhenSeparated();
 
 	//Returns whether all criteria have been met before grabbing an object
 	virtual bool HasReloaded();
 
-	FHitResult LineTrace(FVector CastOrigin, FVector CastDirection) const;
+	//Returns this frame's aim hit if it's within grab range. A fresh hit is traced now even when the aim trace is throttled.
+	FHitResult GetAimHit(bool bFreshTrace = false) const;
 };
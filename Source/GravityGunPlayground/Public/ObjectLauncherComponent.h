@@ -6,8 +6,14 @@
 #include "Components/ActorComponent.h"
 #include "ObjectLauncherComponent.generated.h"
 
+class UPropRewindComponent;
+class UAimQueryComponent;
+
 DECLARE_DYNAMIC_MULTICAST_DELEGATE(FLaunchEvent);
 
+//Native version of the launch events for C++ listeners, fired together with the dynamic ones without going through reflection
+DECLARE_MULTICAST_DELEGATE(FLaunchNativeEvent);
+
 /*
  * Component that allows the owner to launch physicsactors.
  */
@@ -26,9 +32,30 @@ public:
 	//Example Usage: Launch object currently being held by the player.
 	virtual void LaunchActorFromViewport(AActor* ActorToLaunch);
 
+	//Launch the supplied actor directly away from the supplied view, instead of the players viewport.
+	//Example Usage: Launch the object held for a client along the view the client sent.
+	virtual void LaunchActorFromView(AActor* ActorToLaunch, const FVector& ViewLocation, const FRotator& ViewRotation);
+
+	//Launch all supplied components directly away from the players viewport, with a single cooldown.
+	//Example Usage: Launch the group held by the multiobjectgrabber.
+	virtual void LaunchComponentsFromViewport(const TArray<UPrimitiveComponent*>& ComponentsToLaunch);
+
+	//Launch all supplied components along the supplied view rotation, with a single cooldown.
+	virtual void LaunchComponentsFromView(const TArray<UPrimitiveComponent*>& ComponentsToLaunch, const FRotator& ViewRotation);
+
 	//Tries to find an actor through linecast and launches it if found.
 	virtual void TryLaunchActorByLinecast();
 
+	//Launches the actor of the supplied hit from the hit location along the supplied view, instead of the one found by linecasting.
+	//Example Usage: Launch the target the server resolved from a client's view.
+	virtual void TryLaunchActorAtHit(const FHitResult& Hit, const FVector& ViewLocation, const FRotator& ViewRotation);
+
+	//Returns whether or not enough time has passed for the launcher to launch a new actor
+	virtual bool CanLaunch();
+
+	//Records a launch that was rejected by CanLaunch to the telemetry
+	void RecordCooldownRejection() const;
+
 	//Event called when the grabber successfully launches an object
 	UPROPERTY(BlueprintAssignable, Category = "Interaction")
 	FLaunchEvent OnLaunchSuccess;
@@ -37,6 +64,28 @@ public:
 	UPROPERTY(BlueprintAssignable, Category = "Interaction")
 	FLaunchEvent OnLaunchFail;
 
+	//Native versions of OnLaunchSuccess and OnLaunchFail
+	FLaunchNativeEvent OnLaunchSuccessNative;
+	FLaunchNativeEvent OnLaunchFailNative;
+
+	//Returns the velocity the component would have after being launched in the direction, including the velocity clamping
+	//Example Usage: Preview the trajectory of a held actor before it is launched.
+	FVector PredictLaunchVelocity(UPrimitiveComponent* Component, const FVector& LaunchDirection) const;
+
+	float GetLinearLaunchForce() const { return LinearLaunchForce; }
+
+	float GetMinimumLaunchVelocitySize() const { return MinimumLaunchVelocitySize; }
+
+	float GetMaximumLaunchVelocitySize() const { return MaximumLaunchVelocitySize; }
+
+	float GetHitRange() const { return HitRange; }
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
 private:
 	//The linear force with which an actor is launched
 	UPROPERTY(EditAnywhere, Category = "LaunchSettings")
@@ -68,19 +117,25 @@ private:
 
 	//Most recent time at which an actor was launched
 	float LastSuccesfulLaunchTime = 0.f;
+
+	//Bytes reported to the memory tracker for this component
+	int64 TrackedMemoryBytes = 0;
+
+	//Optional rewind component on the owner. Launched actors are registered to it so their movement can be rewound.
+	UPropRewindComponent* RewindComponent = nullptr;
+
+	//Aim query of the pawn carrying the gun. Shared with the objectgrabber and the HUD, so the view is only traced once per frame.
+	UAimQueryComponent* AimQuery = nullptr;
 		
 	//The location of the viewport(and thus the player) this frame
 	FVector ViewportLocation;
 	//The rotator of the viewport(and thus the player) this frame
 	FRotator ViewportRotator;
 
-	//Returns whether or not enough time has passed for the launcher to launch a new actor
-	virtual bool CanLaunch();
-
 	//Launch the supplied actor with an impulse originating from the supplied location.
 	virtual void LaunchActorFromLocation(AActor* ActorToLaunch, FVector LaunchLocation);
 
-	//Updates the Viewport's location and rotation
+	//Updates the Viewport's location and rotation from the shared aim query
 	virtual void UpdateViewportValues();
 
 	//Updates the launch direction to the players aim direction, to make sure the actor is launched in the intended direction
@@ -89,5 +144,6 @@ private:
 	UFUNCTION()
 	virtual void AdjustLaunchedComponentVelocity(UPrimitiveComponent* LaunchedComponent, FVector LaunchDirection);
 
-	FHitResult LineTrace(FVector CastOrigin, FVector CastDirection);
+	//Returns this frame's aim hit if it's within hit range, traced now even when the aim trace is throttled
+	FHitResult GetAimHit() const;
 };
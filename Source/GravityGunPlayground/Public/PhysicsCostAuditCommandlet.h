@@ -0,0 +1,68 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Commandlets/Commandlet.h"
+#include "PhysicsCostAuditCommandlet.generated.h"
+
+class UPrimitiveComponent;
+
+//Audit result of a single simulating primitive
+struct FPhysicsCostAuditEntry
+{
+	FString Name;
+	FString Mesh;
+	FString CollisionType;
+	int32 NumSimpleShapes = 0;
+	int32 NumConvexHulls = 0;
+	int32 NumHullVertices = 0;
+	int32 NumMeshVertices = 0;
+	float Mass = 0.f;
+	//Speed the launcher gives the prop before its velocity is clamped on the next frame
+	float UnclampedLaunchSpeed = 0.f;
+	FString SleepFamily;
+	bool bUseCCD = false;
+	//Relative cost estimate, see UPhysicsCostAuditCommandlet::EstimateCost
+	float EstimatedCost = 0.f;
+	//Reasons the primitive is considered an offender, empty if there are none
+	TArray<FString> Problems;
+	//Whether one of the problems is in the collision geometry, the only ones -Fix can solve
+	bool bCollisionProblem = false;
+};
+
+/*
+ * Headless audit of the physics cost of the simulating primitives in a map.
+ * Reports the collision type, simple shapes, convex hull and vertex counts, mass and sleep settings of every simulating primitive,
+ * sorted by estimated cost, and flags complex-as-simple collision, missing simple collision, heavy hulls
+ * and masses that make the objectlauncher produce speeds far outside its clamp range.
+ *
+ * Usage: UE4Editor-Cmd GravityGunPlayground -run=PhysicsCostAudit [-Map=/Game/Levels/GravityMap] [-Csv=<File>] [-Fix] [-FixThreshold=<Cost>]
+ * -Fix replaces the simple collision of static meshes with collision problems above the threshold with a single box fitted to the mesh bounds
+ * and saves them. Mass and sleep problems are only reported, the collision of those meshes is left alone.
+ */
+UCLASS()
+class GRAVITYGUNPLAYGROUND_API UPhysicsCostAuditCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+
+public:
+	UPhysicsCostAuditCommandlet();
+
+	virtual int32 Main(const FString& Params) override;
+
+	//Fills in the audit entry of a simulating primitive
+	static FPhysicsCostAuditEntry AuditComponent(const UPrimitiveComponent* Component);
+
+	//Relative cost of simulating the primitive. A sphere costs 1, convex hulls and triangle meshes scale with their vertex count.
+	static float EstimateCost(const FPhysicsCostAuditEntry& Entry);
+
+private:
+	//Logs the entries and writes them to the csv file if one is set
+	void Report(const TArray<FPhysicsCostAuditEntry>& Entries, const FString& CsvFilename) const;
+
+#if WITH_EDITOR
+	//Replaces the simple collision of the mesh with a box around its bounds and saves the package. Returns whether the mesh was saved.
+	bool RegenerateBoxCollision(class UStaticMesh* Mesh) const;
+#endif
+};
@@ -0,0 +1,107 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "PropRewindBuffer.h"
+#include "PropLagCompensation.generated.h"
+
+class UPrimitiveComponent;
+
+/*
+ * Server-side history of the grabbable props, used to resolve the grab and launch requests of clients against the props as the client saw them.
+ * Only moving props are recorded: awake physicsbody props are picked up by a periodic scan and their transforms are stored in a
+ * delta-compressed ring buffer. The slot of a prop that stayed at rest for the whole history is handed to the next prop that starts moving.
+ * Props without history at the requested time haven't moved since, and are traced where they are.
+ * ggp.LagComp.Stats reports the memory of the history and the cost of the rewound traces.
+ * One history is spawned per world on servers with remote clients.
+ */
+UCLASS(NotPlaceable)
+class GRAVITYGUNPLAYGROUND_API APropLagCompensation : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	APropLagCompensation();
+
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	//Returns the history of the world, spawning one if there is none yet. Returns nullptr on clients and in standalone games.
+	static APropLagCompensation* Get(UWorld* World);
+
+	//Returns the time of the world as the server sees it, the timeline of the history.
+	//On a client this trails the server by the trip of the replicated time, the same delay as the props it sees.
+	static double GetServerTime(const UWorld* World);
+
+	//Traces for the first physicsbody along the ray, with the moving props at their transform at the supplied server time.
+	//The time is clamped to the recorded history. The hit is moved onto the current transform of the prop, so it can be grabbed or launched directly.
+	//Example Usage: Resolve the target of a client's grab request from the view and time it sent.
+	FHitResult TraceAtTime(const FVector& Start, const FVector& Direction, float Range, double Time, const FCollisionQueryParams& Params);
+
+	int32 GetNumTrackedBodies() const { return TrackedBodies.Num(); }
+
+	//Returns the number of seconds of history that can currently be traced against
+	float GetHistorySeconds() const;
+
+	//Logs the memory of the history and the number and cost of the rewound traces
+	void LogStats() const;
+
+	void ResetStats();
+
+protected:
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	//Bodies being recorded, the index in this array is the body index in the history
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> TrackedBodies;
+
+	//Server time each slot was handed to its current body. Its history before this time belongs to the previous body.
+	TArray<double> SlotStartTimes;
+
+	//Server time each tracked body was last seen awake
+	TArray<double> LastMoveTimes;
+
+	//Slot of every tracked body
+	TMap<TWeakObjectPtr<UPrimitiveComponent>, int32> BodySlots;
+
+	FPropRewindBuffer History;
+
+	//Times of the most recent sample and scan for moving bodies
+	double LastSampleTime = -1.0;
+	double LastScanTime = -1.0;
+
+	//Bytes reported to the memory tracker for the history and the slot arrays
+	int64 TrackedMemoryBytes = 0;
+
+	//Rewound traces since the start or the last reset, how many of them hit a prop at its rewound transform, and their cost
+	int32 NumTraces = 0;
+	int32 NumRewoundHits = 0;
+	double TotalTraceMs = 0.0;
+	double WorstTraceMs = 0.0;
+
+	//States of the most recent sample. Destroyed bodies keep their last state.
+	TArray<FPropRewindState> RecordedStates;
+
+	//Scratch arrays reused between traces
+	TArray<FPropRewindState> SampledStates;
+	TBitArray<> SampledValid;
+
+	//Adds the awake physicsbody props that aren't tracked yet
+	void ScanForMovingBodies(double Time);
+
+	//Returns a free slot for a new body, reusing the slot of a destroyed body or one at rest for longer than the history.
+	//Returns INDEX_NONE if all slots are in use.
+	int32 FindFreeSlot(double Time) const;
+
+	//Records the current transforms of all tracked bodies
+	void RecordSample(double Time);
+
+	//Updates the memory tracker with the current size of the history and the slot arrays
+	void UpdateTrackedMemory();
+};
@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GenericPlatform/GenericPlatformFile.h"
+
+class UWorld;
+
+//Header at the start of every layout file
+struct FPropLayoutHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	//Size of a single record, so older readers can skip fields added by newer versions
+	uint32 RecordSize;
+	uint32 NumRecords;
+	uint32 NumMeshes;
+	//Offset of the mesh table from the start of the file. The records are stored directly after the header.
+	uint32 MeshTableOffset;
+};
+
+//Entry of the mesh table. The path is stored as UTF-8 without terminator.
+struct FPropLayoutMesh
+{
+	uint32 PathOffset;
+	uint32 PathLength;
+};
+
+//A single prop of a layout. Plain data, so a mapped file can be read in place.
+struct FPropLayoutRecord
+{
+	uint16 MeshId;
+	uint16 Flags;
+	float Location[3];
+	float Rotation[4];
+	float Scale[3];
+	//Mass override in kg, zero to use the mass computed from the mesh
+	float Mass;
+	float LinearDamping;
+	float AngularDamping;
+};
+
+/*
+ * Compact versioned binary file holding the static mesh props of a map: mesh, transform, physics settings and whether they can be grabbed.
+ * Layouts are stored next to the maps in Content/Levels/Layouts and staged as loose files, so they can be memory mapped in packaged builds too.
+ * The proplayoutloader spawns them in batches, which is much cheaper to load than the same props placed as actors in the map.
+ * Console usage: ggp.Layout.Export [Name], ggp.Layout.Bench [Name] [BudgetMs]
+ */
+class GRAVITYGUNPLAYGROUND_API FPropLayout
+{
+public:
+	static const uint32 Magic = 0x4C504747; // "GGPL"
+	static const uint32 Version = 1;
+
+	enum EFlags : uint16
+	{
+		//The prop blocks the physicsbody object type the grabbers look for, other props are world dynamic
+		Flag_Grabbable = 1 << 0,
+		Flag_Asleep = 1 << 1,
+		Flag_EnableGravity = 1 << 2
+	};
+
+	//Writes all static mesh props in the world to the output buffer
+	static void Write(UWorld* World, TArray<uint8>& OutData);
+
+	//Writes the layout of the world to the supplied file
+	static bool SaveToFile(UWorld* World, const FString& Filename);
+
+	//Returns the header of the layout, or nullptr if the data is not a valid layout
+	static const FPropLayoutHeader* GetHeader(const uint8* Data, int64 DataSize);
+
+	//Returns the record at the index of a validated layout
+	static const FPropLayoutRecord& GetRecord(const uint8* Data, uint32 Index);
+
+	//Returns the path of the mesh at the index of a validated layout
+	static FString GetMeshPath(const uint8* Data, uint32 MeshId);
+
+	//Returns the layout file of a map
+	static FString GetLayoutFilename(const FString& Name);
+};
+
+//Layout file that is memory mapped when the platform supports it and read into memory otherwise
+class GRAVITYGUNPLAYGROUND_API FPropLayoutFile
+{
+public:
+	//Opens and validates the layout. Returns false if it can't be read or is not a valid layout.
+	bool Open(const FString& Filename);
+
+	void Close();
+
+	bool IsOpen() const { return Header != nullptr; }
+
+	const FPropLayoutHeader* GetHeader() const { return Header; }
+
+	const uint8* GetData() const { return Data; }
+
+	uint32 GetNumRecords() const { return Header ? Header->NumRecords : 0; }
+
+	const FPropLayoutRecord& GetRecord(uint32 Index) const { return FPropLayout::GetRecord(Data, Index); }
+
+private:
+	//The region has to be released before the file handle, hence the declaration order
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+
+	//Contents of the file when it could not be mapped
+	TArray<uint8> FileData;
+
+	const uint8* Data = nullptr;
+	const FPropLayoutHeader* Header = nullptr;
+};
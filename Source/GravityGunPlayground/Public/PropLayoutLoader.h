@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "PropLayout.h"
+#include "PropLayoutLoader.generated.h"
+
+class AStaticMeshActor;
+class UStaticMesh;
+class UStaticMeshComponent;
+
+/*
+ * Spawns the props of a layout file in batches spread over several frames.
+ * Every frame the loader first creates the physics bodies of the props spawned in earlier frames, then spawns new props without collision,
+ * both within a per-frame time budget. Props only become visible to physics, and thus to the grabbers, once their body is created.
+ * Place one in a map next to its layout to load it. Replicated prop classes are only spawned on the server.
+ * ggp.Layout.Bench compares the load with spawning the same props as fully set up actors in a single frame, the way placed props are created.
+ */
+UCLASS()
+class GRAVITYGUNPLAYGROUND_API APropLayoutLoader : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	APropLayoutLoader();
+
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	//Opens the layout file and starts spawning its props. Returns false if the file is not a valid layout.
+	bool StartLoading(const FString& Filename);
+
+	//Spawns all props of the layout at once, with their bodies created on spawn, and destroys them again.
+	//Then loads the same layout in batches on a temporary loader and logs both load times.
+	static void Benchmark(UWorld* World, const FString& Name, float FrameBudgetMs);
+
+	bool IsLoading() const { return LayoutFile.IsOpen(); }
+
+	int32 GetNumSpawnedProps() const { return SpawnedProps.Num(); }
+
+	//Returns the layout name, or the name of the map if none is set
+	FString GetLayoutName() const;
+
+protected:
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	//Name of the layout in Content/Levels/Layouts. Uses the name of the map when empty.
+	UPROPERTY(EditAnywhere, Category = "LayoutSettings")
+	FString LayoutName;
+
+	//Class spawned for every prop. Its static mesh component is made movable to simulate.
+	UPROPERTY(EditAnywhere, Category = "LayoutSettings")
+	TSubclassOf<AStaticMeshActor> PropClass;
+
+	//Milliseconds per frame spent on spawning props and creating their bodies. At least one prop is handled per frame.
+	UPROPERTY(EditAnywhere, Category = "LayoutSettings", meta = (ClampMin = "0"))
+	float FrameBudgetMs = 2.f;
+
+	//Meshes of the layout, indexed by the mesh id of the records
+	UPROPERTY(Transient)
+	TArray<UStaticMesh*> Meshes;
+
+	FPropLayoutFile LayoutFile;
+
+	//Next record to spawn
+	uint32 NextRecord = 0;
+
+	//Props spawned by this loader, indexed like the records. The first NumPhysicsProps of them have their body created.
+	TArray<TWeakObjectPtr<AStaticMeshActor>> SpawnedProps;
+	int32 NumPhysicsProps = 0;
+
+	//Time at which loading started, and the load time measured so far
+	double LoadStartTime = 0.0;
+	double LoadMs = 0.0;
+	double WorstFrameMs = 0.0;
+	int32 LoadFrames = 0;
+
+	//Whether the load is part of ggp.Layout.Bench, which destroys the props and the loader afterwards
+	bool bBenchmark = false;
+
+	//Spawns and destroys the props of the layout the way a map creates placed props and logs the time
+	void BenchmarkPlacedProps(const FString& Filename);
+
+	//Returns whether this instance has to spawn props of the configured class
+	bool ShouldSpawnProps() const;
+
+	//Loads the meshes of the opened layout
+	void ResolveMeshes();
+
+	//Spawns the prop of the record. Without physics the prop is spawned with collision disabled, so no body is created.
+	AStaticMeshActor* SpawnProp(uint32 RecordIndex, bool bWithPhysics);
+
+	//Applies the physics settings of the record to the component, before its body is created
+	void ApplyPhysicsSettings(UStaticMeshComponent* Body, const FPropLayoutRecord& Record) const;
+
+	//Applies the physics settings of the record and creates the body of a prop spawned without physics
+	void CreatePhysics(AStaticMeshActor* Prop, const FPropLayoutRecord& Record) const;
+
+	//Closes the layout and logs the load time
+	void FinishLoading();
+};
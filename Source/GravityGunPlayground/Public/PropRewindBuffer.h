@@ -0,0 +1,107 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+//Transform of a single body in a rewind frame
+struct FPropRewindState
+{
+	FVector Location = FVector::ZeroVector;
+	FQuat Rotation = FQuat::Identity;
+};
+
+/*
+ * Fixed-size history of body transforms.
+ * Every KeyframeInterval frames a keyframe with the full state of all bodies is stored.
+ * The frames in between only hold quantized deltas for the bodies that moved since the previous frame.
+ * Frames are stored in a byte ring buffer; when it is full the oldest frames are dropped.
+ * Bodies are identified by their index in the state arrays, the owner of the buffer maps indices to components.
+ */
+class GRAVITYGUNPLAYGROUND_API FPropRewindBuffer
+{
+public:
+	//Size of a position delta step in unreal units
+	static constexpr float PositionQuantum = 1.f / 32.f;
+
+	//Creates a buffer without storage, nothing is recorded until a sized buffer is assigned to it
+	FPropRewindBuffer();
+
+	FPropRewindBuffer(int32 InCapacityBytes, int32 InMaxFrames = 300, int32 InKeyframeInterval = 30);
+
+	//Removes all frames. Keeps the allocated storage.
+	void Reset();
+
+	//Records the states of all bodies at the supplied time. Times must be increasing.
+	//The array may grow between frames when bodies are added, but indices of existing bodies must stay the same.
+	void RecordFrame(double Time, const TArray<FPropRewindState>& States);
+
+	//Number of decodable frames, starting at the oldest keyframe in the buffer
+	int32 GetNumFrames() const;
+
+	//Time of a frame. Index 0 is the oldest decodable frame.
+	double GetFrameTime(int32 FrameIndex) const;
+
+	double GetOldestTime() const;
+	double GetNewestTime() const;
+
+	//Decodes the states at the supplied time, interpolating between the two surrounding frames.
+	//OutValid is set for the bodies that had been recorded at that time. Returns false if the time is not in the buffer.
+	bool Sample(double Time, TArray<FPropRewindState>& OutStates, TBitArray<>& OutValid);
+
+	//Bytes of the ring buffer that currently hold frame data
+	int32 GetUsedBytes() const;
+
+	//Bytes allocated for the ring buffer and frame table
+	int32 GetAllocatedBytes() const;
+
+	//Average bytes of history stored per second of recorded time
+	float GetBytesPerSecond() const;
+
+private:
+	struct FFrameEntry
+	{
+		double Time = 0.0;
+		int32 Offset = 0;
+		int32 Size = 0;
+		bool bKeyframe = false;
+	};
+
+	int32 CapacityBytes;
+	int32 MaxFrames;
+	int32 KeyframeInterval;
+
+	TArray<uint8> Storage;
+	TArray<FFrameEntry> Frames;
+	int32 FirstFrame = 0;
+	int32 NumFrames = 0;
+	int32 WriteOffset = 0;
+	int32 FramesSinceKeyframe = 0;
+
+	//States as the decoder will see them. Deltas are computed against these, so quantization errors don't accumulate.
+	TArray<FPropRewindState> EncodedStates;
+	int32 NumEncodedBodies = 0;
+
+	//Decoded states of the frames of a single keyframe segment, reused while playback stays in that segment
+	TArray<TArray<FPropRewindState>> SegmentCache;
+	TArray<TBitArray<>> SegmentValidCache;
+	int32 CachedSegmentStart = INDEX_NONE;
+
+	//Scratch buffer for encoding a frame
+	TArray<uint8> FrameScratch;
+
+	const FFrameEntry& GetFrame(int32 FrameIndex) const;
+
+	//Index of the oldest keyframe, frames before it cannot be decoded
+	int32 GetFirstKeyframe() const;
+
+	//Makes room for and copies the scratch buffer into the ring
+	void AppendFrame(double Time, bool bKeyframe);
+
+	void DropOldestFrame();
+
+	//Decodes the keyframe segment containing FrameIndex into the segment cache
+	void DecodeSegment(int32 FrameIndex);
+
+	static void DecodeFrame(const uint8* Data, int32 Size, TArray<FPropRewindState>& InOutStates, TBitArray<>& InOutValid);
+};
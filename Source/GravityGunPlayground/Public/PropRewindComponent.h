@@ -0,0 +1,143 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "PropRewindBuffer.h"
+#include "PropRewindComponent.generated.h"
+
+class UPrimitiveComponent;
+
+DECLARE_DYNAMIC_MULTICAST_DELEGATE(FRewindEvent);
+
+/*
+ * Component that records the recent movement of actors grabbed or launched by the owner, and can play it back in reverse.
+ * History is kept in a fixed-size delta compressed ring buffer, so memory use doesn't depend on the session length.
+ */
+UCLASS(Blueprintable, ClassGroup=(Custom), meta=(BlueprintSpawnableComponent) )
+class GRAVITYGUNPLAYGROUND_API UPropRewindComponent : public UActorComponent
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this component's properties
+	UPropRewindComponent();
+
+	// Called every frame
+	virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+	//Starts recording the movement of the supplied actor. Only actors with a simulating root component can be tracked.
+	//Called by the grabber and launcher when they grab or launch an actor.
+	virtual void TrackActor(AActor* Actor);
+
+	//Starts playing back the recorded history in reverse
+	UFUNCTION(BlueprintCallable)
+	virtual void StartRewind();
+
+	//Stops the playback and hands the tracked bodies back to the physics simulation
+	UFUNCTION(BlueprintCallable)
+	virtual void StopRewind();
+
+	UFUNCTION(BlueprintCallable)
+	bool IsRewinding() const { return bRewinding; }
+
+	//Returns the number of seconds of history that can currently be rewound
+	UFUNCTION(BlueprintCallable)
+	float GetAvailableRewindSeconds() const;
+
+	//Average memory used per second of history
+	float GetHistoryBytesPerSecond() const { return History.GetBytesPerSecond(); }
+
+	int32 GetHistoryUsedBytes() const { return History.GetUsedBytes(); }
+
+	int32 GetNumTrackedBodies() const { return TrackedBodies.Num(); }
+
+	//Event called when a rewind starts
+	UPROPERTY(BlueprintAssignable, Category = "Interaction")
+	FRewindEvent OnRewindStart;
+
+	//Event called when a rewind stops, either by request or because the start of the history is reached
+	UPROPERTY(BlueprintAssignable, Category = "Interaction")
+	FRewindEvent OnRewindStop;
+
+protected:
+	// Called when the game starts
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	//Size of the history ring buffer. When full, the oldest history is dropped.
+	UPROPERTY(EditAnywhere, Category = "RewindSettings")
+	int32 HistoryBufferKB = 1024;
+
+	//The maximum number of seconds of history kept
+	UPROPERTY(EditAnywhere, Category = "RewindSettings")
+	float MaximumHistorySeconds = 5.f;
+
+	//The number of history samples recorded per second
+	UPROPERTY(EditAnywhere, Category = "RewindSettings")
+	float SampleRate = 60.f;
+
+	//Number of samples between two full keyframes. Samples in between only store the bodies that moved.
+	UPROPERTY(EditAnywhere, Category = "RewindSettings")
+	int32 KeyframeInterval = 30;
+
+	//The maximum number of bodies recorded at once. When exceeded, the slot of a destroyed body or of a body that was at rest
+	//for the whole history is reused, or else the body tracked the longest is replaced.
+	UPROPERTY(EditAnywhere, Category = "RewindSettings")
+	int32 MaximumTrackedBodies = 512;
+
+	//Playback speed of a rewind, relative to the recording speed
+	UPROPERTY(EditAnywhere, Category = "RewindSettings")
+	float RewindSpeed = 1.f;
+
+	//Bodies being recorded, the index in this array is the body index in the history.
+	//When a slot is reused, the history recorded for the previous body is not played back on the new one.
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> TrackedBodies;
+
+	//Prop identifiers of the tracked bodies, used to find bodies again after the prop streamer respawned them
+	TArray<uint64> TrackedIds;
+
+	//Record time of the first sample of the body in each slot, negative until it is recorded. Older history belongs to the previous body.
+	TArray<double> SlotStartTimes;
+
+	//Record time at which the body in each slot last moved
+	TArray<double> LastMoveTimes;
+
+	FPropRewindBuffer History;
+
+	//Time since the start of play, used as timeline for the history
+	double RecordTime = 0.0;
+
+	//Time of the most recent sample
+	double LastSampleTime = -1.0;
+
+	//Time in the history currently being played back
+	double PlaybackTime = 0.0;
+
+	bool bRewinding = false;
+
+	//Bytes reported to the memory tracker for the history
+	int64 TrackedMemoryBytes = 0;
+
+	//Scratch arrays reused between frames
+	TArray<FPropRewindState> BodyStates;
+	TBitArray<> ValidStates;
+
+	//Returns the tracked body, or the body of the prop respawned in its place. Returns nullptr if neither exists.
+	UPrimitiveComponent* GetTrackedBody(int32 BodyIndex);
+
+	//Returns a slot whose body was destroyed or didn't move for the whole history, or the slot tracked the longest
+	int32 FindReusableSlot();
+
+	//Records the current transforms of all tracked bodies
+	void RecordSample();
+
+	//Writes the history at the playback time to all tracked bodies
+	void ApplyPlayback();
+
+	//Updates the memory tracker with the current size of the history
+	void UpdateTrackedMemory();
+};
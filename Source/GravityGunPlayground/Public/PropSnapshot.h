@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+class UWorld;
+
+//Header at the start of every snapshot file
+struct FPropSnapshotHeader
+{
+	uint32 Magic;
+	uint32 Version;
+	//Size of a single record, so older readers can skip fields added by newer versions
+	uint32 RecordSize;
+	uint32 NumRecords;
+	double WorldTime;
+};
+
+//Physics state of a single prop. Plain data, so a mapped file can be read in place.
+struct FPropSnapshotRecord
+{
+	uint64 PropId;
+	float Location[3];
+	float Rotation[4];
+	float LinearVelocity[3];
+	//Angular velocity in radians
+	float AngularVelocity[3];
+	uint32 Flags;
+};
+
+/*
+ * Captures and restores the physics state of every simulating prop in a world.
+ * Snapshots are compact versioned binary files that are memory mapped on restore,
+ * so resetting a map is a bulk transform and velocity write instead of a level reload.
+ * Console usage: ggp.Snapshot.Save [Name], ggp.Snapshot.Restore [Name]
+ */
+class GRAVITYGUNPLAYGROUND_API FPropSnapshot
+{
+public:
+	static const uint32 Magic = 0x53504747; // "GGPS"
+	static const uint32 Version = 1;
+
+	enum EFlags : uint32
+	{
+		Flag_Asleep = 1 << 0
+	};
+
+	//Writes the state of all props in the world to the output buffer
+	static void Capture(UWorld* World, TArray<uint8>& OutData);
+
+	//Restores the props in the world from a snapshot buffer. Props that are not in the snapshot are left untouched.
+	//Returns the number of restored props, or INDEX_NONE if the data is not a valid snapshot.
+	static int32 Restore(UWorld* World, const uint8* Data, int64 DataSize);
+
+	//Captures the world and writes it to the supplied file
+	static bool SaveToFile(UWorld* World, const FString& Filename);
+
+	//Maps the supplied file and restores the world from it. Falls back to reading the file when mapping is not supported.
+	static int32 RestoreFromFile(UWorld* World, const FString& Filename);
+
+	//Returns the file used for a named snapshot in the saved directory
+	static FString GetSnapshotFilename(const FString& Name);
+};
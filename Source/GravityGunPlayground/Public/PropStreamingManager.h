@@ -0,0 +1,164 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "PropStreamingManager.generated.h"
+
+class UStaticMesh;
+class UStaticMeshComponent;
+class UMaterialInterface;
+
+//Everything needed to respawn a prop apart from its transform and motion.
+//Shared by all props with the same class, mesh, materials and body settings.
+USTRUCT()
+struct FPropStreamingArchetype
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+	UClass* ActorClass = nullptr;
+
+	UPROPERTY()
+	UStaticMesh* Mesh = nullptr;
+
+	UPROPERTY()
+	TArray<UMaterialInterface*> Materials;
+
+	//Body settings of the placed instance, the class defaults of e.g. a static mesh actor are static and not simulating
+	UPROPERTY()
+	TEnumAsByte<EComponentMobility::Type> Mobility = EComponentMobility::Movable;
+
+	UPROPERTY()
+	FName CollisionProfile;
+
+	//Only used when the collision profile is custom
+	UPROPERTY()
+	TEnumAsByte<ECollisionEnabled::Type> CollisionEnabled = ECollisionEnabled::QueryAndPhysics;
+
+	UPROPERTY()
+	TEnumAsByte<ECollisionChannel> ObjectType = ECC_PhysicsBody;
+
+	UPROPERTY()
+	FCollisionResponseContainer CollisionResponses;
+
+	UPROPERTY()
+	bool bSimulatePhysics = true;
+
+	UPROPERTY()
+	bool bEnableGravity = true;
+
+	UPROPERTY()
+	bool bOverrideMass = false;
+
+	UPROPERTY()
+	float MassInKg = 0.f;
+
+	UPROPERTY()
+	float LinearDamping = 0.f;
+
+	UPROPERTY()
+	float AngularDamping = 0.f;
+
+	//Reads the body settings of the supplied component
+	void SetBodySettings(const UStaticMeshComponent* Component);
+
+	//Applies the body settings to a component that is not registered yet
+	void ApplyBodySettings(UStaticMeshComponent* Component) const;
+
+	bool HasSameBodySettings(const FPropStreamingArchetype& Other) const;
+};
+
+//Physics state of an unloaded prop
+struct FPropStreamingRecord
+{
+	//Identifier of the prop, assigned to the respawned actor so snapshots and rewind history still find it
+	uint64 PropId;
+	uint16 Archetype;
+	uint16 Flags;
+	float Location[3];
+	float Rotation[4];
+	float Scale[3];
+	float LinearVelocity[3];
+	//Angular velocity in radians
+	float AngularVelocity[3];
+};
+
+/*
+ * Streams physics props in and out in grid cells around the players.
+ * When a cell is unloaded, the props in it are written to a compact per-cell buffer and destroyed.
+ * When it is loaded again, they are respawned with the same transform, body settings, velocity and sleep state.
+ * Props are bucketed by their current location on every update, so props moved by the grabber or launcher end up in the right cell.
+ * Place one in a map to enable streaming for that map. Only props with a static mesh root component are streamed.
+ */
+UCLASS()
+class GRAVITYGUNPLAYGROUND_API APropStreamingManager : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	// Sets default values for this actor's properties
+	APropStreamingManager();
+
+	// Called every frame
+	virtual void Tick(float DeltaTime) override;
+
+	//Returns the cell that contains the supplied location
+	FIntPoint GetCell(const FVector& Location) const;
+
+	int32 GetNumLoadedProps() const { return LoadedProps.Num(); }
+
+	int32 GetNumUnloadedProps() const;
+
+	//Bytes used by the buffers of all unloaded cells
+	int64 GetUnloadedBytes() const;
+
+protected:
+	// Called when the game starts or when spawned
+	virtual void BeginPlay() override;
+
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	//Width of a streaming cell in unreal units
+	UPROPERTY(EditAnywhere, Category = "StreamingSettings")
+	float CellSize = 4000.f;
+
+	//Number of cells around a player view that are kept loaded. 1 loads a 3x3 block of cells.
+	UPROPERTY(EditAnywhere, Category = "StreamingSettings")
+	int32 LoadRadiusCells = 1;
+
+	//Seconds between streaming updates
+	UPROPERTY(EditAnywhere, Category = "StreamingSettings")
+	float UpdateInterval = 0.5f;
+
+	UPROPERTY()
+	TArray<FPropStreamingArchetype> Archetypes;
+
+	//Props that are currently spawned and managed by this streamer
+	TArray<TWeakObjectPtr<AActor>> LoadedProps;
+
+	//Buffers of the cells that are not loaded
+	TMap<FIntPoint, TArray<FPropStreamingRecord>> UnloadedCells;
+
+	//Cells that were loaded during the last update
+	TSet<FIntPoint> LoadedCells;
+
+	float TimeSinceUpdate = 0.f;
+
+	//Loads and unloads cells based on the current player view locations
+	void UpdateStreaming();
+
+	//Collects the cells that should be loaded
+	void GetDesiredCells(TSet<FIntPoint>& OutCells) const;
+
+	//Writes the props in cells that are no longer desired to their cell buffers and destroys them
+	void UnloadProps(const TSet<FIntPoint>& DesiredCells);
+
+	//Respawns the props of a cell from its buffer
+	void LoadCell(const FIntPoint& Cell);
+
+	//Returns the archetype index for the prop, adding a new archetype when needed. Returns INDEX_NONE if the prop can't be streamed.
+	int32 FindOrAddArchetype(const AActor* Prop);
+};